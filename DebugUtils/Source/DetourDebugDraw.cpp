@@ -236,7 +236,7 @@ void duDebugDrawNavMesh(duDebugDraw* dd, const dtNavMesh& mesh, unsigned char fl
 {
 	if (!dd) return;
 	
-	for (int i = 0; i < mesh.getMaxTiles(); ++i)
+	for (int i = 0; i < mesh.getTileSlotCount(); ++i)
 	{
 		const dtMeshTile* tile = mesh.getTile(i);
 		if (!tile->header) continue;
@@ -250,7 +250,7 @@ void duDebugDrawNavMeshWithClosedList(struct duDebugDraw* dd, const dtNavMesh& m
 
 	const dtNavMeshQuery* q = (flags & DU_DRAWNAVMESH_CLOSEDLIST) ? &query : 0;
 	
-	for (int i = 0; i < mesh.getMaxTiles(); ++i)
+	for (int i = 0; i < mesh.getTileSlotCount(); ++i)
 	{
 		const dtMeshTile* tile = mesh.getTile(i);
 		if (!tile->header) continue;
@@ -267,30 +267,24 @@ void duDebugDrawNavMeshNodes(struct duDebugDraw* dd, const dtNavMeshQuery& query
 	{
 		const float off = 0.5f;
 		dd->begin(DU_DRAW_POINTS, 4.0f);
-		for (int i = 0; i < pool->getHashSize(); ++i)
+		for (int i = 0; i < pool->getNodeCount(); ++i)
 		{
-			for (dtNodeIndex j = pool->getFirst(i); j != DT_NULL_IDX; j = pool->getNext(j))
-			{
-				const dtNode* node = pool->getNodeAtIdx(j+1);
-				if (!node) continue;
-				dd->vertex(node->pos[0],node->pos[1]+off,node->pos[2], duRGBA(255,192,0,255));
-			}
+			const dtNode* node = pool->getNodeAtIdx(i+1);
+			if (!node) continue;
+			dd->vertex(node->pos[0],node->pos[1]+off,node->pos[2], duRGBA(255,192,0,255));
 		}
 		dd->end();
 		
 		dd->begin(DU_DRAW_LINES, 2.0f);
-		for (int i = 0; i < pool->getHashSize(); ++i)
+		for (int i = 0; i < pool->getNodeCount(); ++i)
 		{
-			for (dtNodeIndex j = pool->getFirst(i); j != DT_NULL_IDX; j = pool->getNext(j))
-			{
-				const dtNode* node = pool->getNodeAtIdx(j+1);
-				if (!node) continue;
-				if (!node->pidx) continue;
-				const dtNode* parent = pool->getNodeAtIdx(node->pidx);
-				if (!parent) continue;
-				dd->vertex(node->pos[0],node->pos[1]+off,node->pos[2], duRGBA(255,192,0,128));
-				dd->vertex(parent->pos[0],parent->pos[1]+off,parent->pos[2], duRGBA(255,192,0,128));
-			}
+			const dtNode* node = pool->getNodeAtIdx(i+1);
+			if (!node) continue;
+			if (!node->pidx) continue;
+			const dtNode* parent = pool->getNodeAtIdx(node->pidx);
+			if (!parent) continue;
+			dd->vertex(node->pos[0],node->pos[1]+off,node->pos[2], duRGBA(255,192,0,128));
+			dd->vertex(parent->pos[0],parent->pos[1]+off,parent->pos[2], duRGBA(255,192,0,128));
 		}
 		dd->end();
 	}
@@ -322,7 +316,7 @@ void duDebugDrawNavMeshBVTree(duDebugDraw* dd, const dtNavMesh& mesh)
 {
 	if (!dd) return;
 	
-	for (int i = 0; i < mesh.getMaxTiles(); ++i)
+	for (int i = 0; i < mesh.getTileSlotCount(); ++i)
 	{
 		const dtMeshTile* tile = mesh.getTile(i);
 		if (!tile->header) continue;
@@ -406,7 +400,7 @@ void duDebugDrawNavMeshPortals(duDebugDraw* dd, const dtNavMesh& mesh)
 {
 	if (!dd) return;
 	
-	for (int i = 0; i < mesh.getMaxTiles(); ++i)
+	for (int i = 0; i < mesh.getTileSlotCount(); ++i)
 	{
 		const dtMeshTile* tile = mesh.getTile(i);
 		if (!tile->header) continue;
@@ -419,7 +413,7 @@ void duDebugDrawNavMeshPolysWithFlags(struct duDebugDraw* dd, const dtNavMesh& m
 {
 	if (!dd) return;
 	
-	for (int i = 0; i < mesh.getMaxTiles(); ++i)
+	for (int i = 0; i < mesh.getTileSlotCount(); ++i)
 	{
 		const dtMeshTile* tile = mesh.getTile(i);
 		if (!tile->header) continue;
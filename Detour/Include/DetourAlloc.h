@@ -59,4 +59,32 @@ void* dtAlloc(size_t size, dtAllocHint hint);
 /// @see dtAlloc
 void dtFree(void* ptr);
 
+/// An allocator used by a single navigation mesh or query in place of #dtAlloc and #dtFree,
+/// so each can take its memory from its own arena, region or budget.
+/// @note The allocator must be thread safe if it is used from several threads, such as
+/// for tile data loaded by dtTileStreamer::runJob.
+/// @see dtAllocNavMesh, dtAllocNavMeshQuery
+struct dtAllocator
+{
+	virtual ~dtAllocator() {}
+
+	/// Allocates a memory block. (See: #dtAllocFunc)
+	virtual void* allocate(size_t size, dtAllocHint hint) = 0;
+
+	/// Deallocates a memory block allocated by #allocate.
+	virtual void deallocate(void* ptr) = 0;
+};
+
+/// Allocates a memory block with the allocator, or with #dtAlloc if the allocator is null.
+///  @param[in]		size		The size, in bytes of memory, to allocate.
+///  @param[in]		hint		A hint to the allocator on how long the memory is expected to be in use.
+///  @param[in]		allocator	The allocator to use. [opt]
+///  @return A pointer to the beginning of the allocated memory block, or null if the allocation failed.
+void* dtAlloc(size_t size, dtAllocHint hint, dtAllocator* allocator);
+
+/// Deallocates a memory block with the allocator, or with #dtFree if the allocator is null.
+///  @param[in]		ptr			A pointer to a memory block allocated with the same allocator.
+///  @param[in]		allocator	The allocator the block was allocated with. [opt]
+void dtFree(void* ptr, dtAllocator* allocator);
+
 #endif
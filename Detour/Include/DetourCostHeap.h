@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#ifndef DETOURCOSTHEAP_H
+#define DETOURCOSTHEAP_H
+
+#include "DetourAlloc.h"
+
+/// An item of a dtCostHeap, a polygon, link or node within a tile slot.
+/// @ingroup detour
+struct dtCostHeapItem
+{
+	float total;			///< The value the heap is ordered by. (Cost plus heuristic, or just the cost.)
+	float cost;				///< The cost from the start of the search.
+	int tile;				///< The tile slot of the item.
+	unsigned int index;		///< The polygon, link or node of the item within the tile.
+};
+
+/// A growing binary min-heap of tile items, used by the searches of the tables that keep
+/// data per tile.
+/// @ingroup detour
+class dtCostHeap
+{
+public:
+	dtCostHeap();
+	~dtCostHeap();
+
+	/// Frees the memory of the heap.
+	void purge();
+
+	/// Frees the memory of the heap and takes its memory from the allocator from now on.
+	///  @param[in]		allocator	The allocator, or null to use #dtAlloc. [opt]
+	void setAllocator(dtAllocator* allocator);
+
+	/// Removes all items, keeping the memory.
+	void clear() { m_size = 0; }
+
+	/// Adds an item, growing the heap if needed.
+	///  @param[in]		item	The item to add.
+	/// @returns False if out of memory.
+	bool push(const dtCostHeapItem& item);
+
+	/// Removes the item with the smallest total. The heap must not be empty.
+	/// @returns The removed item.
+	dtCostHeapItem pop();
+
+	/// Returns true if the heap has no items.
+	bool empty() const { return m_size == 0; }
+
+	/// Returns the memory used by the heap in bytes.
+	int getMemUsed() const { return (int)sizeof(dtCostHeapItem)*m_capacity; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtCostHeap(const dtCostHeap&);
+	dtCostHeap& operator=(const dtCostHeap&);
+
+	dtAllocator* m_allocator;
+	dtCostHeapItem* m_items;
+	int m_size;
+	int m_capacity;
+};
+
+#endif // DETOURCOSTHEAP_H
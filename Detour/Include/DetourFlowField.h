@@ -0,0 +1,175 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURFLOWFIELD_H
+#define DETOURFLOWFIELD_H
+
+#include "DetourNavMesh.h"
+#include "DetourAlloc.h"
+#include "DetourStatus.h"
+#include "DetourTileTracker.h"
+#include "DetourCostHeap.h"
+
+class dtQueryFilter;
+
+/// The cost of reaching a goal from every polygon around it, used to move many agents
+/// to the same goal without a path search per agent.
+///
+/// The field is built with a Dijkstra search backwards from the goal. Every polygon reached
+/// stores its cost to the goal and the next polygon on the way there, so an agent anywhere
+/// in the field can read its route with a few lookups.
+///
+/// Call update() after tiles have been added or removed, or after polygon flags or areas have
+/// changed. It rebuilds the field if the change touches it.
+/// @ingroup detour
+class dtFlowField
+{
+public:
+	dtFlowField();
+	~dtFlowField();
+
+	/// Prepares the field for the navigation mesh.
+	///  @param[in]		nav		The navigation mesh. Must outlive the field.
+	///  						The memory of the field is taken from its allocator. (See: dtNavMesh::getAllocator)
+	///  @param[in]		filter	The filter used to measure costs. Must outlive the field.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const dtQueryFilter* filter);
+
+	/// Builds the field for a goal.
+	///  @param[in]		goalRef		The reference id of the goal polygon.
+	///  @param[in]		goalPos		The goal position within the goal polygon. [(x, y, z)]
+	///  @param[in]		maxRadius	Polygons are not entered through portals further than this from the goal.
+	///  @param[in]		maxCost		Polygons are not entered if their cost to the goal would exceed this.
+	/// @returns The status flags for the operation.
+	dtStatus build(dtPolyRef goalRef, const float* goalPos, const float maxRadius, const float maxCost);
+
+	/// Returns true if tiles in or next to the field were added, removed, or had polygon flags
+	/// or areas changed since it was built.
+	bool isStale() const;
+
+	/// Rebuilds the field for the same goal if it is stale.
+	/// @returns The status flags for the operation. Fails if the goal polygon no longer exists,
+	/// 		 in which case the field is left empty.
+	dtStatus update();
+
+	/// Returns the cost of reaching the goal from the polygon. The cost is measured from
+	/// where the route leaves the polygon, use getCost(dtPolyRef, const float*) const to
+	/// include the way there.
+	///  @param[in]		ref		The reference of the polygon.
+	/// @returns The cost, or FLT_MAX if the polygon is not in the field.
+	float getCost(dtPolyRef ref) const;
+
+	/// Returns the cost of reaching the goal from a position within the polygon.
+	///  @param[in]		ref		The reference of the polygon.
+	///  @param[in]		pos		A position within the polygon. [(x, y, z)]
+	/// @returns The cost, or FLT_MAX if the polygon is not in the field.
+	float getCost(dtPolyRef ref, const float* pos) const;
+
+	/// Returns the next polygon on the way to the goal.
+	///  @param[in]		ref		The reference of the polygon.
+	/// @returns The next polygon, or zero for the goal polygon and polygons not in the field.
+	dtPolyRef getNextPoly(dtPolyRef ref) const;
+
+	/// Gets the portal to the next polygon on the way to the goal.
+	///  @param[in]		ref		The reference of the polygon.
+	///  @param[out]	left	The left end of the portal, or the goal position in the goal polygon. [(x, y, z)]
+	///  @param[out]	right	The right end of the portal, or the goal position in the goal polygon. [(x, y, z)]
+	/// @returns The status flags for the query.
+	dtStatus getNextPortal(dtPolyRef ref, float* left, float* right) const;
+
+	/// Gets the route from the polygon to the goal.
+	///  @param[in]		ref			The reference of the polygon.
+	///  @param[out]	path		An ordered list of polygon references. (Polygon to goal.)
+	///  							[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath		The maximum number of polygons the @p path array can hold. [Limit: >= 1]
+	/// @returns The status flags for the query.
+	dtStatus getPath(dtPolyRef ref, dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+	/// The reference id of the goal polygon.
+	dtPolyRef getGoalRef() const { return m_goalRef; }
+
+	/// The goal position.
+	const float* getGoalPos() const { return m_goalPos; }
+
+	/// The number of polygons in the field.
+	int getPolyCount() const { return m_polyCount; }
+
+	/// Returns the memory used by the field in bytes.
+	int getMemUsed() const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtFlowField(const dtFlowField&);
+	dtFlowField& operator=(const dtFlowField&);
+
+	/// Field data for a single tile slot.
+	struct TileData
+	{
+		unsigned int salt;		///< Salt of the tile the data was allocated for. (0 if the slot is empty.)
+		int x, y;				///< Location of the tile the data was allocated for.
+		int polyCount;			///< The number of polygons in the tile.
+		unsigned int stamp;		///< The build the data belongs to.
+		int oneWayCount;		///< The number of one-way off-mesh connections landing in the tile.
+		float* costs;			///< Cost to the goal from each polygon, FLT_MAX if not in the field. [Size: polyCount]
+		float* pos;				///< Where the route leaves each polygon. [(x, y, z) * polyCount]
+		dtPolyRef* next;		///< The next polygon towards the goal. [Size: polyCount]
+	};
+
+	void purge();
+	dtStatus reserveTiles();
+	void freeTileData(TileData& data);
+	dtStatus touchTile(const int tileIdx);
+	dtStatus relax(const dtCostHeapItem& item, const float* itemPos,
+				   dtPolyRef curRef, const dtMeshTile* curTile, const dtPoly* curPoly,
+				   dtPolyRef nextRef, const dtMeshTile* nextTile, const dtPoly* nextPoly,
+				   dtPolyRef prevRef, const dtMeshTile* prevTile, const dtPoly* prevPoly);
+	const TileData* getTileData(dtPolyRef ref, unsigned int& ip) const;
+	bool isNextToField(const dtMeshTile* tile) const;
+
+	const dtNavMesh* m_nav;
+	dtAllocator* m_allocator;
+	const dtQueryFilter* m_filter;
+
+	dtTileTracker m_tracker;	///< The tile slots as they were when the field was built.
+	TileData* m_tiles;
+	int m_maxTiles;			///< The number of tile slots tracked.
+	int m_tileCapacity;		///< The number of tile slots the arrays have room for.
+	unsigned int m_stamp;
+	unsigned int m_polyChangeCount;	///< Polygon change count of the mesh when the field was built.
+
+	dtPolyRef m_goalRef;
+	float m_goalPos[3];
+	float m_maxRadius;
+	float m_maxCost;
+	int m_polyCount;
+
+	dtCostHeap m_heap;
+};
+
+/// Allocates a flow field object using the Detour allocator.
+/// @return A flow field that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtFlowField* dtAllocFlowField();
+
+/// Frees the specified flow field object using the Detour allocator.
+///  @param[in]	field	A flow field allocated using #dtAllocFlowField
+///  @ingroup detour
+void dtFreeFlowField(dtFlowField* field);
+
+#endif // DETOURFLOWFIELD_H
@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURISLANDS_H
+#define DETOURISLANDS_H
+
+#include "DetourNavMesh.h"
+#include "DetourAlloc.h"
+#include "DetourStatus.h"
+#include "DetourTileTracker.h"
+
+class dtQueryFilter;
+
+/// Labels the polygons of a navigation mesh with the island they belong to, so that
+/// path queries between polygons that are not connected can be rejected without a search.
+///
+/// Two polygons are on the same island if they are connected by links, off-mesh connections
+/// included, through polygons that pass the filter. Links are treated as two-way, so polygons
+/// on the same island may still be unreachable through a one-way off-mesh connection, but
+/// polygons on different islands are never connected.
+///
+/// The polygons are labelled by the include and exclude flags of the filter the table is built
+/// with, and the query uses the table for every filter with the same flags. A filter that
+/// overrides passFilter() to decide by more than the flags must not be used with the table.
+///
+/// Call update() after tiles have been added or removed, or after polygon flags or areas have
+/// changed. Until then the table is stale: polygons of new tiles are treated as connected to
+/// everything, but a new tile joining two islands is not seen, so pairs that the tile connects
+/// are wrongly rejected.
+/// @ingroup detour
+class dtIslandTable
+{
+public:
+	dtIslandTable();
+	~dtIslandTable();
+
+	/// Labels the polygons of the navigation mesh.
+	///  @param[in]		nav		The navigation mesh. Must outlive the table.
+	///  						The memory of the table is taken from its allocator. (See: dtNavMesh::getAllocator)
+	///  @param[in]		filter	The filter whose include and exclude flags decide which polygons connect
+	///  						the islands. Only the flags are kept.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const dtQueryFilter* filter);
+
+	/// Brings the labels in sync with tiles that were added to or removed from the navigation mesh,
+	/// and with polygon flag and area changes, since the last call to init() or update().
+	/// @returns The status flags for the operation.
+	dtStatus update();
+
+	/// Returns the island of the polygon.
+	///  @param[in]		ref		The reference of the polygon.
+	/// @returns The island, or zero if the polygon does not pass the filter or is not known to the table.
+	unsigned int getIsland(dtPolyRef ref) const;
+
+	/// Returns false if there is certainly no path between the polygons.
+	///  @param[in]		from	The reference of the polygon to start from.
+	///  @param[in]		to		The reference of the polygon to reach.
+	/// @returns False if the polygons are on different islands, true otherwise.
+	bool isConnected(dtPolyRef from, dtPolyRef to) const;
+
+	/// Returns true if the filter has the include and exclude flags the table was built with.
+	///  @param[in]		filter	The filter to check.
+	bool matchesFilter(const dtQueryFilter* filter) const;
+
+	/// The include flags of the filter the table was built with.
+	unsigned short getIncludeFlags() const { return m_includeFlags; }
+
+	/// The exclude flags of the filter the table was built with.
+	unsigned short getExcludeFlags() const { return m_excludeFlags; }
+
+	/// The number of islands.
+	int getIslandCount() const { return m_islandCount; }
+
+	/// Returns the memory used by the table in bytes.
+	int getMemUsed() const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtIslandTable(const dtIslandTable&);
+	dtIslandTable& operator=(const dtIslandTable&);
+
+	/// Labels of a single tile slot.
+	struct TileData
+	{
+		unsigned int salt;		///< Salt of the tile the labels were built for. (0 if the slot is empty.)
+		int polyCount;			///< The number of polygons in the tile.
+		unsigned int* labels;	///< The label of each polygon, zero if the polygon does not pass the filter. [Size: polyCount]
+	};
+
+	void purge();
+	bool passFlags(const dtPoly* poly) const;
+	dtStatus reserveTiles();
+	void clearLabels();
+	dtStatus labelTile(const int tileIdx);
+	void connectTile(const int tileIdx);
+	unsigned int findRoot(unsigned int label);
+	void unite(unsigned int a, unsigned int b);
+	void flatten();
+
+	const dtNavMesh* m_nav;
+	dtAllocator* m_allocator;
+	unsigned short m_includeFlags;	///< Include flags of the filter the table was built with.
+	unsigned short m_excludeFlags;	///< Exclude flags of the filter the table was built with.
+	dtTileTracker m_tracker;
+
+	TileData* m_tiles;
+	int m_maxTiles;			///< The number of tile slots tracked.
+	int m_tileCapacity;		///< The number of tile slots the arrays have room for.
+	unsigned char* m_added;
+	unsigned int m_polyChangeCount;	///< Polygon change count of the mesh at the last update.
+
+	unsigned int* m_parents;	///< Union-find parent of each label. Flattened after each update.
+	int m_labelCount;
+	int m_labelCapacity;
+	int m_islandCount;
+
+	dtPolyRef* m_stack;
+	int m_stackCapacity;
+};
+
+/// Allocates an island table object using the Detour allocator.
+/// @return An island table that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtIslandTable* dtAllocIslandTable();
+
+/// Frees the specified island table object using the Detour allocator.
+///  @param[in]	table	An island table allocated using #dtAllocIslandTable
+///  @ingroup detour
+void dtFreeIslandTable(dtIslandTable* table);
+
+#endif // DETOURISLANDS_H
@@ -0,0 +1,148 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURLANDMARKS_H
+#define DETOURLANDMARKS_H
+
+#include "DetourNavMesh.h"
+#include "DetourAlloc.h"
+#include "DetourStatus.h"
+#include "DetourTileTracker.h"
+#include "DetourCostHeap.h"
+
+class dtQueryFilter;
+
+/// The maximum number of landmarks a dtLandmarkTable can hold.
+static const int DT_MAX_LANDMARKS = 16;
+
+/// Precomputed landmark distances used as an ALT (A*, landmarks, triangle inequality)
+/// heuristic by dtNavMeshQuery::findPath and the sliced path finder.
+///
+/// Distances are measured over the same graph the path finder walks: every polygon link
+/// is a vertex located at the midpoint of its portal, and moving from one link to the next
+/// costs what dtQueryFilter::getCost() reports for the segment. Each polygon stores the
+/// range [lo, hi] of the distances of the links entering it, which makes the bound
+/// independent of which portal the search actually used to reach the polygon.
+///
+/// Call update() after tiles have been added or removed; until then the stale table is still
+/// safe to use, it just gives weaker estimates for the changed area. The table does not see
+/// polygon flag or area changes, and a polygon that became passable or cheaper can make the
+/// estimates too high, which makes the paths found suboptimal. Call init() after changing flags
+/// or areas.
+/// @ingroup detour
+class dtLandmarkTable
+{
+public:
+	dtLandmarkTable();
+	~dtLandmarkTable();
+
+	/// Builds the landmark distances for the navigation mesh.
+	///  @param[in]		nav		The navigation mesh. Must outlive the table.
+	///  						The memory of the table is taken from its allocator. (See: dtNavMesh::getAllocator)
+	///  @param[in]		filter	The filter used to measure distances. Must stay valid while update() is used.
+	///  @param[in]		count	The number of landmarks. [Limits: 0 < value <= #DT_MAX_LANDMARKS]
+	///  @param[in]		refs	The landmark polygons, or null to pick them automatically. [(polyRef) * @p count] [opt]
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const dtQueryFilter* filter, const int count, const dtPolyRef* refs = 0);
+
+	/// Brings the table in sync with tiles that were added to or removed from the navigation mesh
+	/// since the last call to init() or update(). Only the affected area is recomputed.
+	/// @returns The status flags for the operation.
+	dtStatus update();
+
+	/// Returns a lower bound of the cost of travelling from polygon @p from to polygon @p to.
+	///  @param[in]		from	The reference of the polygon to start from.
+	///  @param[in]		to		The reference of the polygon to reach.
+	/// @returns The lower bound, or zero if the table knows nothing about either polygon.
+	float getHeuristic(dtPolyRef from, dtPolyRef to) const;
+
+	/// The number of landmarks in the table.
+	int getLandmarkCount() const { return m_count; }
+
+	/// Returns the polygon reference of the specified landmark.
+	dtPolyRef getLandmark(const int i) const { return m_landmarks[i]; }
+
+	/// The navigation mesh the table was built for.
+	const dtNavMesh* getNavMesh() const { return m_nav; }
+
+	/// Returns the memory used by the table in bytes.
+	int getMemUsed() const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtLandmarkTable(const dtLandmarkTable&);
+	dtLandmarkTable& operator=(const dtLandmarkTable&);
+
+	/// Landmark data for a single tile slot.
+	struct TileData
+	{
+		unsigned int salt;		///< Salt of the tile the data was built for. (0 if the slot is empty.)
+		int x, y;				///< Location of the tile the data was built for.
+		int linkCount;			///< The number of links covered by the arrays below.
+		int polyCount;			///< The number of polygons covered by the arrays below.
+		unsigned short* owner;	///< The polygon owning each link, or 0xffff for unused links. [Size: linkCount]
+		float* pos;				///< The portal midpoint of each link. [(x, y, z) * linkCount]
+		float* dist;			///< The distance of each link from each landmark. [Size: linkCount * landmark count]
+		float* range;			///< The [lo, hi] distance of each polygon from each landmark. [Size: polyCount * landmark count * 2]
+	};
+
+	void purge();
+	dtStatus reserveTiles();
+	void freeTileData(TileData& data);
+	bool allocTileData(TileData& data, const dtMeshTile* tile);
+	void refreshLinks(const int tileIdx);
+	void markNeighbours(const int x, const int y, const int radius, const unsigned char flag);
+	bool push(const float dist, const int tile, const unsigned int link);
+	bool pushLandmark(const int l);
+	dtStatus propagate(const int l);
+	dtStatus computeLandmark(const int l);
+	void updateRanges(const int tileIdx);
+	void updateSymmetry();
+	dtPolyRef findSeed() const;
+	dtPolyRef pickNextLandmark(const int count) const;
+	const float* getRanges(dtPolyRef ref) const;
+
+	const dtNavMesh* m_nav;
+	dtAllocator* m_allocator;
+	const dtQueryFilter* m_filter;
+	dtTileTracker m_tracker;
+	int m_count;			///< The number of landmarks placed.
+	int m_stride;			///< The number of landmarks the per link and per polygon arrays have room for.
+	dtPolyRef m_landmarks[DT_MAX_LANDMARKS];
+	bool m_symmetric;		///< True if every link can also be travelled backwards, enabling the reverse bound.
+
+	TileData* m_tiles;
+	int m_maxTiles;			///< The number of tile slots tracked.
+	int m_tileCapacity;		///< The number of tile slots the arrays have room for.
+	unsigned char* m_marks;
+	unsigned char* m_fresh;
+
+	dtCostHeap m_heap;
+};
+
+/// Allocates a landmark table object using the Detour allocator.
+/// @return A landmark table that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtLandmarkTable* dtAllocLandmarkTable();
+
+/// Frees the specified landmark table object using the Detour allocator.
+///  @param[in]	table	A landmark table allocated using #dtAllocLandmarkTable
+///  @ingroup detour
+void dtFreeLandmarkTable(dtLandmarkTable* table);
+
+#endif // DETOURLANDMARKS_H
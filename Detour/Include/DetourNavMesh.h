@@ -23,7 +23,8 @@
 #include "DetourStatus.h"
 
 // Undefine (or define in a build cofnig) the following line to use 64bit polyref.
-// Generally not needed, useful for very large worlds.
+// Generally not needed, useful for very large worlds: with 64bit refs a navigation mesh can
+// address 2^28 tiles, and maxTiles can be left at 0 to use all of them.
 // Note: tiles build using 32bit refs are not compatible with 64bit refs!
 //#define DT_POLYREF64 1
 
@@ -34,8 +35,7 @@
 #include <stdint.h>
 #endif
 
-// Note: If you want to use 64-bit refs, change the types of both dtPolyRef & dtTileRef.
-// It is also recommended that you change dtHashRef() to a proper 64-bit hash.
+// Note: With 64-bit refs, dtHashRef() and the tile position hash mix all bits of the 64-bit values.
 
 /// A handle to a polygon within a navigation mesh tile.
 /// @ingroup detour
@@ -71,7 +71,8 @@ static const int DT_VERTS_PER_POLYGON = 6;
 static const int DT_NAVMESH_MAGIC = 'D'<<24 | 'N'<<16 | 'A'<<8 | 'V';
 
 /// A version number used to detect compatibility of navigation tile data.
-static const int DT_NAVMESH_VERSION = 7;
+/// Version 8 added the sorted border edges.
+static const int DT_NAVMESH_VERSION = 8;
 
 /// A magic number used to detect the compatibility of navigation tile states.
 static const int DT_NAVMESH_STATE_MAGIC = 'D'<<24 | 'N'<<16 | 'M'<<8 | 'S';
@@ -79,6 +80,13 @@ static const int DT_NAVMESH_STATE_MAGIC = 'D'<<24 | 'N'<<16 | 'M'<<8 | 'S';
 /// A version number used to detect compatibility of navigation tile states.
 static const int DT_NAVMESH_STATE_VERSION = 1;
 
+/// A magic number used to detect navigation mesh images. (See: dtNavMesh::storeImage)
+static const int DT_NAVMESH_IMAGE_MAGIC = 'D'<<24 | 'N'<<16 | 'M'<<8 | 'I';
+
+/// A version number used to detect compatibility of navigation mesh images.
+/// Version 2 aligned the tile index for the 64-bit tile references.
+static const int DT_NAVMESH_IMAGE_VERSION = 2;
+
 /// @}
 
 /// A flag that indicates that an entity links to an external entity.
@@ -106,7 +114,12 @@ enum dtTileFlags
 {
 	/// The navigation mesh owns the tile memory and is responsible for freeing it.
 	/// ӵtileڴ沢ͷ
+	/// The memory is freed with the allocator of the navigation mesh. (See: #dtAllocNavMesh)
 	DT_TILE_FREE_DATA = 0x01,
+
+	/// The links of each polygon are kept next to each other in dtMeshTile::links, in the order
+	/// they are visited, and are compacted again whenever the links of the tile change.
+	DT_TILE_COMPACT_LINKS = 0x02,
 };
 
 /// Vertex flags returned by dtNavMeshQuery::findStraightPath.
@@ -126,11 +139,12 @@ enum dtStraightPathOptions
 };
 
 
-/// Options for dtNavMeshQuery::initSlicedFindPath and updateSlicedFindPath
+/// Options for dtNavMeshQuery::findPath, initSlicedFindPath and updateSlicedFindPath
 /// ·ڼʹraycastݡ(raycastȻǳɱ)
 enum dtFindPathOptions
 {
 	DT_FINDPATH_ANY_ANGLE	= 0x02,		///< use raycasts during pathfind to "shortcut" (raycast still consider costs)
+	DT_FINDPATH_BIDIRECTIONAL	= 0x04,	///< search from both the start and the end polygon, meeting in between
 };
 
 /// Options for dtNavMeshQuery::raycast
@@ -237,6 +251,20 @@ struct dtBVNode
 	int i;							///< The node's index. (Negative for escape sequence.)///<ڵ(תС)
 };
 
+/// A portal edge on the border of a tile, used to connect the tile with its neighbours.
+/// The edges of a tile are sorted by side, and by their start along the border.
+/// @note This structure is rarely if ever used by the end user.
+/// @see dtMeshTile
+struct dtBorderEdge
+{
+	float min;						///< The start of the edge along the border. (z for sides 0 and 4, x otherwise.)
+	float max;						///< The end of the edge along the border.
+	float reach;					///< The largest end of this and the preceding edges on the same side.
+	unsigned short poly;			///< The index of the polygon.
+	unsigned char edge;				///< The index of the edge in the polygon.
+	unsigned char side;				///< The side of the tile the edge is on.
+};
+
 /// Defines an navigation mesh off-mesh connection within a dtMeshTile object.
 /// An off-mesh connection is a user defined traversable connection made up to two vertices.
 /// dtMeshTileжһӡɵûĿɱӡ
@@ -290,6 +318,7 @@ struct dtMeshHeader
 	int detailTriCount;			///< The number of triangles in the detail mesh.///< ϸε
 	int bvNodeCount;			///< The number of bounding volume nodes. (Zero if bounding volumes are disabled.)///< Χڵ(˱߽Ϊ㡣)
 	int offMeshConCount;		///< The number of off-mesh connections.///< ӵ
+	int borderEdgeCount;		///< The number of portal edges on the borders of the tile.
 	int offMeshBase;			///< The index of the first polygon which is an off-mesh connection.///< һεһӡ
 	float walkableHeight;		///< The height of the agents using the tile.///< ߵĸ߶ȡ
 	float walkableRadius;		///< The radius of the agents using the tile.///< ߵİ뾶
@@ -326,10 +355,13 @@ struct dtMeshTile
 	dtBVNode* bvTree;
 
 	dtOffMeshConnection* offMeshCons;		///< The tile off-mesh connections. [Size: dtMeshHeader::offMeshConCount]
+	dtBorderEdge* borderEdges;				///< The portal edges on the tile borders. [Size: dtMeshHeader::borderEdgeCount]
 		
 	unsigned char* data;					///< The tile data. (Not directly accessed under normal situations.)
 	int dataSize;							///< Size of the tile data.
 	int flags;								///< Tile flags. (See: #dtTileFlags)
+	unsigned int revision;					///< Counter of changes to the tile's polygon flags, areas and links.
+	unsigned int index;						///< The index of the tile slot. (See: dtNavMesh::getTile)
 	dtMeshTile* next;						///< The next free tile, or the next tile in the spatial grid.
 private:
 	dtMeshTile(const dtMeshTile&);
@@ -346,17 +378,31 @@ struct dtNavMeshParams
 	float orig[3];					///< The world space origin of the navigation mesh's tile space. [(x, y, z)]///< Ƭռռԭ㡣[xyz]
 	float tileWidth;				///< The width of each tile. (Along the x-axis.)///< ÿשĿȡXᡣ
 	float tileHeight;				///< The height of each tile. (Along the z-axis.)///< ÿשĸ߶ȡZᡣ
-	int maxTiles;					///< The maximum number of tiles the navigation mesh can contain.///< ԰Ƭ
+	int maxTiles;					///< The maximum number of tiles the navigation mesh can contain. (0 for #DT_TILE_BITS with #DT_POLYREF64.)///< ԰Ƭ
 	int maxPolys;					///< The maximum number of polygons each tile can contain.///< ÿƬ԰
 };
 
+/// Runs the independent tasks of a batch operation, e.g. on a thread pool. (See: dtNavMesh::addTiles)
+/// @ingroup detour
+struct dtTaskRunner
+{
+	virtual ~dtTaskRunner() { }
+
+	/// Calls task(context, i) once for each i in [0, count), in any order and on any threads,
+	/// and returns when all calls have returned.
+	virtual void run(void (*task)(void* context, int index), void* context, int count) = 0;
+};
+
 /// A navigation mesh based on tiles of convex polygons.
 /// ͹ηֿĵ
 /// @ingroup detour
 class dtNavMesh
 {
 public:
-	dtNavMesh();
+	/// Creates an empty navigation mesh.
+	///  @param[in]	allocator	The allocator of the memory of the navigation mesh, or null
+	///  						to use #dtAlloc. Must outlive the navigation mesh. [opt]
+	explicit dtNavMesh(dtAllocator* allocator = 0);
 	~dtNavMesh();
 
 	/// @{
@@ -374,10 +420,31 @@ public:
 	/// @return The status flags for the operation.
 	///  @see dtCreateNavMeshData
 	dtStatus init(unsigned char* data, const int dataSize, const int flags);
+
+	/// Initializes the navigation mesh from an image stored by #storeImage. The tiles use the
+	/// data in the image in place, with the links stored in it.
+	///  @param[in]	data		The image. Must stay valid until the navigation mesh is freed. [Limit: 4 byte aligned]
+	///  @param[in]	dataSize	The size of the image.
+	///  @param[in]	flags		The tile flags. (See: #dtTileFlags) #DT_TILE_FREE_DATA is ignored.
+	/// @return The status flags for the operation.
+	dtStatus initFromImage(unsigned char* data, const int dataSize, const int flags);
+
+	/// Gets the size of the buffer required by #storeImage to store the navigation mesh.
+	/// @return The size of the buffer required to store the navigation mesh.
+	int getImageSize() const;
+
+	/// Stores the navigation mesh parameters and all tiles, links included, in one buffer.
+	///  @param[out]	data			The buffer to store the image in.
+	///  @param[in]		maxDataSize		The size of the data buffer. [Limit: >= #getImageSize]
+	/// @return The status flags for the operation.
+	dtStatus storeImage(unsigned char* data, const int maxDataSize) const;
 	
 	/// The navigation mesh initialization params.
 	const dtNavMeshParams* getParams() const;
 
+	/// The allocator of the navigation mesh, or null if it uses #dtAlloc.
+	dtAllocator* getAllocator() const { return m_allocator; }
+
 	/// Adds a tile to the navigation mesh.
 	///  @param[in]		data		Data for the new tile mesh. (See: #dtCreateNavMeshData)
 	///  @param[in]		dataSize	Data size of the new tile mesh.
@@ -386,6 +453,19 @@ public:
 	///  @param[out]	result		The tile reference. (If the tile was succesfully added.) [opt]
 	/// @return The status flags for the operation.
 	dtStatus addTile(unsigned char* data, int dataSize, int flags, dtTileRef lastRef, dtTileRef* result);
+
+	/// Adds several tiles to the navigation mesh, and links them once all of them are in place.
+	///  @param[in]		data		Data for the new tile meshes. (See: #dtCreateNavMeshData) [Size: count]
+	///  @param[in]		dataSize	Data sizes of the new tile meshes. [Size: count]
+	///  @param[in]		count		The number of tiles to add.
+	///  @param[in]		flags		Tile flags of the new tiles. (See: #dtTileFlags)
+	///  @param[in]		lastRefs	The desired references for the tiles. (When reloading tiles.) [opt] [Size: count]
+	///  @param[in]		runner		Runs the linking of the tiles in parallel. Without it the tiles are
+	///  						linked on the calling thread. [opt]
+	///  @param[out]	results		The tile references. (If the tiles were succesfully added.) [opt] [Size: count]
+	/// @return The status flags for the operation.
+	dtStatus addTiles(unsigned char** data, const int* dataSize, const int count, const int flags,
+					  const dtTileRef* lastRefs, dtTaskRunner* runner, dtTileRef* results);
 	
 	/// Removes the specified tile from the navigation mesh.
 	///  @param[in]		ref			The reference of the tile to remove.
@@ -449,9 +529,21 @@ public:
 	/// Gets the tile at the specified index.
 	/// ȡָλôƬ
 	///  @param[in]	i		The tile index. [Limit: 0 >= index < #getMaxTiles()]
-	/// @return The tile at the specified index.
+	/// @return The tile at the specified index. (An empty tile if the slot has never been used.)
 	const dtMeshTile* getTile(int i) const;
 
+	/// The number of tile slots in use or used before. Tiles with higher indices are empty.
+	/// @return The number of tile slots created by the navigation mesh.
+	int getTileSlotCount() const { return m_tileCount; }
+
+	/// The number of tiles added since the navigation mesh was initialized.
+	/// @return The number of tiles added since the navigation mesh was initialized.
+	unsigned int getTileAddCount() const;
+
+	/// The number of changes to polygon flags and areas since the navigation mesh was initialized.
+	/// @return The number of polygon flag and area changes since the navigation mesh was initialized.
+	unsigned int getPolyChangeCount() const;
+
 	/// Gets the tile and polygon for the specified polygon reference.
 	///  @param[in]		ref		The reference for the a polygon.
 	///  @param[out]	tile	The tile containing the polygon.
@@ -490,6 +582,47 @@ public:
 	///  @param[in]	ref		The polygon reference of the off-mesh connection.
 	/// @return The specified off-mesh connection, or null if the polygon reference is not valid.
 	const dtOffMeshConnection* getOffMeshConnectionByRef(dtPolyRef ref) const;
+
+	/// Gets the point where a path crossing the link enters the linked polygon.
+	/// This is the midpoint of the portal, or the off-mesh connection endpoint.
+	///  @param[in]		fromRef		The reference of the polygon owning the link.
+	///  @param[in]		fromTile	The tile containing the polygon owning the link.
+	///  @param[in]		fromPoly	The polygon owning the link.
+	///  @param[in]		link		The link to the neighbour polygon.
+	///  @param[out]	mid			The crossing point. [(x, y, z)]
+	void getLinkMidPoint(dtPolyRef fromRef, const dtMeshTile* fromTile, const dtPoly* fromPoly,
+						 const dtLink* link, float* mid) const;
+
+	/// Gets the portal a path crossing the link passes through. Both ends are the
+	/// crossing point of getLinkMidPoint() if either polygon is an off-mesh connection.
+	///  @param[in]		fromRef		The reference of the polygon owning the link.
+	///  @param[in]		fromTile	The tile containing the polygon owning the link.
+	///  @param[in]		fromPoly	The polygon owning the link.
+	///  @param[in]		link		The link to the neighbour polygon.
+	///  @param[out]	left		The left end of the portal. [(x, y, z)]
+	///  @param[out]	right		The right end of the portal. [(x, y, z)]
+	void getLinkPortal(dtPolyRef fromRef, const dtMeshTile* fromTile, const dtPoly* fromPoly,
+					   const dtLink* link, float* left, float* right) const;
+
+	/// Checks if the polygon has a link to the specified polygon.
+	///  @param[in]		tile	The tile containing the polygon.
+	///  @param[in]		poly	The polygon.
+	///  @param[in]		ref		The reference of the linked polygon.
+	/// @return True if the polygon has a link to @p ref.
+	bool hasLinkTo(const dtMeshTile* tile, const dtPoly* poly, dtPolyRef ref) const;
+
+	/// Checks if the off-mesh connection lands in the tile at the specified location.
+	///  @param[in]		tile	The tile containing the off-mesh connection.
+	///  @param[in]		con		The off-mesh connection.
+	///  @param[in]		x		The x-location of the tile.
+	///  @param[in]		y		The y-location of the tile.
+	/// @return True if the end point of the connection is in the tile at (@p x, @p y).
+	bool offMeshConLandsAt(const dtMeshTile* tile, const dtOffMeshConnection* con, const int x, const int y) const;
+
+	/// Counts the one-way off-mesh connections landing in the tile.
+	///  @param[in]		tile	The tile.
+	/// @return The number of one-way off-mesh connections of the tile and its neighbours ending in the tile.
+	int countOneWayOffMeshConnections(const dtMeshTile* tile) const;
 	
 	/// @}
 
@@ -638,8 +771,14 @@ private:
 	dtNavMesh(const dtNavMesh&);
 	dtNavMesh& operator=(const dtNavMesh&);
 
-	/// Returns pointer to tile in the tile array.
-	dtMeshTile* getTile(int i);
+	/// Returns the tile slot at the index. [Limit: 0 >= index < #m_tileCount]
+	dtMeshTile* getTileSlot(unsigned int i) const;
+
+	/// Creates the tile slots up to the count and appends them to the free list.
+	dtStatus createTileSlots(int count);
+
+	/// Inserts the tile in the position lookup, growing the lookup when it gets crowded.
+	void insertTileLookup(dtMeshTile* tile);
 
 	/// Returns neighbour tile based on side.
 	int getTilesAt(const int x, const int y,
@@ -668,6 +807,25 @@ private:
 	
 	/// Removes external links at specified side.
 	void unconnectLinks(dtMeshTile* tile, dtMeshTile* target);
+
+	/// Points the tile at the sections of its data.
+	void patchTilePointers(dtMeshTile* tile, unsigned char* data);
+
+	/// Puts the tile data in a tile slot and the position lookup, without any links.
+	dtStatus insertTile(unsigned char* data, int dataSize, int flags, dtTileRef lastRef, dtMeshTile** result);
+
+	/// Builds the links of an inserted tile and connects it with its neighbours.
+	void connectTile(dtMeshTile* tile);
+
+	/// Builds the external links between two tiles in both directions.
+	void connectTilePair(dtMeshTile* tile, dtMeshTile* nei, int side);
+
+	/// Tasks of #addTiles: builds the links inside a tile, and connects the tiles of a tile location.
+	static void linkTileTask(void* context, int index);
+	static void connectCellTask(void* context, int index);
+
+	/// Moves the links of each polygon next to each other, if the tile has #DT_TILE_COMPACT_LINKS set.
+	void compactLinks(dtMeshTile* tile);
 	
 
 	// TODO: These methods are duplicates from dtNavMeshQuery, but are needed for off-mesh connection finding.
@@ -684,6 +842,7 @@ private:
 	/// ĵڶ
 	void closestPointOnPoly(dtPolyRef ref, const float* pos, float* closest, bool* posOverPoly) const;
 	
+	dtAllocator* m_allocator;			///< Allocator of the memory of the mesh. (Null for dtAlloc.)
 	dtNavMeshParams m_params;			///< Current initialization params. TODO: do not store this info twice.///< ǰʼTODO:ҪϢ洢
 	float m_orig[3];					///< Origin of the tile (0,0)///< Ƭԭ
 	float m_tileWidth, m_tileHeight;	///< Dimensions of each tile.///< Ƭĳߴ
@@ -692,8 +851,13 @@ private:
 	int m_tileLutMask;					///< Tile hash lookup mask.///< Ƭϣλ
 
 	dtMeshTile** m_posLookup;			///< Tile hash lookup.///< Ƭϣ
+	int m_posLookupCount;				///< Number of tiles in the hash lookup.
 	dtMeshTile* m_nextFree;				///< Freelist of tiles.///< ƬͷŽڵlist
-	dtMeshTile* m_tiles;				///< List of tiles.///<Ƭlist
+	dtMeshTile** m_tilePages;			///< Pages of tile slots, allocated as the slots are used.
+	int m_tilePageCapacity;				///< Size of the page table.
+	int m_tileCount;					///< Number of tile slots created.
+	unsigned int m_tileAddCount;		///< Number of tiles added since init.
+	unsigned int m_polyChangeCount;		///< Number of polygon flag and area changes since init.
 		
 #ifndef DT_POLYREF64
 	unsigned int m_saltBits;			///< Number of salt bits in the tile ID.
@@ -713,6 +877,12 @@ dtNavMesh* dtAllocNavMesh();
 ///  @ingroup detour
 void dtFreeNavMesh(dtNavMesh* navmesh);
 
+/// Allocates a navigation mesh object that takes all of its memory from the allocator.
+///  @param[in]	allocator	The allocator. Must outlive the navigation mesh.
+/// @return A navigation mesh that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtNavMesh* dtAllocNavMesh(dtAllocator* allocator);
+
 #endif // DETOURNAVMESH_H
 
 ///////////////////////////////////////////////////////////////////////////
@@ -20,6 +20,7 @@
 #define DETOURNAVMESHBUILDER_H
 
 #include "DetourAlloc.h"
+#include "DetourNavMesh.h"
 
 /// Represents the source data used to build an navigation mesh tile.
 /// @ingroup detour
@@ -101,6 +102,10 @@ struct dtNavMeshCreateParams
 	/// @note The BVTree is not normally needed for layered navigation meshes.
 	bool buildBvTree;
 
+	/// The allocator of the tile data, or null to use #dtAlloc. Use the allocator of the
+	/// navigation mesh if the mesh is to own the data. (See: dtNavMesh::getAllocator) [opt]
+	dtAllocator* allocator;
+
 	/// @}
 };
 
@@ -122,6 +127,37 @@ bool dtNavMeshHeaderSwapEndian(unsigned char* data, const int dataSize);
 ///  @param[in]		dataSize	The size of the data array.
 bool dtNavMeshDataSwapEndian(unsigned char* data, const int dataSize);
 
+/// A version number used to detect tile data in the quantized storage format. (See: #dtQuantizeNavMeshData)
+static const int DT_NAVMESH_QUANTIZED_VERSION = DT_NAVMESH_VERSION | 0x100;
+
+/// Encodes tile data in a smaller storage format, with the polygon and detail mesh vertices stored
+/// as 16 bit steps of a fraction of the cell size and without the space for the links.
+/// The data must be decoded with #dtDequantizeNavMeshData before it is added to a navigation mesh,
+/// so the format reduces the size of stored tiles, not the memory of loaded ones.
+///  @param[in]		data		The tile data array.
+///  @param[in]		dataSize	The size of the data array.
+///  @param[out]	outData		The quantized tile data. Allocated with #dtAlloc.
+///  @param[out]	outDataSize	The size of the quantized tile data array.
+/// @return True if the tile data was successfully converted.
+bool dtQuantizeNavMeshData(const unsigned char* data, const int dataSize, unsigned char** outData, int* outDataSize);
+
+/// Decodes tile data stored by #dtQuantizeNavMeshData back to tile data that can be added to a navigation mesh.
+///  @param[in]		data		The quantized tile data array.
+///  @param[in]		dataSize	The size of the data array.
+///  @param[out]	outData		The tile data. Allocated with @p allocator.
+///  @param[out]	outDataSize	The size of the tile data array.
+///  @param[in]		allocator	The allocator of the tile data, or null to use #dtAlloc. [opt]
+/// @return True if the tile data was successfully converted.
+bool dtDequantizeNavMeshData(const unsigned char* data, const int dataSize, unsigned char** outData, int* outDataSize,
+							 dtAllocator* allocator = 0);
+
+/// Returns the largest distance along each axis between a vertex of quantized tile data and the original vertex.
+///  @param[in]		data		The quantized tile data array.
+///  @param[in]		dataSize	The size of the data array.
+///  @param[out]	error		The maximum error along each axis. [(x, y, z)]
+/// @return True if the data is quantized tile data.
+bool dtGetQuantizedNavMeshDataError(const unsigned char* data, const int dataSize, float* error);
+
 #endif // DETOURNAVMESHBUILDER_H
 
 // This section contains detailed documentation for members that don't have
@@ -19,8 +19,15 @@
 #ifndef DETOURNAVMESHQUERY_H
 #define DETOURNAVMESHQUERY_H
 
+#include <float.h>
+#include <limits.h>
+#include <string.h>
 #include "DetourNavMesh.h"
+#include "DetourNode.h"
 #include "DetourStatus.h"
+#include "DetourCommon.h"
+#include "DetourAssert.h"
+#include "DetourTime.h"
 
 
 // Define DT_VIRTUAL_QUERYFILTER if you wish to derive a custom filter from dtQueryFilter.
@@ -34,6 +41,99 @@
 
 //#define DT_VIRTUAL_QUERYFILTER 1
 
+// Define DT_QUERY_STATS to count the work done by the queries of dtNavMeshQuery, see dtQueryStats.
+// Without it the counting code is compiled out and the statistics stay zero.
+
+//#define DT_QUERY_STATS 1
+
+// dtNavMeshQuery::findPath, raycast and moveAlongSurface are also templates on the filter type.
+// A custom filter class passed to them is called directly, without DT_VIRTUAL_QUERYFILTER.
+
+/// Scale applied to the search heuristic, slightly below one so that it never overestimates.
+static const float DT_QUERY_HEURISTIC_SCALE = 0.999f;
+
+/// Node state of the backward half of the bidirectional path searches.
+static const unsigned char DT_BACKWARD_NODE_STATE = 1;
+
+/// A handle to a sliced path query started with dtNavMeshQuery::initSlicedFindPath(..., dtSlicedSearchRef*).
+/// Zero is never a valid handle.
+typedef unsigned int dtSlicedSearchRef;
+
+/// The maximum number of concurrent sliced path queries of a dtNavMeshQuery.
+static const int DT_MAX_SLICED_SEARCHES = 256;
+
+/// Limits on the work done by a single dtNavMeshQuery::findPath call. A limit of zero is not applied.
+/// @ingroup detour
+struct dtFindPathLimits
+{
+	int maxNodes;			///< The maximum number of search nodes to expand.
+	float maxCost;			///< The search stops once no path cheaper than this can be found.
+	dtTimeVal deadline;		///< The search stops at this time of dtGetTimeUsec(). [Units: us]
+};
+
+/// No limits on the work done by dtNavMeshQuery::findPath.
+static const dtFindPathLimits DT_FINDPATH_NO_LIMITS = { 0, 0.0f, 0 };
+
+/// The number of nodes dtNavMeshQuery::findPath expands between reads of the clock when it has a deadline.
+static const int DT_FINDPATH_DEADLINE_CHECK_NODES = 32;
+
+/// The query types dtQueryStats keeps statistics for.
+/// @ingroup detour
+enum dtQueryStatsType
+{
+	DT_QUERYSTATS_FIND_PATH,				///< dtNavMeshQuery::findPath
+	DT_QUERYSTATS_SLICED_FIND_PATH,			///< dtNavMeshQuery::updateSlicedFindPath and updateSlicedFindPathTimed, counted per call.
+	DT_QUERYSTATS_FIND_STRAIGHT_PATH,		///< dtNavMeshQuery::findStraightPath
+	DT_QUERYSTATS_MOVE_ALONG_SURFACE,		///< dtNavMeshQuery::moveAlongSurface
+	DT_QUERYSTATS_RAYCAST,					///< dtNavMeshQuery::raycast
+	DT_QUERYSTATS_FIND_NEAREST_POLY,		///< dtNavMeshQuery::findNearestPoly
+	DT_QUERYSTATS_QUERY_POLYGONS,			///< dtNavMeshQuery::queryPolygons
+	DT_QUERYSTATS_FIND_POLYS_AROUND,		///< dtNavMeshQuery::findPolysAroundCircle and findPolysAroundShape
+	DT_QUERYSTATS_FIND_LOCAL_NEIGHBOURHOOD,	///< dtNavMeshQuery::findLocalNeighbourhood
+	DT_QUERYSTATS_FIND_DISTANCE_TO_WALL,	///< dtNavMeshQuery::findDistanceToWall
+	DT_QUERYSTATS_FIND_COSTS,				///< dtNavMeshQuery::findCostsToPolys and findCostsFromPolys
+	DT_QUERYSTATS_TYPE_COUNT,
+};
+
+/// The number of buckets in the histograms of dtQueryTypeStats.
+static const int DT_QUERYSTATS_HISTOGRAM_SIZE = 16;
+
+/// Counters of the work done by queries.
+/// @ingroup detour
+struct dtQueryCounters
+{
+	int64_t nodesExpanded;		///< Search nodes taken from the open list and expanded.
+	int64_t nodesReopened;		///< Closed search nodes put back on the open list because a cheaper route was found.
+	int64_t tilesTouched;		///< Tiles searched by the spatial queries, plus tile borders crossed by the graph searches.
+	int64_t bvNodesVisited;		///< BV tree nodes, or polygons of tiles without a BV tree, tested by the spatial queries.
+	int64_t outOfNodes;			///< The number of times a search could not get a node because the node pool was full.
+	dtTimeVal time;				///< Wall time. [Units: us]
+};
+
+/// Aggregate statistics of one type of query.
+///
+/// Bucket 0 of the histograms counts the queries with a value of zero, bucket i > 0 the values
+/// in [2^(i-1), 2^i), and the last bucket also counts every larger value.
+/// @ingroup detour
+struct dtQueryTypeStats
+{
+	int64_t calls;												///< The number of queries.
+	dtQueryCounters total;										///< The sum of the counters of the queries.
+	dtQueryCounters max;										///< The largest value of each counter in a single query.
+	unsigned int timeHistogram[DT_QUERYSTATS_HISTOGRAM_SIZE];	///< The queries by wall time in microseconds.
+	unsigned int nodesHistogram[DT_QUERYSTATS_HISTOGRAM_SIZE];	///< The queries by the number of nodes expanded.
+};
+
+/// Statistics of the queries of a dtNavMeshQuery, collected when DT_QUERY_STATS is defined.
+/// A query called by another query, such as the ray casts of an any-angle path search, is part
+/// of the outer query.
+/// @see dtNavMeshQuery::getQueryStats
+/// @ingroup detour
+struct dtQueryStats
+{
+	dtQueryTypeStats types[DT_QUERYSTATS_TYPE_COUNT];	///< Statistics by query type. (See: #dtQueryStatsType)
+};
+
 /// Defines polygon filtering and traversal costs for navigation mesh query operations.
 /// ڵѯĶι˺ͱɱ
 /// @ingroup detour
@@ -132,6 +232,23 @@ public:
 
 };
 
+#ifndef DT_VIRTUAL_QUERYFILTER
+inline bool dtQueryFilter::passFilter(const dtPolyRef /*ref*/,
+									  const dtMeshTile* /*tile*/,
+									  const dtPoly* poly) const
+{
+	return (poly->flags & m_includeFlags) != 0 && (poly->flags & m_excludeFlags) == 0;
+}
+
+inline float dtQueryFilter::getCost(const float* pa, const float* pb,
+									const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
+									const dtPolyRef /*curRef*/, const dtMeshTile* /*curTile*/, const dtPoly* curPoly,
+									const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
+{
+	return dtVdist(pa, pb) * m_areaCost[curPoly->getArea()];
+}
+#endif
+
 
 
 /// Provides information about raycast hit
@@ -192,14 +309,18 @@ public:
 class dtNavMeshQuery
 {
 public:
-	dtNavMeshQuery();
+	/// Creates a query object.
+	///  @param[in]		allocator	The allocator of the node pools and open lists, or null to
+	///  							use #dtAlloc. Must outlive the query object. [opt]
+	explicit dtNavMeshQuery(dtAllocator* allocator = 0);
 	~dtNavMeshQuery();
 	
 	/// Initializes the query object.
 	///  @param[in]		nav			Pointer to the dtNavMesh object to use for all queries.
 	///  @param[in]		maxNodes	Maximum number of search nodes. [Limits: 0 < value <= 65535]
+	///  @param[in]		openListType	The open list implementation used by the searches. (See: #dtNodeQueueType)
 	/// @returns The status flags for the query.
-	dtStatus init(const dtNavMesh* nav, const int maxNodes);
+	dtStatus init(const dtNavMesh* nav, const int maxNodes, const int openListType = 0);
 	
 	/// @name Standard Pathfinding Functions
 	// /@{
@@ -214,9 +335,48 @@ public:
 	///  							[(polyRef) * @p pathCount]
 	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
 	///  @param[in]		maxPath		The maximum number of polygons the @p path array can hold. [Limit: >= 1]
+	///  @param[in]		options		Query options. (See: #dtFindPathOptions, #DT_FINDPATH_ANY_ANGLE is ignored.)
 	dtStatus findPath(dtPolyRef startRef, dtPolyRef endRef,
 					  const float* startPos, const float* endPos,
 					  const dtQueryFilter* filter,
+					  dtPolyRef* path, int* pathCount, const int maxPath,
+					  const unsigned int options = 0) const;
+
+	/// Finds a path from the start polygon to the end polygon with a filter type known at compile time.
+	/// The filter may be any class with the passFilter() and getCost() methods of dtQueryFilter.
+	/// They are called directly, so a custom cost function is inlined into the search loop.
+	/// The parameters are the same as for the dtQueryFilter version.
+	template<class TFilter>
+	dtStatus findPath(dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  const TFilter* filter,
+					  dtPolyRef* path, int* pathCount, const int maxPath,
+					  const unsigned int options = 0) const;
+
+	/// Finds a path from the start polygon to the end polygon, stopping early at the limits.
+	/// When the search is stopped by a limit, the path to the polygon nearest to the end polygon
+	/// found so far is returned with #DT_PARTIAL_RESULT and #DT_SEARCH_LIMIT set.
+	///  @param[in]		startRef	The refrence id of the start polygon.
+	///  @param[in]		endRef		The reference id of the end polygon.
+	///  @param[in]		startPos	A position within the start polygon. [(x, y, z)]
+	///  @param[in]		endPos		A position within the end polygon. [(x, y, z)]
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	///  @param[in]		limits		The limits on the work done by the search.
+	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to end.) 
+	///  							[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath		The maximum number of polygons the @p path array can hold. [Limit: >= 1]
+	dtStatus findPath(dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  const dtQueryFilter* filter, const dtFindPathLimits& limits,
+					  dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+	/// Finds a path with a filter type known at compile time, stopping early at the limits.
+	/// The parameters are the same as for the dtQueryFilter version.
+	template<class TFilter>
+	dtStatus findPath(dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  const TFilter* filter, const dtFindPathLimits& limits,
 					  dtPolyRef* path, int* pathCount, const int maxPath) const;
 
 	/// Finds the straight path from the start to the end position within the polygon corridor.
@@ -262,6 +422,19 @@ public:
 	/// @returns The status flags for the query.
 	dtStatus updateSlicedFindPath(const int maxIter, int* doneIters);
 
+	/// Updates an in-progress sliced path query until it completes or the time budget is used.
+	///  @param[in]		maxTime		The time budget of the update. [Units: us] [Limit: >= 0]
+	///  @param[in]		checkIters	The number of iterations performed between reads of the clock. [Limit: > 0]
+	///  @param[out]	doneIters	The actual number of iterations completed. [opt]
+	/// @returns The status flags for the query.
+	dtStatus updateSlicedFindPathTimed(const int maxTime, const int checkIters, int* doneIters);
+
+	/// Returns the statistics of the updateSlicedFindPathTimed() calls since the last reset.
+	const dtTimeBudgetStats& getSlicedStats() const { return m_slicedStats; }
+
+	/// Clears the statistics returned by getSlicedStats().
+	void resetSlicedStats() { dtResetTimeBudgetStats(m_slicedStats); }
+
 	/// Finalizes and returns the results of a sliced path query.
 	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to end.) 
 	///  							[(polyRef) * @p pathCount]
@@ -282,6 +455,89 @@ public:
 	dtStatus finalizeSlicedFindPathPartial(const dtPolyRef* existing, const int existingSize,
 										   dtPolyRef* path, int* pathCount, const int maxPath);
 
+	///@}
+	/// @name Concurrent Sliced Pathfinding Functions
+	/// Several sliced path queries can be in flight at the same time, each identified by a handle.
+	/// Common use case:
+	///	-# Call initSlicedSearches() once to allocate the node pools of the searches.
+	///	-# Call initSlicedFindPath(..., &searchRef) to start a search.
+	///	-# Call updateSlicedFindPath(searchRef, ...) on the searches in any order until they return complete.
+	///	-# Call finalizeSlicedFindPath(searchRef, ...) to get the path and release the handle.
+	///@{
+
+	/// Allocates the node pools of the concurrent sliced path queries and cancels the queries in flight.
+	///  @param[in]		maxSearches	The maximum number of queries in flight. [Limits: 0 <= value <= #DT_MAX_SLICED_SEARCHES]
+	///  @param[in]		maxNodes	Maximum number of search nodes of each query. [Limits: 0 < value <= 65535]
+	/// @returns The status flags for the operation.
+	dtStatus initSlicedSearches(const int maxSearches, const int maxNodes);
+
+	/// Intializes a concurrent sliced path query.
+	///  @param[in]		startRef	The refrence id of the start polygon.
+	///  @param[in]		endRef		The reference id of the end polygon.
+	///  @param[in]		startPos	A position within the start polygon. [(x, y, z)]
+	///  @param[in]		endPos		A position within the end polygon. [(x, y, z)]
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	///  @param[in]		options		query options (see: #dtFindPathOptions)
+	///  @param[out]	searchRef	The handle of the query, or zero if it could not be started.
+	/// @returns The status flags for the query.
+	dtStatus initSlicedFindPath(dtPolyRef startRef, dtPolyRef endRef,
+								const float* startPos, const float* endPos,
+								const dtQueryFilter* filter, const unsigned int options,
+								dtSlicedSearchRef* searchRef);
+
+	/// Updates an in-progress concurrent sliced path query.
+	///  @param[in]		searchRef	The handle of the query.
+	///  @param[in]		maxIter		The maximum number of iterations to perform.
+	///  @param[out]	doneIters	The actual number of iterations completed. [opt]
+	/// @returns The status flags for the query.
+	dtStatus updateSlicedFindPath(dtSlicedSearchRef searchRef, const int maxIter, int* doneIters);
+
+	/// Updates an in-progress concurrent sliced path query until it completes or the time budget is used.
+	///  @param[in]		searchRef	The handle of the query.
+	///  @param[in]		maxTime		The time budget of the update. [Units: us] [Limit: >= 0]
+	///  @param[in]		checkIters	The number of iterations performed between reads of the clock. [Limit: > 0]
+	///  @param[out]	doneIters	The actual number of iterations completed. [opt]
+	/// @returns The status flags for the query.
+	dtStatus updateSlicedFindPathTimed(dtSlicedSearchRef searchRef, const int maxTime, const int checkIters, int* doneIters);
+
+	/// Finalizes and returns the results of a concurrent sliced path query, and releases its handle.
+	///  @param[in]		searchRef	The handle of the query.
+	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to end.) 
+	///  							[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath		The max number of polygons the path array can hold. [Limit: >= 1]
+	/// @returns The status flags for the query.
+	dtStatus finalizeSlicedFindPath(dtSlicedSearchRef searchRef, dtPolyRef* path, int* pathCount, const int maxPath);
+
+	/// Finalizes and returns the results of an incomplete concurrent sliced path query, returning the path
+	/// to the furthest polygon on the existing path that was visited during the search, and releases its handle.
+	///  @param[in]		searchRef		The handle of the query.
+	///  @param[in]		existing		An array of polygon references for the existing path.
+	///  @param[in]		existingSize	The number of polygon in the @p existing array.
+	///  @param[out]	path			An ordered list of polygon references representing the path. (Start to end.) 
+	///  								[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount		The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath			The max number of polygons the @p path array can hold. [Limit: >= 1]
+	/// @returns The status flags for the query.
+	dtStatus finalizeSlicedFindPathPartial(dtSlicedSearchRef searchRef, const dtPolyRef* existing, const int existingSize,
+										   dtPolyRef* path, int* pathCount, const int maxPath);
+
+	/// Stops a concurrent sliced path query without finalizing it and releases its handle.
+	///  @param[in]		searchRef	The handle of the query.
+	/// @returns The status flags for the operation.
+	dtStatus cancelSlicedFindPath(dtSlicedSearchRef searchRef);
+
+	/// Returns the status of a concurrent sliced path query.
+	///  @param[in]		searchRef	The handle of the query.
+	/// @returns The status of the query, or #DT_FAILURE | #DT_INVALID_PARAM if the handle is not valid.
+	dtStatus getSlicedFindPathStatus(dtSlicedSearchRef searchRef) const;
+
+	/// Returns the number of concurrent sliced path queries in flight.
+	int getSlicedSearchCount() const;
+
+	/// Returns the maximum number of concurrent sliced path queries set by initSlicedSearches().
+	int getMaxSlicedSearches() const { return m_maxSearches; }
+
 	///@}
 	/// @name Dijkstra Search Functions
 	/// @{ 
@@ -322,6 +578,42 @@ public:
 								  const dtQueryFilter* filter,
 								  dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
 								  int* resultCount, const int maxResult) const;
+
+	/// Finds the cost of the paths from the start polygon to a set of target polygons
+	/// with a single Dijkstra search.
+	///  @param[in]		startRef		The reference id of the start polygon.
+	///  @param[in]		startPos		A position within the start polygon. [(x, y, z)]
+	///  @param[in]		targetRefs		The reference ids of the target polygons. [(polyRef) * @p targetCount]
+	///  @param[in]		targetPos		A position within each target polygon. [(x, y, z) * @p targetCount]
+	///  @param[in]		targetCount		The number of targets.
+	///  @param[in]		filter			The polygon filter to apply to the query.
+	///  @param[in]		maxHits			The number of cheapest targets to find.
+	///  @param[out]	resultCost		The cost of the path to each target, or FLT_MAX if the target
+	///  								was not reached or is not among the cheapest. [Size: @p targetCount]
+	///  @param[out]	hitCount		The number of targets reached.
+	/// @returns The status flags for the query.
+	dtStatus findCostsToPolys(dtPolyRef startRef, const float* startPos,
+							  const dtPolyRef* targetRefs, const float* targetPos, const int targetCount,
+							  const dtQueryFilter* filter, const int maxHits,
+							  float* resultCost, int* hitCount) const;
+
+	/// Finds the cost of the paths from a set of start polygons to the end polygon
+	/// with a single Dijkstra search backwards from the end.
+	///  @param[in]		startRefs		The reference ids of the start polygons. [(polyRef) * @p startCount]
+	///  @param[in]		startPos		A position within each start polygon. [(x, y, z) * @p startCount]
+	///  @param[in]		startCount		The number of start polygons.
+	///  @param[in]		endRef			The reference id of the end polygon.
+	///  @param[in]		endPos			A position within the end polygon. [(x, y, z)]
+	///  @param[in]		filter			The polygon filter to apply to the query.
+	///  @param[in]		maxHits			The number of cheapest start polygons to find.
+	///  @param[out]	resultCost		The cost of the path from each start, or FLT_MAX if the start
+	///  								was not reached or is not among the cheapest. [Size: @p startCount]
+	///  @param[out]	hitCount		The number of start polygons reached.
+	/// @returns The status flags for the query.
+	dtStatus findCostsFromPolys(const dtPolyRef* startRefs, const float* startPos, const int startCount,
+								dtPolyRef endRef, const float* endPos,
+								const dtQueryFilter* filter, const int maxHits,
+								float* resultCost, int* hitCount) const;
 	
 	/// Gets a path from the explored nodes in the previous search.
 	/// ǰĽڵȡ·
@@ -335,7 +627,9 @@ public:
 	///  				if @p path cannot contain the entire path. In this case it is filled to capacity with a partial path.
 	///  				Otherwise returns DT_SUCCESS.
 	///  @remarks		The result of this function depends on the state of the query object. For that reason it should only
-	///  				be used immediately after one of the two Dijkstra searches, findPolysAroundCircle or findPolysAroundShape.
+	///  				be used immediately after one of the Dijkstra searches, findPolysAroundCircle, findPolysAroundShape,
+	///  				findCostsToPolys or findCostsFromPolys. After findCostsFromPolys @p endRef is the start polygon of
+	///  				the path, and the path leads from it to the end of the search.
 	dtStatus getPathFromDijkstraSearch(dtPolyRef endRef, dtPolyRef* path, int* pathCount, int maxPath) const;
 
 	/// @}
@@ -408,6 +702,12 @@ public:
 	dtStatus moveAlongSurface(dtPolyRef startRef, const float* startPos, const float* endPos,
 							  const dtQueryFilter* filter,
 							  float* resultPos, dtPolyRef* visited, int* visitedCount, const int maxVisitedSize) const;
+
+	/// Moves along the surface with a filter type known at compile time. (See: findPath() with a template filter.)
+	template<class TFilter>
+	dtStatus moveAlongSurface(dtPolyRef startRef, const float* startPos, const float* endPos,
+							  const TFilter* filter,
+							  float* resultPos, dtPolyRef* visited, int* visitedCount, const int maxVisitedSize) const;
 	
 	/// Casts a 'walkability' ray along the surface of the navigation mesh from 
 	/// the start position toward the end position.
@@ -445,6 +745,12 @@ public:
 					 const dtQueryFilter* filter, const unsigned int options,
 					 dtRaycastHit* hit, dtPolyRef prevRef = 0) const;
 
+	/// Casts a ray with a filter type known at compile time. (See: findPath() with a template filter.)
+	template<class TFilter>
+	dtStatus raycast(dtPolyRef startRef, const float* startPos, const float* endPos,
+					 const TFilter* filter, const unsigned int options,
+					 dtRaycastHit* hit, dtPolyRef prevRef = 0) const;
+
 
 	/// Finds the distance from the specified position to the nearest polygon wall.
 	/// ҴָλõĶǽľ롣
@@ -477,6 +783,7 @@ public:
 
 	/// Returns random location on navmesh.
 	/// Polygons are chosen weighted by area. The search runs in linear related to number of polygon.
+	/// Tiles are chosen with equal probability, use dtRandomPointTable for locations uniform over the area.
 	///  @param[in]		filter			The polygon filter to apply to the query.
 	///  @param[in]		frand			Function returning a random number [0..1).
 	///  @param[out]	randomRef		The reference id of the random location.
@@ -551,6 +858,48 @@ public:
 	/// @return The navigation mesh the query object is using.
 	const dtNavMesh* getAttachedNavMesh() const { return m_nav; }
 
+	/// The allocator of the query object, or null if it uses #dtAlloc.
+	dtAllocator* getAllocator() const { return m_allocator; }
+
+	/// Sets the landmark table used to improve the search heuristic of findPath() and the sliced path finder.
+	///  @param[in]		table	The landmark table, or null to use the plain distance heuristic. 
+	///  						Must be built for the attached navigation mesh and outlive its use.
+	void setLandmarkTable(const class dtLandmarkTable* table) { m_landmarks = table; }
+
+	/// Gets the landmark table used by the path finder.
+	/// @return The landmark table, or null if none is set.
+	const class dtLandmarkTable* getLandmarkTable() const { return m_landmarks; }
+
+	/// Sets the island table used by findPath() and the sliced path finder to reject
+	/// polygons that are not connected without searching.
+	///  @param[in]		table	The island table, or null to always search. 
+	///  						Must be built for the attached navigation mesh and outlive its use.
+	/// The table is only used by queries whose filter has the include and exclude flags it was
+	/// built with, queries with other flags search as if no table was set. (See: dtIslandTable)
+	/// The template findPath() uses the table for dtQueryFilter and dtPolyMaskFilter only.
+	void setIslandTable(const class dtIslandTable* table) { m_islands = table; }
+
+	/// Gets the island table used by the path finder.
+	/// @return The island table, or null if none is set.
+	const class dtIslandTable* getIslandTable() const { return m_islands; }
+
+	/// @}
+	/// @name Statistics
+	/// The statistics are only collected when DT_QUERY_STATS is defined, otherwise they stay zero.
+	/// @{
+
+	/// Returns the statistics of the queries since the last reset.
+	const dtQueryStats& getQueryStats() const { return m_queryStats; }
+
+	/// Returns the counters of the last query.
+	const dtQueryCounters& getLastQueryCounters() const { return m_lastQueryCounters; }
+
+	/// Returns the type of the last query. (See: #dtQueryStatsType)
+	int getLastQueryType() const { return m_lastQueryType; }
+
+	/// Clears the statistics returned by getQueryStats().
+	void resetQueryStats();
+
 	/// @}
 	
 private:
@@ -589,9 +938,47 @@ private:
 						   float* straightPath, unsigned char* straightPathFlags, dtPolyRef* straightPathRefs,
 						   int* straightPathCount, const int maxStraightPath, const int options) const;
 
+	// Validates the input of findPath() and pushes the start node, shared by all filter types.
+	dtStatus beginFindPath(dtPolyRef startRef, dtPolyRef endRef,
+						   const float* startPos, const float* endPos, const void* filter,
+						   const dtQueryFilter* islandFilter,
+						   dtPolyRef* path, int* pathCount, const int maxPath, struct dtNode** startNode) const;
+
+	// Returns false if the island table rules out a path between the polygons for the filter.
+	bool isIslandConnected(dtPolyRef from, dtPolyRef to, const dtQueryFilter* filter) const;
+
+	// Returns the landmark lower bound of the cost between the polygons.
+	float getLandmarkHeuristic(dtPolyRef from, dtPolyRef to) const;
+
 	// Gets the path leading to the specified end node.
 	// ȡָָڵ·
 	dtStatus getPathToNode(struct dtNode* endNode, dtPolyRef* path, int* pathCount, int maxPath) const;
+
+	struct dtQueryData;
+
+	// Bidirectional path search, shared by findPath() and the sliced path finder.
+	template<class TFilter>
+	void initBackwardSearch(dtQueryData& query, const TFilter* filter) const;
+	template<class TFilter>
+	dtStatus updateBidirectionalSearch(dtQueryData& query, const TFilter* filter, const int maxIter, int* doneIters) const;
+	dtStatus getBidirectionalPath(const dtQueryData& query, dtPolyRef* path, int* pathCount, const int maxPath) const;
+	template<class TFilter>
+	bool expandForward(dtQueryData& query, const TFilter* filter, struct dtNode* bestNode) const;
+	template<class TFilter>
+	bool expandBackward(dtQueryData& query, const TFilter* filter, struct dtNode* bestNode) const;
+	template<class TFilter>
+	void relaxBackward(dtQueryData& query, const TFilter* filter, struct dtNode* bestNode,
+					   dtPolyRef bestRef, const dtMeshTile* bestTile, const dtPoly* bestPoly,
+					   dtPolyRef nextRef, const dtMeshTile* nextTile, const dtPoly* nextPoly,
+					   dtPolyRef prevRef, const dtMeshTile* prevTile, const dtPoly* prevPoly) const;
+	template<class TFilter>
+	void updateMeeting(dtQueryData& query, const TFilter* filter, struct dtNode* forwardNode, struct dtNode* backwardNode) const;
+
+	// Dijkstra search to a set of targets, shared by findCostsToPolys() and findCostsFromPolys().
+	dtStatus findCostsToTargets(dtPolyRef rootRef, const float* rootPos,
+								const dtPolyRef* targetRefs, const float* targetPos, const int targetCount,
+								const dtQueryFilter* filter, const int maxHits, const bool backward,
+								float* resultCost, int* hitCount) const;
 	
 	const dtNavMesh* m_nav;				///< Pointer to navmesh data.
 
@@ -605,14 +992,1136 @@ private:
 		const dtQueryFilter* filter;
 		unsigned int options;
 		float raycastLimitSqr;
+		struct dtNode* meetNode;			///< Forward node of the cheapest meeting found by the bidirectional search.
+		struct dtNode* meetBackNode;		///< Backward node of the cheapest meeting.
+		float meetCost;						///< Cost of the path through the meeting.
+		const dtMeshTile* oneWayTile;		///< The tile oneWayCount was counted around.
+		int oneWayCount;					///< The number of one-way off-mesh connections around oneWayTile.
 	};
 	dtQueryData m_query;				///< Sliced query state.///< Ƭѯ״̬
+	dtTimeBudgetStats m_slicedStats;	///< Statistics of the time budgeted sliced query updates.
+
+	/// State of a concurrent sliced path query. The state and the node pools are swapped with the
+	/// ones of the query object while the query runs.
+	struct dtSlicedSearch
+	{
+		dtQueryData query;					///< Sliced query state.
+		class dtNodePool* nodePool;			///< Node pool of the query.
+		class dtNodeQueue* openList;		///< Open list of the query.
+		class dtNodeQueue* backOpenList;	///< Open list of the backward half of bidirectional queries.
+		unsigned int salt;					///< Incremented every time the slot is reused.
+		bool inUse;							///< True while the query is in flight.
+	};
+	dtAllocator* m_allocator;			///< Allocator of the memory of the query. (Null for dtAlloc.)
+	dtSlicedSearch* m_searches;			///< Concurrent sliced query slots.
+	int m_maxSearches;					///< The number of slots in m_searches.
+
+	dtSlicedSearch* getSlicedSearch(dtSlicedSearchRef searchRef) const;
+	void swapSlicedSearch(dtSlicedSearch& search);
+	void releaseSlicedSearch(dtSlicedSearch& search);
+
+	/// Records the query it is created in, see DT_QUERY_STATS_SCOPE.
+	struct dtQueryStatsScope
+	{
+		dtQueryStatsScope(const dtNavMeshQuery* query, const int type) : m_query(query), m_type(type) { m_query->beginQueryStats(); }
+		~dtQueryStatsScope() { m_query->endQueryStats(m_type); }
+		const dtNavMeshQuery* m_query;
+		const int m_type;
+	};
+
+	void beginQueryStats() const;
+	void endQueryStats(const int type) const;
+
+	mutable dtQueryStats m_queryStats;				///< Statistics of the queries since the last reset.
+	mutable dtQueryCounters m_lastQueryCounters;	///< Counters of the last or current query.
+	mutable dtTimeVal m_queryStartTime;				///< Start time of the current query.
+	mutable int m_lastQueryType;					///< Type of the last query.
+	mutable int m_queryDepth;						///< The number of nested queries being recorded.
+	void purgeSlicedSearches();
 
 	class dtNodePool* m_tinyNodePool;	///< Pointer to small node pool.
 	class dtNodePool* m_nodePool;		///< Pointer to node pool.
 	class dtNodeQueue* m_openList;		///< Pointer to open list queue.
+	class dtNodeQueue* m_backOpenList;	///< Open list of the backward half of bidirectional searches.
+
+	const class dtLandmarkTable* m_landmarks;	///< Optional landmark table used by the path finder heuristic.
+	const class dtIslandTable* m_islands;		///< Optional island table used to reject unconnected paths.
 };
 
+// DT_QUERY_STATS_SCOPE records the query of the enclosing function in the statistics and
+// DT_QUERY_STATS_ADD adds to a counter of the current query. (See: dtQueryCounters)
+#ifdef DT_QUERY_STATS
+#define DT_QUERY_STATS_SCOPE(type) const dtQueryStatsScope queryStatsScope(this, type)
+#define DT_QUERY_STATS_ADD(counter, value) (m_lastQueryCounters.counter += (value))
+#else
+#define DT_QUERY_STATS_SCOPE(type) ((void)0)
+#define DT_QUERY_STATS_ADD(counter, value) ((void)0)
+#endif
+
+// The searches with a template filter are defined here so that they can be instantiated for
+// any filter type. The dtQueryFilter versions in DetourNavMeshQuery.cpp call them.
+
+// Returns the dtQueryFilter whose flags the island table is checked against. Other filter
+// types do not tell which polygons they pass, so their searches do not use the table.
+inline const dtQueryFilter* dtGetIslandFilter(const dtQueryFilter* filter) { return filter; }
+inline const dtQueryFilter* dtGetIslandFilter(const void* /*filter*/) { return 0; }
+
+template<class TFilter>
+dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
+								  const float* startPos, const float* endPos,
+								  const TFilter* filter,
+								  dtPolyRef* path, int* pathCount, const int maxPath,
+								  const unsigned int options) const
+{
+	if (!(options & DT_FINDPATH_BIDIRECTIONAL))
+		return findPath(startRef, endRef, startPos, endPos, filter, DT_FINDPATH_NO_LIMITS, path, pathCount, maxPath);
+
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_FIND_PATH);
+
+	dtNode* startNode = 0;
+	const dtStatus status = beginFindPath(startRef, endRef, startPos, endPos, filter, dtGetIslandFilter(filter),
+										  path, pathCount, maxPath, &startNode);
+	if (status != DT_IN_PROGRESS)
+		return status;
+
+	// The filter is passed to the search instead of stored, it need not be a dtQueryFilter.
+	dtQueryData query;
+	memset(&query, 0, sizeof(dtQueryData));
+	query.status = DT_IN_PROGRESS;
+	query.lastBestNode = startNode;
+	query.lastBestNodeCost = startNode->total;
+	query.startRef = startRef;
+	query.endRef = endRef;
+	dtVcopy(query.startPos, startPos);
+	dtVcopy(query.endPos, endPos);
+	query.options = options;
+	initBackwardSearch(query, filter);
+	updateBidirectionalSearch(query, filter, INT_MAX, 0);
+	return getBidirectionalPath(query, path, pathCount, maxPath);
+}
+
+template<class TFilter>
+dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
+								  const float* startPos, const float* endPos,
+								  const TFilter* filter, const dtFindPathLimits& limits,
+								  dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_FIND_PATH);
+
+	dtNode* startNode = 0;
+	const dtStatus initStatus = beginFindPath(startRef, endRef, startPos, endPos, filter, dtGetIslandFilter(filter),
+											  path, pathCount, maxPath, &startNode);
+	if (initStatus != DT_IN_PROGRESS)
+		return initStatus;
+
+	dtNode* lastBestNode = startNode;
+	float lastBestNodeCost = startNode->total;
+	
+	bool outOfNodes = false;
+	bool limited = false;
+	int expanded = 0;
+	
+	while (!m_openList->empty())
+	{
+		// Stop at the limits of the caller. The heuristic never overestimates, so no path
+		// through the remaining open nodes is cheaper than the total of the top node.
+		if ((limits.maxNodes > 0 && expanded >= limits.maxNodes) ||
+			(limits.maxCost > 0.0f && m_openList->top()->total > limits.maxCost) ||
+			(limits.deadline > 0 && (expanded % DT_FINDPATH_DEADLINE_CHECK_NODES) == 0 && dtGetTimeUsec() >= limits.deadline))
+		{
+			limited = true;
+			break;
+		}
+		expanded++;
+
+		// Remove node from open list and put it in closed list.
+		dtNode* bestNode = m_openList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+		DT_QUERY_STATS_ADD(nodesExpanded, 1);
+		
+		// Reached the goal, stop searching.
+		if (bestNode->id == endRef)
+		{
+			lastBestNode = bestNode;
+			break;
+		}
+		
+		// Get current poly and tile.
+		// The API input has been cheked already, skip checking internal data.
+		const dtPolyRef bestRef = bestNode->id;
+		const dtMeshTile* bestTile = 0;
+		const dtPoly* bestPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
+		
+		// Get parent poly and tile.
+		dtPolyRef parentRef = 0;
+		const dtMeshTile* parentTile = 0;
+		const dtPoly* parentPoly = 0;
+		if (bestNode->pidx)
+			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
+		if (parentRef)
+			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
+		
+		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+		{
+			dtPolyRef neighbourRef = bestTile->links[i].ref;
+			
+			// Skip invalid ids and do not expand back to where we came from.
+			if (!neighbourRef || neighbourRef == parentRef)
+				continue;
+			
+			// Get neighbour poly and tile.
+			// The API input has been cheked already, skip checking internal data.
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);			
+			
+			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+				continue;
+
+			// deal explicitly with crossing tile boundaries
+			unsigned char crossSide = 0;
+			if (bestTile->links[i].side != 0xff)
+			{
+				crossSide = bestTile->links[i].side >> 1;
+				DT_QUERY_STATS_ADD(tilesTouched, 1);
+			}
+
+			// get the node
+			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, crossSide);
+			if (!neighbourNode)
+			{
+				outOfNodes = true;
+				DT_QUERY_STATS_ADD(outOfNodes, 1);
+				continue;
+			}
+			
+			// If the node is visited the first time, calculate node position.
+			if (neighbourNode->flags == 0)
+			{
+				getEdgeMidPoint(bestRef, bestPoly, bestTile,
+								neighbourRef, neighbourPoly, neighbourTile,
+								neighbourNode->pos);
+			}
+
+			// Calculate cost and heuristic.
+			float cost = 0;
+			float heuristic = 0;
+			
+			// Special case for last node.
+			if (neighbourRef == endRef)
+			{
+				// Cost
+				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
+													  parentRef, parentTile, parentPoly,
+													  bestRef, bestTile, bestPoly,
+													  neighbourRef, neighbourTile, neighbourPoly);
+				const float endCost = filter->getCost(neighbourNode->pos, endPos,
+													  bestRef, bestTile, bestPoly,
+													  neighbourRef, neighbourTile, neighbourPoly,
+													  0, 0, 0);
+				
+				cost = bestNode->cost + curCost + endCost;
+				heuristic = 0;
+			}
+			else
+			{
+				// Cost
+				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
+													  parentRef, parentTile, parentPoly,
+													  bestRef, bestTile, bestPoly,
+													  neighbourRef, neighbourTile, neighbourPoly);
+				cost = bestNode->cost + curCost;
+				heuristic = dtVdist(neighbourNode->pos, endPos)*DT_QUERY_HEURISTIC_SCALE;
+				if (m_landmarks)
+					heuristic = dtMax(heuristic, getLandmarkHeuristic(neighbourRef, endRef)*DT_QUERY_HEURISTIC_SCALE);
+			}
+
+			const float total = cost + heuristic;
+			
+			// The node is already in open list and the new result is worse, skip.
+			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
+				continue;
+			// The node is already visited and process, and the new result is worse, skip.
+			if ((neighbourNode->flags & DT_NODE_CLOSED) && total >= neighbourNode->total)
+				continue;
+			if (neighbourNode->flags & DT_NODE_CLOSED)
+				DT_QUERY_STATS_ADD(nodesReopened, 1);
+			
+			// Add or update the node.
+			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
+			neighbourNode->id = neighbourRef;
+			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
+			neighbourNode->cost = cost;
+			neighbourNode->total = total;
+			
+			if (neighbourNode->flags & DT_NODE_OPEN)
+			{
+				// Already in open, update node location.
+				m_openList->modify(neighbourNode);
+			}
+			else
+			{
+				// Put the node in open list.
+				neighbourNode->flags |= DT_NODE_OPEN;
+				m_openList->push(neighbourNode);
+			}
+			
+			// Update nearest node to target so far.
+			if (heuristic < lastBestNodeCost)
+			{
+				lastBestNodeCost = heuristic;
+				lastBestNode = neighbourNode;
+			}
+		}
+	}
+
+	dtStatus status = getPathToNode(lastBestNode, path, pathCount, maxPath);
+
+	if (lastBestNode->id != endRef)
+		status |= DT_PARTIAL_RESULT;
+
+	if (outOfNodes)
+		status |= DT_OUT_OF_NODES;
+
+	if (limited)
+		status |= DT_SEARCH_LIMIT;
+	
+	return status;
+}
+
+template<class TFilter>
+void dtNavMeshQuery::initBackwardSearch(dtQueryData& query, const TFilter* filter) const
+{
+	m_backOpenList->clear();
+	query.meetNode = 0;
+	query.meetBackNode = 0;
+	query.meetCost = FLT_MAX;
+	query.oneWayTile = 0;
+	query.oneWayCount = 0;
+
+	// The forward search never enters an end polygon that does not pass the filter,
+	// leave the backward search empty so that the result is the same.
+	const dtMeshTile* endTile = 0;
+	const dtPoly* endPoly = 0;
+	m_nav->getTileAndPolyByRefUnsafe(query.endRef, &endTile, &endPoly);
+	if (!filter->passFilter(query.endRef, endTile, endPoly))
+		return;
+
+	dtNode* endNode = m_nodePool->getNode(query.endRef, DT_BACKWARD_NODE_STATE);
+	if (!endNode)
+	{
+		query.status |= DT_OUT_OF_NODES;
+		DT_QUERY_STATS_ADD(outOfNodes, 1);
+		return;
+	}
+	dtVcopy(endNode->pos, query.endPos);
+	endNode->pidx = 0;
+	endNode->cost = 0;
+	endNode->total = dtVdist(query.endPos, query.startPos) *DT_QUERY_HEURISTIC_SCALE;
+	endNode->id = query.endRef;
+	endNode->flags = DT_NODE_OPEN;
+	m_backOpenList->push(endNode);
+}
+
+// Records the path through a polygon reached by both searches if it is the cheapest so far.
+template<class TFilter>
+void dtNavMeshQuery::updateMeeting(dtQueryData& query, const TFilter* filter, dtNode* forwardNode, dtNode* backwardNode) const
+{
+	if (forwardNode->cost + backwardNode->cost >= query.meetCost)
+		return;
+
+	const dtPolyRef curRef = forwardNode->id;
+	const dtMeshTile* curTile = 0;
+	const dtPoly* curPoly = 0;
+	m_nav->getTileAndPolyByRefUnsafe(curRef, &curTile, &curPoly);
+
+	dtPolyRef prevRef = 0, nextRef = 0;
+	const dtMeshTile* prevTile = 0;
+	const dtMeshTile* nextTile = 0;
+	const dtPoly* prevPoly = 0;
+	const dtPoly* nextPoly = 0;
+	if (forwardNode->pidx)
+	{
+		prevRef = m_nodePool->getNodeAtIdx(forwardNode->pidx)->id;
+		m_nav->getTileAndPolyByRefUnsafe(prevRef, &prevTile, &prevPoly);
+	}
+	if (backwardNode->pidx)
+	{
+		nextRef = m_nodePool->getNodeAtIdx(backwardNode->pidx)->id;
+		m_nav->getTileAndPolyByRefUnsafe(nextRef, &nextTile, &nextPoly);
+	}
+
+	// Cross the polygon from where the forward search entered it to where the backward search leaves it.
+	const float cost = forwardNode->cost + backwardNode->cost +
+		filter->getCost(forwardNode->pos, backwardNode->pos,
+							  prevRef, prevTile, prevPoly,
+							  curRef, curTile, curPoly,
+							  nextRef, nextTile, nextPoly);
+	if (cost < query.meetCost)
+	{
+		query.meetCost = cost;
+		query.meetNode = forwardNode;
+		query.meetBackNode = backwardNode;
+	}
+}
+
+template<class TFilter>
+bool dtNavMeshQuery::expandForward(dtQueryData& query, const TFilter* filter, dtNode* bestNode) const
+{
+	// Get current poly and tile.
+	const dtPolyRef bestRef = bestNode->id;
+	const dtMeshTile* bestTile = 0;
+	const dtPoly* bestPoly = 0;
+	if (dtStatusFailed(m_nav->getTileAndPolyByRef(bestRef, &bestTile, &bestPoly)))
+		return false;
+
+	// Get parent poly and tile.
+	dtPolyRef parentRef = 0;
+	const dtMeshTile* parentTile = 0;
+	const dtPoly* parentPoly = 0;
+	if (bestNode->pidx)
+		parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
+	if (parentRef && dtStatusFailed(m_nav->getTileAndPolyByRef(parentRef, &parentTile, &parentPoly)))
+		return false;
+
+	for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+	{
+		const dtPolyRef neighbourRef = bestTile->links[i].ref;
+
+		// Skip invalid ids and do not expand back to where we came from.
+		if (!neighbourRef || neighbourRef == parentRef)
+			continue;
+
+		const dtMeshTile* neighbourTile = 0;
+		const dtPoly* neighbourPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
+
+		if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+			continue;
+
+		if (neighbourTile != bestTile)
+			DT_QUERY_STATS_ADD(tilesTouched, 1);
+
+		dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, 0);
+		if (!neighbourNode)
+		{
+			query.status |= DT_OUT_OF_NODES;
+			DT_QUERY_STATS_ADD(outOfNodes, 1);
+			continue;
+		}
+
+		// If the node is visited the first time, calculate node position.
+		if (!(neighbourNode->flags & (DT_NODE_OPEN | DT_NODE_CLOSED)))
+		{
+			getEdgeMidPoint(bestRef, bestPoly, bestTile,
+							neighbourRef, neighbourPoly, neighbourTile,
+							neighbourNode->pos);
+		}
+
+		// The cost to the end position is added when the searches meet.
+		const float cost = bestNode->cost +
+			filter->getCost(bestNode->pos, neighbourNode->pos,
+								  parentRef, parentTile, parentPoly,
+								  bestRef, bestTile, bestPoly,
+								  neighbourRef, neighbourTile, neighbourPoly);
+		// Searches without an end polygon are plain Dijkstra searches.
+		float heuristic = 0;
+		if (query.endRef && neighbourRef != query.endRef)
+		{
+			heuristic = dtVdist(neighbourNode->pos, query.endPos)*DT_QUERY_HEURISTIC_SCALE;
+			if (m_landmarks)
+				heuristic = dtMax(heuristic, getLandmarkHeuristic(neighbourRef, query.endRef)*DT_QUERY_HEURISTIC_SCALE);
+		}
+		const float total = cost + heuristic;
+
+		// The node is already in open or closed list and the new result is worse, skip.
+		if ((neighbourNode->flags & (DT_NODE_OPEN | DT_NODE_CLOSED)) && total >= neighbourNode->total)
+			continue;
+
+		if (neighbourNode->flags & DT_NODE_CLOSED)
+			DT_QUERY_STATS_ADD(nodesReopened, 1);
+
+		// Add or update the node.
+		neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
+		neighbourNode->id = neighbourRef;
+		neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
+		neighbourNode->cost = cost;
+		neighbourNode->total = total;
+
+		if (neighbourNode->flags & DT_NODE_OPEN)
+		{
+			m_openList->modify(neighbourNode);
+		}
+		else
+		{
+			neighbourNode->flags |= DT_NODE_OPEN;
+			m_openList->push(neighbourNode);
+		}
+
+		// Update nearest node to target so far.
+		if (heuristic < query.lastBestNodeCost)
+		{
+			query.lastBestNodeCost = heuristic;
+			query.lastBestNode = neighbourNode;
+		}
+
+		dtNode* backwardNode = m_nodePool->findNode(neighbourRef, DT_BACKWARD_NODE_STATE);
+		if (backwardNode && backwardNode->flags)
+			updateMeeting(query, filter, neighbourNode, backwardNode);
+	}
+
+	return true;
+}
+
+// Reaches the polygon prevRef, from which the polygon of bestNode is entered on the way to nextRef.
+template<class TFilter>
+void dtNavMeshQuery::relaxBackward(dtQueryData& query, const TFilter* filter, dtNode* bestNode,
+								   dtPolyRef bestRef, const dtMeshTile* bestTile, const dtPoly* bestPoly,
+								   dtPolyRef nextRef, const dtMeshTile* nextTile, const dtPoly* nextPoly,
+								   dtPolyRef prevRef, const dtMeshTile* prevTile, const dtPoly* prevPoly) const
+{
+	// The forward search starts on the start polygon whether it passes the filter or not.
+	if (prevRef != query.startRef && !filter->passFilter(prevRef, prevTile, prevPoly))
+		return;
+
+	dtNode* prevNode = m_nodePool->getNode(prevRef, DT_BACKWARD_NODE_STATE);
+	if (!prevNode)
+	{
+		query.status |= DT_OUT_OF_NODES;
+		DT_QUERY_STATS_ADD(outOfNodes, 1);
+		return;
+	}
+
+	// Backward nodes are located where the path leaves the polygon.
+	if (!(prevNode->flags & (DT_NODE_OPEN | DT_NODE_CLOSED)))
+	{
+		getEdgeMidPoint(prevRef, prevPoly, prevTile,
+						bestRef, bestPoly, bestTile,
+						prevNode->pos);
+	}
+
+	const float cost = bestNode->cost +
+		filter->getCost(prevNode->pos, bestNode->pos,
+							  prevRef, prevTile, prevPoly,
+							  bestRef, bestTile, bestPoly,
+							  nextRef, nextTile, nextPoly);
+	float heuristic = 0;
+	if (query.startRef && prevRef != query.startRef)
+	{
+		heuristic = dtVdist(prevNode->pos, query.startPos)*DT_QUERY_HEURISTIC_SCALE;
+		if (m_landmarks)
+			heuristic = dtMax(heuristic, getLandmarkHeuristic(query.startRef, prevRef)*DT_QUERY_HEURISTIC_SCALE);
+	}
+	const float total = cost + heuristic;
+
+	if ((prevNode->flags & (DT_NODE_OPEN | DT_NODE_CLOSED)) && total >= prevNode->total)
+		return;
+
+	prevNode->pidx = m_nodePool->getNodeIdx(bestNode);
+	prevNode->id = prevRef;
+	prevNode->flags = (prevNode->flags & ~DT_NODE_CLOSED);
+	prevNode->cost = cost;
+	prevNode->total = total;
+
+	if (prevNode->flags & DT_NODE_OPEN)
+	{
+		m_backOpenList->modify(prevNode);
+	}
+	else
+	{
+		prevNode->flags |= DT_NODE_OPEN;
+		m_backOpenList->push(prevNode);
+	}
+
+	dtNode* forwardNode = m_nodePool->findNode(prevRef, 0);
+	if (forwardNode && forwardNode->flags)
+		updateMeeting(query, filter, forwardNode, prevNode);
+}
+
+template<class TFilter>
+bool dtNavMeshQuery::expandBackward(dtQueryData& query, const TFilter* filter, dtNode* bestNode) const
+{
+	const dtPolyRef bestRef = bestNode->id;
+	const dtMeshTile* bestTile = 0;
+	const dtPoly* bestPoly = 0;
+	if (dtStatusFailed(m_nav->getTileAndPolyByRef(bestRef, &bestTile, &bestPoly)))
+		return false;
+
+	// The parent of a backward node is the next polygon on the way to the end.
+	dtPolyRef nextRef = 0;
+	const dtMeshTile* nextTile = 0;
+	const dtPoly* nextPoly = 0;
+	if (bestNode->pidx)
+		nextRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
+	if (nextRef && dtStatusFailed(m_nav->getTileAndPolyByRef(nextRef, &nextTile, &nextPoly)))
+		return false;
+
+	const bool offMesh = bestPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION;
+	for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+	{
+		const dtPolyRef prevRef = bestTile->links[i].ref;
+		if (!prevRef || prevRef == nextRef)
+			continue;
+
+		const dtMeshTile* prevTile = 0;
+		const dtPoly* prevPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(prevRef, &prevTile, &prevPoly);
+
+		// Polygons are linked both ways, but an off-mesh connection is linked from its end
+		// only if it is bidirectional.
+		if (offMesh && !m_nav->hasLinkTo(prevTile, prevPoly, bestRef))
+			continue;
+
+		relaxBackward(query, filter, bestNode, bestRef, bestTile, bestPoly,
+					  nextRef, nextTile, nextPoly, prevRef, prevTile, prevPoly);
+	}
+
+	if (offMesh)
+		return true;
+
+	// One-way off-mesh connections landing on the polygon are not linked from it,
+	// look for them in the surrounding tiles.
+	if (query.oneWayTile != bestTile)
+	{
+		query.oneWayTile = bestTile;
+		query.oneWayCount = m_nav->countOneWayOffMeshConnections(bestTile);
+	}
+	if (query.oneWayCount == 0)
+		return true;
+
+	static const int MAX_NEIS = 32;
+	const dtMeshTile* neis[MAX_NEIS];
+	for (int dy = -1; dy <= 1; ++dy)
+	{
+		for (int dx = -1; dx <= 1; ++dx)
+		{
+			const int nneis = m_nav->getTilesAt(bestTile->header->x+dx, bestTile->header->y+dy, neis, MAX_NEIS);
+			for (int j = 0; j < nneis; ++j)
+			{
+				const dtMeshTile* prevTile = neis[j];
+				const dtPolyRef base = m_nav->getPolyRefBase(prevTile);
+				for (int k = 0; k < prevTile->header->offMeshConCount; ++k)
+				{
+					const dtOffMeshConnection* con = &prevTile->offMeshCons[k];
+					if ((con->flags & DT_OFFMESH_CON_BIDIR) ||
+						!m_nav->offMeshConLandsAt(prevTile, con, bestTile->header->x, bestTile->header->y))
+						continue;
+					const dtPolyRef prevRef = base | (dtPolyRef)con->poly;
+					const dtPoly* prevPoly = &prevTile->polys[con->poly];
+					if (prevRef == nextRef || !m_nav->hasLinkTo(prevTile, prevPoly, bestRef) ||
+						m_nav->hasLinkTo(bestTile, bestPoly, prevRef))
+						continue;
+					relaxBackward(query, filter, bestNode, bestRef, bestTile, bestPoly,
+								  nextRef, nextTile, nextPoly, prevRef, prevTile, prevPoly);
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+template<class TFilter>
+dtStatus dtNavMeshQuery::updateBidirectionalSearch(dtQueryData& query, const TFilter* filter, const int maxIter, int* doneIters) const
+{
+	int iter = 0;
+	while (iter < maxIter)
+	{
+		// Every path cheaper than the best meeting would pass through an open node of both
+		// searches, so stop once either open list cannot hold one. Without a meeting the
+		// forward search runs out on its own to find the nearest polygon for the partial path.
+		if (m_openList->empty() ||
+			(query.meetNode && (m_backOpenList->empty() ||
+								m_openList->top()->total >= query.meetCost ||
+								m_backOpenList->top()->total >= query.meetCost)))
+		{
+			const dtStatus details = query.status & DT_STATUS_DETAIL_MASK;
+			query.status = DT_SUCCESS | details;
+			break;
+		}
+
+		iter++;
+
+		// Expand the search with the smaller frontier.
+		const bool backward = !m_backOpenList->empty() && m_backOpenList->size() < m_openList->size();
+		dtNode* bestNode = backward ? m_backOpenList->pop() : m_openList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+		DT_QUERY_STATS_ADD(nodesExpanded, 1);
+
+		// No path continues past the polygon the search is heading for.
+		if (bestNode->id == (backward ? query.startRef : query.endRef))
+			continue;
+
+		// Paths through the node cost at least its cost plus the smallest total of the
+		// other search, less the estimate of the other search for the node. Skip the node if
+		// that cannot beat the best meeting.
+		if (query.meetNode)
+		{
+			dtNodeQueue* otherList = backward ? m_openList : m_backOpenList;
+			if (!otherList->empty())
+			{
+				float otherHeuristic;
+				if (backward)
+				{
+					otherHeuristic = dtVdist(bestNode->pos, query.endPos)*DT_QUERY_HEURISTIC_SCALE;
+					if (m_landmarks)
+						otherHeuristic = dtMax(otherHeuristic, getLandmarkHeuristic(bestNode->id, query.endRef)*DT_QUERY_HEURISTIC_SCALE);
+				}
+				else
+				{
+					otherHeuristic = dtVdist(bestNode->pos, query.startPos)*DT_QUERY_HEURISTIC_SCALE;
+					if (m_landmarks)
+						otherHeuristic = dtMax(otherHeuristic, getLandmarkHeuristic(query.startRef, bestNode->id)*DT_QUERY_HEURISTIC_SCALE);
+				}
+				if (bestNode->cost + otherList->top()->total - otherHeuristic >= query.meetCost)
+					continue;
+			}
+		}
+
+		if (!(backward ? expandBackward(query, filter, bestNode) : expandForward(query, filter, bestNode)))
+		{
+			// The polygon has disappeared during the sliced query, fail.
+			query.status = DT_FAILURE;
+			break;
+		}
+	}
+
+	if (doneIters)
+		*doneIters = iter;
+
+	return query.status;
+}
+
+template<class TFilter>
+dtStatus dtNavMeshQuery::moveAlongSurface(dtPolyRef startRef, const float* startPos, const float* endPos,
+										  const TFilter* filter,
+										  float* resultPos, dtPolyRef* visited, int* visitedCount, const int maxVisitedSize) const
+{
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_MOVE_ALONG_SURFACE);
+
+	dtAssert(m_nav);
+	dtAssert(m_tinyNodePool);
+
+	*visitedCount = 0;
+	
+	// Validate input
+	if (!startRef)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!m_nav->isValidPolyRef(startRef))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	dtStatus status = DT_SUCCESS;
+	
+	static const int MAX_STACK = 48;
+	dtNode* stack[MAX_STACK];
+	int nstack = 0;
+	
+	m_tinyNodePool->clear();
+	
+	dtNode* startNode = m_tinyNodePool->getNode(startRef);
+	startNode->pidx = 0;
+	startNode->cost = 0;
+	startNode->total = 0;
+	startNode->id = startRef;
+	startNode->flags = DT_NODE_CLOSED;
+	stack[nstack++] = startNode;
+	
+	float bestPos[3];
+	float bestDist = FLT_MAX;
+	dtNode* bestNode = 0;
+	dtVcopy(bestPos, startPos);
+	
+	// Search constraints
+	float searchPos[3], searchRadSqr;
+	dtVlerp(searchPos, startPos, endPos, 0.5f);
+	searchRadSqr = dtSqr(dtVdist(startPos, endPos)/2.0f + 0.001f);
+	
+	float verts[DT_VERTS_PER_POLYGON*3];
+	
+	while (nstack)
+	{
+		// Pop front.
+		dtNode* curNode = stack[0];
+		for (int i = 0; i < nstack-1; ++i)
+			stack[i] = stack[i+1];
+		nstack--;
+		DT_QUERY_STATS_ADD(nodesExpanded, 1);
+		
+		// Get poly and tile.
+		// The API input has been cheked already, skip checking internal data.
+		const dtPolyRef curRef = curNode->id;
+		const dtMeshTile* curTile = 0;
+		const dtPoly* curPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(curRef, &curTile, &curPoly);			
+		
+		// Collect vertices.
+		const int nverts = curPoly->vertCount;
+		for (int i = 0; i < nverts; ++i)
+			dtVcopy(&verts[i*3], &curTile->verts[curPoly->verts[i]*3]);
+		
+		// If target is inside the poly, stop search.
+		if (dtPointInPolygon(endPos, verts, nverts))
+		{
+			bestNode = curNode;
+			dtVcopy(bestPos, endPos);
+			break;
+		}
+		
+		// Find wall edges and find nearest point inside the walls.
+		for (int i = 0, j = (int)curPoly->vertCount-1; i < (int)curPoly->vertCount; j = i++)
+		{
+			// Find links to neighbours.
+			static const int MAX_NEIS = 8;
+			int nneis = 0;
+			dtPolyRef neis[MAX_NEIS];
+			
+			if (curPoly->neis[j] & DT_EXT_LINK)
+			{
+				// Tile border.
+				for (unsigned int k = curPoly->firstLink; k != DT_NULL_LINK; k = curTile->links[k].next)
+				{
+					const dtLink* link = &curTile->links[k];
+					if (link->edge == j)
+					{
+						if (link->ref != 0)
+						{
+							const dtMeshTile* neiTile = 0;
+							const dtPoly* neiPoly = 0;
+							m_nav->getTileAndPolyByRefUnsafe(link->ref, &neiTile, &neiPoly);
+							if (filter->passFilter(link->ref, neiTile, neiPoly))
+							{
+								if (nneis < MAX_NEIS)
+									neis[nneis++] = link->ref;
+							}
+						}
+					}
+				}
+			}
+			else if (curPoly->neis[j])
+			{
+				const unsigned int idx = (unsigned int)(curPoly->neis[j]-1);
+				const dtPolyRef ref = m_nav->getPolyRefBase(curTile) | idx;
+				if (filter->passFilter(ref, curTile, &curTile->polys[idx]))
+				{
+					// Internal edge, encode id.
+					neis[nneis++] = ref;
+				}
+			}
+			
+			if (!nneis)
+			{
+				// Wall edge, calc distance.
+				const float* vj = &verts[j*3];
+				const float* vi = &verts[i*3];
+				float tseg;
+				const float distSqr = dtDistancePtSegSqr2D(endPos, vj, vi, tseg);
+				if (distSqr < bestDist)
+				{
+                    // Update nearest distance.
+					dtVlerp(bestPos, vj,vi, tseg);
+					bestDist = distSqr;
+					bestNode = curNode;
+				}
+			}
+			else
+			{
+				for (int k = 0; k < nneis; ++k)
+				{
+					// Skip if no node can be allocated.
+					dtNode* neighbourNode = m_tinyNodePool->getNode(neis[k]);
+					if (!neighbourNode)
+					{
+						DT_QUERY_STATS_ADD(outOfNodes, 1);
+						continue;
+					}
+					// Skip if already visited.
+					if (neighbourNode->flags & DT_NODE_CLOSED)
+						continue;
+					
+					// Skip the link if it is too far from search constraint.
+					// TODO: Maybe should use getPortalPoints(), but this one is way faster.
+					const float* vj = &verts[j*3];
+					const float* vi = &verts[i*3];
+					float tseg;
+					float distSqr = dtDistancePtSegSqr2D(searchPos, vj, vi, tseg);
+					if (distSqr > searchRadSqr)
+						continue;
+					
+					// Mark as the node as visited and push to queue.
+					if (nstack < MAX_STACK)
+					{
+						neighbourNode->pidx = m_tinyNodePool->getNodeIdx(curNode);
+						neighbourNode->flags |= DT_NODE_CLOSED;
+						stack[nstack++] = neighbourNode;
+					}
+				}
+			}
+		}
+	}
+	
+	int n = 0;
+	if (bestNode)
+	{
+		// Reverse the path.
+		dtNode* prev = 0;
+		dtNode* node = bestNode;
+		do
+		{
+			dtNode* next = m_tinyNodePool->getNodeAtIdx(node->pidx);
+			node->pidx = m_tinyNodePool->getNodeIdx(prev);
+			prev = node;
+			node = next;
+		}
+		while (node);
+		
+		// Store result
+		node = prev;
+		do
+		{
+			visited[n++] = node->id;
+			if (n >= maxVisitedSize)
+			{
+				status |= DT_BUFFER_TOO_SMALL;
+				break;
+			}
+			node = m_tinyNodePool->getNodeAtIdx(node->pidx);
+		}
+		while (node);
+	}
+	
+	dtVcopy(resultPos, bestPos);
+	
+	*visitedCount = n;
+	
+	return status;
+}
+
+template<class TFilter>
+dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, const float* endPos,
+								 const TFilter* filter, const unsigned int options,
+								 dtRaycastHit* hit, dtPolyRef prevRef) const
+{
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_RAYCAST);
+
+	dtAssert(m_nav);
+	
+	hit->t = 0;
+	hit->pathCount = 0;
+	hit->pathCost = 0;
+
+	// Validate input
+	if (!startRef || !m_nav->isValidPolyRef(startRef))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (prevRef && !m_nav->isValidPolyRef(prevRef))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	float dir[3], curPos[3], lastPos[3];
+	float verts[DT_VERTS_PER_POLYGON*3+3];	
+	int n = 0;
+
+	dtVcopy(curPos, startPos);
+	dtVsub(dir, endPos, startPos);
+	dtVset(hit->hitNormal, 0, 0, 0);
+
+	dtStatus status = DT_SUCCESS;
+
+	const dtMeshTile* prevTile, *tile, *nextTile;
+	const dtPoly* prevPoly, *poly, *nextPoly;
+	dtPolyRef curRef;
+
+	// The API input has been checked already, skip checking internal data.
+	curRef = startRef;
+	tile = 0;
+	poly = 0;
+	m_nav->getTileAndPolyByRefUnsafe(curRef, &tile, &poly);
+	nextTile = prevTile = tile;
+	nextPoly = prevPoly = poly;
+	if (prevRef)
+		m_nav->getTileAndPolyByRefUnsafe(prevRef, &prevTile, &prevPoly);
+
+	while (curRef)
+	{
+		// Cast ray against current polygon.
+		
+		// Collect vertices.
+		int nv = 0;
+		for (int i = 0; i < (int)poly->vertCount; ++i)
+		{
+			dtVcopy(&verts[nv*3], &tile->verts[poly->verts[i]*3]);
+			nv++;
+		}
+		
+		float tmin, tmax;
+		int segMin, segMax;
+		if (!dtIntersectSegmentPoly2D(startPos, endPos, verts, nv, tmin, tmax, segMin, segMax))
+		{
+			// Could not hit the polygon, keep the old t and report hit.
+			hit->pathCount = n;
+			return status;
+		}
+
+		hit->hitEdgeIndex = segMax;
+
+		// Keep track of furthest t so far.
+		if (tmax > hit->t)
+			hit->t = tmax;
+		
+		// Store visited polygons.
+		if (n < hit->maxPath)
+			hit->path[n++] = curRef;
+		else
+			status |= DT_BUFFER_TOO_SMALL;
+
+		// Ray end is completely inside the polygon.
+		if (segMax == -1)
+		{
+			hit->t = FLT_MAX;
+			hit->pathCount = n;
+			
+			// add the cost
+			if (options & DT_RAYCAST_USE_COSTS)
+				hit->pathCost += filter->getCost(curPos, endPos, prevRef, prevTile, prevPoly, curRef, tile, poly, curRef, tile, poly);
+			return status;
+		}
+
+		// Follow neighbours.
+		dtPolyRef nextRef = 0;
+		
+		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			const dtLink* link = &tile->links[i];
+			
+			// Find link which contains this edge.
+			if ((int)link->edge != segMax)
+				continue;
+			
+			// Get pointer to the next polygon.
+			nextTile = 0;
+			nextPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(link->ref, &nextTile, &nextPoly);
+			
+			// Skip off-mesh connections.
+			if (nextPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+				continue;
+			
+			// Skip links based on filter.
+			if (!filter->passFilter(link->ref, nextTile, nextPoly))
+				continue;
+			
+			// If the link is internal, just return the ref.
+			if (link->side == 0xff)
+			{
+				nextRef = link->ref;
+				break;
+			}
+			
+			// If the link is at tile boundary,
+			
+			// Check if the link spans the whole edge, and accept.
+			if (link->bmin == 0 && link->bmax == 255)
+			{
+				nextRef = link->ref;
+				break;
+			}
+			
+			// Check for partial edge links.
+			const int v0 = poly->verts[link->edge];
+			const int v1 = poly->verts[(link->edge+1) % poly->vertCount];
+			const float* left = &tile->verts[v0*3];
+			const float* right = &tile->verts[v1*3];
+			
+			// Check that the intersection lies inside the link portal.
+			if (link->side == 0 || link->side == 4)
+			{
+				// Calculate link size.
+				const float s = 1.0f/255.0f;
+				float lmin = left[2] + (right[2] - left[2])*(link->bmin*s);
+				float lmax = left[2] + (right[2] - left[2])*(link->bmax*s);
+				if (lmin > lmax) dtSwap(lmin, lmax);
+				
+				// Find Z intersection.
+				float z = startPos[2] + (endPos[2]-startPos[2])*tmax;
+				if (z >= lmin && z <= lmax)
+				{
+					nextRef = link->ref;
+					break;
+				}
+			}
+			else if (link->side == 2 || link->side == 6)
+			{
+				// Calculate link size.
+				const float s = 1.0f/255.0f;
+				float lmin = left[0] + (right[0] - left[0])*(link->bmin*s);
+				float lmax = left[0] + (right[0] - left[0])*(link->bmax*s);
+				if (lmin > lmax) dtSwap(lmin, lmax);
+				
+				// Find X intersection.
+				float x = startPos[0] + (endPos[0]-startPos[0])*tmax;
+				if (x >= lmin && x <= lmax)
+				{
+					nextRef = link->ref;
+					break;
+				}
+			}
+		}
+		
+		// add the cost
+		if (options & DT_RAYCAST_USE_COSTS)
+		{
+			// compute the intersection point at the furthest end of the polygon
+			// and correct the height (since the raycast moves in 2d)
+			dtVcopy(lastPos, curPos);
+			dtVmad(curPos, startPos, dir, hit->t);
+			float* e1 = &verts[segMax*3];
+			float* e2 = &verts[((segMax+1)%nv)*3];
+			float eDir[3], diff[3];
+			dtVsub(eDir, e2, e1);
+			dtVsub(diff, curPos, e1);
+			float s = dtSqr(eDir[0]) > dtSqr(eDir[2]) ? diff[0] / eDir[0] : diff[2] / eDir[2];
+			curPos[1] = e1[1] + eDir[1] * s;
+
+			hit->pathCost += filter->getCost(lastPos, curPos, prevRef, prevTile, prevPoly, curRef, tile, poly, nextRef, nextTile, nextPoly);
+		}
+
+		if (!nextRef)
+		{
+			// No neighbour, we hit a wall.
+			
+			// Calculate hit normal.
+			const int a = segMax;
+			const int b = segMax+1 < nv ? segMax+1 : 0;
+			const float* va = &verts[a*3];
+			const float* vb = &verts[b*3];
+			const float dx = vb[0] - va[0];
+			const float dz = vb[2] - va[2];
+			hit->hitNormal[0] = dz;
+			hit->hitNormal[1] = 0;
+			hit->hitNormal[2] = -dx;
+			dtVnormalize(hit->hitNormal);
+			
+			hit->pathCount = n;
+			return status;
+		}
+
+		// No hit, advance to neighbour polygon.
+		if (nextTile != tile)
+			DT_QUERY_STATS_ADD(tilesTouched, 1);
+		prevRef = curRef;
+		curRef = nextRef;
+		prevTile = tile;
+		tile = nextTile;
+		prevPoly = poly;
+		poly = nextPoly;
+	}
+	
+	hit->pathCount = n;
+	
+	return status;
+}
+
 /// Allocates a query object using the Detour allocator.
 /// ʹDetourѯ
 /// @return An allocated query object, or null on failure.
@@ -625,4 +2134,10 @@ dtNavMeshQuery* dtAllocNavMeshQuery();
 /// @ingroup detour
 void dtFreeNavMeshQuery(dtNavMeshQuery* query);
 
+/// Allocates a query object that takes all of its memory from the allocator.
+///  @param[in]		allocator	The allocator. Must outlive the query object.
+/// @return An allocated query object, or null on failure.
+/// @ingroup detour
+dtNavMeshQuery* dtAllocNavMeshQuery(dtAllocator* allocator);
+
 #endif // DETOURNAVMESHQUERY_H
@@ -26,6 +26,7 @@ enum dtNodeFlags
 	DT_NODE_OPEN = 0x01,
 	DT_NODE_CLOSED = 0x02,
 	DT_NODE_PARENT_DETACHED = 0x04, // parent of the node is not adjacent. Found using raycast.// ڵĸڡʹùͶҵ
+	DT_NODE_TARGET = 0x08, // the polygon is a target of dtNavMeshQuery::findCostsToPolys or findCostsFromPolys.
 };
 
 typedef unsigned short dtNodeIndex;
@@ -40,16 +41,25 @@ struct dtNode
 	float total;								///< Cost up to the node.///< ܳɱ
 	unsigned int pidx : DT_NODE_PARENT_BITS;	///< Index to parent node.///< ڵ
 	unsigned int state : DT_NODE_STATE_BITS;	///< extra state information. A polyRef can have multiple nodes with different extra info. see DT_MAX_STATES_PER_NODE///< ״̬ϢpolyRefԾовͬϢĶڵ
-	unsigned int flags : 3;						///< Node flags. A combination of dtNodeFlags.///< ڵıʶdtNodeFlags
+	unsigned int flags : 4;						///< Node flags. A combination of dtNodeFlags.///< ڵıʶdtNodeFlags
+	unsigned int qidx;							///< Position of the node in the open list. (Internal use by dtNodeQueue.)
 	dtPolyRef id;								///< Polygon ref the node corresponds to.///< ڵӦĶref
 };
 
 static const int DT_MAX_STATES_PER_NODE = 1 << DT_NODE_STATE_BITS;	// number of extra states per node. See dtNode::state
 
+/// Stores the search nodes of a query in a fixed size array, indexed by an open
+/// addressed hash table on the polygon reference.
+///
+/// Each hash slot is tagged with the generation it was written in, so clear()
+/// only needs to advance the generation counter instead of touching the table.
 class dtNodePool
 {
 public:
-	dtNodePool(int maxNodes, int hashSize);
+	/// @param[in]	maxNodes	The maximum number of nodes. [Limits: 0 < value <= 65535]
+	/// @param[in]	hashSize	The minimum hash table size, must be power of two. The actual
+	///							table is grown so that it is at most half full.
+	dtNodePool(int maxNodes, int hashSize, dtAllocator* allocator = 0);
 	~dtNodePool();
 	void clear();
 
@@ -82,15 +92,16 @@ public:
 	{
 		return sizeof(*this) +
 			sizeof(dtNode)*m_maxNodes +
-			sizeof(dtNodeIndex)*m_maxNodes +
-			sizeof(dtNodeIndex)*m_hashSize;
+			sizeof(dtNodeIndex)*m_hashSize +
+			sizeof(unsigned int)*m_hashSize;
 	}
 	
 	inline int getMaxNodes() const { return m_maxNodes; }
 	
 	inline int getHashSize() const { return m_hashSize; }
-	inline dtNodeIndex getFirst(int bucket) const { return m_first[bucket]; }
-	inline dtNodeIndex getNext(int i) const { return m_next[i]; }
+	
+	/// Returns the number of nodes allocated since the last clear().
+	/// The nodes are stored contiguously, use getNodeAtIdx(1..count) to iterate them.
 	inline int getNodeCount() const { return m_nodeCount; }
 	
 private:
@@ -98,60 +109,96 @@ private:
 	dtNodePool(const dtNodePool&);
 	dtNodePool& operator=(const dtNodePool&);
 	
+	dtAllocator* m_allocator;
 	dtNode* m_nodes;
-	dtNodeIndex* m_first;
-	dtNodeIndex* m_next;
+	dtNodeIndex* m_slots;			///< Open addressed hash table of node indices.
+	unsigned int* m_stamps;			///< Generation in which each hash slot was last written.
 	const int m_maxNodes;
 	const int m_hashSize;
+	unsigned int m_generation;		///< Slots stamped with a different generation are empty.
 	int m_nodeCount;
 };
 
+/// Open list implementations supported by dtNodeQueue.
+/// @see dtNavMeshQuery::init
+enum dtNodeQueueType
+{
+	DT_NODE_QUEUE_HEAP = 0,		///< 4-ary min-heap with indexed decrease-key.
+	DT_NODE_QUEUE_RADIX = 1,	///< Radix queue. Assumes the popped totals never decrease, as with a consistent A* heuristic.
+};
+
+/// Priority queue of open nodes, ordered by dtNode::total.
+/// The position of each queued node is kept in dtNode::qidx so that modify() does not need to search.
 class dtNodeQueue
 {
 public:
-	dtNodeQueue(int n);
+	dtNodeQueue(int n, int type = DT_NODE_QUEUE_HEAP, dtAllocator* allocator = 0);
 	~dtNodeQueue();
 	
-	inline void clear() { m_size = 0; }
+	inline void clear()
+	{
+		m_size = 0;
+		if (m_type == DT_NODE_QUEUE_RADIX)
+			radixClear();
+	}
 	
-	inline dtNode* top() { return m_heap[0]; }
+	inline dtNode* top()
+	{
+		if (m_type == DT_NODE_QUEUE_RADIX)
+			return radixTop();
+		return m_heap[0];
+	}
 	
 	inline dtNode* pop()
 	{
+		if (m_type == DT_NODE_QUEUE_RADIX)
+			return radixPop();
 		dtNode* result = m_heap[0];
 		m_size--;
-		trickleDown(0, m_heap[m_size]);
+		if (m_size > 0)
+			trickleDown(0, m_heap[m_size]);
 		return result;
 	}
 	
 	inline void push(dtNode* node)
 	{
+		if (m_type == DT_NODE_QUEUE_RADIX)
+		{
+			radixPush(node);
+			return;
+		}
 		m_size++;
 		bubbleUp(m_size-1, node);
 	}
 	
+	/// Updates the position of a queued node after its total has been decreased.
 	inline void modify(dtNode* node)
 	{
-		for (int i = 0; i < m_size; ++i)
+		if (m_type == DT_NODE_QUEUE_RADIX)
 		{
-			if (m_heap[i] == node)
-			{
-				bubbleUp(i, node);
-				return;
-			}
+			radixModify(node);
+			return;
 		}
+		bubbleUp((int)node->qidx, node);
 	}
 	
 	inline bool empty() const { return m_size == 0; }
 	
+	inline int size() const { return m_size; }
+	
 	inline int getMemUsed() const
 	{
-		return sizeof(*this) +
-		sizeof(dtNode*) * (m_capacity + 1);
+		int mem = sizeof(*this) +
+			sizeof(dtNode*) * (m_capacity + 1);
+		if (m_type == DT_NODE_QUEUE_RADIX)
+			mem += (sizeof(unsigned int) + sizeof(int)*2 + sizeof(unsigned char)) * m_capacity;
+		return mem;
 	}
 	
 	inline int getCapacity() const { return m_capacity; }
 	
+	inline int getType() const { return m_type; }
+	
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
 	dtNodeQueue(const dtNodeQueue&);
@@ -160,9 +207,33 @@ private:
 	void bubbleUp(int i, dtNode* node);
 	void trickleDown(int i, dtNode* node);
 	
-	dtNode** m_heap;
+	void radixClear();
+	dtNode* radixTop();
+	dtNode* radixPop();
+	void radixPush(dtNode* node);
+	void radixModify(dtNode* node);
+	void radixLink(int slot);
+	void radixUnlink(int slot);
+	void radixRedistribute();
+	
+	static const int RADIX_BUCKETS = 33;
+	
+	dtAllocator* m_allocator;
+	dtNode** m_heap;				///< Heap array, or the node of each slot for the radix queue.
 	const int m_capacity;
+	const int m_type;
 	int m_size;
+	
+	// Radix queue state. Slots are linked into buckets by the highest bit in which
+	// their key differs from the last popped key.
+	unsigned int* m_slotKey;
+	int* m_slotNext;
+	int* m_slotPrev;
+	unsigned char* m_slotBucket;
+	int m_bucketFirst[RADIX_BUCKETS];
+	int m_slotCount;
+	int m_freeSlot;
+	unsigned int m_lastKey;
 };		
 
 
@@ -0,0 +1,162 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURPATHCACHE_H
+#define DETOURPATHCACHE_H
+
+#include "DetourNavMesh.h"
+#include "DetourAlloc.h"
+#include "DetourStatus.h"
+
+class dtNavMeshQuery;
+class dtQueryFilter;
+
+/// A least recently used cache of polygon corridors found by dtNavMeshQuery::findPath.
+///
+/// Paths are keyed by the start and end polygons, the search options and the filter settings.
+/// Every cached path remembers the revision of each tile it passes through, so a path is
+/// dropped as soon as links in one of those tiles change, or the tile is removed. Paths through
+/// unrelated tiles stay cached. Adding a tile or changing any polygon flags or areas drops all
+/// paths, as the new tile or a polygon that became passable may be a shortcut for any of them.
+/// @ingroup detour
+class dtPathCache
+{
+public:
+	dtPathCache();
+	~dtPathCache();
+
+	/// Initializes the cache.
+	///  @param[in]		nav				The navigation mesh the paths are found on. Must outlive the cache.
+	///  						The memory of the cache is taken from its allocator. (See: dtNavMesh::getAllocator)
+	///  @param[in]		maxPaths		The maximum number of paths the cache can hold. [Limit: > 0]
+	///  @param[in]		maxPathSize		The maximum number of polygons in a cached path. Longer paths are not cached. [Limit: > 0]
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const int maxPaths, const int maxPathSize);
+
+	/// Finds a path like dtNavMeshQuery::findPath, returning the cached result when there is a valid one.
+	///  @param[in]		query		The query used on a cache miss. Must use the same navigation mesh as the cache.
+	///  @param[in]		startRef	The reference id of the start polygon.
+	///  @param[in]		endRef		The reference id of the end polygon.
+	///  @param[in]		startPos	A position within the start polygon. [(x, y, z)]
+	///  @param[in]		endPos		A position within the end polygon. [(x, y, z)]
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to end.)
+	///  							[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath		The maximum number of polygons the @p path array can hold. [Limit: >= 1]
+	///  @param[in]		options		Search options passed to dtNavMeshQuery::findPath. (see: #dtFindPathOptions)
+	/// @returns The status flags for the query.
+	dtStatus findPath(dtNavMeshQuery* query, dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  const dtQueryFilter* filter,
+					  dtPolyRef* path, int* pathCount, const int maxPath,
+					  const unsigned int options = 0);
+
+	/// Removes all paths from the cache.
+	void clear();
+
+	/// The number of paths in the cache.
+	int getPathCount() const { return m_pathCount; }
+
+	/// The number of queries answered from the cache.
+	int getHitCount() const { return m_hitCount; }
+
+	/// The number of queries that had to search.
+	int getMissCount() const { return m_missCount; }
+
+	/// The number of cached paths dropped because the tiles they pass through changed.
+	int getInvalidationCount() const { return m_invalidationCount; }
+
+	/// Returns the memory used by the cache in bytes.
+	int getMemUsed() const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtPathCache(const dtPathCache&);
+	dtPathCache& operator=(const dtPathCache&);
+
+	/// The settings of the default filter implementation a path was found with.
+	struct FilterKey
+	{
+		unsigned short includeFlags;
+		unsigned short excludeFlags;
+		float areaCost[DT_MAX_AREAS];
+	};
+
+	/// A cached path.
+	struct Entry
+	{
+		dtPolyRef startRef;				///< The start polygon of the path. (0 if the entry is free.)
+		dtPolyRef endRef;				///< The end polygon of the path.
+		FilterKey filter;				///< The filter settings used to find the path.
+		unsigned int filterHash;		///< Hash of the filter settings, used to find the bucket.
+		unsigned int options;			///< The search options used to find the path.
+		int pathCount;					///< The number of polygons in the path.
+		int tileCount;					///< The number of tiles the path passes through.
+		unsigned int tileAddCount;		///< The tile add count of the navigation mesh when the path was found.
+		unsigned int polyChangeCount;	///< The polygon change count of the navigation mesh when the path was found.
+		int prev, next;					///< Neighbours in the use order, or the next free entry.
+		int hashNext;					///< The next entry in the same hash bucket.
+	};
+
+	void purge();
+	static unsigned int initFilterKey(const dtQueryFilter* filter, FilterKey& key);
+	int findEntry(dtPolyRef startRef, dtPolyRef endRef, const FilterKey& filter, unsigned int filterHash,
+				  unsigned int options) const;
+	bool isEntryValid(const int idx) const;
+	void unlinkEntry(const int idx);
+	void pushFront(const int idx);
+	void removeEntry(const int idx);
+	int allocEntry();
+	void storePath(dtPolyRef startRef, dtPolyRef endRef, const FilterKey& filter, unsigned int filterHash,
+				   unsigned int options, const dtPolyRef* path, const int pathCount);
+	unsigned int getBucket(dtPolyRef startRef, dtPolyRef endRef, unsigned int filterHash, unsigned int options) const;
+
+	const dtNavMesh* m_nav;
+	dtAllocator* m_allocator;
+
+	Entry* m_entries;
+	dtPolyRef* m_paths;			///< Path of each entry. [Size: maxPaths * maxPathSize]
+	unsigned int* m_tiles;		///< Tile index and revision pairs of each entry. [Size: maxPaths * maxPathSize * 2]
+	int m_maxPaths;
+	int m_maxPathSize;
+
+	int* m_buckets;
+	int m_bucketMask;
+
+	int m_head;					///< The most recently used entry.
+	int m_tail;					///< The least recently used entry.
+	int m_freeList;
+	int m_pathCount;
+
+	int m_hitCount;
+	int m_missCount;
+	int m_invalidationCount;
+};
+
+/// Allocates a path cache object using the Detour allocator.
+/// @return A path cache that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtPathCache* dtAllocPathCache();
+
+/// Frees the specified path cache object using the Detour allocator.
+///  @param[in]	cache	A path cache allocated using #dtAllocPathCache
+///  @ingroup detour
+void dtFreePathCache(dtPathCache* cache);
+
+#endif // DETOURPATHCACHE_H
@@ -0,0 +1,161 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURPOLYMASKFILTER_H
+#define DETOURPOLYMASKFILTER_H
+
+#include "DetourNavMesh.h"
+#include "DetourAlloc.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourStatus.h"
+
+/// A query filter that excludes individual polygons, or scales their cost, without changing
+/// the navigation mesh.
+///
+/// The polygon flags and areas of the navigation mesh are shared by every query. This filter
+/// keeps its own bitset of excluded polygons, and optionally a cost scale per polygon, for each
+/// tile it has been told about, so every agent can carry its own closures. The lookup is a bit
+/// test indexed by the polygon reference.
+///
+/// The include flags, exclude flags and area costs of the dtQueryFilter passed to init() still apply.
+///
+/// Pass the filter to the template versions of dtNavMeshQuery::findPath, raycast and
+/// moveAlongSurface. It is not a dtQueryFilter, so passing it to the other queries, which
+/// would not see the exclusions and cost scales, does not compile.
+/// @ingroup detour
+class dtPolyMaskFilter
+{
+public:
+	dtPolyMaskFilter();
+	~dtPolyMaskFilter();
+
+	/// Prepares the filter for the navigation mesh and clears all exclusions and cost scales.
+	///  @param[in]		nav		The navigation mesh. Must outlive the filter.
+	///  						The memory of the filter is taken from its allocator. (See: dtNavMesh::getAllocator)
+	///  @param[in]		filter	The filter whose flags and area costs also apply. Must outlive the filter.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const dtQueryFilter* filter);
+
+	/// Excludes the polygon from the queries using the filter, or includes it again.
+	///  @param[in]		ref			The reference of the polygon.
+	///  @param[in]		excluded	True to exclude the polygon.
+	/// @returns The status flags for the operation.
+	dtStatus setPolyExcluded(dtPolyRef ref, bool excluded);
+
+	/// Returns true if the polygon is excluded by setPolyExcluded().
+	///  @param[in]		ref		The reference of the polygon.
+	bool isPolyExcluded(dtPolyRef ref) const;
+
+	/// Scales the cost of moving through the polygon.
+	///  @param[in]		ref		The reference of the polygon.
+	///  @param[in]		scale	The scale applied to the cost of the polygon. [Limit: > 0, 1 to reset]
+	/// @returns The status flags for the operation.
+	dtStatus setPolyCostScale(dtPolyRef ref, float scale);
+
+	/// Returns the cost scale of the polygon, 1 unless set by setPolyCostScale().
+	///  @param[in]		ref		The reference of the polygon.
+	float getPolyCostScale(dtPolyRef ref) const;
+
+	/// Removes all exclusions and cost scales.
+	void clearPolys();
+
+	/// Returns the memory used by the filter in bytes.
+	int getMemUsed() const;
+
+	/// Returns the filter whose flags and area costs also apply.
+	const dtQueryFilter* getFilter() const { return m_filter; }
+
+	/// Returns true if the polygon can be visited. (See: dtQueryFilter::passFilter)
+	bool passFilter(const dtPolyRef ref,
+					const dtMeshTile* tile,
+					const dtPoly* poly) const;
+
+	/// Returns the cost to move across the polygon, scaled by its cost scale. (See: dtQueryFilter::getCost)
+	float getCost(const float* pa, const float* pb,
+				  const dtPolyRef prevRef, const dtMeshTile* prevTile, const dtPoly* prevPoly,
+				  const dtPolyRef curRef, const dtMeshTile* curTile, const dtPoly* curPoly,
+				  const dtPolyRef nextRef, const dtMeshTile* nextTile, const dtPoly* nextPoly) const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtPolyMaskFilter(const dtPolyMaskFilter&);
+	dtPolyMaskFilter& operator=(const dtPolyMaskFilter&);
+
+	/// Per polygon state of a single tile slot.
+	struct TileMask
+	{
+		unsigned int salt;		///< Salt of the tile the mask was allocated for. (0 if not allocated.)
+		int polyCount;			///< The number of polygons in the tile.
+		unsigned int* excluded;	///< Bit per polygon, set if excluded. (Null if none were excluded.)
+		float* costScales;		///< Cost scale per polygon. (Null if none were set.)
+	};
+
+	void purge();
+	void freeTileMask(TileMask& mask);
+	TileMask* getTileMask(dtPolyRef ref, unsigned int& ip);
+	const TileMask* findTileMask(dtPolyRef ref, unsigned int& ip) const;
+
+	const dtNavMesh* m_nav;
+	dtAllocator* m_allocator;
+	const dtQueryFilter* m_filter;
+	TileMask* m_tiles;
+	int m_maxTiles;			///< The number of tile slots the masks have room for.
+};
+
+inline bool dtPolyMaskFilter::passFilter(const dtPolyRef ref,
+										 const dtMeshTile* tile,
+										 const dtPoly* poly) const
+{
+	if (!m_filter->passFilter(ref, tile, poly))
+		return false;
+	const unsigned int it = m_nav->decodePolyIdTile(ref);
+	if (it >= (unsigned int)m_maxTiles)
+		return true;
+	const TileMask& mask = m_tiles[it];
+	if (!mask.excluded || mask.salt != tile->salt)
+		return true;
+	const unsigned int ip = m_nav->decodePolyIdPoly(ref);
+	return (mask.excluded[ip >> 5] & (1u << (ip & 31))) == 0;
+}
+
+inline float dtPolyMaskFilter::getCost(const float* pa, const float* pb,
+									   const dtPolyRef prevRef, const dtMeshTile* prevTile, const dtPoly* prevPoly,
+									   const dtPolyRef curRef, const dtMeshTile* curTile, const dtPoly* curPoly,
+									   const dtPolyRef nextRef, const dtMeshTile* nextTile, const dtPoly* nextPoly) const
+{
+	const float cost = m_filter->getCost(pa, pb,
+										 prevRef, prevTile, prevPoly,
+										 curRef, curTile, curPoly,
+										 nextRef, nextTile, nextPoly);
+	const unsigned int it = m_nav->decodePolyIdTile(curRef);
+	if (it >= (unsigned int)m_maxTiles)
+		return cost;
+	const TileMask& mask = m_tiles[it];
+	if (!mask.costScales || mask.salt != curTile->salt)
+		return cost;
+	return cost * mask.costScales[m_nav->decodePolyIdPoly(curRef)];
+}
+
+// The filter passes a subset of the polygons of its dtQueryFilter, so an island table built for
+// the flags of that filter also rules out paths for it. (See: dtNavMeshQuery::setIslandTable)
+inline const dtQueryFilter* dtGetIslandFilter(const dtPolyMaskFilter* filter)
+{
+	return filter->getFilter();
+}
+
+#endif // DETOURPOLYMASKFILTER_H
@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURRANDOMPOINTS_H
+#define DETOURRANDOMPOINTS_H
+
+#include "DetourNavMesh.h"
+#include "DetourAlloc.h"
+#include "DetourStatus.h"
+#include "DetourTileTracker.h"
+
+class dtNavMeshQuery;
+class dtQueryFilter;
+
+/// An index of the walkable area of a navigation mesh for picking random points that are
+/// uniformly distributed over the area.
+///
+/// dtNavMeshQuery::findRandomPoint visits every tile and every polygon of the chosen tile for
+/// each point, and picks the tiles with equal probability whatever their area. The table keeps
+/// the running sums of the polygon areas, so a point is picked with two binary searches.
+///
+/// Only ground polygons that pass the filter are counted. Call update() after tiles have been
+/// added or removed, or polygon flags or areas have changed. Until then the points are picked
+/// from the polygons that were counted, with their old weights, and points falling in a tile
+/// that is gone fail.
+/// @ingroup detour
+class dtRandomPointTable
+{
+public:
+	dtRandomPointTable();
+	~dtRandomPointTable();
+
+	/// Builds the table for the navigation mesh.
+	///  @param[in]		nav		The navigation mesh. Must outlive the table.
+	///  						The memory of the table is taken from its allocator. (See: dtNavMesh::getAllocator)
+	///  @param[in]		filter	The filter deciding which polygons are counted. Must outlive the table.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const dtQueryFilter* filter);
+
+	/// Brings the table in sync with the tiles that changed since the last call to init() or update().
+	/// @returns The status flags for the operation.
+	dtStatus update();
+
+	/// Returns a random point on the navigation mesh, uniformly distributed over the area of the table.
+	///  @param[in]		query		The query used to find the height of the point. Must use the same navigation mesh as the table.
+	///  @param[in]		frand		Function returning a random number [0..1).
+	///  @param[out]	randomRef	The reference id of the random location.
+	///  @param[out]	randomPt	The random location. 
+	/// @returns The status flags for the query.
+	dtStatus findRandomPoint(const dtNavMeshQuery* query, float (*frand)(),
+							 dtPolyRef* randomRef, float* randomPt) const;
+
+	/// The total area of the polygons in the table.
+	float getTotalArea() const;
+
+	/// Returns the memory used by the table in bytes.
+	int getMemUsed() const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtRandomPointTable(const dtRandomPointTable&);
+	dtRandomPointTable& operator=(const dtRandomPointTable&);
+
+	/// Areas of a single tile slot.
+	struct TileData
+	{
+		unsigned int salt;		///< Salt of the tile the areas were computed for. (0 if the slot is empty.)
+		int polyCount;			///< The number of polygons in the tile.
+		float* areaSums;		///< The sum of the areas of the polygons up to and including each polygon. [Size: polyCount]
+	};
+
+	void purge();
+	dtStatus reserveTiles();
+	dtStatus computeTile(const int tileIdx);
+
+	const dtNavMesh* m_nav;
+	dtAllocator* m_allocator;
+	const dtQueryFilter* m_filter;
+	dtTileTracker m_tracker;
+
+	TileData* m_tiles;
+	double* m_tileSums;		///< The sum of the areas of the tiles up to and including each tile slot. [Size: maxTiles]
+	int m_maxTiles;			///< The number of tile slots tracked.
+	int m_tileCapacity;		///< The number of tile slots the arrays have room for.
+};
+
+/// Allocates a random point table object using the Detour allocator.
+/// @return A random point table that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtRandomPointTable* dtAllocRandomPointTable();
+
+/// Frees the specified random point table object using the Detour allocator.
+///  @param[in]	table	A random point table allocated using #dtAllocRandomPointTable
+///  @ingroup detour
+void dtFreeRandomPointTable(dtRandomPointTable* table);
+
+#endif // DETOURRANDOMPOINTS_H
@@ -36,6 +36,8 @@ static const unsigned int DT_BUFFER_TOO_SMALL = 1 << 4;	// Result buffer for the
 static const unsigned int DT_OUT_OF_NODES = 1 << 5;		// Query ran out of nodes during search.
 static const unsigned int DT_PARTIAL_RESULT = 1 << 6;	// Query did not reach the end location, returning best guess. 
 static const unsigned int DT_ALREADY_OCCUPIED = 1 << 7;	// A tile has already been assigned to the given x,y coordinate
+static const unsigned int DT_SEARCH_LIMIT = 1 << 8;		// Query stopped at a limit set by the caller, returning best guess.
+static const unsigned int DT_TILE_NOT_LOADED = 1 << 9;	// A tile needed by the result is not loaded.
 
 
 // Returns true of status is success.
@@ -0,0 +1,172 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURTILEGRAPH_H
+#define DETOURTILEGRAPH_H
+
+#include "DetourNavMesh.h"
+#include "DetourAlloc.h"
+#include "DetourStatus.h"
+#include "DetourTileTracker.h"
+#include "DetourCostHeap.h"
+
+class dtQueryFilter;
+class dtNavMeshQuery;
+
+/// A coarse graph of the tile borders of a navigation mesh, used to plan long paths.
+///
+/// The nodes of the graph are the polygons on tile borders, the polygons that link to or
+/// are linked from a polygon in another tile. Every pair of nodes within a tile is connected
+/// with the cost of the cheapest path between them that stays inside the tile, and the links
+/// crossing the tile borders connect the nodes of neighbouring tiles.
+///
+/// A long path is found by searching the coarse graph from the start to the end polygon, which
+/// gives a list of waypoints one tile apart, and then refining the legs between the waypoints
+/// with the polygon A* of dtNavMeshQuery. Each leg stays within a tile or two, so the node
+/// pool of the query only needs to cover a couple of tiles however long the path is.
+///
+/// Call update() after tiles have been added or removed. The graph does not see polygon flag
+/// or area changes: its costs and waypoints keep following the old flags and areas, so the
+/// waypoints may miss a shortcut or lie on a polygon the filter now rejects, in which case the
+/// refined path ends early. Call init() after changing flags or areas.
+/// @ingroup detour
+class dtTileGraph
+{
+public:
+	dtTileGraph();
+	~dtTileGraph();
+
+	/// Builds the graph for the navigation mesh.
+	///  @param[in]		nav		The navigation mesh. Must outlive the graph.
+	///  						The memory of the graph is taken from its allocator. (See: dtNavMesh::getAllocator)
+	///  @param[in]		filter	The filter used to measure costs and to refine paths. Must outlive the graph.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const dtQueryFilter* filter);
+
+	/// Rebuilds the tiles that were added or removed since the last call to init() or update(),
+	/// and their neighbours.
+	/// @returns The status flags for the operation.
+	dtStatus update();
+
+	/// Finds the tile border waypoints of a path from the start polygon to the end polygon.
+	///  @param[in]		startRef	The reference id of the start polygon.
+	///  @param[in]		endRef		The reference id of the end polygon.
+	///  @param[in]		startPos	A position within the start polygon. [(x, y, z)]
+	///  @param[in]		endPos		A position within the end polygon. [(x, y, z)]
+	///  @param[out]	refs		The waypoint polygons, not including the start, ending with the end polygon.
+	///  							[(polyRef) * @p count]
+	///  @param[out]	pos			The waypoint positions. [(x, y, z) * @p count]
+	///  @param[out]	count		The number of waypoints returned.
+	///  @param[in]		maxCount	The maximum number of waypoints the arrays can hold. [Limit: >= 1]
+	/// @returns The status flags for the query.
+	dtStatus findWaypoints(dtPolyRef startRef, dtPolyRef endRef,
+						   const float* startPos, const float* endPos,
+						   dtPolyRef* refs, float* pos, int* count, const int maxCount);
+
+	/// Finds a path from the start polygon to the end polygon by refining the waypoints
+	/// found by findWaypoints() with dtNavMeshQuery::findPath().
+	///  @param[in]		query		The query object used to refine the path. Must use the same navigation mesh.
+	///  @param[in]		startRef	The reference id of the start polygon.
+	///  @param[in]		endRef		The reference id of the end polygon.
+	///  @param[in]		startPos	A position within the start polygon. [(x, y, z)]
+	///  @param[in]		endPos		A position within the end polygon. [(x, y, z)]
+	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to end.)
+	///  							[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath		The maximum number of polygons the @p path array can hold. [Limit: >= 1]
+	/// @returns The status flags for the query.
+	dtStatus findPath(const dtNavMeshQuery* query, dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  dtPolyRef* path, int* pathCount, const int maxPath);
+
+	/// The number of nodes in the graph.
+	int getNodeCount() const;
+
+	/// Returns the memory used by the graph in bytes.
+	int getMemUsed() const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtTileGraph(const dtTileGraph&);
+	dtTileGraph& operator=(const dtTileGraph&);
+
+	/// Search state of a node.
+	struct NodeState
+	{
+		float cost;					///< Cost from the start.
+		unsigned int stamp;			///< Search the state belongs to.
+		int parentTile;				///< Tile of the parent node, or -1 for the start.
+		unsigned short parentNode;	///< Index of the parent node in its tile.
+	};
+
+	/// Graph data for a single tile slot.
+	struct TileData
+	{
+		unsigned int salt;			///< Salt of the tile the data was built for. (0 if the slot is empty.)
+		int x, y;					///< Location of the tile the data was built for.
+		int polyCount;				///< The number of polygons in the tile.
+		int nodeCount;				///< The number of nodes in the tile.
+		int edgeCount;				///< The number of edges leaving the tile.
+		float* centers;				///< Polygon centers. [(x, y, z) * polyCount]
+		unsigned short* polyNode;	///< The node of each polygon, or 0xffff. [Size: polyCount]
+		unsigned short* nodePoly;	///< The polygon of each node. [Size: nodeCount]
+		float* costs;				///< Cost between each pair of nodes within the tile. [Size: nodeCount * nodeCount]
+		int* firstEdge;				///< The first edge leaving each node. [Size: nodeCount + 1]
+		dtPolyRef* edgeRefs;		///< The node polygon in the other tile each edge leads to. [Size: edgeCount]
+		float* edgeCosts;			///< The cost of each edge. [Size: edgeCount]
+		NodeState* states;			///< Search state of each node. [Size: nodeCount]
+	};
+
+	void purge();
+	dtStatus reserveTiles();
+	void freeTileData(TileData& data);
+	dtStatus buildTile(const int tileIdx);
+	void markNeighbours(const int x, const int y, unsigned char* marks);
+	dtStatus calcTileCosts(const int tileIdx, dtPolyRef startRef, const float* startPos, float* dist);
+	bool reservePolys(const int count);
+
+	const dtNavMesh* m_nav;
+	dtAllocator* m_allocator;
+	const dtQueryFilter* m_filter;
+	dtTileTracker m_tracker;
+
+	TileData* m_tiles;
+	int m_maxTiles;			///< The number of tile slots tracked.
+	int m_tileCapacity;		///< The number of tile slots the arrays have room for.
+	unsigned char* m_marks;
+	unsigned int m_stamp;
+
+	dtCostHeap m_heap;
+
+	float* m_polyDist;			///< Scratch polygon costs for in-tile searches.
+	float* m_startDist;			///< Costs from the start within the start tile.
+	float* m_endDist;			///< Costs to the end within the end tile.
+	int m_polyCapacity;
+};
+
+/// Allocates a tile graph object using the Detour allocator.
+/// @return A tile graph that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtTileGraph* dtAllocTileGraph();
+
+/// Frees the specified tile graph object using the Detour allocator.
+///  @param[in]	graph	A tile graph allocated using #dtAllocTileGraph
+///  @ingroup detour
+void dtFreeTileGraph(dtTileGraph* graph);
+
+#endif // DETOURTILEGRAPH_H
@@ -0,0 +1,272 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURTILESTREAMER_H
+#define DETOURTILESTREAMER_H
+
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+
+/// A magic number used to detect tile archives. (See: #dtCreateTileArchive)
+static const int DT_TILE_ARCHIVE_MAGIC = 'D'<<24 | 'T'<<16 | 'A'<<8 | 'R';
+
+/// A version number used to detect compatibility of tile archives.
+static const int DT_TILE_ARCHIVE_VERSION = 1;
+
+/// Flags for the tiles of a tile archive.
+enum dtTileArchiveEntryFlags
+{
+	DT_TILE_ARCHIVE_QUANTIZED = 0x01,	///< The tile is stored with #dtQuantizeNavMeshData.
+};
+
+/// The header of a tile archive. It is followed by the index of the tiles and the tile data.
+struct dtTileArchiveHeader
+{
+	int magic;					///< Magic number, used to identify the data.
+	int version;				///< Data version number.
+	int tileCount;				///< The number of tiles in the archive.
+	dtNavMeshParams params;		///< The parameters of the navigation mesh the tiles were stored from.
+};
+
+/// The index entry of a tile in a tile archive.
+struct dtTileArchiveEntry
+{
+	int x;						///< The x-position of the tile within the tile grid.
+	int y;						///< The y-position of the tile within the tile grid.
+	int layer;					///< The layer of the tile.
+	int flags;					///< The flags of the stored tile. (See: #dtTileArchiveEntryFlags)
+	int offset;					///< The offset of the stored tile from the start of the archive.
+	int dataSize;				///< The size of the stored tile.
+	int tileSize;				///< The size of the tile data once loaded.
+};
+
+/// Returns the size of the header and index of a tile archive.
+///  @param[in]		header	The header of the archive.
+/// @return The number of bytes from the start of the archive to the end of the index.
+int dtGetTileArchiveIndexSize(const dtTileArchiveHeader* header);
+
+/// Stores all tiles of a navigation mesh in a tile archive.
+///  @param[in]		nav			The navigation mesh.
+///  @param[in]		quantize	True to store the tiles with #dtQuantizeNavMeshData.
+///  @param[out]	outData		The archive. Allocated with #dtAlloc.
+///  @param[out]	outDataSize	The size of the archive.
+/// @return The status flags for the operation.
+dtStatus dtCreateTileArchive(const dtNavMesh* nav, const bool quantize, unsigned char** outData, int* outDataSize);
+
+/// Reads stored tiles from a tile archive, e.g. from a file.
+/// @ingroup detour
+struct dtTileArchiveReader
+{
+	virtual ~dtTileArchiveReader() { }
+
+	/// Reads a range of the archive. Called by dtTileStreamer::runJob, possibly from several threads at once.
+	///  @param[in]		offset	The offset of the range from the start of the archive.
+	///  @param[in]		size	The size of the range.
+	///  @param[out]	data	The buffer to read the range to. [Size: size]
+	/// @return The status flags for the operation.
+	virtual dtStatus read(const int offset, const int size, unsigned char* data) = 0;
+};
+
+/// The budgets of a tile streamer.
+/// @ingroup detour
+struct dtTileStreamerParams
+{
+	int maxFocus;				///< The maximum number of focus points.
+	int maxJobs;				///< The maximum number of tiles being loaded at the same time.
+	int maxResidentSize;		///< The maximum size of the loaded tile data, including the tiles being loaded.
+	int maxReadSize;			///< The maximum size of the stored tiles one update starts to read. (At least one tile is read.)
+};
+
+/// The loading of a single tile, run by dtTileStreamer::runJob.
+/// @ingroup detour
+struct dtTileStreamJob
+{
+	int entry;					///< The index of the tile in the archive.
+	int offset;					///< The offset of the stored tile in the archive.
+	int dataSize;				///< The size of the stored tile.
+	int flags;					///< The flags of the stored tile. (See: #dtTileArchiveEntryFlags)
+	unsigned char* data;		///< The loaded tile data, set by dtTileStreamer::runJob.
+	int tileSize;				///< The size of the loaded tile data.
+	dtStatus status;			///< The status of the job.
+};
+
+/// Loads and unloads the tiles of a navigation mesh around focus points.
+///
+/// The tiles are read from a tile archive. update() compares the tiles within the radius of the
+/// focus points to the loaded tiles, removes the tiles no longer needed and starts jobs for the
+/// closest missing tiles, within the budgets of the streamer. The jobs read and decode the tiles,
+/// and can be run on any thread with runJob(). finishJob() adds the loaded tile to the navigation
+/// mesh.
+///
+/// update(), getJobs(), finishJob() and checkPath() change or read the navigation mesh, and must
+/// be called from the thread that runs the queries. runJob() only touches the job and the reader.
+/// @ingroup detour
+class dtTileStreamer
+{
+public:
+	dtTileStreamer();
+	~dtTileStreamer();
+
+	/// Initializes the streamer.
+	///  @param[in]		nav			The navigation mesh, initialized with the parameters of the archive. Must outlive the streamer.
+	///  @param[in]		index		The header and index of the archive. [Size: #dtGetTileArchiveIndexSize]
+	///  @param[in]		indexSize	The size of the index.
+	///  @param[in]		reader		The reader of the stored tiles. Must outlive the streamer.
+	///  @param[in]		params		The budgets of the streamer.
+	/// @returns The status flags for the operation.
+	dtStatus init(dtNavMesh* nav, const unsigned char* index, const int indexSize,
+				  dtTileArchiveReader* reader, const dtTileStreamerParams* params);
+
+	/// Adds a focus point. The tiles within the radius of the point are loaded.
+	///  @param[in]		pos		The position of the focus point. [(x, y, z)]
+	///  @param[in]		radius	The radius of the tiles to load around the point.
+	/// @returns The id of the focus point, or -1 if there are too many.
+	int addFocus(const float* pos, const float radius);
+
+	/// Moves a focus point.
+	///  @param[in]		id		The id of the focus point.
+	///  @param[in]		pos		The new position of the focus point. [(x, y, z)]
+	///  @param[in]		radius	The new radius of the tiles to load around the point.
+	void setFocus(const int id, const float* pos, const float radius);
+
+	/// Removes a focus point. Its tiles are unloaded by the next update unless other points need them.
+	///  @param[in]		id		The id of the focus point.
+	void removeFocus(const int id);
+
+	/// Unloads the tiles not needed by the focus points and starts loading the missing tiles.
+	/// @returns The status flags for the operation.
+	dtStatus update();
+
+	/// Hands out the jobs started by update() that have not been handed out yet.
+	///  @param[out]	jobs		The jobs to run with runJob() and pass to finishJob().
+	///  @param[in]		maxJobs		The size of the jobs array.
+	/// @returns The number of jobs handed out.
+	int getJobs(dtTileStreamJob** jobs, const int maxJobs);
+
+	/// Reads and decodes the tile of a job. Can be called from any thread.
+	///  @param[in,out]	job		The job to run.
+	void runJob(dtTileStreamJob* job) const;
+
+	/// Adds the tile loaded by a job to the navigation mesh, or drops it if it is no longer needed.
+	/// Every job handed out by getJobs() must be finished before the streamer is freed.
+	///  @param[in]		job		The job, run by runJob().
+	/// @returns The status flags for the operation.
+	dtStatus finishJob(dtTileStreamJob* job);
+
+	/// Checks whether a path found on the streamed navigation mesh is affected by missing tiles.
+	///
+	/// The path is not valid if one of its tiles was unloaded. The path stops short of the end
+	/// position if the tile at the end position is not loaded.
+	///  @param[in]		path		The polygon path.
+	///  @param[in]		pathCount	The number of polygons in the path.
+	///  @param[in]		endPos		The end position of the path query. [(x, y, z)]
+	/// @returns #DT_FAILURE | #DT_TILE_NOT_LOADED if a polygon of the path was unloaded,
+	/// #DT_SUCCESS | #DT_TILE_NOT_LOADED if the tile at the end position is in the archive
+	/// but not loaded, #DT_SUCCESS otherwise.
+	dtStatus checkPath(const dtPolyRef* path, const int pathCount, const float* endPos) const;
+
+	/// Returns true if a tile of the archive at the tile location is loaded.
+	bool isTileLoaded(const int x, const int y) const;
+
+	/// The number of tiles loaded.
+	int getLoadedTileCount() const { return m_loadedCount; }
+
+	/// The size of the loaded tile data, including the tiles being loaded.
+	int getResidentSize() const { return m_residentSize; }
+
+	/// The number of jobs started and not finished.
+	int getJobCount() const { return m_jobCount; }
+
+	/// Returns the memory used by the streamer in bytes, excluding the tile data.
+	int getMemUsed() const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtTileStreamer(const dtTileStreamer&);
+	dtTileStreamer& operator=(const dtTileStreamer&);
+
+	enum TileState
+	{
+		TILE_UNLOADED,
+		TILE_LOADING,
+		TILE_LOADED,
+		TILE_FAILED,
+	};
+
+	/// State of a single tile of the archive.
+	struct Tile
+	{
+		dtTileArchiveEntry entry;	///< The index entry of the tile.
+		dtTileRef ref;				///< The reference of the loaded tile.
+		float priority;				///< The squared distance to the closest focus point, FLT_MAX if not needed.
+		int state;					///< The state of the tile. (See: TileState)
+	};
+
+	struct Focus
+	{
+		float pos[3];
+		float radius;
+		bool used;
+	};
+
+	/// A missing tile to load, sorted by priority.
+	struct Candidate
+	{
+		float priority;
+		int tile;
+	};
+
+	struct JobSlot
+	{
+		dtTileStreamJob job;
+		bool used;
+		bool handedOut;
+	};
+
+	void purge();
+	int findFirstTile(const int x, const int y) const;
+	void prioritizeTiles();
+	void unloadTile(Tile& tile);
+
+	dtNavMesh* m_nav;
+	dtTileArchiveReader* m_reader;
+	dtTileStreamerParams m_params;
+
+	Tile* m_tiles;				///< The tiles of the archive, sorted by location. [Size: m_tileCount]
+	Candidate* m_candidates;	///< Scratch space for the tiles to load. [Size: m_tileCount]
+	int m_tileCount;
+
+	Focus* m_focus;				///< [Size: m_params.maxFocus]
+	JobSlot* m_jobs;			///< [Size: m_params.maxJobs]
+	int m_jobCount;
+
+	int m_loadedCount;
+	int m_residentSize;
+};
+
+/// Allocates a tile streamer object using the Detour allocator.
+/// @return A tile streamer that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtTileStreamer* dtAllocTileStreamer();
+
+/// Frees the specified tile streamer object using the Detour allocator.
+///  @param[in]	streamer	A tile streamer allocated using #dtAllocTileStreamer
+///  @ingroup detour
+void dtFreeTileStreamer(dtTileStreamer* streamer);
+
+#endif // DETOURTILESTREAMER_H
@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#ifndef DETOURTILETRACKER_H
+#define DETOURTILETRACKER_H
+
+#include <string.h>
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+#include "DetourAlloc.h"
+#include "DetourCommon.h"
+
+/// The maximum number of tiles at a grid location the tables keeping data per tile look at.
+static const int DT_MAX_TILE_LAYERS = 32;
+
+/// Changes of a tile slot reported by dtTileTracker.
+/// @ingroup detour
+enum dtTileChangeFlags
+{
+	DT_TILE_REMOVED = 0x01,		///< The tile that was in the slot was removed.
+	DT_TILE_ADDED = 0x02,		///< A tile was added to the slot.
+	DT_TILE_REVISED = 0x04,		///< The polygon flags, areas or links of the tile changed. (See: dtMeshTile::revision)
+};
+
+/// Tells which tile slots of a navigation mesh changed, for the tables that keep data per tile.
+///
+/// The navigation mesh does not notify anyone of its changes. The tracker remembers the salt,
+/// header and revision of every tile slot, and compares them with the navigation mesh when polled.
+/// The navigation mesh creates its tile slots as tiles are added, call reserve() before poll()
+/// to track the slots created since.
+/// @ingroup detour
+class dtTileTracker
+{
+public:
+	dtTileTracker();
+	~dtTileTracker();
+
+	/// Prepares the tracker for the navigation mesh. The slots start out empty, so the first
+	/// call to poll() reports every tile of the navigation mesh as added.
+	///  @param[in]		nav		The navigation mesh. Must outlive the tracker.
+	///  						The memory of the tracker is taken from its allocator. (See: dtNavMesh::getAllocator)
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav);
+
+	/// Frees the memory used by the tracker.
+	void purge();
+
+	/// Starts tracking the tile slots the navigation mesh created since the last call. The new
+	/// slots start out empty.
+	/// @returns The status flags for the operation.
+	dtStatus reserve();
+
+	/// Finds the changes of every tile slot since the last poll, and remembers the current state.
+	/// @returns True if any tile slot changed.
+	bool poll();
+
+	/// Returns the changes of the tile slot found by the last poll. (See: #dtTileChangeFlags)
+	///  @param[in]		i		The index of the tile slot.
+	unsigned char getChanges(const int i) const { return m_slots[i].changes; }
+
+	/// Returns the changes of the tile slot since the last poll, without remembering the current state.
+	/// (See: #dtTileChangeFlags)
+	///  @param[in]		i		The index of the tile slot. Slots not tracked yet count as empty.
+	///  						[Limit: 0 <= value < dtNavMesh::getTileSlotCount()]
+	unsigned char findChanges(const int i) const;
+
+	/// Returns the salt of the tile in the slot at the last poll, or zero if the slot was empty.
+	///  @param[in]		i		The index of the tile slot.
+	unsigned int getSalt(const int i) const { return m_slots[i].salt; }
+
+	/// The number of tile slots tracked.
+	int getSlotCount() const { return m_slotCount; }
+
+	/// The number of tile slots the tracker has room for. Grows by doubling, so the tables can
+	/// size their per slot arrays with it.
+	int getSlotCapacity() const { return m_slotCapacity; }
+
+	/// Returns the memory used by the tracker in bytes.
+	int getMemUsed() const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtTileTracker(const dtTileTracker&);
+	dtTileTracker& operator=(const dtTileTracker&);
+
+	/// The state of a tile slot at the last poll.
+	struct Slot
+	{
+		unsigned int salt;				///< Salt of the tile. (0 if the slot is empty.)
+		unsigned int revision;			///< Revision of the tile.
+		const dtMeshHeader* header;		///< Header of the tile.
+		unsigned char changes;			///< The changes found by the last poll. (See: #dtTileChangeFlags)
+	};
+
+	const dtNavMesh* m_nav;
+	dtAllocator* m_allocator;
+	Slot* m_slots;
+	int m_slotCount;
+	int m_slotCapacity;
+};
+
+/// Grows a per tile slot array of a table, keeping the items and zeroing the new ones.
+///  @param[in,out]	items		The array, or null if none was allocated yet.
+///  @param[in]		count		The number of items in the array.
+///  @param[in]		newCount	The number of items to grow to.
+///  @param[in]		allocator	The allocator the array was allocated with. [opt]
+/// @returns False if out of memory, in which case the array is left unchanged.
+template<class T> bool dtGrowTileArray(T*& items, const int count, const int newCount, dtAllocator* allocator)
+{
+	if (newCount <= count && items)
+		return true;
+	T* grown = (T*)dtAlloc(sizeof(T)*dtMax(newCount, 1), DT_ALLOC_PERM, allocator);
+	if (!grown)
+		return false;
+	if (count > 0)
+		memcpy(grown, items, sizeof(T)*count);
+	memset(grown + count, 0, sizeof(T)*(dtMax(newCount, 1) - count));
+	dtFree(items, allocator);
+	items = grown;
+	return true;
+}
+
+#endif // DETOURTILETRACKER_H
@@ -0,0 +1,66 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#ifndef DETOURTIME_H
+#define DETOURTIME_H
+
+#include <stdint.h>
+
+/// A time in microseconds, measured from an arbitrary but fixed point.
+typedef int64_t dtTimeVal;
+
+/// A clock function.
+///  @return The current time in microseconds.
+/// @see dtTimeSetCustom
+typedef dtTimeVal (dtTimeFunc)();
+
+/// Sets the clock used by the time budgeted queries.
+///  @param[in]		timeFunc	The clock to be used by #dtGetTimeUsec, or null to restore the default clock.
+void dtTimeSetCustom(dtTimeFunc* timeFunc);
+
+/// Returns the current time of the Detour clock in microseconds.
+/// The default clock is monotonic and has at least microsecond resolution where the platform supports it.
+dtTimeVal dtGetTimeUsec();
+
+/// Statistics of time budgeted query updates.
+/// @see dtNavMeshQuery::updateSlicedFindPathTimed, dtPathQueue::updateTimed
+struct dtTimeBudgetStats
+{
+	int updates;			///< The number of budgeted updates.
+	int overruns;			///< The number of updates that took longer than their budget.
+	int64_t iterations;		///< The number of search iterations performed.
+	dtTimeVal time;			///< The time spent in the updates. [Units: us]
+	dtTimeVal maxTime;		///< The longest single update. [Units: us]
+
+	/// Returns the average number of search iterations performed per microsecond.
+	inline float getItersPerUsec() const { return time > 0 ? (float)((double)iterations / (double)time) : 0.0f; }
+};
+
+/// Clears the statistics.
+///  @param[out]	stats	The statistics to clear.
+void dtResetTimeBudgetStats(dtTimeBudgetStats& stats);
+
+/// Adds a budgeted update to the statistics.
+///  @param[in,out]	stats		The statistics to update.
+///  @param[in]		iterations	The number of search iterations performed by the update.
+///  @param[in]		time		The time the update took. [Units: us]
+///  @param[in]		budget		The time budget of the update. [Units: us]
+void dtAddTimeBudgetUpdate(dtTimeBudgetStats& stats, const int iterations, const dtTimeVal time, const int budget);
+
+#endif // DETOURTIME_H
@@ -51,3 +51,18 @@ void dtFree(void* ptr)
 	ptr = 0x0;
 	//add end
 }
+
+void* dtAlloc(size_t size, dtAllocHint hint, dtAllocator* allocator)
+{
+	if (!allocator)
+		return dtAlloc(size, hint);
+	return allocator->allocate(size, hint);
+}
+
+void dtFree(void* ptr, dtAllocator* allocator)
+{
+	if (!allocator)
+		dtFree(ptr);
+	else if (ptr)
+		allocator->deallocate(ptr);
+}
@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#include <string.h>
+#include "DetourCostHeap.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+
+/// @class dtCostHeap
+///
+/// Unlike dtNodeQueue, items are never modified in place: a search pushes an item again when
+/// it finds a cheaper way to it, and skips the outdated copies when they are popped.
+///
+/// @see dtLandmarkTable, dtTileGraph, dtFlowField
+
+dtCostHeap::dtCostHeap() :
+	m_allocator(0),
+	m_items(0),
+	m_size(0),
+	m_capacity(0)
+{
+}
+
+dtCostHeap::~dtCostHeap()
+{
+	purge();
+}
+
+void dtCostHeap::purge()
+{
+	dtFree(m_items, m_allocator);
+	m_items = 0;
+	m_size = 0;
+	m_capacity = 0;
+}
+
+void dtCostHeap::setAllocator(dtAllocator* allocator)
+{
+	purge();
+	m_allocator = allocator;
+}
+
+bool dtCostHeap::push(const dtCostHeapItem& item)
+{
+	if (m_size >= m_capacity)
+	{
+		const int capacity = dtMax(256, m_capacity*2);
+		dtCostHeapItem* items = (dtCostHeapItem*)dtAlloc(sizeof(dtCostHeapItem)*capacity, DT_ALLOC_PERM, m_allocator);
+		if (!items)
+			return false;
+		if (m_size)
+			memcpy(items, m_items, sizeof(dtCostHeapItem)*m_size);
+		dtFree(m_items, m_allocator);
+		m_items = items;
+		m_capacity = capacity;
+	}
+
+	int i = m_size++;
+	while (i > 0)
+	{
+		const int parent = (i-1)/2;
+		if (m_items[parent].total <= item.total)
+			break;
+		m_items[i] = m_items[parent];
+		i = parent;
+	}
+	m_items[i] = item;
+	return true;
+}
+
+dtCostHeapItem dtCostHeap::pop()
+{
+	const dtCostHeapItem result = m_items[0];
+	const dtCostHeapItem last = m_items[--m_size];
+	int i = 0;
+	for (;;)
+	{
+		int child = i*2+1;
+		if (child >= m_size)
+			break;
+		if (child+1 < m_size && m_items[child+1].total < m_items[child].total)
+			child++;
+		if (last.total <= m_items[child].total)
+			break;
+		m_items[i] = m_items[child];
+		i = child;
+	}
+	if (m_size > 0)
+		m_items[i] = last;
+	return result;
+}
@@ -0,0 +1,540 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <float.h>
+#include <string.h>
+#include <new>
+#include "DetourFlowField.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+
+static const float DT_FLOWFIELD_INF = FLT_MAX;
+
+dtFlowField* dtAllocFlowField()
+{
+	void* mem = dtAlloc(sizeof(dtFlowField), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtFlowField;
+}
+
+void dtFreeFlowField(dtFlowField* field)
+{
+	if (!field) return;
+	field->~dtFlowField();
+	dtFree(field);
+}
+
+/// @class dtFlowField
+///
+/// The search runs over the reversed links, so one-way off-mesh connections are only
+/// followed in their direction of travel. Each polygon is located where the route leaves it,
+/// at the midpoint of the portal to the next polygon, and its cost is measured from there with
+/// dtQueryFilter::getCost(). The costs are close to those of dtNavMeshQuery::findPath().
+///
+/// Memory is allocated per tile the field reaches and kept between builds, so rebuilding a
+/// field for a moving goal does not allocate once the area has been covered.
+///
+/// The field is stale once a tile it reached is removed or replaced, or a tile is added next to
+/// one, since either may change the routes. Tiles changing elsewhere leave it as it is.
+///
+/// @see dtNavMeshQuery::findCostsFromPolys
+
+dtFlowField::dtFlowField() :
+	m_nav(0),
+	m_allocator(0),
+	m_filter(0),
+	m_tiles(0),
+	m_maxTiles(0),
+	m_tileCapacity(0),
+	m_stamp(0),
+	m_polyChangeCount(0),
+	m_goalRef(0),
+	m_maxRadius(0),
+	m_maxCost(0),
+	m_polyCount(0)
+{
+	dtVset(m_goalPos, 0, 0, 0);
+}
+
+dtFlowField::~dtFlowField()
+{
+	purge();
+}
+
+void dtFlowField::purge()
+{
+	if (m_tiles)
+	{
+		for (int i = 0; i < m_maxTiles; ++i)
+			freeTileData(m_tiles[i]);
+		dtFree(m_tiles, m_allocator);
+	}
+	m_tiles = 0;
+	m_maxTiles = 0;
+	m_tileCapacity = 0;
+	m_tracker.purge();
+	m_heap.purge();
+	m_nav = 0;
+	m_allocator = 0;
+	m_filter = 0;
+	m_goalRef = 0;
+	m_polyCount = 0;
+}
+
+void dtFlowField::freeTileData(TileData& data)
+{
+	dtFree(data.costs, m_allocator);
+	dtFree(data.pos, m_allocator);
+	dtFree(data.next, m_allocator);
+	memset(&data, 0, sizeof(TileData));
+}
+
+// Makes the data of the tile slot part of the current build.
+dtStatus dtFlowField::touchTile(const int tileIdx)
+{
+	TileData& data = m_tiles[tileIdx];
+	if (data.stamp == m_stamp)
+		return DT_SUCCESS;
+
+	const dtMeshTile* tile = m_nav->getTile(tileIdx);
+	const int npolys = tile->header->polyCount;
+	if (data.salt != tile->salt || data.polyCount != npolys)
+	{
+		freeTileData(data);
+		data.costs = (float*)dtAlloc(sizeof(float)*dtMax(npolys, 1), DT_ALLOC_PERM, m_allocator);
+		data.pos = (float*)dtAlloc(sizeof(float)*3*dtMax(npolys, 1), DT_ALLOC_PERM, m_allocator);
+		data.next = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*dtMax(npolys, 1), DT_ALLOC_PERM, m_allocator);
+		if (!data.costs || !data.pos || !data.next)
+		{
+			freeTileData(data);
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+		data.salt = tile->salt;
+		data.x = tile->header->x;
+		data.y = tile->header->y;
+		data.polyCount = npolys;
+	}
+
+	for (int i = 0; i < npolys; ++i)
+		data.costs[i] = DT_FLOWFIELD_INF;
+	memset(data.next, 0, sizeof(dtPolyRef)*npolys);
+	data.oneWayCount = m_nav->countOneWayOffMeshConnections(tile);
+	data.stamp = m_stamp;
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtFlowField::init(const dtNavMesh* nav, const dtQueryFilter* filter)
+{
+	purge();
+
+	if (!nav || !filter)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtStatus status = m_tracker.init(nav);
+	if (dtStatusFailed(status))
+		return status;
+
+	m_nav = nav;
+	m_allocator = nav->getAllocator();
+	m_heap.setAllocator(m_allocator);
+	m_filter = filter;
+	const dtStatus reserveStatus = reserveTiles();
+	if (dtStatusFailed(reserveStatus))
+		purge();
+	return reserveStatus;
+}
+
+// Grows the per tile slot arrays to the tile slots the navigation mesh created.
+dtStatus dtFlowField::reserveTiles()
+{
+	const dtStatus status = m_tracker.reserve();
+	if (dtStatusFailed(status))
+		return status;
+	const int capacity = m_tracker.getSlotCapacity();
+	if (capacity > m_tileCapacity)
+	{
+		if (!dtGrowTileArray(m_tiles, m_tileCapacity, capacity, m_allocator))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		m_tileCapacity = capacity;
+	}
+	m_maxTiles = m_tracker.getSlotCount();
+	return DT_SUCCESS;
+}
+
+// Reaches the polygon prevRef, from which the polygon of the item is entered on the way to nextRef.
+dtStatus dtFlowField::relax(const dtCostHeapItem& item, const float* itemPos,
+							dtPolyRef curRef, const dtMeshTile* curTile, const dtPoly* curPoly,
+							dtPolyRef nextRef, const dtMeshTile* nextTile, const dtPoly* nextPoly,
+							dtPolyRef prevRef, const dtMeshTile* prevTile, const dtPoly* prevPoly)
+{
+	if (!m_filter->passFilter(prevRef, prevTile, prevPoly))
+		return DT_SUCCESS;
+
+	const dtLink* link = 0;
+	for (unsigned int i = prevPoly->firstLink; i != DT_NULL_LINK; i = prevTile->links[i].next)
+	{
+		if (prevTile->links[i].ref == curRef)
+		{
+			link = &prevTile->links[i];
+			break;
+		}
+	}
+	if (!link)
+		return DT_SUCCESS;
+
+	float left[3], right[3];
+	m_nav->getLinkPortal(prevRef, prevTile, prevPoly, link, left, right);
+	if (m_maxRadius < DT_FLOWFIELD_INF)
+	{
+		float t;
+		if (dtDistancePtSegSqr2D(m_goalPos, left, right, t) > dtSqr(m_maxRadius))
+			return DT_SUCCESS;
+	}
+
+	float mid[3];
+	dtVlerp(mid, left, right, 0.5f);
+	const float cost = item.cost +
+		m_filter->getCost(mid, itemPos,
+						  prevRef, prevTile, prevPoly,
+						  curRef, curTile, curPoly,
+						  nextRef, nextTile, nextPoly);
+	if (cost > m_maxCost)
+		return DT_SUCCESS;
+
+	const int tileIdx = (int)m_nav->decodePolyIdTile(prevRef);
+	const unsigned int ip = m_nav->decodePolyIdPoly(prevRef);
+	const dtStatus status = touchTile(tileIdx);
+	if (dtStatusFailed(status))
+		return status;
+
+	// The position moves with the route, so it always lies on the portal to the next polygon.
+	TileData& data = m_tiles[tileIdx];
+	if (cost >= data.costs[ip])
+		return DT_SUCCESS;
+	if (data.costs[ip] == DT_FLOWFIELD_INF)
+		m_polyCount++;
+	data.costs[ip] = cost;
+	dtVcopy(&data.pos[ip*3], mid);
+	data.next[ip] = curRef;
+
+	dtCostHeapItem prev;
+	prev.total = cost;
+	prev.cost = cost;
+	prev.tile = tileIdx;
+	prev.index = ip;
+	if (!m_heap.push(prev))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// Pass FLT_MAX as @p maxRadius or @p maxCost to leave the field unbounded in that respect.
+/// Either bound keeps the field, and the time to build it, proportional to the area around the
+/// goal that agents actually come from.
+dtStatus dtFlowField::build(dtPolyRef goalRef, const float* goalPos, const float maxRadius, const float maxCost)
+{
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	m_stamp++;
+	m_polyCount = 0;
+	m_polyChangeCount = m_nav->getPolyChangeCount();
+	m_heap.clear();
+	m_goalRef = 0;
+
+	// Remember the tiles the field is built on, and drop the data of the tiles that are gone.
+	dtStatus status = reserveTiles();
+	if (dtStatusFailed(status))
+		return status;
+	m_tracker.poll();
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (m_tiles[i].salt && m_tiles[i].salt != m_tracker.getSalt(i))
+			freeTileData(m_tiles[i]);
+	}
+
+	if (!goalRef || !m_nav->isValidPolyRef(goalRef) || !goalPos || maxRadius < 0 || maxCost < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	m_goalRef = goalRef;
+	dtVcopy(m_goalPos, goalPos);
+	m_maxRadius = maxRadius;
+	m_maxCost = maxCost;
+
+	const int goalTile = (int)m_nav->decodePolyIdTile(goalRef);
+	const unsigned int goalPoly = m_nav->decodePolyIdPoly(goalRef);
+	status = touchTile(goalTile);
+	if (dtStatusFailed(status))
+		return status;
+	TileData& goalData = m_tiles[goalTile];
+	goalData.costs[goalPoly] = 0.0f;
+	dtVcopy(&goalData.pos[goalPoly*3], goalPos);
+	goalData.next[goalPoly] = 0;
+	m_polyCount = 1;
+
+	dtCostHeapItem goal;
+	goal.total = 0.0f;
+	goal.cost = 0.0f;
+	goal.tile = goalTile;
+	goal.index = goalPoly;
+	if (!m_heap.push(goal))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	const dtMeshTile* neis[DT_MAX_TILE_LAYERS];
+	while (!m_heap.empty())
+	{
+		const dtCostHeapItem item = m_heap.pop();
+		const TileData& data = m_tiles[item.tile];
+		if (item.cost > data.costs[item.index])
+			continue;
+
+		const dtMeshTile* curTile = m_nav->getTile(item.tile);
+		const dtPolyRef curRef = m_nav->getPolyRefBase(curTile) | (dtPolyRef)item.index;
+		const dtPoly* curPoly = &curTile->polys[item.index];
+		float curPos[3];
+		dtVcopy(curPos, &data.pos[item.index*3]);
+		const int oneWayCount = data.oneWayCount;
+
+		const dtPolyRef nextRef = data.next[item.index];
+		const dtMeshTile* nextTile = 0;
+		const dtPoly* nextPoly = 0;
+		if (nextRef)
+			m_nav->getTileAndPolyByRefUnsafe(nextRef, &nextTile, &nextPoly);
+
+		// Polygons are linked both ways, but an off-mesh connection is linked from its end
+		// only if it is bidirectional.
+		const bool offMesh = curPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION;
+		for (unsigned int i = curPoly->firstLink; i != DT_NULL_LINK; i = curTile->links[i].next)
+		{
+			const dtPolyRef prevRef = curTile->links[i].ref;
+			if (!prevRef || prevRef == nextRef)
+				continue;
+			const dtMeshTile* prevTile = 0;
+			const dtPoly* prevPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(prevRef, &prevTile, &prevPoly);
+			if (offMesh && !m_nav->hasLinkTo(prevTile, prevPoly, curRef))
+				continue;
+			status = relax(item, curPos, curRef, curTile, curPoly, nextRef, nextTile, nextPoly, prevRef, prevTile, prevPoly);
+			if (dtStatusFailed(status))
+				return status;
+		}
+
+		if (offMesh || !oneWayCount)
+			continue;
+
+		// One-way off-mesh connections landing on the polygon are not linked from it,
+		// look for them in the surrounding tiles.
+		for (int dy = -1; dy <= 1; ++dy)
+		{
+			for (int dx = -1; dx <= 1; ++dx)
+			{
+				const int nneis = m_nav->getTilesAt(curTile->header->x+dx, curTile->header->y+dy, neis, DT_MAX_TILE_LAYERS);
+				for (int j = 0; j < nneis; ++j)
+				{
+					const dtMeshTile* prevTile = neis[j];
+					const dtPolyRef base = m_nav->getPolyRefBase(prevTile);
+					for (int k = 0; k < prevTile->header->offMeshConCount; ++k)
+					{
+						const dtOffMeshConnection* con = &prevTile->offMeshCons[k];
+						if ((con->flags & DT_OFFMESH_CON_BIDIR) ||
+							!m_nav->offMeshConLandsAt(prevTile, con, curTile->header->x, curTile->header->y))
+							continue;
+						const dtPolyRef prevRef = base | (dtPolyRef)con->poly;
+						const dtPoly* prevPoly = &prevTile->polys[con->poly];
+						if (prevRef == nextRef || m_nav->hasLinkTo(curTile, curPoly, prevRef))
+							continue;
+						status = relax(item, curPos, curRef, curTile, curPoly, nextRef, nextTile, nextPoly, prevRef, prevTile, prevPoly);
+						if (dtStatusFailed(status))
+							return status;
+					}
+				}
+			}
+		}
+	}
+
+	return DT_SUCCESS;
+}
+
+bool dtFlowField::isStale() const
+{
+	if (!m_goalRef)
+		return false;
+
+	// Tiles are also revised when their links to new neighbours change, which the added
+	// tiles cover. Only polygon flag and area changes matter here.
+	const bool polysChanged = m_nav->getPolyChangeCount() != m_polyChangeCount;
+	for (int i = 0; i < m_nav->getTileSlotCount(); ++i)
+	{
+		const unsigned char changes = m_tracker.findChanges(i);
+		// A tile the field reached is gone.
+		if ((changes & DT_TILE_REMOVED) && m_tiles[i].stamp == m_stamp && m_tiles[i].salt == m_tracker.getSalt(i))
+			return true;
+		// A new tile, or a tile whose polygons opened, closed or changed cost, may change
+		// the routes of the tiles the field reached.
+		if ((changes & DT_TILE_ADDED) || ((changes & DT_TILE_REVISED) && polysChanged))
+		{
+			if (isNextToField(m_nav->getTile(i)))
+				return true;
+		}
+	}
+	return false;
+}
+
+// Returns true if the tile is one the field reached or next to one.
+bool dtFlowField::isNextToField(const dtMeshTile* tile) const
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const TileData& data = m_tiles[i];
+		if (data.stamp == m_stamp && data.salt == m_tracker.getSalt(i) &&
+			dtAbs(data.x - tile->header->x) <= 1 && dtAbs(data.y - tile->header->y) <= 1)
+			return true;
+	}
+	return false;
+}
+
+dtStatus dtFlowField::update()
+{
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!isStale())
+		return DT_SUCCESS;
+
+	float goalPos[3];
+	dtVcopy(goalPos, m_goalPos);
+	return build(m_goalRef, goalPos, m_maxRadius, m_maxCost);
+}
+
+const dtFlowField::TileData* dtFlowField::getTileData(dtPolyRef ref, unsigned int& ip) const
+{
+	if (!m_tiles || !ref || !m_nav->isValidPolyRef(ref))
+		return 0;
+	unsigned int salt, it;
+	m_nav->decodePolyId(ref, salt, it, ip);
+	if (it >= (unsigned int)m_maxTiles)
+		return 0;
+	const TileData& data = m_tiles[it];
+	if (data.stamp != m_stamp || data.salt != salt || data.salt != m_tracker.getSalt(it) ||
+		ip >= (unsigned int)data.polyCount || data.costs[ip] == DT_FLOWFIELD_INF)
+		return 0;
+	return &data;
+}
+
+float dtFlowField::getCost(dtPolyRef ref) const
+{
+	unsigned int ip;
+	const TileData* data = getTileData(ref, ip);
+	return data ? data->costs[ip] : DT_FLOWFIELD_INF;
+}
+
+float dtFlowField::getCost(dtPolyRef ref, const float* pos) const
+{
+	unsigned int ip;
+	const TileData* data = getTileData(ref, ip);
+	if (!data)
+		return DT_FLOWFIELD_INF;
+
+	const dtMeshTile* tile = 0;
+	const dtPoly* poly = 0;
+	m_nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+	const dtPolyRef nextRef = data->next[ip];
+	const dtMeshTile* nextTile = 0;
+	const dtPoly* nextPoly = 0;
+	if (nextRef)
+		m_nav->getTileAndPolyByRefUnsafe(nextRef, &nextTile, &nextPoly);
+	return data->costs[ip] +
+		m_filter->getCost(pos, &data->pos[ip*3],
+						  0, 0, 0,
+						  ref, tile, poly,
+						  nextRef, nextTile, nextPoly);
+}
+
+dtPolyRef dtFlowField::getNextPoly(dtPolyRef ref) const
+{
+	unsigned int ip;
+	const TileData* data = getTileData(ref, ip);
+	return data ? data->next[ip] : 0;
+}
+
+dtStatus dtFlowField::getNextPortal(dtPolyRef ref, float* left, float* right) const
+{
+	unsigned int ip;
+	const TileData* data = getTileData(ref, ip);
+	if (!data || !left || !right)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtPolyRef nextRef = data->next[ip];
+	if (!nextRef)
+	{
+		dtVcopy(left, m_goalPos);
+		dtVcopy(right, m_goalPos);
+		return DT_SUCCESS;
+	}
+
+	const dtMeshTile* tile = 0;
+	const dtPoly* poly = 0;
+	m_nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+	for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+	{
+		if (tile->links[i].ref == nextRef)
+		{
+			m_nav->getLinkPortal(ref, tile, poly, &tile->links[i], left, right);
+			return DT_SUCCESS;
+		}
+	}
+	return DT_FAILURE;
+}
+
+dtStatus dtFlowField::getPath(dtPolyRef ref, dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	if (!pathCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	*pathCount = 0;
+
+	unsigned int ip;
+	if (!getTileData(ref, ip) || !path || maxPath < 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	int n = 0;
+	for (dtPolyRef cur = ref; cur; cur = getNextPoly(cur))
+	{
+		if (n >= maxPath)
+		{
+			*pathCount = n;
+			return DT_SUCCESS | DT_BUFFER_TOO_SMALL;
+		}
+		path[n++] = cur;
+	}
+	*pathCount = n;
+
+	return DT_SUCCESS;
+}
+
+int dtFlowField::getMemUsed() const
+{
+	int size = sizeof(*this) + m_tracker.getMemUsed() +
+		(int)sizeof(TileData)*m_tileCapacity +
+		m_heap.getMemUsed();
+	for (int i = 0; i < m_maxTiles && m_tiles; ++i)
+		size += m_tiles[i].polyCount*(int)(sizeof(float)*4 + sizeof(dtPolyRef));
+	return size;
+}
@@ -0,0 +1,414 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include <new>
+#include "DetourIslands.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+
+dtIslandTable* dtAllocIslandTable()
+{
+	void* mem = dtAlloc(sizeof(dtIslandTable), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtIslandTable;
+}
+
+void dtFreeIslandTable(dtIslandTable* table)
+{
+	if (!table) return;
+	table->~dtIslandTable();
+	dtFree(table);
+}
+
+/// @class dtIslandTable
+///
+/// Each tile is flood filled into local labels, and the labels connected by links crossing
+/// the tile borders are merged with a union-find structure. Adding tiles only labels the new
+/// tiles and merges their borders. Removing a tile, or changing polygon flags or areas, may
+/// split an island, so it relabels the whole mesh, which costs a pass over all polygons. The union-find is flattened after every update,
+/// which makes isConnected() two table lookups.
+///
+/// @see dtNavMeshQuery::setIslandTable
+
+dtIslandTable::dtIslandTable() :
+	m_nav(0),
+	m_allocator(0),
+	m_includeFlags(0),
+	m_excludeFlags(0),
+	m_tiles(0),
+	m_maxTiles(0),
+	m_tileCapacity(0),
+	m_added(0),
+	m_polyChangeCount(0),
+	m_parents(0),
+	m_labelCount(0),
+	m_labelCapacity(0),
+	m_islandCount(0),
+	m_stack(0),
+	m_stackCapacity(0)
+{
+}
+
+dtIslandTable::~dtIslandTable()
+{
+	purge();
+}
+
+void dtIslandTable::purge()
+{
+	clearLabels();
+	dtFree(m_tiles, m_allocator);
+	m_tiles = 0;
+	m_maxTiles = 0;
+	m_tileCapacity = 0;
+	m_tracker.purge();
+	dtFree(m_added, m_allocator);
+	m_added = 0;
+	dtFree(m_parents, m_allocator);
+	m_parents = 0;
+	m_labelCapacity = 0;
+	dtFree(m_stack, m_allocator);
+	m_stack = 0;
+	m_stackCapacity = 0;
+	m_nav = 0;
+	m_allocator = 0;
+	m_includeFlags = 0;
+	m_excludeFlags = 0;
+}
+
+// Same test as dtQueryFilter::passFilter(), so the labels do not depend on the filter object.
+inline bool dtIslandTable::passFlags(const dtPoly* poly) const
+{
+	return (poly->flags & m_includeFlags) != 0 && (poly->flags & m_excludeFlags) == 0;
+}
+
+void dtIslandTable::clearLabels()
+{
+	for (int i = 0; i < m_maxTiles && m_tiles; ++i)
+	{
+		dtFree(m_tiles[i].labels, m_allocator);
+		memset(&m_tiles[i], 0, sizeof(TileData));
+	}
+	// Label zero is reserved for polygons that do not pass the filter.
+	m_labelCount = 1;
+	m_islandCount = 0;
+}
+
+unsigned int dtIslandTable::findRoot(unsigned int label)
+{
+	while (m_parents[label] != label)
+	{
+		m_parents[label] = m_parents[m_parents[label]];
+		label = m_parents[label];
+	}
+	return label;
+}
+
+void dtIslandTable::unite(unsigned int a, unsigned int b)
+{
+	a = findRoot(a);
+	b = findRoot(b);
+	if (a == b)
+		return;
+	if (a < b)
+		m_parents[b] = a;
+	else
+		m_parents[a] = b;
+}
+
+void dtIslandTable::flatten()
+{
+	m_islandCount = 0;
+	for (int i = 1; i < m_labelCount; ++i)
+	{
+		m_parents[i] = findRoot((unsigned int)i);
+		if (m_parents[i] == (unsigned int)i)
+			m_islandCount++;
+	}
+}
+
+// Flood fills the polygons of the tile into new labels, following the links within the tile.
+dtStatus dtIslandTable::labelTile(const int tileIdx)
+{
+	const dtMeshTile* tile = m_nav->getTile(tileIdx);
+	TileData& data = m_tiles[tileIdx];
+	dtFree(data.labels, m_allocator);
+	memset(&data, 0, sizeof(TileData));
+	if (!tile->header)
+		return DT_SUCCESS;
+
+	const int npolys = tile->header->polyCount;
+	data.labels = (unsigned int*)dtAlloc(sizeof(unsigned int)*dtMax(npolys, 1), DT_ALLOC_PERM, m_allocator);
+	if (!data.labels)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(data.labels, 0, sizeof(unsigned int)*dtMax(npolys, 1));
+	data.salt = tile->salt;
+	data.polyCount = npolys;
+
+	if (npolys > m_stackCapacity)
+	{
+		dtFree(m_stack, m_allocator);
+		m_stackCapacity = (int)dtNextPow2((unsigned int)npolys);
+		m_stack = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*m_stackCapacity, DT_ALLOC_PERM, m_allocator);
+		if (!m_stack)
+		{
+			m_stackCapacity = 0;
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+	}
+
+	for (int i = 0; i < npolys; ++i)
+	{
+		if (data.labels[i] || !passFlags(&tile->polys[i]))
+			continue;
+
+		if (m_labelCount >= m_labelCapacity)
+		{
+			const int capacity = dtMax(256, m_labelCapacity*2);
+			unsigned int* parents = (unsigned int*)dtAlloc(sizeof(unsigned int)*capacity, DT_ALLOC_PERM, m_allocator);
+			if (!parents)
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+			if (m_parents)
+				memcpy(parents, m_parents, sizeof(unsigned int)*m_labelCount);
+			dtFree(m_parents, m_allocator);
+			m_parents = parents;
+			m_labelCapacity = capacity;
+		}
+		const unsigned int label = (unsigned int)m_labelCount++;
+		m_parents[label] = label;
+
+		int nstack = 0;
+		data.labels[i] = label;
+		m_stack[nstack++] = (dtPolyRef)i;
+		while (nstack > 0)
+		{
+			const dtPoly* poly = &tile->polys[m_stack[--nstack]];
+			for (unsigned int j = poly->firstLink; j != DT_NULL_LINK; j = tile->links[j].next)
+			{
+				const dtPolyRef ref = tile->links[j].ref;
+				if (!ref || (int)m_nav->decodePolyIdTile(ref) != tileIdx)
+					continue;
+				const unsigned int ip = m_nav->decodePolyIdPoly(ref);
+				if (data.labels[ip] || !passFlags(&tile->polys[ip]))
+					continue;
+				data.labels[ip] = label;
+				m_stack[nstack++] = (dtPolyRef)ip;
+			}
+		}
+	}
+
+	return DT_SUCCESS;
+}
+
+// Merges the labels connected by the links leaving the tile and by the links of the neighbour
+// tiles entering it.
+void dtIslandTable::connectTile(const int tileIdx)
+{
+	const dtMeshTile* tile = m_nav->getTile(tileIdx);
+	const dtMeshTile* neis[DT_MAX_TILE_LAYERS];
+	for (int dy = -1; dy <= 1; ++dy)
+	{
+		for (int dx = -1; dx <= 1; ++dx)
+		{
+			const int nneis = m_nav->getTilesAt(tile->header->x+dx, tile->header->y+dy, neis, DT_MAX_TILE_LAYERS);
+			for (int n = 0; n < nneis; ++n)
+			{
+				const dtMeshTile* from = neis[n];
+				const int fromIdx = (int)m_nav->decodePolyIdTile(m_nav->getPolyRefBase(from));
+				const TileData& fromData = m_tiles[fromIdx];
+				if (fromData.salt != from->salt)
+					continue;
+				for (int i = 0; i < fromData.polyCount; ++i)
+				{
+					const unsigned int label = fromData.labels[i];
+					if (!label)
+						continue;
+					const dtPoly* poly = &from->polys[i];
+					for (unsigned int j = poly->firstLink; j != DT_NULL_LINK; j = from->links[j].next)
+					{
+						const dtPolyRef ref = from->links[j].ref;
+						if (!ref)
+							continue;
+						const int toIdx = (int)m_nav->decodePolyIdTile(ref);
+						if (toIdx == fromIdx || (fromIdx != tileIdx && toIdx != tileIdx))
+							continue;
+						const TileData& toData = m_tiles[toIdx];
+						if (toData.salt != m_nav->decodePolyIdSalt(ref))
+							continue;
+						const unsigned int toLabel = toData.labels[m_nav->decodePolyIdPoly(ref)];
+						if (toLabel)
+							unite(label, toLabel);
+					}
+				}
+			}
+		}
+	}
+}
+
+dtStatus dtIslandTable::init(const dtNavMesh* nav, const dtQueryFilter* filter)
+{
+	purge();
+
+	if (!nav || !filter)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtStatus status = m_tracker.init(nav);
+	if (dtStatusFailed(status))
+		return status;
+
+	m_nav = nav;
+	m_allocator = nav->getAllocator();
+	m_includeFlags = filter->getIncludeFlags();
+	m_excludeFlags = filter->getExcludeFlags();
+	m_polyChangeCount = nav->getPolyChangeCount();
+
+	return update();
+}
+
+// Grows the per tile slot arrays to the tile slots the navigation mesh created.
+dtStatus dtIslandTable::reserveTiles()
+{
+	const dtStatus status = m_tracker.reserve();
+	if (dtStatusFailed(status))
+		return status;
+	const int capacity = m_tracker.getSlotCapacity();
+	if (capacity > m_tileCapacity)
+	{
+		if (!dtGrowTileArray(m_tiles, m_tileCapacity, capacity, m_allocator) ||
+			!dtGrowTileArray(m_added, m_tileCapacity, capacity, m_allocator))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		m_tileCapacity = capacity;
+	}
+	m_maxTiles = m_tracker.getSlotCount();
+	return DT_SUCCESS;
+}
+
+dtStatus dtIslandTable::update()
+{
+	if (!m_nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtStatus status = reserveTiles();
+	if (dtStatusFailed(status))
+	{
+		purge();
+		return status;
+	}
+
+	if (!m_tracker.poll())
+		return DT_SUCCESS;
+
+	bool removed = false;
+	bool added = false;
+	bool revised = false;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const unsigned char changes = m_tracker.getChanges(i);
+		if (changes & DT_TILE_REMOVED)
+			removed = true;
+		if (changes & DT_TILE_REVISED)
+			revised = true;
+		m_added[i] = (changes & DT_TILE_ADDED) ? 1 : 0;
+		if (m_added[i])
+			added = true;
+	}
+
+	// Tiles are also revised when their links to new neighbours change, which connectTile()
+	// handles. Only polygon flag and area changes need a relabel.
+	const unsigned int polyChangeCount = m_nav->getPolyChangeCount();
+	if (revised && polyChangeCount != m_polyChangeCount)
+		removed = true;
+	m_polyChangeCount = polyChangeCount;
+
+	if (!removed && !added)
+		return DT_SUCCESS;
+
+	if (removed)
+	{
+		// Islands may have split, start over.
+		clearLabels();
+		for (int i = 0; i < m_maxTiles; ++i)
+			m_added[i] = m_nav->getTile(i)->header ? 1 : 0;
+	}
+
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (!m_added[i])
+			continue;
+		const dtStatus status = labelTile(i);
+		if (dtStatusFailed(status))
+		{
+			purge();
+			return status;
+		}
+	}
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (m_added[i])
+			connectTile(i);
+	}
+	flatten();
+
+	return DT_SUCCESS;
+}
+
+unsigned int dtIslandTable::getIsland(dtPolyRef ref) const
+{
+	if (!m_tiles || !ref)
+		return 0;
+	unsigned int salt, it, ip;
+	m_nav->decodePolyId(ref, salt, it, ip);
+	if (it >= (unsigned int)m_maxTiles)
+		return 0;
+	const TileData& data = m_tiles[it];
+	if (!data.salt || data.salt != salt || ip >= (unsigned int)data.polyCount)
+		return 0;
+	const unsigned int label = data.labels[ip];
+	return label ? m_parents[label] : 0;
+}
+
+/// @par
+///
+/// Polygons that do not pass the filter, or that the table does not know yet, are assumed to be
+/// connected to everything, so the result is only ever a safe rejection.
+bool dtIslandTable::isConnected(dtPolyRef from, dtPolyRef to) const
+{
+	const unsigned int a = getIsland(from);
+	const unsigned int b = getIsland(to);
+	if (!a || !b)
+		return true;
+	return a == b;
+}
+
+bool dtIslandTable::matchesFilter(const dtQueryFilter* filter) const
+{
+	return filter->getIncludeFlags() == m_includeFlags && filter->getExcludeFlags() == m_excludeFlags;
+}
+
+int dtIslandTable::getMemUsed() const
+{
+	int size = sizeof(*this) + m_tracker.getMemUsed() +
+		(int)(sizeof(TileData) + sizeof(unsigned char))*m_tileCapacity +
+		(int)sizeof(unsigned int)*m_labelCapacity +
+		(int)sizeof(dtPolyRef)*m_stackCapacity;
+	for (int i = 0; i < m_maxTiles && m_tiles; ++i)
+		size += m_tiles[i].polyCount*(int)sizeof(unsigned int);
+	return size;
+}
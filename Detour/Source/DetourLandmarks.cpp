@@ -0,0 +1,782 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <float.h>
+#include <string.h>
+#include <new>
+#include "DetourLandmarks.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+
+static const float DT_LANDMARK_INF = FLT_MAX;
+static const unsigned short DT_LANDMARK_NO_OWNER = 0xffff;
+
+// Per tile slot marks used while updating.
+static const unsigned char DT_LANDMARK_MARK_LINKS = 0x01;	// Link owners and positions must be refreshed.
+static const unsigned char DT_LANDMARK_MARK_RANGES = 0x02;	// Polygon ranges must be recomputed.
+static const unsigned char DT_LANDMARK_MARK_SEED = 0x04;	// Links must be re-propagated.
+
+dtLandmarkTable* dtAllocLandmarkTable()
+{
+	void* mem = dtAlloc(sizeof(dtLandmarkTable), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtLandmarkTable;
+}
+
+void dtFreeLandmarkTable(dtLandmarkTable* table)
+{
+	if (!table) return;
+	table->~dtLandmarkTable();
+	dtFree(table);
+}
+
+/// @class dtLandmarkTable
+///
+/// The table stores one distance per landmark for every link of every tile, plus a
+/// [lo, hi] range per polygon. For a query from polygon @e n to polygon @e e the
+/// heuristic is the largest of <tt>lo(e) - hi(n)</tt> over all landmarks. When every link of the
+/// mesh can be travelled in both directions (no one-way off-mesh connections) the reverse
+/// bound <tt>lo(n) - hi(e)</tt> is used as well.
+///
+/// The bound stays admissible as long as the distances are consistent with the current links:
+/// removing tiles only removes links, and added tiles are propagated incrementally by update()
+/// using a decrease-only Dijkstra seeded from the surrounding tiles.
+///
+/// The filter passed to init() defines the graph. Queries using the table must use a filter
+/// that is no more permissive and no cheaper than it, otherwise the path finder may return
+/// suboptimal paths. The reverse bound also assumes dtQueryFilter::getCost() does not depend on
+/// the travel direction, which is true for the default filter. The filter must stay valid until
+/// the last call to update(). Changing polygon flags or areas requires a new call to init().
+///
+/// @see dtNavMeshQuery::setLandmarkTable
+
+dtLandmarkTable::dtLandmarkTable() :
+	m_nav(0),
+	m_allocator(0),
+	m_filter(0),
+	m_count(0),
+	m_stride(0),
+	m_symmetric(false),
+	m_tiles(0),
+	m_maxTiles(0),
+	m_tileCapacity(0),
+	m_marks(0),
+	m_fresh(0)
+{
+	memset(m_landmarks, 0, sizeof(m_landmarks));
+}
+
+dtLandmarkTable::~dtLandmarkTable()
+{
+	purge();
+}
+
+void dtLandmarkTable::purge()
+{
+	if (m_tiles)
+	{
+		for (int i = 0; i < m_maxTiles; ++i)
+			freeTileData(m_tiles[i]);
+		dtFree(m_tiles, m_allocator);
+	}
+	m_tiles = 0;
+	m_maxTiles = 0;
+	m_tileCapacity = 0;
+	m_tracker.purge();
+	dtFree(m_marks, m_allocator);
+	m_marks = 0;
+	dtFree(m_fresh, m_allocator);
+	m_fresh = 0;
+	m_heap.purge();
+	m_nav = 0;
+	m_allocator = 0;
+	m_filter = 0;
+	m_count = 0;
+	m_stride = 0;
+}
+
+void dtLandmarkTable::freeTileData(TileData& data)
+{
+	dtFree(data.owner, m_allocator);
+	dtFree(data.pos, m_allocator);
+	dtFree(data.dist, m_allocator);
+	dtFree(data.range, m_allocator);
+	memset(&data, 0, sizeof(TileData));
+}
+
+bool dtLandmarkTable::allocTileData(TileData& data, const dtMeshTile* tile)
+{
+	const int nlinks = tile->header->maxLinkCount;
+	const int npolys = tile->header->polyCount;
+
+	memset(&data, 0, sizeof(TileData));
+	data.owner = (unsigned short*)dtAlloc(sizeof(unsigned short)*dtMax(nlinks, 1), DT_ALLOC_PERM, m_allocator);
+	data.pos = (float*)dtAlloc(sizeof(float)*3*dtMax(nlinks, 1), DT_ALLOC_PERM, m_allocator);
+	data.dist = (float*)dtAlloc(sizeof(float)*m_stride*dtMax(nlinks, 1), DT_ALLOC_PERM, m_allocator);
+	data.range = (float*)dtAlloc(sizeof(float)*m_stride*2*dtMax(npolys, 1), DT_ALLOC_PERM, m_allocator);
+	if (!data.owner || !data.pos || !data.dist || !data.range)
+	{
+		freeTileData(data);
+		return false;
+	}
+
+	data.salt = tile->salt;
+	data.x = tile->header->x;
+	data.y = tile->header->y;
+	data.linkCount = nlinks;
+	data.polyCount = npolys;
+	for (int i = 0; i < nlinks; ++i)
+		data.owner[i] = DT_LANDMARK_NO_OWNER;
+	for (int i = 0; i < nlinks*m_stride; ++i)
+		data.dist[i] = DT_LANDMARK_INF;
+	for (int i = 0; i < npolys*m_stride*2; ++i)
+		data.range[i] = DT_LANDMARK_INF;
+	return true;
+}
+
+// Recomputes the owner and position of every link in the tile. Links that did not
+// exist before the last update get an unknown distance.
+void dtLandmarkTable::refreshLinks(const int tileIdx)
+{
+	const dtMeshTile* tile = m_nav->getTile(tileIdx);
+	TileData& data = m_tiles[tileIdx];
+	const dtPolyRef base = m_nav->getPolyRefBase(tile);
+	const bool freshTile = m_fresh[tileIdx] != 0;
+
+	for (int i = 0; i < data.linkCount; ++i)
+		data.owner[i] = DT_LANDMARK_NO_OWNER;
+
+	for (int ip = 0; ip < tile->header->polyCount; ++ip)
+	{
+		const dtPoly* poly = &tile->polys[ip];
+		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			const dtLink& link = tile->links[i];
+			data.owner[i] = (unsigned short)ip;
+			m_nav->getLinkMidPoint(base | (dtPolyRef)ip, tile, poly, &link, &data.pos[i*3]);
+			if (freshTile || m_fresh[m_nav->decodePolyIdTile(link.ref)])
+			{
+				for (int l = 0; l < m_stride; ++l)
+					data.dist[i*m_stride+l] = DT_LANDMARK_INF;
+			}
+		}
+	}
+}
+
+void dtLandmarkTable::markNeighbours(const int x, const int y, const int radius, const unsigned char flag)
+{
+	const dtMeshTile* tiles[DT_MAX_TILE_LAYERS];
+	for (int dy = -radius; dy <= radius; ++dy)
+	{
+		for (int dx = -radius; dx <= radius; ++dx)
+		{
+			const int n = m_nav->getTilesAt(x+dx, y+dy, tiles, DT_MAX_TILE_LAYERS);
+			for (int i = 0; i < n; ++i)
+				m_marks[m_nav->decodePolyIdTile(m_nav->getPolyRefBase(tiles[i]))] |= flag;
+		}
+	}
+}
+
+bool dtLandmarkTable::push(const float dist, const int tile, const unsigned int link)
+{
+	dtCostHeapItem item;
+	item.total = dist;
+	item.cost = dist;
+	item.tile = tile;
+	item.index = link;
+	return m_heap.push(item);
+}
+
+bool dtLandmarkTable::pushLandmark(const int l)
+{
+	const dtPolyRef ref = m_landmarks[l];
+	if (!m_nav->isValidPolyRef(ref))
+		return true;
+	const dtMeshTile* tile = 0;
+	const dtPoly* poly = 0;
+	m_nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+	const int tileIdx = (int)m_nav->decodePolyIdTile(ref);
+	TileData& data = m_tiles[tileIdx];
+
+	for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+	{
+		const dtLink& link = tile->links[i];
+		if (!link.ref)
+			continue;
+		const dtMeshTile* nextTile = 0;
+		const dtPoly* nextPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(link.ref, &nextTile, &nextPoly);
+		if (!m_filter->passFilter(link.ref, nextTile, nextPoly))
+			continue;
+		float& d = data.dist[i*m_stride+l];
+		if (d > 0.0f)
+		{
+			d = 0.0f;
+			m_marks[m_nav->decodePolyIdTile(link.ref)] |= DT_LANDMARK_MARK_RANGES;
+			if (!push(0.0f, tileIdx, i))
+				return false;
+		}
+	}
+	return true;
+}
+
+// Runs Dijkstra for landmark l from the links currently in the heap. Distances only ever decrease.
+dtStatus dtLandmarkTable::propagate(const int l)
+{
+	while (!m_heap.empty())
+	{
+		const dtCostHeapItem item = m_heap.pop();
+
+		TileData& prevData = m_tiles[item.tile];
+		if (item.cost > prevData.dist[item.index*m_stride+l])
+			continue;
+
+		const dtMeshTile* prevTile = m_nav->getTile(item.tile);
+		const dtLink& entry = prevTile->links[item.index];
+		const unsigned int prevIdx = prevData.owner[item.index];
+		const dtPolyRef prevRef = m_nav->getPolyRefBase(prevTile) | (dtPolyRef)prevIdx;
+		const dtPoly* prevPoly = &prevTile->polys[prevIdx];
+
+		const dtPolyRef curRef = entry.ref;
+		const dtMeshTile* curTile = 0;
+		const dtPoly* curPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(curRef, &curTile, &curPoly);
+		TileData& curData = m_tiles[m_nav->decodePolyIdTile(curRef)];
+
+		for (unsigned int j = curPoly->firstLink; j != DT_NULL_LINK; j = curTile->links[j].next)
+		{
+			const dtPolyRef nextRef = curTile->links[j].ref;
+			if (!nextRef)
+				continue;
+			const dtMeshTile* nextTile = 0;
+			const dtPoly* nextPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(nextRef, &nextTile, &nextPoly);
+			if (!m_filter->passFilter(nextRef, nextTile, nextPoly))
+				continue;
+
+			const float cost = m_filter->getCost(&prevData.pos[item.index*3], &curData.pos[j*3],
+												 prevRef, prevTile, prevPoly,
+												 curRef, curTile, curPoly,
+												 nextRef, nextTile, nextPoly);
+			const float dist = item.cost + cost;
+			float& d = curData.dist[j*m_stride+l];
+			if (dist < d)
+			{
+				d = dist;
+				m_marks[m_nav->decodePolyIdTile(nextRef)] |= DT_LANDMARK_MARK_RANGES;
+				if (!push(dist, (int)m_nav->decodePolyIdTile(curRef), j))
+					return DT_FAILURE | DT_OUT_OF_MEMORY;
+			}
+		}
+	}
+	return DT_SUCCESS;
+}
+
+// Recomputes the [lo, hi] range of every polygon in the tile from the links entering it.
+void dtLandmarkTable::updateRanges(const int tileIdx)
+{
+	TileData& data = m_tiles[tileIdx];
+	const int n = data.polyCount*m_stride;
+	for (int i = 0; i < n; ++i)
+	{
+		data.range[i*2+0] = DT_LANDMARK_INF;
+		data.range[i*2+1] = -1.0f;
+	}
+
+	const dtMeshTile* tiles[DT_MAX_TILE_LAYERS];
+	for (int dy = -1; dy <= 1; ++dy)
+	{
+		for (int dx = -1; dx <= 1; ++dx)
+		{
+			const int ntiles = m_nav->getTilesAt(data.x+dx, data.y+dy, tiles, DT_MAX_TILE_LAYERS);
+			for (int t = 0; t < ntiles; ++t)
+			{
+				const dtMeshTile* tile = tiles[t];
+				const TileData& from = m_tiles[m_nav->decodePolyIdTile(m_nav->getPolyRefBase(tile))];
+				for (int i = 0; i < from.linkCount; ++i)
+				{
+					if (from.owner[i] == DT_LANDMARK_NO_OWNER)
+						continue;
+					const dtPolyRef ref = tile->links[i].ref;
+					if (!ref || (int)m_nav->decodePolyIdTile(ref) != tileIdx)
+						continue;
+					float* range = &data.range[m_nav->decodePolyIdPoly(ref)*m_stride*2];
+					const float* dist = &from.dist[i*m_stride];
+					for (int l = 0; l < m_stride; ++l)
+					{
+						range[l*2+0] = dtMin(range[l*2+0], dist[l]);
+						range[l*2+1] = dtMax(range[l*2+1], dist[l]);
+					}
+				}
+			}
+		}
+	}
+
+	// Polygons nobody can enter give no information.
+	for (int i = 0; i < n; ++i)
+	{
+		if (data.range[i*2+1] < 0.0f)
+			data.range[i*2+1] = DT_LANDMARK_INF;
+	}
+}
+
+void dtLandmarkTable::updateSymmetry()
+{
+	m_symmetric = true;
+	for (int i = 0; i < m_maxTiles && m_symmetric; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		if (!tile->header)
+			continue;
+		for (int j = 0; j < tile->header->offMeshConCount; ++j)
+		{
+			if ((tile->offMeshCons[j].flags & DT_OFFMESH_CON_BIDIR) == 0)
+			{
+				m_symmetric = false;
+				break;
+			}
+		}
+	}
+}
+
+// Farthest point selection: returns the polygon whose distance to the closest of the
+// first count landmarks is the largest.
+dtPolyRef dtLandmarkTable::pickNextLandmark(const int count) const
+{
+	dtPolyRef best = 0;
+	float bestDist = 0.0f;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		if (!tile->header)
+			continue;
+		const TileData& data = m_tiles[i];
+		const dtPolyRef base = m_nav->getPolyRefBase(tile);
+		for (int ip = 0; ip < data.polyCount; ++ip)
+		{
+			const dtPoly* poly = &tile->polys[ip];
+			if (poly->getType() != DT_POLYTYPE_GROUND)
+				continue;
+			if (!m_filter->passFilter(base | (dtPolyRef)ip, tile, poly))
+				continue;
+			const float* range = &data.range[ip*m_stride*2];
+			float dist = DT_LANDMARK_INF;
+			for (int l = 0; l < count; ++l)
+				dist = dtMin(dist, range[l*2]);
+			if (dist < DT_LANDMARK_INF && dist > bestDist)
+			{
+				bestDist = dist;
+				best = base | (dtPolyRef)ip;
+			}
+		}
+	}
+	return best;
+}
+
+// Returns a passable ground polygon in the largest set of polygons connected by links.
+dtPolyRef dtLandmarkTable::findSeed() const
+{
+	int* offsets = (int*)dtAlloc(sizeof(int)*(m_maxTiles+1), DT_ALLOC_TEMP, m_allocator);
+	if (!offsets)
+		return 0;
+	int npolys = 0;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		offsets[i] = npolys;
+		npolys += m_tiles[i].polyCount;
+	}
+	offsets[m_maxTiles] = npolys;
+
+	unsigned char* visited = (unsigned char*)dtAlloc(sizeof(unsigned char)*dtMax(npolys, 1), DT_ALLOC_TEMP, m_allocator);
+	dtPolyRef* stack = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*dtMax(npolys, 1), DT_ALLOC_TEMP, m_allocator);
+	if (!visited || !stack)
+	{
+		dtFree(offsets, m_allocator);
+		dtFree(visited, m_allocator);
+		dtFree(stack, m_allocator);
+		return 0;
+	}
+	memset(visited, 0, sizeof(unsigned char)*npolys);
+
+	dtPolyRef best = 0;
+	int bestSize = 0;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		if (!tile->header)
+			continue;
+		const dtPolyRef base = m_nav->getPolyRefBase(tile);
+		for (int ip = 0; ip < m_tiles[i].polyCount; ++ip)
+		{
+			const dtPoly* poly = &tile->polys[ip];
+			if (visited[offsets[i]+ip] || poly->getType() != DT_POLYTYPE_GROUND)
+				continue;
+			if (!m_filter->passFilter(base | (dtPolyRef)ip, tile, poly))
+				continue;
+
+			// Flood fill the polygons reachable from this one.
+			int size = 0;
+			int nstack = 0;
+			visited[offsets[i]+ip] = 1;
+			stack[nstack++] = base | (dtPolyRef)ip;
+			while (nstack > 0)
+			{
+				const dtPolyRef ref = stack[--nstack];
+				const dtMeshTile* curTile = 0;
+				const dtPoly* curPoly = 0;
+				m_nav->getTileAndPolyByRefUnsafe(ref, &curTile, &curPoly);
+				size++;
+				for (unsigned int j = curPoly->firstLink; j != DT_NULL_LINK; j = curTile->links[j].next)
+				{
+					const dtPolyRef nextRef = curTile->links[j].ref;
+					if (!nextRef)
+						continue;
+					const int idx = offsets[m_nav->decodePolyIdTile(nextRef)] + (int)m_nav->decodePolyIdPoly(nextRef);
+					if (visited[idx])
+						continue;
+					const dtMeshTile* nextTile = 0;
+					const dtPoly* nextPoly = 0;
+					m_nav->getTileAndPolyByRefUnsafe(nextRef, &nextTile, &nextPoly);
+					if (!m_filter->passFilter(nextRef, nextTile, nextPoly))
+						continue;
+					visited[idx] = 1;
+					stack[nstack++] = nextRef;
+				}
+			}
+
+			if (size > bestSize)
+			{
+				bestSize = size;
+				best = base | (dtPolyRef)ip;
+			}
+		}
+	}
+
+	dtFree(offsets, m_allocator);
+	dtFree(visited, m_allocator);
+	dtFree(stack, m_allocator);
+	return best;
+}
+
+dtStatus dtLandmarkTable::computeLandmark(const int l)
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		TileData& data = m_tiles[i];
+		for (int j = 0; j < data.linkCount; ++j)
+			data.dist[j*m_stride+l] = DT_LANDMARK_INF;
+		m_marks[i] |= DT_LANDMARK_MARK_RANGES;
+	}
+
+	m_heap.clear();
+	if (!pushLandmark(l))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	dtStatus status = propagate(l);
+	if (dtStatusFailed(status))
+		return status;
+
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (m_tiles[i].salt)
+			updateRanges(i);
+		m_marks[i] = 0;
+	}
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// When @p refs is null the landmarks are placed with farthest point selection, starting from
+/// the polygon farthest away from an arbitrary polygon of the largest connected area. This spreads them along
+/// the boundary of the largest reachable area, which is where they give the tightest bounds.
+/// Fewer than @p count landmarks may be placed if the mesh is too small.
+///
+/// The cost of building the table is one Dijkstra search over all links per landmark.
+dtStatus dtLandmarkTable::init(const dtNavMesh* nav, const dtQueryFilter* filter, const int count, const dtPolyRef* refs)
+{
+	purge();
+
+	if (!nav || !filter || count <= 0 || count > DT_MAX_LANDMARKS)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (refs)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			if (!nav->isValidPolyRef(refs[i]))
+				return DT_FAILURE | DT_INVALID_PARAM;
+		}
+	}
+
+	dtStatus status = m_tracker.init(nav);
+	if (dtStatusFailed(status))
+		return status;
+
+	m_nav = nav;
+	m_allocator = nav->getAllocator();
+	m_heap.setAllocator(m_allocator);
+	m_filter = filter;
+	m_stride = count;
+	status = reserveTiles();
+	if (dtStatusFailed(status))
+	{
+		purge();
+		return status;
+	}
+
+	m_tracker.poll();
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (!(m_tracker.getChanges(i) & DT_TILE_ADDED))
+			continue;
+		if (!allocTileData(m_tiles[i], nav->getTile(i)))
+		{
+			purge();
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+	}
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (m_tiles[i].salt)
+			refreshLinks(i);
+	}
+	updateSymmetry();
+
+	if (refs)
+	{
+		for (int l = 0; l < count && dtStatusSucceed(status); ++l)
+		{
+			m_landmarks[l] = refs[l];
+			m_count = l+1;
+			status = computeLandmark(l);
+		}
+	}
+	else
+	{
+		// Seed the selection in the largest connected area, small islands would
+		// otherwise trap all the landmarks.
+		const dtPolyRef seed = findSeed();
+		if (!seed)
+		{
+			purge();
+			return DT_FAILURE | DT_INVALID_PARAM;
+		}
+
+		m_landmarks[0] = seed;
+		m_count = 1;
+		status = computeLandmark(0);
+		for (int l = 0; l < count && dtStatusSucceed(status); ++l)
+		{
+			// The first pick replaces the seed.
+			const dtPolyRef next = pickNextLandmark(dtMax(l, 1));
+			if (!next)
+				break;
+			m_landmarks[l] = next;
+			m_count = l+1;
+			status = computeLandmark(l);
+		}
+	}
+
+	if (dtStatusFailed(status))
+	{
+		purge();
+		return status;
+	}
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// Tiles whose salt changed since the last update are treated as removed and re-added.
+/// The links of the new tiles start with unknown distances, and the known distances of the
+/// surrounding tiles are propagated into them. Distances elsewhere are left untouched: they can
+/// only be too low after a removal, which keeps the heuristic admissible. Tiles that were only
+/// revised are not recomputed, their links changed with a neighbour that was added or removed,
+/// which is handled through the neighbour.
+// Grows the per tile slot arrays to the tile slots the navigation mesh created.
+dtStatus dtLandmarkTable::reserveTiles()
+{
+	const dtStatus status = m_tracker.reserve();
+	if (dtStatusFailed(status))
+		return status;
+	const int capacity = m_tracker.getSlotCapacity();
+	if (capacity > m_tileCapacity)
+	{
+		if (!dtGrowTileArray(m_tiles, m_tileCapacity, capacity, m_allocator) ||
+			!dtGrowTileArray(m_marks, m_tileCapacity, capacity, m_allocator) ||
+			!dtGrowTileArray(m_fresh, m_tileCapacity, capacity, m_allocator))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		m_tileCapacity = capacity;
+	}
+	m_maxTiles = m_tracker.getSlotCount();
+	return DT_SUCCESS;
+}
+
+dtStatus dtLandmarkTable::update()
+{
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtStatus reserveStatus = reserveTiles();
+	if (dtStatusFailed(reserveStatus))
+	{
+		purge();
+		return reserveStatus;
+	}
+
+	if (!m_tracker.poll())
+		return DT_SUCCESS;
+
+	memset(m_marks, 0, sizeof(unsigned char)*m_maxTiles);
+	memset(m_fresh, 0, sizeof(unsigned char)*m_maxTiles);
+
+	bool changed = false;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const unsigned char changes = m_tracker.getChanges(i);
+		TileData& data = m_tiles[i];
+		if (changes & DT_TILE_REMOVED)
+		{
+			// The neighbours lost the links to the removed tile.
+			markNeighbours(data.x, data.y, 1, DT_LANDMARK_MARK_LINKS | DT_LANDMARK_MARK_RANGES);
+			freeTileData(data);
+			changed = true;
+		}
+		if (changes & DT_TILE_ADDED)
+		{
+			changed = true;
+			if (!allocTileData(data, m_nav->getTile(i)))
+			{
+				purge();
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+			}
+			m_fresh[i] = 1;
+		}
+	}
+	if (!changed)
+		return DT_SUCCESS;
+
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (!m_fresh[i])
+			continue;
+		// Links may have been added to the neighbours, and any link entering the neighbours
+		// may lead into the new tile.
+		markNeighbours(m_tiles[i].x, m_tiles[i].y, 1, DT_LANDMARK_MARK_LINKS | DT_LANDMARK_MARK_RANGES);
+		markNeighbours(m_tiles[i].x, m_tiles[i].y, 2, DT_LANDMARK_MARK_SEED);
+	}
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (m_tiles[i].salt && (m_marks[i] & DT_LANDMARK_MARK_LINKS))
+			refreshLinks(i);
+	}
+	updateSymmetry();
+
+	for (int l = 0; l < m_count; ++l)
+	{
+		m_heap.clear();
+		for (int i = 0; i < m_maxTiles; ++i)
+		{
+			if (!(m_marks[i] & DT_LANDMARK_MARK_SEED))
+				continue;
+			const TileData& data = m_tiles[i];
+			for (int j = 0; j < data.linkCount; ++j)
+			{
+				const float d = data.dist[j*m_stride+l];
+				if (data.owner[j] != DT_LANDMARK_NO_OWNER && d < DT_LANDMARK_INF)
+				{
+					if (!push(d, i, (unsigned int)j))
+					{
+						purge();
+						return DT_FAILURE | DT_OUT_OF_MEMORY;
+					}
+				}
+			}
+		}
+		if (!pushLandmark(l))
+		{
+			purge();
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+		const dtStatus status = propagate(l);
+		if (dtStatusFailed(status))
+		{
+			purge();
+			return status;
+		}
+	}
+
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (m_tiles[i].salt && (m_marks[i] & DT_LANDMARK_MARK_RANGES))
+			updateRanges(i);
+		m_marks[i] = 0;
+	}
+	return DT_SUCCESS;
+}
+
+const float* dtLandmarkTable::getRanges(dtPolyRef ref) const
+{
+	if (!m_tiles || !ref)
+		return 0;
+	unsigned int salt, it, ip;
+	m_nav->decodePolyId(ref, salt, it, ip);
+	if (it >= (unsigned int)m_maxTiles)
+		return 0;
+	const TileData& data = m_tiles[it];
+	if (!data.salt || data.salt != salt || ip >= (unsigned int)data.polyCount)
+		return 0;
+	return &data.range[ip*m_stride*2];
+}
+
+float dtLandmarkTable::getHeuristic(dtPolyRef from, dtPolyRef to) const
+{
+	const float* a = getRanges(from);
+	const float* b = getRanges(to);
+	if (!a || !b)
+		return 0.0f;
+
+	float h = 0.0f;
+	for (int l = 0; l < m_count; ++l)
+	{
+		const float aLo = a[l*2+0], aHi = a[l*2+1];
+		const float bLo = b[l*2+0], bHi = b[l*2+1];
+		if (bLo < DT_LANDMARK_INF && aHi < DT_LANDMARK_INF)
+			h = dtMax(h, bLo - aHi);
+		if (m_symmetric && aLo < DT_LANDMARK_INF && bHi < DT_LANDMARK_INF)
+			h = dtMax(h, aLo - bHi);
+	}
+	return h;
+}
+
+int dtLandmarkTable::getMemUsed() const
+{
+	int size = sizeof(*this) + m_tracker.getMemUsed() +
+		(int)sizeof(TileData)*m_tileCapacity +
+		(int)sizeof(unsigned char)*m_tileCapacity*2 +
+		m_heap.getMemUsed();
+	for (int i = 0; i < m_maxTiles && m_tiles; ++i)
+	{
+		const TileData& data = m_tiles[i];
+		if (!data.salt)
+			continue;
+		size += data.linkCount*(int)(sizeof(unsigned short) + sizeof(float)*3 + sizeof(float)*m_stride);
+		size += data.polyCount*(int)sizeof(float)*m_stride*2;
+	}
+	return size;
+}
@@ -17,6 +17,7 @@
 //
 
 #include <float.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include "DetourNavMesh.h"
@@ -111,6 +112,19 @@ static void calcSlabEndPoints(const float* va, const float* vb, float* bmin, flo
 	}
 }
 
+#ifdef DT_POLYREF64
+inline int computeTileHash(int x, int y, const int mask)
+{
+	// Mixes all bits of both coordinates, so tiles far from the origin spread as well as near it.
+	uint64_t n = ((uint64_t)(unsigned int)x << 32) | (uint64_t)(unsigned int)y;
+	n ^= n >> 33;
+	n *= 0xff51afd7ed558ccdULL;
+	n ^= n >> 33;
+	n *= 0xc4ceb9fe1a85ec53ULL;
+	n ^= n >> 33;
+	return (int)(n & (uint64_t)mask);
+}
+#else
 inline int computeTileHash(int x, int y, const int mask)
 {
 	const unsigned int h1 = 0x8da6b343; // Large multiplicative constants;
@@ -118,6 +132,33 @@ inline int computeTileHash(int x, int y, const int mask)
 	unsigned int n = h1 * x + h2 * y;
 	return (int)(n & mask);
 }
+#endif
+
+// The tile slots are allocated in pages as they are used, so the memory follows the number of
+// tiles loaded rather than maxTiles.
+static const int DT_TILE_PAGE_BITS = 6;
+static const int DT_TILE_PAGE_SIZE = 1 << DT_TILE_PAGE_BITS;
+static const int DT_TILE_PAGE_MASK = DT_TILE_PAGE_SIZE-1;
+
+// Initial size of the tile position lookup, it grows with the number of tiles.
+static const int DT_TILE_LUT_INITIAL_SIZE = 256;
+
+// Returned by getTile() for the slots that have not been created.
+static union { void* align; unsigned char data[sizeof(dtMeshTile)]; } s_unusedTile;
+
+inline dtMeshTile* dtNavMesh::getTileSlot(unsigned int i) const
+{
+	return &m_tilePages[i >> DT_TILE_PAGE_BITS][i & DT_TILE_PAGE_MASK];
+}
+
+// Puts the tile slot in the state of a slot that has never held a tile.
+static void resetTileSlot(dtMeshTile* tile, const int index)
+{
+	// dtMeshTile only holds plain data, the cast tells the compiler the memset is intended.
+	memset((void*)tile, 0, sizeof(dtMeshTile));
+	tile->salt = 1;
+	tile->index = (unsigned int)index;
+}
 
 inline unsigned int allocLink(dtMeshTile* tile)
 {
@@ -142,6 +183,20 @@ dtNavMesh* dtAllocNavMesh()
 	return new(mem) dtNavMesh;
 }
 
+/// @par
+///
+/// The navigation mesh object, its tile arrays, the temporary memory of its operations and
+/// the data of the tiles added with #DT_TILE_FREE_DATA all come from the allocator, so a
+/// navigation mesh can be freed at once by releasing an arena, or kept within a budget.
+/// Tile data owned by the mesh must be allocated with the same allocator. (See:
+/// dtNavMeshCreateParams::allocator)
+dtNavMesh* dtAllocNavMesh(dtAllocator* allocator)
+{
+	void* mem = dtAlloc(sizeof(dtNavMesh), DT_ALLOC_PERM, allocator);
+	if (!mem) return 0;
+	return new(mem) dtNavMesh(allocator);
+}
+
 /// @par
 ///
 /// This function will only free the memory for tiles with the #DT_TILE_FREE_DATA
@@ -149,8 +204,9 @@ dtNavMesh* dtAllocNavMesh()
 void dtFreeNavMesh(dtNavMesh* navmesh)
 {
 	if (!navmesh) return;
+	dtAllocator* allocator = navmesh->getAllocator();
 	navmesh->~dtNavMesh();
-	dtFree(navmesh);
+	dtFree(navmesh, allocator);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -185,15 +241,21 @@ Notes:
 @see dtNavMeshQuery, dtCreateNavMeshData, dtNavMeshCreateParams, #dtAllocNavMesh, #dtFreeNavMesh
 */
 
-dtNavMesh::dtNavMesh() :
+dtNavMesh::dtNavMesh(dtAllocator* allocator) :
+	m_allocator(allocator),
 	m_tileWidth(0),
 	m_tileHeight(0),
 	m_maxTiles(0),
 	m_tileLutSize(0),
 	m_tileLutMask(0),
 	m_posLookup(0),
+	m_posLookupCount(0),
 	m_nextFree(0),
-	m_tiles(0)
+	m_tilePages(0),
+	m_tilePageCapacity(0),
+	m_tileCount(0),
+	m_tileAddCount(0),
+	m_polyChangeCount(0)
 {
 #ifndef DT_POLYREF64
 	m_saltBits = 0;
@@ -208,19 +270,28 @@ dtNavMesh::dtNavMesh() :
 
 dtNavMesh::~dtNavMesh()
 {
-	for (int i = 0; i < m_maxTiles; ++i)
+	for (int i = 0; i < m_tileCount; ++i)
 	{
-		if (m_tiles[i].flags & DT_TILE_FREE_DATA)
+		dtMeshTile* tile = getTileSlot(i);
+		if (tile->flags & DT_TILE_FREE_DATA)
 		{
-			dtFree(m_tiles[i].data);
-			m_tiles[i].data = 0;
-			m_tiles[i].dataSize = 0;
+			dtFree(tile->data, m_allocator);
+			tile->data = 0;
+			tile->dataSize = 0;
 		}
 	}
-	dtFree(m_posLookup);
-	dtFree(m_tiles);
+	dtFree(m_posLookup, m_allocator);
+	for (int i = 0; i < (m_tileCount + DT_TILE_PAGE_SIZE-1) >> DT_TILE_PAGE_BITS; ++i)
+		dtFree(m_tilePages[i], m_allocator);
+	dtFree(m_tilePages, m_allocator);
 }
 		
+/// @par
+///
+/// The tile slots and the tile position lookup are allocated as tiles are added, so the memory
+/// used depends on the number of tiles loaded, not on maxTiles. A tile added with a lastRef
+/// creates the slots up to its index. With #DT_POLYREF64, a maxTiles of 0 allows as many tiles
+/// as the references can address.
 dtStatus dtNavMesh::init(const dtNavMeshParams* params)
 {
 	memcpy(&m_params, params, sizeof(dtNavMeshParams));
@@ -230,26 +301,26 @@ dtStatus dtNavMesh::init(const dtNavMeshParams* params)
 	
 	// Init tiles
 	m_maxTiles = params->maxTiles;
-	m_tileLutSize = dtNextPow2(params->maxTiles/4);
+#ifdef DT_POLYREF64
+	if (m_maxTiles <= 0)
+		m_maxTiles = 1 << DT_TILE_BITS;
+	if (m_maxTiles > (1 << DT_TILE_BITS))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	m_params.maxTiles = m_maxTiles;
+#endif
+	m_tileLutSize = dtNextPow2(dtMin(m_maxTiles/4, DT_TILE_LUT_INITIAL_SIZE));
 	if (!m_tileLutSize) m_tileLutSize = 1;
 	m_tileLutMask = m_tileLutSize-1;
 	
-	//dtMeshTileʼ
-	m_tiles = (dtMeshTile*)dtAlloc(sizeof(dtMeshTile)*m_maxTiles, DT_ALLOC_PERM);
-	if (!m_tiles)
-		return DT_FAILURE | DT_OUT_OF_MEMORY;
-	m_posLookup = (dtMeshTile**)dtAlloc(sizeof(dtMeshTile*)*m_tileLutSize, DT_ALLOC_PERM);
+	//ƬλòұƬʱ
+	m_posLookup = (dtMeshTile**)dtAlloc(sizeof(dtMeshTile*)*m_tileLutSize, DT_ALLOC_PERM, m_allocator);
 	if (!m_posLookup)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
-	memset(m_tiles, 0, sizeof(dtMeshTile)*m_maxTiles);
 	memset(m_posLookup, 0, sizeof(dtMeshTile*)*m_tileLutSize);
+	m_posLookupCount = 0;
 	m_nextFree = 0;
-	for (int i = m_maxTiles-1; i >= 0; --i)
-	{
-		m_tiles[i].salt = 1;
-		m_tiles[i].next = m_nextFree;
-		m_nextFree = &m_tiles[i];
-	}
+	m_tileAddCount = 0;
+	m_polyChangeCount = 0;
 	
 	// Init ID generator values.
 #ifndef DT_POLYREF64
@@ -308,12 +379,78 @@ int dtNavMesh::findConnectingPolys(const float* va, const float* vb,
 	calcSlabEndPoints(va, vb, amin, amax, side);
 	const float apos = getSlabCoord(va, side);
 
-	// Remove links pointing to 'side' and compact the links array. 
 	float bmin[2], bmax[2];
 	unsigned short m = DT_EXT_LINK | (unsigned short)side;
 	int n = 0;
 	
 	dtPolyRef base = getPolyRefBase(tile);
+
+	// Find the border edges of the side that overlap the segment: the edges starting before the end
+	// of the segment, walking back while the preceding edges reach past the start of the segment.
+	static const int MAX_CANDIDATES = 32;
+	unsigned short candPolys[MAX_CANDIDATES];
+	unsigned char candEdges[MAX_CANDIDATES];
+	float candArea[MAX_CANDIDATES*2];
+	int ncand = 0;
+	const dtBorderEdge* edges = tile->borderEdges;
+	int lo = 0, hi = tile->header->borderEdgeCount;
+	while (lo < hi)
+	{
+		const int mid = (lo + hi) / 2;
+		if (edges[mid].side < side || (edges[mid].side == side && edges[mid].min < amax[0]))
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	for (int k = lo-1; k >= 0 && edges[k].side == side && edges[k].reach > amin[0]; --k)
+	{
+		const dtBorderEdge& edge = edges[k];
+		if (edge.max <= amin[0])
+			continue;
+
+		const dtPoly* poly = &tile->polys[edge.poly];
+		const float* vc = &tile->verts[poly->verts[edge.edge]*3];
+		const float* vd = &tile->verts[poly->verts[(edge.edge+1) % poly->vertCount]*3];
+		if (dtAbs(apos-getSlabCoord(vc, side)) > 0.01f)
+			continue;
+		calcSlabEndPoints(vc,vd, bmin,bmax, side);
+		if (!overlapSlabs(amin,amax, bmin,bmax, 0.01f, tile->header->walkableClimb)) continue;
+
+		if (ncand == MAX_CANDIDATES)
+		{
+			// Too many overlapping edges, use the scan below.
+			ncand = -1;
+			break;
+		}
+		// Keep the candidates sorted by polygon and edge, like the scan below finds them.
+		int pos = ncand++;
+		while (pos > 0 && (candPolys[pos-1] > edge.poly || (candPolys[pos-1] == edge.poly && candEdges[pos-1] > edge.edge)))
+		{
+			candPolys[pos] = candPolys[pos-1];
+			candEdges[pos] = candEdges[pos-1];
+			candArea[pos*2+0] = candArea[(pos-1)*2+0];
+			candArea[pos*2+1] = candArea[(pos-1)*2+1];
+			pos--;
+		}
+		candPolys[pos] = edge.poly;
+		candEdges[pos] = edge.edge;
+		candArea[pos*2+0] = dtMax(amin[0], bmin[0]);
+		candArea[pos*2+1] = dtMin(amax[0], bmax[0]);
+	}
+	if (ncand >= 0)
+	{
+		// Only the first edge of each polygon connects.
+		for (int k = 0; k < ncand && n < maxcon; ++k)
+		{
+			if (k > 0 && candPolys[k] == candPolys[k-1])
+				continue;
+			conarea[n*2+0] = candArea[k*2+0];
+			conarea[n*2+1] = candArea[k*2+1];
+			con[n] = base | (dtPolyRef)candPolys[k];
+			n++;
+		}
+		return n;
+	}
 	
 	for (int i = 0; i < tile->header->polyCount; ++i)
 	{
@@ -385,6 +522,80 @@ void dtNavMesh::unconnectLinks(dtMeshTile* tile, dtMeshTile* target)
 	}
 }
 
+/// @par
+///
+/// Links are handed out from a free list as the tile and its neighbours are connected, and
+/// each polygon pushes its new links to the front of its list, so the list of a polygon jumps
+/// around the link array. Compacting copies the lists in polygon order into one run, which
+/// makes following dtPoly::firstLink and dtLink::next a sequential walk through memory. The
+/// order of the links within a list does not change.
+void dtNavMesh::compactLinks(dtMeshTile* tile)
+{
+	if (!(tile->flags & DT_TILE_COMPACT_LINKS))
+		return;
+
+	const unsigned int maxLinks = (unsigned int)tile->header->maxLinkCount;
+	if (!maxLinks)
+		return;
+	dtLink* links = (dtLink*)dtAlloc(sizeof(dtLink)*maxLinks, DT_ALLOC_TEMP, m_allocator);
+	if (!links)
+		return; // The links stay valid, just scattered.
+
+	unsigned int n = 0;
+	for (int i = 0; i < tile->header->polyCount; ++i)
+	{
+		dtPoly* poly = &tile->polys[i];
+		if (poly->firstLink == DT_NULL_LINK)
+			continue;
+		unsigned int j = poly->firstLink;
+		poly->firstLink = n;
+		for (; j != DT_NULL_LINK; j = tile->links[j].next)
+		{
+			links[n] = tile->links[j];
+			links[n].next = n+1;
+			n++;
+		}
+		links[n-1].next = DT_NULL_LINK;
+	}
+	memcpy(tile->links, links, sizeof(dtLink)*n);
+	dtFree(links, m_allocator);
+
+	// The rest of the links are free.
+	tile->linksFreeList = n < maxLinks ? n : DT_NULL_LINK;
+	for (unsigned int i = n; i < maxLinks; ++i)
+		tile->links[i].next = i+1 < maxLinks ? i+1 : DT_NULL_LINK;
+}
+
+void dtNavMesh::patchTilePointers(dtMeshTile* tile, unsigned char* data)
+{
+	const dtMeshHeader* header = (const dtMeshHeader*)data;
+	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
+	const int vertsSize = dtAlign4(sizeof(float)*3*header->vertCount);
+	const int polysSize = dtAlign4(sizeof(dtPoly)*header->polyCount);
+	const int linksSize = dtAlign4(sizeof(dtLink)*(header->maxLinkCount));
+	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount);
+	const int detailVertsSize = dtAlign4(sizeof(float)*3*header->detailVertCount);
+	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
+	const int bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
+	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
+	const int borderEdgesSize = dtAlign4(sizeof(dtBorderEdge)*header->borderEdgeCount);
+	
+	unsigned char* d = data + headerSize;
+	tile->verts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
+	tile->polys = dtGetThenAdvanceBufferPointer<dtPoly>(d, polysSize);
+	tile->links = dtGetThenAdvanceBufferPointer<dtLink>(d, linksSize);
+	tile->detailMeshes = dtGetThenAdvanceBufferPointer<dtPolyDetail>(d, detailMeshesSize);
+	tile->detailVerts = dtGetThenAdvanceBufferPointer<float>(d, detailVertsSize);
+	tile->detailTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
+	tile->bvTree = dtGetThenAdvanceBufferPointer<dtBVNode>(d, bvtreeSize);
+	tile->offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshLinksSize);
+	tile->borderEdges = dtGetThenAdvanceBufferPointer<dtBorderEdge>(d, borderEdgesSize);
+
+	// If there are no items in the bvtree, reset the tree pointer.
+	if (!bvtreeSize)
+		tile->bvTree = 0;
+}
+
 void dtNavMesh::connectExtLinks(dtMeshTile* tile, dtMeshTile* target, int side)
 {
 	if (!tile) return;
@@ -846,6 +1057,21 @@ int dtNavMesh::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, co
 /// @see dtCreateNavMeshData, #removeTile
 dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 							dtTileRef lastRef, dtTileRef* result)
+{
+	dtMeshTile* tile = 0;
+	dtStatus status = insertTile(data, dataSize, flags, lastRef, &tile);
+	if (dtStatusFailed(status))
+		return status;
+
+	connectTile(tile);
+	
+	if (result)
+		*result = getTileRef(tile);
+	
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMesh::insertTile(unsigned char* data, int dataSize, int flags, dtTileRef lastRef, dtMeshTile** result)
 {
 	// Make sure the data is in right format.
 	dtMeshHeader* header = (dtMeshHeader*)data;
@@ -862,6 +1088,9 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	dtMeshTile* tile = 0;
 	if (!lastRef)
 	{
+		// Create a new slot when all created slots are in use.
+		if (!m_nextFree && m_tileCount < m_maxTiles)
+			createTileSlots(m_tileCount+1);
 		if (m_nextFree)
 		{
 			tile = m_nextFree;
@@ -875,8 +1104,10 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 		int tileIndex = (int)decodePolyIdTile((dtPolyRef)lastRef);
 		if (tileIndex >= m_maxTiles)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		if (tileIndex >= m_tileCount && dtStatusFailed(createTileSlots(tileIndex+1)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
 		// Try to find the specific tile id from the free list.
-		dtMeshTile* target = &m_tiles[tileIndex];
+		dtMeshTile* target = getTileSlot(tileIndex);
 		dtMeshTile* prev = 0;
 		tile = m_nextFree;
 		while (tile && tile != target)
@@ -901,47 +1132,130 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	if (!tile)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
-	// Insert tile into the position lut.
-	int h = computeTileHash(header->x, header->y, m_tileLutMask);
-	tile->next = m_posLookup[h];
-	m_posLookup[h] = tile;
-	
 	// Patch header pointers.
-	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
-	const int vertsSize = dtAlign4(sizeof(float)*3*header->vertCount);
-	const int polysSize = dtAlign4(sizeof(dtPoly)*header->polyCount);
-	const int linksSize = dtAlign4(sizeof(dtLink)*(header->maxLinkCount));
-	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount);
-	const int detailVertsSize = dtAlign4(sizeof(float)*3*header->detailVertCount);
-	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
-	const int bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
-	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
-	
-	unsigned char* d = data + headerSize;
-	tile->verts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
-	tile->polys = dtGetThenAdvanceBufferPointer<dtPoly>(d, polysSize);
-	tile->links = dtGetThenAdvanceBufferPointer<dtLink>(d, linksSize);
-	tile->detailMeshes = dtGetThenAdvanceBufferPointer<dtPolyDetail>(d, detailMeshesSize);
-	tile->detailVerts = dtGetThenAdvanceBufferPointer<float>(d, detailVertsSize);
-	tile->detailTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
-	tile->bvTree = dtGetThenAdvanceBufferPointer<dtBVNode>(d, bvtreeSize);
-	tile->offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshLinksSize);
-
-	// If there are no items in the bvtree, reset the tree pointer.
-	if (!bvtreeSize)
-		tile->bvTree = 0;
+	patchTilePointers(tile, data);
 
 	// Build links freelist
 	tile->linksFreeList = 0;
 	tile->links[header->maxLinkCount-1].next = DT_NULL_LINK;
 	for (int i = 0; i < header->maxLinkCount-1; ++i)
 		tile->links[i].next = i+1;
+	for (int i = 0; i < header->polyCount; ++i)
+		tile->polys[i].firstLink = DT_NULL_LINK;
 
 	// Init tile.
 	tile->header = header;
 	tile->data = data;
 	tile->dataSize = dataSize;
 	tile->flags = flags;
+	tile->revision++;
+	m_tileAddCount++;
+
+	// Insert tile into the position lut.
+	insertTileLookup(tile);
+
+	*result = tile;
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// The slots are allocated in pages and never freed until the navigation mesh is destroyed.
+/// The new slots are free, and follow the free slots already in the list in index order.
+dtStatus dtNavMesh::createTileSlots(const int count)
+{
+	if (count > m_maxTiles)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	const int pageCount = (count + DT_TILE_PAGE_SIZE-1) >> DT_TILE_PAGE_BITS;
+	if (pageCount > m_tilePageCapacity)
+	{
+		int capacity = dtMax(m_tilePageCapacity*2, 8);
+		while (capacity < pageCount)
+			capacity *= 2;
+		dtMeshTile** pages = (dtMeshTile**)dtAlloc(sizeof(dtMeshTile*)*capacity, DT_ALLOC_PERM, m_allocator);
+		if (!pages)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		memset(pages, 0, sizeof(dtMeshTile*)*capacity);
+		if (m_tilePages)
+			memcpy(pages, m_tilePages, sizeof(dtMeshTile*)*m_tilePageCapacity);
+		dtFree(m_tilePages, m_allocator);
+		m_tilePages = pages;
+		m_tilePageCapacity = capacity;
+	}
+
+	dtMeshTile** tail = &m_nextFree;
+	while (*tail)
+		tail = &(*tail)->next;
+
+	for (; m_tileCount < count; ++m_tileCount)
+	{
+		if ((m_tileCount & DT_TILE_PAGE_MASK) == 0)
+		{
+			dtMeshTile* page = (dtMeshTile*)dtAlloc(sizeof(dtMeshTile)*DT_TILE_PAGE_SIZE, DT_ALLOC_PERM, m_allocator);
+			if (!page)
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+			for (int i = 0; i < DT_TILE_PAGE_SIZE; ++i)
+				resetTileSlot(&page[i], m_tileCount + i);
+			m_tilePages[m_tileCount >> DT_TILE_PAGE_BITS] = page;
+		}
+		dtMeshTile* tile = getTileSlot(m_tileCount);
+		*tail = tile;
+		tail = &tile->next;
+	}
+
+	return DT_SUCCESS;
+}
+
+void dtNavMesh::insertTileLookup(dtMeshTile* tile)
+{
+	// Double the lookup when it has more than two tiles per bucket. If that fails, the lookup
+	// keeps its size and the chains get longer.
+	if (m_posLookupCount >= m_tileLutSize*2)
+	{
+		const int size = m_tileLutSize*2;
+		dtMeshTile** lookup = (dtMeshTile**)dtAlloc(sizeof(dtMeshTile*)*size, DT_ALLOC_PERM, m_allocator);
+		if (lookup)
+		{
+			// Each chain splits in two, the tiles keep their order in both.
+			for (int i = 0; i < m_tileLutSize; ++i)
+			{
+				dtMeshTile** low = &lookup[i];
+				dtMeshTile** high = &lookup[i + m_tileLutSize];
+				for (dtMeshTile* cur = m_posLookup[i]; cur; cur = cur->next)
+				{
+					dtMeshTile**& tail = computeTileHash(cur->header->x, cur->header->y, size-1) == i ? low : high;
+					*tail = cur;
+					tail = &cur->next;
+				}
+				*low = 0;
+				*high = 0;
+			}
+			dtFree(m_posLookup, m_allocator);
+			m_posLookup = lookup;
+			m_tileLutSize = size;
+			m_tileLutMask = size-1;
+		}
+	}
+
+	const int h = computeTileHash(tile->header->x, tile->header->y, m_tileLutMask);
+	tile->next = m_posLookup[h];
+	m_posLookup[h] = tile;
+	m_posLookupCount++;
+}
+
+void dtNavMesh::connectTilePair(dtMeshTile* tile, dtMeshTile* nei, int side)
+{
+	const int opposite = side == -1 ? -1 : dtOppositeTile(side);
+	connectExtLinks(tile, nei, side);
+	connectExtLinks(nei, tile, opposite);
+	connectExtOffMeshLinks(tile, nei, side);
+	connectExtOffMeshLinks(nei, tile, opposite);
+}
+
+void dtNavMesh::connectTile(dtMeshTile* tile)
+{
+	const dtMeshHeader* header = tile->header;
 
 	connectIntLinks(tile);
 
@@ -961,10 +1275,9 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 		if (neis[j] == tile)
 			continue;
 	
-		connectExtLinks(tile, neis[j], -1);
-		connectExtLinks(neis[j], tile, -1);
-		connectExtOffMeshLinks(tile, neis[j], -1);
-		connectExtOffMeshLinks(neis[j], tile, -1);
+		connectTilePair(tile, neis[j], -1);
+		neis[j]->revision++;
+		compactLinks(neis[j]);
 	}
 	
 	// Connect with neighbour tiles.
@@ -973,17 +1286,215 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 		nneis = getNeighbourTilesAt(header->x, header->y, i, neis, MAX_NEIS);
 		for (int j = 0; j < nneis; ++j)
 		{
-			connectExtLinks(tile, neis[j], i);
-			connectExtLinks(neis[j], tile, dtOppositeTile(i));
-			connectExtOffMeshLinks(tile, neis[j], i);
-			connectExtOffMeshLinks(neis[j], tile, dtOppositeTile(i));
+			connectTilePair(tile, neis[j], i);
+			neis[j]->revision++;
+			compactLinks(neis[j]);
 		}
 	}
-	
-	if (result)
-		*result = getTileRef(tile);
-	
-	return DT_SUCCESS;
+	compactLinks(tile);
+}
+
+// Shared state of the tasks of dtNavMesh::addTiles.
+struct dtAddTilesBatch
+{
+	dtNavMesh* nav;
+	dtMeshTile** tiles;			// The new tiles, sorted by location.
+	int* cells;					// Index of the first new tile at each location, followed by the tile count.
+	int* passCells;				// The locations connected by the current pass.
+	unsigned char* slots;		// State of each tile slot. (See: dtAddTilesSlotState)
+};
+
+enum dtAddTilesSlotState
+{
+	DT_BATCH_SLOT_OLD = 0,		// The tile was in the navigation mesh before.
+	DT_BATCH_SLOT_NEW,			// The tile is added by the batch.
+	DT_BATCH_SLOT_TOUCHED,		// The tile was in the navigation mesh before and has links to new tiles.
+};
+
+static int compareTileLocations(const void* va, const void* vb)
+{
+	const dtMeshHeader* a = (*(const dtMeshTile* const*)va)->header;
+	const dtMeshHeader* b = (*(const dtMeshTile* const*)vb)->header;
+	if (a->x != b->x) return a->x < b->x ? -1 : 1;
+	if (a->y != b->y) return a->y < b->y ? -1 : 1;
+	return 0;
+}
+
+static void runTasks(dtTaskRunner* runner, void (*task)(void*, int), void* context, const int count)
+{
+	if (!count)
+		return;
+	if (runner)
+	{
+		runner->run(task, context, count);
+		return;
+	}
+	for (int i = 0; i < count; ++i)
+		task(context, i);
+}
+
+void dtNavMesh::linkTileTask(void* context, int index)
+{
+	dtAddTilesBatch* batch = (dtAddTilesBatch*)context;
+	dtMeshTile* tile = batch->tiles[index];
+	batch->nav->connectIntLinks(tile);
+	batch->nav->baseOffMeshLinks(tile);
+	batch->nav->connectExtOffMeshLinks(tile, tile, -1);
+}
+
+void dtNavMesh::connectCellTask(void* context, int index)
+{
+	dtAddTilesBatch* batch = (dtAddTilesBatch*)context;
+	dtNavMesh* nav = batch->nav;
+	const int cell = batch->passCells[index];
+
+	static const int MAX_NEIS = 32;
+	dtMeshTile* neis[MAX_NEIS];
+	for (int k = batch->cells[cell]; k < batch->cells[cell+1]; ++k)
+	{
+		dtMeshTile* tile = batch->tiles[k];
+		const int x = tile->header->x, y = tile->header->y;
+		for (int side = -1; side < 8; ++side)
+		{
+			const int nneis = side == -1 ? nav->getTilesAt(x, y, neis, MAX_NEIS) :
+										   nav->getNeighbourTilesAt(x, y, side, neis, MAX_NEIS);
+			for (int j = 0; j < nneis; ++j)
+			{
+				dtMeshTile* nei = neis[j];
+				if (nei == tile)
+					continue;
+				// Two new tiles are connected once, from the one in the lower slot.
+				unsigned char& state = batch->slots[nei->index];
+				if (state == DT_BATCH_SLOT_NEW && nei->index < tile->index)
+					continue;
+				nav->connectTilePair(tile, nei, side);
+				if (state == DT_BATCH_SLOT_OLD)
+					state = DT_BATCH_SLOT_TOUCHED;
+			}
+		}
+	}
+}
+
+/// @par
+///
+/// The tiles are added in two steps. All tiles are first put in their tile slots, then they are
+/// linked: the links inside each tile are built, and the tiles are connected with their
+/// neighbours, including the tiles already in the navigation mesh. Each pair of neighbouring
+/// tiles is connected once, and the neighbours are compacted and have their revision changed
+/// once for the whole batch.
+///
+/// The linking of a tile only touches the tiles around its location. With a task runner, the
+/// tiles are linked in parallel, in nine passes over the tile locations, so that the locations
+/// connected at the same time are three tiles apart. The links of a polygon may be in a different
+/// order than when the tiles are added one by one.
+///
+/// Without a task runner the same passes run on the calling thread.
+///
+/// If a tile cannot be added, none of the tiles are added, and the data of all tiles is left
+/// to the caller.
+///
+/// @see addTile
+dtStatus dtNavMesh::addTiles(unsigned char** data, const int* dataSize, const int count, const int flags,
+							 const dtTileRef* lastRefs, dtTaskRunner* runner, dtTileRef* results)
+{
+	if (!data || !dataSize || count < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!count)
+		return DT_SUCCESS;
+
+	dtAddTilesBatch batch;
+	batch.nav = this;
+	batch.tiles = (dtMeshTile**)dtAlloc(sizeof(dtMeshTile*)*count, DT_ALLOC_TEMP, m_allocator);
+	batch.cells = (int*)dtAlloc(sizeof(int)*(count+1), DT_ALLOC_TEMP, m_allocator);
+	batch.passCells = (int*)dtAlloc(sizeof(int)*count, DT_ALLOC_TEMP, m_allocator);
+	batch.slots = 0;
+	if (!batch.tiles || !batch.cells || !batch.passCells)
+	{
+		dtFree(batch.tiles, m_allocator);
+		dtFree(batch.cells, m_allocator);
+		dtFree(batch.passCells, m_allocator);
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	dtStatus status = DT_SUCCESS;
+	int n = 0;
+	for (; n < count; ++n)
+	{
+		status = insertTile(data[n], dataSize[n], flags, lastRefs ? lastRefs[n] : 0, &batch.tiles[n]);
+		if (dtStatusFailed(status))
+			break;
+	}
+	if (dtStatusSucceed(status))
+	{
+		// The inserted tiles may have created new slots.
+		batch.slots = (unsigned char*)dtAlloc(sizeof(unsigned char)*m_tileCount, DT_ALLOC_TEMP, m_allocator);
+		if (batch.slots)
+			memset(batch.slots, DT_BATCH_SLOT_OLD, sizeof(unsigned char)*m_tileCount);
+		else
+			status = DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	if (dtStatusFailed(status))
+	{
+		// The inserted tiles have no links yet, remove them in reverse order to restore the free list.
+		for (int i = n-1; i >= 0; --i)
+		{
+			batch.tiles[i]->flags &= ~DT_TILE_FREE_DATA;
+			removeTile(getTileRef(batch.tiles[i]), 0, 0);
+		}
+	}
+	else
+	{
+		if (results)
+		{
+			for (int i = 0; i < count; ++i)
+				results[i] = getTileRef(batch.tiles[i]);
+		}
+
+		// Group the tiles by location.
+		qsort(batch.tiles, count, sizeof(dtMeshTile*), compareTileLocations);
+		int ncells = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			batch.slots[batch.tiles[i]->index] = DT_BATCH_SLOT_NEW;
+			if (i == 0 || compareTileLocations(&batch.tiles[i-1], &batch.tiles[i]) != 0)
+				batch.cells[ncells++] = i;
+		}
+		batch.cells[ncells] = count;
+
+		runTasks(runner, linkTileTask, &batch, count);
+
+		for (int pass = 0; pass < 9; ++pass)
+		{
+			int npass = 0;
+			for (int i = 0; i < ncells; ++i)
+			{
+				const dtMeshHeader* header = batch.tiles[batch.cells[i]]->header;
+				if (((header->x % 3 + 3) % 3) + ((header->y % 3 + 3) % 3)*3 == pass)
+					batch.passCells[npass++] = i;
+			}
+			runTasks(runner, connectCellTask, &batch, npass);
+		}
+
+		for (int i = 0; i < m_tileCount; ++i)
+		{
+			if (batch.slots[i] == DT_BATCH_SLOT_TOUCHED)
+			{
+				getTileSlot(i)->revision++;
+				compactLinks(getTileSlot(i));
+			}
+			else if (batch.slots[i] == DT_BATCH_SLOT_NEW)
+			{
+				compactLinks(getTileSlot(i));
+			}
+		}
+	}
+
+	dtFree(batch.tiles, m_allocator);
+	dtFree(batch.cells, m_allocator);
+	dtFree(batch.passCells, m_allocator);
+	dtFree(batch.slots, m_allocator);
+
+	return status;
 }
 
 const dtMeshTile* dtNavMesh::getTileAt(const int x, const int y, const int layer) const
@@ -1097,9 +1608,9 @@ const dtMeshTile* dtNavMesh::getTileByRef(dtTileRef ref) const
 		return 0;
 	unsigned int tileIndex = decodePolyIdTile((dtPolyRef)ref);
 	unsigned int tileSalt = decodePolyIdSalt((dtPolyRef)ref);
-	if ((int)tileIndex >= m_maxTiles)
+	if ((int)tileIndex >= m_tileCount)
 		return 0;
-	const dtMeshTile* tile = &m_tiles[tileIndex];
+	const dtMeshTile* tile = getTileSlot(tileIndex);
 	if (tile->salt != tileSalt)
 		return 0;
 	return tile;
@@ -1110,14 +1621,34 @@ int dtNavMesh::getMaxTiles() const
 	return m_maxTiles;
 }
 
-dtMeshTile* dtNavMesh::getTile(int i)
+/// @par
+///
+/// The slots are created as tiles are added. The slots at or above #getTileSlotCount have never
+/// been used and are all represented by the same empty tile.
+const dtMeshTile* dtNavMesh::getTile(int i) const
 {
-	return &m_tiles[i];
+	if (i >= m_tileCount)
+		return (const dtMeshTile*)s_unusedTile.data;
+	return getTileSlot(i);
 }
 
-const dtMeshTile* dtNavMesh::getTile(int i) const
+/// @par
+///
+/// A new tile can make paths shorter anywhere on the mesh, not only next to the tile, so
+/// results that depend on the shortest path can compare the count to see if they are stale.
+unsigned int dtNavMesh::getTileAddCount() const
+{
+	return m_tileAddCount;
+}
+
+/// @par
+///
+/// Like a new tile, a polygon that becomes passable or cheaper can shorten paths that do not
+/// pass through its tile. The count changes with #setPolyFlags, #setPolyArea and #restoreTileState,
+/// and can be compared like #getTileAddCount. dtMeshTile::revision tells which tile changed.
+unsigned int dtNavMesh::getPolyChangeCount() const
 {
-	return &m_tiles[i];
+	return m_polyChangeCount;
 }
 
 void dtNavMesh::calcTileLoc(const float* pos, int* tx, int* ty) const
@@ -1131,11 +1662,12 @@ dtStatus dtNavMesh::getTileAndPolyByRef(const dtPolyRef ref, const dtMeshTile**
 	if (!ref) return DT_FAILURE;
 	unsigned int salt, it, ip;
 	decodePolyId(ref, salt, it, ip);
-	if (it >= (unsigned int)m_maxTiles) return DT_FAILURE | DT_INVALID_PARAM;
-	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return DT_FAILURE | DT_INVALID_PARAM;
-	if (ip >= (unsigned int)m_tiles[it].header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
-	*tile = &m_tiles[it];
-	*poly = &m_tiles[it].polys[ip];
+	if (it >= (unsigned int)m_tileCount) return DT_FAILURE | DT_INVALID_PARAM;
+	const dtMeshTile* t = getTileSlot(it);
+	if (t->salt != salt || t->header == 0) return DT_FAILURE | DT_INVALID_PARAM;
+	if (ip >= (unsigned int)t->header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
+	*tile = t;
+	*poly = &t->polys[ip];
 	return DT_SUCCESS;
 }
 
@@ -1148,8 +1680,9 @@ void dtNavMesh::getTileAndPolyByRefUnsafe(const dtPolyRef ref, const dtMeshTile*
 {
 	unsigned int salt, it, ip;
 	decodePolyId(ref, salt, it, ip);
-	*tile = &m_tiles[it];
-	*poly = &m_tiles[it].polys[ip];
+	const dtMeshTile* t = getTileSlot(it);
+	*tile = t;
+	*poly = &t->polys[ip];
 }
 
 bool dtNavMesh::isValidPolyRef(dtPolyRef ref) const
@@ -1157,9 +1690,10 @@ bool dtNavMesh::isValidPolyRef(dtPolyRef ref) const
 	if (!ref) return false;
 	unsigned int salt, it, ip;
 	decodePolyId(ref, salt, it, ip);
-	if (it >= (unsigned int)m_maxTiles) return false;
-	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return false;
-	if (ip >= (unsigned int)m_tiles[it].header->polyCount) return false;
+	if (it >= (unsigned int)m_tileCount) return false;
+	const dtMeshTile* tile = getTileSlot(it);
+	if (tile->salt != salt || tile->header == 0) return false;
+	if (ip >= (unsigned int)tile->header->polyCount) return false;
 	return true;
 }
 
@@ -1175,9 +1709,9 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 		return DT_FAILURE | DT_INVALID_PARAM;
 	unsigned int tileIndex = decodePolyIdTile((dtPolyRef)ref);
 	unsigned int tileSalt = decodePolyIdSalt((dtPolyRef)ref);
-	if ((int)tileIndex >= m_maxTiles)
+	if ((int)tileIndex >= m_tileCount)
 		return DT_FAILURE | DT_INVALID_PARAM;
-	dtMeshTile* tile = &m_tiles[tileIndex];
+	dtMeshTile* tile = getTileSlot(tileIndex);
 	if (tile->salt != tileSalt)
 		return DT_FAILURE | DT_INVALID_PARAM;
 	
@@ -1193,6 +1727,7 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 				prev->next = cur->next;
 			else
 				m_posLookup[h] = cur->next;
+			m_posLookupCount--;
 			break;
 		}
 		prev = cur;
@@ -1210,6 +1745,8 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	{
 		if (neis[j] == tile) continue;
 		unconnectLinks(neis[j], tile);
+		neis[j]->revision++;
+		compactLinks(neis[j]);
 	}
 	
 	// Disconnect from neighbour tiles.
@@ -1217,14 +1754,18 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	{
 		nneis = getNeighbourTilesAt(tile->header->x, tile->header->y, i, neis, MAX_NEIS);
 		for (int j = 0; j < nneis; ++j)
+		{
 			unconnectLinks(neis[j], tile);
+			neis[j]->revision++;
+			compactLinks(neis[j]);
+		}
 	}
 		
 	// Reset tile.
 	if (tile->flags & DT_TILE_FREE_DATA)
 	{
 		// Owns data
-		dtFree(tile->data);
+		dtFree(tile->data, m_allocator);
 		tile->data = 0;
 		tile->dataSize = 0;
 		if (data) *data = 0;
@@ -1247,6 +1788,8 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	tile->detailTris = 0;
 	tile->bvTree = 0;
 	tile->offMeshCons = 0;
+	tile->borderEdges = 0;
+	tile->revision++;
 
 	// Update salt, salt should never be zero.
 #ifdef DT_POLYREF64
@@ -1267,8 +1810,7 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 dtTileRef dtNavMesh::getTileRef(const dtMeshTile* tile) const
 {
 	if (!tile) return 0;
-	const unsigned int it = (unsigned int)(tile - m_tiles);
-	return (dtTileRef)encodePolyId(tile->salt, it, 0);
+	return (dtTileRef)encodePolyId(tile->salt, tile->index, 0);
 }
 
 /// @par
@@ -1288,8 +1830,230 @@ dtTileRef dtNavMesh::getTileRef(const dtMeshTile* tile) const
 dtPolyRef dtNavMesh::getPolyRefBase(const dtMeshTile* tile) const
 {
 	if (!tile) return 0;
-	const unsigned int it = (unsigned int)(tile - m_tiles);
-	return encodePolyId(tile->salt, it, 0);
+	return encodePolyId(tile->salt, tile->index, 0);
+}
+
+// Start of a navigation mesh image, followed by the index of the tiles and the tile data.
+// The index starts at the first aligned offset after the header, and each tile data too.
+struct dtNavMeshImageHeader
+{
+	int magic;								// Magic number, used to identify the data.
+	int version;							// Data version number.
+	int refSize;							// Size of dtPolyRef the image was stored with.
+	int tileCount;							// Number of tiles in the image.
+	dtNavMeshParams params;					// Parameters of the navigation mesh.
+};
+
+struct dtNavMeshImageTile
+{
+	dtTileRef ref;							// Tile ref at the time of storing the data.
+	unsigned int linksFreeList;				// Index of the first free link of the tile.
+	int dataOffset;							// Offset of the tile data from the start of the image.
+	int dataSize;							// Size of the tile data.
+};
+
+// Alignment of the tile data within an image, so tiles start on their own cache line.
+static const int DT_NAVMESH_IMAGE_ALIGN = 64;
+
+inline int alignImageOffset(const int x) { return (x + DT_NAVMESH_IMAGE_ALIGN-1) & ~(DT_NAVMESH_IMAGE_ALIGN-1); }
+
+// Offset of the tile index from the start of the image, aligned for the tile references.
+inline int getImageIndexOffset() { return alignImageOffset(sizeof(dtNavMeshImageHeader)); }
+
+// Returns true if the sections the tile header describes fit in the tile data.
+static bool tileSectionsFit(const dtMeshHeader* header, const int dataSize)
+{
+	const int counts[] = {
+		header->vertCount, header->polyCount, header->maxLinkCount,
+		header->detailMeshCount, header->detailVertCount, header->detailTriCount,
+		header->bvNodeCount, header->offMeshConCount, header->borderEdgeCount };
+	const int itemSizes[] = {
+		(int)sizeof(float)*3, (int)sizeof(dtPoly), (int)sizeof(dtLink),
+		(int)sizeof(dtPolyDetail), (int)sizeof(float)*3, (int)sizeof(unsigned char)*4,
+		(int)sizeof(dtBVNode), (int)sizeof(dtOffMeshConnection), (int)sizeof(dtBorderEdge) };
+
+	// Same layout as patchTilePointers(), checked section by section so the sizes cannot overflow.
+	int remaining = dataSize - dtAlign4(sizeof(dtMeshHeader));
+	for (int i = 0; i < (int)(sizeof(counts)/sizeof(counts[0])); ++i)
+	{
+		if (remaining < 0 || counts[i] < 0 || counts[i] > remaining / itemSizes[i])
+			return false;
+		remaining -= dtAlign4(itemSizes[i]*counts[i]);
+	}
+	return remaining >= 0;
+}
+
+///  @see #storeImage
+int dtNavMesh::getImageSize() const
+{
+	int tileCount = 0;
+	int tilesSize = 0;
+	for (int i = 0; i < m_tileCount; ++i)
+	{
+		const dtMeshTile* tile = getTileSlot(i);
+		if (!tile->header)
+			continue;
+		tileCount++;
+		tilesSize += alignImageOffset(tile->dataSize);
+	}
+	return alignImageOffset(getImageIndexOffset() + sizeof(dtNavMeshImageTile)*tileCount) + tilesSize;
+}
+
+/// @par
+///
+/// The image holds the tile data as it is used by the navigation mesh, with the links built
+/// and the polygon flags and areas as they are, and the reference of each tile. Loading it
+/// with #initFromImage does not copy or link anything, so the image can be memory mapped from
+/// a file and shared by processes. The format is not portable between builds with different
+/// endianess or #dtPolyRef size.
+///
+/// @see #initFromImage
+dtStatus dtNavMesh::storeImage(unsigned char* data, const int maxDataSize) const
+{
+	const int size = getImageSize();
+	if (!data || maxDataSize < size)
+		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+	memset(data, 0, size);
+
+	dtNavMeshImageHeader* header = (dtNavMeshImageHeader*)data;
+	dtNavMeshImageTile* tiles = (dtNavMeshImageTile*)(data + getImageIndexOffset());
+	header->magic = DT_NAVMESH_IMAGE_MAGIC;
+	header->version = DT_NAVMESH_IMAGE_VERSION;
+	header->refSize = (int)sizeof(dtTileRef);
+	memcpy(&header->params, &m_params, sizeof(dtNavMeshParams));
+
+	int n = 0;
+	for (int i = 0; i < m_tileCount; ++i)
+	{
+		if (getTileSlot(i)->header)
+			n++;
+	}
+	header->tileCount = n;
+
+	int offset = alignImageOffset(getImageIndexOffset() + sizeof(dtNavMeshImageTile)*n);
+	n = 0;
+	for (int i = 0; i < m_tileCount; ++i)
+	{
+		const dtMeshTile* tile = getTileSlot(i);
+		if (!tile->header)
+			continue;
+		dtNavMeshImageTile& entry = tiles[n++];
+		entry.ref = getTileRef(tile);
+		entry.linksFreeList = tile->linksFreeList;
+		entry.dataOffset = offset;
+		entry.dataSize = tile->dataSize;
+		memcpy(data + offset, tile->data, tile->dataSize);
+		offset += alignImageOffset(tile->dataSize);
+	}
+
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// Call this instead of #init. The tiles are placed at the references they were stored with,
+/// and point into the image, so it must be writable if polygon flags or areas are changed or
+/// tiles are added next to or removed from the tiles of the image. Map the file copy-on-write
+/// to share the pages that are not changed.
+///
+/// The tiles are not owned by the navigation mesh. Tiles can be removed and added as usual.
+///
+/// The image must be aligned like memory returned by #dtAlloc, the tile references of its
+/// index and the data of its tiles are read in place.
+///
+/// @see #storeImage
+dtStatus dtNavMesh::initFromImage(unsigned char* data, const int dataSize, const int flags)
+{
+	if (!data || dataSize < (int)sizeof(dtNavMeshImageHeader))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	const dtNavMeshImageHeader* header = (const dtNavMeshImageHeader*)data;
+	if (header->magic != DT_NAVMESH_IMAGE_MAGIC)
+		return DT_FAILURE | DT_WRONG_MAGIC;
+	if (header->version != DT_NAVMESH_IMAGE_VERSION || header->refSize != (int)sizeof(dtTileRef))
+		return DT_FAILURE | DT_WRONG_VERSION;
+	const int indexOffset = getImageIndexOffset();
+	if (header->tileCount < 0 || dataSize < indexOffset ||
+		header->tileCount > (dataSize - indexOffset) / (int)sizeof(dtNavMeshImageTile))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	const int indexSize = indexOffset + (int)sizeof(dtNavMeshImageTile)*header->tileCount;
+
+	dtStatus status = init(&header->params);
+	if (dtStatusFailed(status))
+		return status;
+
+	const dtNavMeshImageTile* entries = (const dtNavMeshImageTile*)(data + indexOffset);
+	for (int i = 0; i < header->tileCount; ++i)
+	{
+		const dtNavMeshImageTile& entry = entries[i];
+		if (entry.dataOffset < indexSize || entry.dataOffset != alignImageOffset(entry.dataOffset) ||
+			entry.dataSize < (int)sizeof(dtMeshHeader) || entry.dataOffset > dataSize - entry.dataSize)
+		{
+			status = DT_FAILURE | DT_INVALID_PARAM;
+			break;
+		}
+		unsigned char* tileData = data + entry.dataOffset;
+		dtMeshHeader* tileHeader = (dtMeshHeader*)tileData;
+		if (tileHeader->magic != DT_NAVMESH_MAGIC || tileHeader->version != DT_NAVMESH_VERSION)
+		{
+			status = DT_FAILURE | DT_WRONG_VERSION;
+			break;
+		}
+		if (!tileSectionsFit(tileHeader, entry.dataSize))
+		{
+			status = DT_FAILURE | DT_INVALID_PARAM;
+			break;
+		}
+		const int tileIndex = (int)decodePolyIdTile((dtPolyRef)entry.ref);
+		if (tileIndex >= m_maxTiles || (tileIndex < m_tileCount && getTileSlot(tileIndex)->header) ||
+			getTileAt(tileHeader->x, tileHeader->y, tileHeader->layer))
+		{
+			status = DT_FAILURE | DT_ALREADY_OCCUPIED;
+			break;
+		}
+		if (tileIndex >= m_tileCount)
+		{
+			status = createTileSlots(tileIndex+1);
+			// The free list is built after all tiles are placed.
+			m_nextFree = 0;
+			if (dtStatusFailed(status))
+				break;
+		}
+
+		dtMeshTile* tile = getTileSlot(tileIndex);
+		tile->salt = decodePolyIdSalt((dtPolyRef)entry.ref);
+		patchTilePointers(tile, tileData);
+		tile->linksFreeList = entry.linksFreeList;
+		tile->header = tileHeader;
+		tile->data = tileData;
+		tile->dataSize = entry.dataSize;
+		tile->flags = flags & ~DT_TILE_FREE_DATA;
+		tile->revision++;
+		m_tileAddCount++;
+		insertTileLookup(tile);
+	}
+
+	if (dtStatusFailed(status))
+	{
+		// Leave the navigation mesh empty.
+		for (int i = 0; i < m_tileCount; ++i)
+			resetTileSlot(getTileSlot(i), i);
+		memset(m_posLookup, 0, sizeof(dtMeshTile*)*m_tileLutSize);
+		m_posLookupCount = 0;
+		m_tileAddCount = 0;
+	}
+
+	// The remaining tiles are free, in index order.
+	m_nextFree = 0;
+	for (int i = m_tileCount-1; i >= 0; --i)
+	{
+		dtMeshTile* tile = getTileSlot(i);
+		if (tile->header)
+			continue;
+		tile->next = m_nextFree;
+		m_nextFree = tile;
+	}
+
+	return status;
 }
 
 struct dtTileState
@@ -1377,6 +2141,8 @@ dtStatus dtNavMesh::restoreTileState(dtMeshTile* tile, const unsigned char* data
 		p->flags = s->flags;
 		p->setArea(s->area);
 	}
+	tile->revision++;
+	m_polyChangeCount++;
 	
 	return DT_SUCCESS;
 }
@@ -1397,9 +2163,9 @@ dtStatus dtNavMesh::getOffMeshConnectionPolyEndPoints(dtPolyRef prevRef, dtPolyR
 	
 	// Get current polygon
 	decodePolyId(polyRef, salt, it, ip);
-	if (it >= (unsigned int)m_maxTiles) return DT_FAILURE | DT_INVALID_PARAM;
-	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return DT_FAILURE | DT_INVALID_PARAM;
-	const dtMeshTile* tile = &m_tiles[it];
+	if (it >= (unsigned int)m_tileCount) return DT_FAILURE | DT_INVALID_PARAM;
+	const dtMeshTile* tile = getTileSlot(it);
+	if (tile->salt != salt || tile->header == 0) return DT_FAILURE | DT_INVALID_PARAM;
 	if (ip >= (unsigned int)tile->header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
 	const dtPoly* poly = &tile->polys[ip];
 
@@ -1440,9 +2206,9 @@ const dtOffMeshConnection* dtNavMesh::getOffMeshConnectionByRef(dtPolyRef ref) c
 	
 	// Get current polygon
 	decodePolyId(ref, salt, it, ip);
-	if (it >= (unsigned int)m_maxTiles) return 0;
-	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return 0;
-	const dtMeshTile* tile = &m_tiles[it];
+	if (it >= (unsigned int)m_tileCount) return 0;
+	const dtMeshTile* tile = getTileSlot(it);
+	if (tile->salt != salt || tile->header == 0) return 0;
 	if (ip >= (unsigned int)tile->header->polyCount) return 0;
 	const dtPoly* poly = &tile->polys[ip];
 	
@@ -1455,19 +2221,128 @@ const dtOffMeshConnection* dtNavMesh::getOffMeshConnectionByRef(dtPolyRef ref) c
 	return &tile->offMeshCons[idx];
 }
 
+/// @par
+///
+/// Returns the same point dtNavMeshQuery uses as the node position when the
+/// linked polygon is entered from @p fromPoly. The link must belong to @p fromPoly.
+void dtNavMesh::getLinkMidPoint(dtPolyRef fromRef, const dtMeshTile* fromTile, const dtPoly* fromPoly,
+								const dtLink* link, float* mid) const
+{
+	float left[3], right[3];
+	getLinkPortal(fromRef, fromTile, fromPoly, link, left, right);
+	mid[0] = (left[0]+right[0])*0.5f;
+	mid[1] = (left[1]+right[1])*0.5f;
+	mid[2] = (left[2]+right[2])*0.5f;
+}
+
+void dtNavMesh::getLinkPortal(dtPolyRef fromRef, const dtMeshTile* fromTile, const dtPoly* fromPoly,
+							  const dtLink* link, float* left, float* right) const
+{
+	if (fromPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		dtVcopy(left, &fromTile->verts[fromPoly->verts[link->edge]*3]);
+		dtVcopy(right, left);
+		return;
+	}
+
+	const dtMeshTile* toTile = 0;
+	const dtPoly* toPoly = 0;
+	getTileAndPolyByRefUnsafe(link->ref, &toTile, &toPoly);
+	if (toPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		for (unsigned int i = toPoly->firstLink; i != DT_NULL_LINK; i = toTile->links[i].next)
+		{
+			if (toTile->links[i].ref == fromRef)
+			{
+				dtVcopy(left, &toTile->verts[toPoly->verts[toTile->links[i].edge]*3]);
+				dtVcopy(right, left);
+				return;
+			}
+		}
+		// One-way connection that does not link back, use its start.
+		dtVcopy(left, &toTile->verts[toPoly->verts[0]*3]);
+		dtVcopy(right, left);
+		return;
+	}
+
+	const float* v0 = &fromTile->verts[fromPoly->verts[link->edge]*3];
+	const float* v1 = &fromTile->verts[fromPoly->verts[(link->edge+1) % (int)fromPoly->vertCount]*3];
+	dtVcopy(left, v0);
+	dtVcopy(right, v1);
+	if (link->side != 0xff && (link->bmin != 0 || link->bmax != 255))
+	{
+		const float s = 1.0f/255.0f;
+		dtVlerp(left, v0, v1, link->bmin*s);
+		dtVlerp(right, v0, v1, link->bmax*s);
+	}
+}
+
+bool dtNavMesh::hasLinkTo(const dtMeshTile* tile, const dtPoly* poly, dtPolyRef ref) const
+{
+	for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+	{
+		if (tile->links[i].ref == ref)
+			return true;
+	}
+	return false;
+}
+
+bool dtNavMesh::offMeshConLandsAt(const dtMeshTile* tile, const dtOffMeshConnection* con, const int x, const int y) const
+{
+	// Tile offsets of the sides, see getNeighbourTilesAt().
+	static const int offsets[8][2] = { {1,0}, {1,1}, {0,1}, {-1,1}, {-1,0}, {-1,-1}, {0,-1}, {1,-1} };
+	if (con->side == 0xff)
+		return tile->header->x == x && tile->header->y == y;
+	return tile->header->x + offsets[con->side & 7][0] == x && tile->header->y + offsets[con->side & 7][1] == y;
+}
+
+/// @par
+///
+/// The connections may start in the tile itself or in any of its neighbours. A search running
+/// over the reversed links cannot enter the tile through them.
+int dtNavMesh::countOneWayOffMeshConnections(const dtMeshTile* tile) const
+{
+	static const int MAX_NEIS = 32;
+	const dtMeshTile* neis[MAX_NEIS];
+	const int x = tile->header->x, y = tile->header->y;
+	int count = 0;
+	for (int dy = -1; dy <= 1; ++dy)
+	{
+		for (int dx = -1; dx <= 1; ++dx)
+		{
+			const int nneis = getTilesAt(x+dx, y+dy, neis, MAX_NEIS);
+			for (int i = 0; i < nneis; ++i)
+			{
+				for (int j = 0; j < neis[i]->header->offMeshConCount; ++j)
+				{
+					const dtOffMeshConnection* con = &neis[i]->offMeshCons[j];
+					if (!(con->flags & DT_OFFMESH_CON_BIDIR) && offMeshConLandsAt(neis[i], con, x, y))
+						count++;
+				}
+			}
+		}
+	}
+	return count;
+}
+
 
 dtStatus dtNavMesh::setPolyFlags(dtPolyRef ref, unsigned short flags)
 {
 	if (!ref) return DT_FAILURE;
 	unsigned int salt, it, ip;
 	decodePolyId(ref, salt, it, ip);
-	if (it >= (unsigned int)m_maxTiles) return DT_FAILURE | DT_INVALID_PARAM;
-	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return DT_FAILURE | DT_INVALID_PARAM;
-	dtMeshTile* tile = &m_tiles[it];
+	if (it >= (unsigned int)m_tileCount) return DT_FAILURE | DT_INVALID_PARAM;
+	dtMeshTile* tile = getTileSlot(it);
+	if (tile->salt != salt || tile->header == 0) return DT_FAILURE | DT_INVALID_PARAM;
 	if (ip >= (unsigned int)tile->header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
 	dtPoly* poly = &tile->polys[ip];
 	
 	// Change flags.
+	if (poly->flags != flags)
+	{
+		tile->revision++;
+		m_polyChangeCount++;
+	}
 	poly->flags = flags;
 	
 	return DT_SUCCESS;
@@ -1478,9 +2353,9 @@ dtStatus dtNavMesh::getPolyFlags(dtPolyRef ref, unsigned short* resultFlags) con
 	if (!ref) return DT_FAILURE;
 	unsigned int salt, it, ip;
 	decodePolyId(ref, salt, it, ip);
-	if (it >= (unsigned int)m_maxTiles) return DT_FAILURE | DT_INVALID_PARAM;
-	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return DT_FAILURE | DT_INVALID_PARAM;
-	const dtMeshTile* tile = &m_tiles[it];
+	if (it >= (unsigned int)m_tileCount) return DT_FAILURE | DT_INVALID_PARAM;
+	const dtMeshTile* tile = getTileSlot(it);
+	if (tile->salt != salt || tile->header == 0) return DT_FAILURE | DT_INVALID_PARAM;
 	if (ip >= (unsigned int)tile->header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
 	const dtPoly* poly = &tile->polys[ip];
 
@@ -1494,12 +2369,17 @@ dtStatus dtNavMesh::setPolyArea(dtPolyRef ref, unsigned char area)
 	if (!ref) return DT_FAILURE;
 	unsigned int salt, it, ip;
 	decodePolyId(ref, salt, it, ip);
-	if (it >= (unsigned int)m_maxTiles) return DT_FAILURE | DT_INVALID_PARAM;
-	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return DT_FAILURE | DT_INVALID_PARAM;
-	dtMeshTile* tile = &m_tiles[it];
+	if (it >= (unsigned int)m_tileCount) return DT_FAILURE | DT_INVALID_PARAM;
+	dtMeshTile* tile = getTileSlot(it);
+	if (tile->salt != salt || tile->header == 0) return DT_FAILURE | DT_INVALID_PARAM;
 	if (ip >= (unsigned int)tile->header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
 	dtPoly* poly = &tile->polys[ip];
 	
+	if (poly->getArea() != area)
+	{
+		tile->revision++;
+		m_polyChangeCount++;
+	}
 	poly->setArea(area);
 	
 	return DT_SUCCESS;
@@ -1510,9 +2390,9 @@ dtStatus dtNavMesh::getPolyArea(dtPolyRef ref, unsigned char* resultArea) const
 	if (!ref) return DT_FAILURE;
 	unsigned int salt, it, ip;
 	decodePolyId(ref, salt, it, ip);
-	if (it >= (unsigned int)m_maxTiles) return DT_FAILURE | DT_INVALID_PARAM;
-	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return DT_FAILURE | DT_INVALID_PARAM;
-	const dtMeshTile* tile = &m_tiles[it];
+	if (it >= (unsigned int)m_tileCount) return DT_FAILURE | DT_INVALID_PARAM;
+	const dtMeshTile* tile = getTileSlot(it);
+	if (tile->salt != salt || tile->header == 0) return DT_FAILURE | DT_INVALID_PARAM;
 	if (ip >= (unsigned int)tile->header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
 	const dtPoly* poly = &tile->polys[ip];
 	
@@ -240,6 +240,52 @@ static int createBVTree(dtNavMeshCreateParams* params, dtBVNode* nodes, int /*nn
 	return curNode;
 }
 
+static int compareBorderEdges(const void* va, const void* vb)
+{
+	const dtBorderEdge* a = (const dtBorderEdge*)va;
+	const dtBorderEdge* b = (const dtBorderEdge*)vb;
+	if (a->side != b->side)
+		return a->side < b->side ? -1 : 1;
+	if (a->min != b->min)
+		return a->min < b->min ? -1 : 1;
+	if (a->poly != b->poly)
+		return a->poly < b->poly ? -1 : 1;
+	if (a->edge != b->edge)
+		return a->edge < b->edge ? -1 : 1;
+	return 0;
+}
+
+// Collects the portal edges on the tile borders, sorted by side and start along the border.
+static void buildBorderEdges(const float* verts, const dtPoly* polys, const int polyCount, dtBorderEdge* edges, const int edgeCount)
+{
+	int n = 0;
+	for (int i = 0; i < polyCount; ++i)
+	{
+		const dtPoly* p = &polys[i];
+		if (p->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+			continue;
+		for (int j = 0; j < p->vertCount; ++j)
+		{
+			if (!(p->neis[j] & DT_EXT_LINK) || n >= edgeCount)
+				continue;
+			const unsigned char side = (unsigned char)(p->neis[j] & 0xff);
+			// The same axis as the slab end points used when connecting tiles.
+			const int axis = (side == 0 || side == 4) ? 2 : 0;
+			const float a = verts[p->verts[j]*3+axis];
+			const float b = verts[p->verts[(j+1) % p->vertCount]*3+axis];
+			dtBorderEdge& edge = edges[n++];
+			edge.min = dtMin(a, b);
+			edge.max = dtMax(a, b);
+			edge.poly = (unsigned short)i;
+			edge.edge = (unsigned char)j;
+			edge.side = side;
+		}
+	}
+	qsort(edges, n, sizeof(dtBorderEdge), compareBorderEdges);
+	for (int i = 0; i < n; ++i)
+		edges[i].reach = (i > 0 && edges[i-1].side == edges[i].side) ? dtMax(edges[i-1].reach, edges[i].max) : edges[i].max;
+}
+
 static unsigned char classifyOffMeshPoint(const float* pt, const float* bmin, const float* bmax)
 {
 	static const unsigned char XP = 1<<0;
@@ -433,12 +479,13 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*detailTriCount);
 	const int bvTreeSize = params->buildBvTree ? dtAlign4(sizeof(dtBVNode)*params->polyCount*2) : 0;
 	const int offMeshConsSize = dtAlign4(sizeof(dtOffMeshConnection)*storedOffMeshConCount);
+	const int borderEdgesSize = dtAlign4(sizeof(dtBorderEdge)*portalCount);
 	
 	const int dataSize = headerSize + vertsSize + polysSize + linksSize +
 						 detailMeshesSize + detailVertsSize + detailTrisSize +
-						 bvTreeSize + offMeshConsSize;
+						 bvTreeSize + offMeshConsSize + borderEdgesSize;
 						 
-	unsigned char* data = (unsigned char*)dtAlloc(sizeof(unsigned char)*dataSize, DT_ALLOC_PERM);
+	unsigned char* data = (unsigned char*)dtAlloc(sizeof(unsigned char)*dataSize, DT_ALLOC_PERM, params->allocator);
 	if (!data)
 	{
 		dtFree(offMeshConClass);
@@ -457,6 +504,7 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	unsigned char* navDTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
 	dtBVNode* navBvtree = dtGetThenAdvanceBufferPointer<dtBVNode>(d, bvTreeSize);
 	dtOffMeshConnection* offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshConsSize);
+	dtBorderEdge* borderEdges = dtGetThenAdvanceBufferPointer<dtBorderEdge>(d, borderEdgesSize);
 	
 	
 	// Store header
@@ -480,6 +528,7 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	header->walkableRadius = params->walkableRadius;
 	header->walkableClimb = params->walkableClimb;
 	header->offMeshConCount = storedOffMeshConCount;
+	header->borderEdgeCount = portalCount;
 	header->bvNodeCount = params->buildBvTree ? params->polyCount*2 : 0;
 	
 	const int offMeshVertsBase = params->vertCount;
@@ -626,6 +675,9 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	{
 		createBVTree(params, navBvtree, 2*params->polyCount);
 	}
+
+	// Store border edges.
+	buildBorderEdges(navVerts, navPolys, totPolyCount, borderEdges, portalCount);
 	
 	// Store Off-Mesh connections.
 	n = 0;
@@ -686,6 +738,7 @@ bool dtNavMeshHeaderSwapEndian(unsigned char* data, const int /*dataSize*/)
 	dtSwapEndian(&header->detailTriCount);
 	dtSwapEndian(&header->bvNodeCount);
 	dtSwapEndian(&header->offMeshConCount);
+	dtSwapEndian(&header->borderEdgeCount);
 	dtSwapEndian(&header->offMeshBase);
 	dtSwapEndian(&header->walkableHeight);
 	dtSwapEndian(&header->walkableRadius);
@@ -728,6 +781,7 @@ bool dtNavMeshDataSwapEndian(unsigned char* data, const int /*dataSize*/)
 	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
 	const int bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
 	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
+	const int borderEdgesSize = dtAlign4(sizeof(dtBorderEdge)*header->borderEdgeCount);
 	
 	unsigned char* d = data + headerSize;
 	float* verts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
@@ -740,6 +794,7 @@ bool dtNavMeshDataSwapEndian(unsigned char* data, const int /*dataSize*/)
 	//unsigned char* detailTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
 	dtBVNode* bvTree = dtGetThenAdvanceBufferPointer<dtBVNode>(d, bvtreeSize);
 	dtOffMeshConnection* offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshLinksSize);
+	dtBorderEdge* borderEdges = dtGetThenAdvanceBufferPointer<dtBorderEdge>(d, borderEdgesSize);
 	
 	// Vertices
 	for (int i = 0; i < header->vertCount*3; ++i)
@@ -797,6 +852,246 @@ bool dtNavMeshDataSwapEndian(unsigned char* data, const int /*dataSize*/)
 		dtSwapEndian(&con->rad);
 		dtSwapEndian(&con->poly);
 	}
+
+	// Border edges.
+	for (int i = 0; i < header->borderEdgeCount; ++i)
+	{
+		dtBorderEdge* edge = &borderEdges[i];
+		dtSwapEndian(&edge->min);
+		dtSwapEndian(&edge->max);
+		dtSwapEndian(&edge->reach);
+		dtSwapEndian(&edge->poly);
+	}
 	
 	return true;
 }
+
+// Range of the quantized vertices, stored after the header of quantized tile data.
+struct dtQuantizedVertRange
+{
+	float bmin[3];		///< The minimum of the vertices. [(x, y, z)]
+	float step[3];		///< The size of a quantization step along each axis. [(x, y, z)]
+};
+
+static const float DT_QUANTIZED_VERT_STEPS = 65535.0f;
+static const int DT_QUANTIZED_MAX_CELL_SUBDIV = 16;
+
+// The sections of tile data, in the order they are stored.
+struct dtNavMeshDataSections
+{
+	int header, range, verts, polys, links, detailMeshes, detailVerts, detailTris, bvTree, offMeshCons, borderEdges;
+
+	int total() const
+	{
+		return header + range + verts + polys + links + detailMeshes + detailVerts + detailTris + bvTree + offMeshCons + borderEdges;
+	}
+};
+
+// Returns the section sizes of tile data with the header, quantized or not.
+static dtNavMeshDataSections getNavMeshDataSections(const dtMeshHeader* header, const bool quantized)
+{
+	const int vertSize = quantized ? (int)sizeof(unsigned short)*3 : (int)sizeof(float)*3;
+	dtNavMeshDataSections s;
+	s.header = dtAlign4(sizeof(dtMeshHeader));
+	s.range = quantized ? dtAlign4(sizeof(dtQuantizedVertRange)) : 0;
+	s.verts = dtAlign4(vertSize*header->vertCount);
+	s.polys = dtAlign4(sizeof(dtPoly)*header->polyCount);
+	s.links = quantized ? 0 : dtAlign4(sizeof(dtLink)*(header->maxLinkCount));
+	s.detailMeshes = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount);
+	s.detailVerts = dtAlign4(vertSize*header->detailVertCount);
+	s.detailTris = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
+	s.bvTree = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
+	s.offMeshCons = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
+	s.borderEdges = quantized ? 0 : dtAlign4(sizeof(dtBorderEdge)*header->borderEdgeCount);
+	return s;
+}
+
+// Returns the smallest power of two fraction or multiple of the cell size that spans the extent
+// in the available steps, leaving one step for aligning the minimum to the step.
+static float getQuantizationStep(const float cs, const float extent)
+{
+	float step = cs;
+	while (extent > step*(DT_QUANTIZED_VERT_STEPS - 1.0f))
+		step *= 2.0f;
+	for (int i = 0; i < DT_QUANTIZED_MAX_CELL_SUBDIV && extent <= step*0.5f*(DT_QUANTIZED_VERT_STEPS - 1.0f); ++i)
+		step *= 0.5f;
+	return step;
+}
+
+static void quantizeVerts(const float* verts, const int nverts, const dtQuantizedVertRange& range, unsigned short* out)
+{
+	for (int i = 0; i < nverts*3; ++i)
+	{
+		const int axis = i % 3;
+		const float q = range.step[axis] > 0.0f ? dtMathFloorf((verts[i] - range.bmin[axis]) / range.step[axis] + 0.5f) : 0.0f;
+		out[i] = (unsigned short)dtClamp(q, 0.0f, DT_QUANTIZED_VERT_STEPS);
+	}
+}
+
+static void dequantizeVerts(const unsigned short* verts, const int nverts, const dtQuantizedVertRange& range, float* out)
+{
+	for (int i = 0; i < nverts*3; ++i)
+		out[i] = range.bmin[i % 3] + verts[i] * range.step[i % 3];
+}
+
+/// @par
+///
+/// This is a storage format: the vertices are decoded by #dtDequantizeNavMeshData when the tile
+/// is loaded, so it reduces the size of files and streamed tiles, not the memory of loaded tiles.
+///
+/// The step along each axis is the cell size of the tile divided by a power of two, the smallest
+/// which spans the extent of the vertices in 65535 steps, and the steps are aligned to the minimum
+/// of the tile. The polygon vertices along x and z lie on the voxel grid, so they are restored
+/// exactly, apart from float rounding, and the polygons keep their shape and links. The cell height
+/// is not stored in the tile data, so the heights and the detail vertices are restored within half
+/// a step of their original position. (See: #dtGetQuantizedNavMeshDataError)
+///
+/// The results of the queries on the restored tile data are bounded by the error of the vertices:
+/// the nearest points and the polygon heights move by at most a few times the error (more only
+/// on steep detail triangles), and the polygons found stay the same as long as the error is well
+/// below the cell size. Paths of nearly equal cost may swap.
+///
+/// Only the vertices are quantized. The polygons, bounding volume tree, detail triangles and
+/// off-mesh connections are copied as they are. The links are not stored, as they are rebuilt
+/// when the tile is added, and neither are the border edges, as they are rebuilt from the
+/// vertices when the data is dequantized.
+///
+/// @warning The data must be in the native endianess. Call #dtNavMeshDataSwapEndian before
+/// quantizing, or after dequantizing, if the data is stored in a different endianess.
+bool dtQuantizeNavMeshData(const unsigned char* data, const int dataSize, unsigned char** outData, int* outDataSize)
+{
+	if (!data || !outData || !outDataSize || dataSize < (int)sizeof(dtMeshHeader))
+		return false;
+	const dtMeshHeader* header = (const dtMeshHeader*)data;
+	if (header->magic != DT_NAVMESH_MAGIC || header->version != DT_NAVMESH_VERSION)
+		return false;
+
+	const dtNavMeshDataSections src = getNavMeshDataSections(header, false);
+	const dtNavMeshDataSections dst = getNavMeshDataSections(header, true);
+	if (dataSize < src.total())
+		return false;
+
+	const unsigned char* s = data + src.header;
+	const float* verts = (const float*)s; s += src.verts;
+	const unsigned char* polys = s; s += src.polys + src.links;
+	const unsigned char* detailMeshes = s; s += src.detailMeshes;
+	const float* detailVerts = (const float*)s; s += src.detailVerts;
+	const unsigned char* rest = s;
+
+	// Quantize over the bounds of all vertices.
+	float bmin[3], bmax[3];
+	dtVcopy(bmin, header->bmin);
+	dtVcopy(bmax, header->bmin);
+	if (header->vertCount > 0)
+	{
+		dtVcopy(bmin, verts);
+		dtVcopy(bmax, verts);
+	}
+	for (int i = 0; i < header->vertCount; ++i)
+	{
+		dtVmin(bmin, &verts[i*3]);
+		dtVmax(bmax, &verts[i*3]);
+	}
+	for (int i = 0; i < header->detailVertCount; ++i)
+	{
+		dtVmin(bmin, &detailVerts[i*3]);
+		dtVmax(bmax, &detailVerts[i*3]);
+	}
+
+	// The steps are fractions of the cell size aligned to the tile minimum,
+	// so the vertices on the voxel grid are restored exactly.
+	const float cs = header->bvQuantFactor > 0.0f ? 1.0f / header->bvQuantFactor : 1.0f;
+	dtQuantizedVertRange range;
+	for (int i = 0; i < 3; ++i)
+	{
+		range.step[i] = getQuantizationStep(cs, bmax[i] - bmin[i]);
+		range.bmin[i] = header->bmin[i] + dtMathFloorf((bmin[i] - header->bmin[i]) / range.step[i]) * range.step[i];
+	}
+
+	const int size = dst.total();
+	unsigned char* out = (unsigned char*)dtAlloc(sizeof(unsigned char)*size, DT_ALLOC_PERM);
+	if (!out)
+		return false;
+	memset(out, 0, size);
+
+	unsigned char* d = out;
+	dtMeshHeader* outHeader = dtGetThenAdvanceBufferPointer<dtMeshHeader>(d, dst.header);
+	memcpy(outHeader, header, sizeof(dtMeshHeader));
+	outHeader->version = DT_NAVMESH_QUANTIZED_VERSION;
+	memcpy(dtGetThenAdvanceBufferPointer<dtQuantizedVertRange>(d, dst.range), &range, sizeof(range));
+	quantizeVerts(verts, header->vertCount, range, dtGetThenAdvanceBufferPointer<unsigned short>(d, dst.verts));
+	memcpy(dtGetThenAdvanceBufferPointer<unsigned char>(d, dst.polys), polys, dst.polys);
+	memcpy(dtGetThenAdvanceBufferPointer<unsigned char>(d, dst.detailMeshes), detailMeshes, dst.detailMeshes);
+	quantizeVerts(detailVerts, header->detailVertCount, range, dtGetThenAdvanceBufferPointer<unsigned short>(d, dst.detailVerts));
+	memcpy(d, rest, dst.detailTris + dst.bvTree + dst.offMeshCons);
+
+	*outData = out;
+	*outDataSize = size;
+
+	return true;
+}
+
+bool dtDequantizeNavMeshData(const unsigned char* data, const int dataSize, unsigned char** outData, int* outDataSize,
+							 dtAllocator* allocator)
+{
+	if (!data || !outData || !outDataSize || dataSize < (int)sizeof(dtMeshHeader))
+		return false;
+	const dtMeshHeader* header = (const dtMeshHeader*)data;
+	if (header->magic != DT_NAVMESH_MAGIC || header->version != DT_NAVMESH_QUANTIZED_VERSION)
+		return false;
+
+	const dtNavMeshDataSections src = getNavMeshDataSections(header, true);
+	const dtNavMeshDataSections dst = getNavMeshDataSections(header, false);
+	if (dataSize < src.total())
+		return false;
+
+	const unsigned char* s = data + src.header;
+	const dtQuantizedVertRange* range = (const dtQuantizedVertRange*)s; s += src.range;
+	const unsigned short* verts = (const unsigned short*)s; s += src.verts;
+	const unsigned char* polys = s; s += src.polys;
+	const unsigned char* detailMeshes = s; s += src.detailMeshes;
+	const unsigned short* detailVerts = (const unsigned short*)s; s += src.detailVerts;
+	const unsigned char* rest = s;
+
+	const int size = dst.total();
+	unsigned char* out = (unsigned char*)dtAlloc(sizeof(unsigned char)*size, DT_ALLOC_PERM, allocator);
+	if (!out)
+		return false;
+	memset(out, 0, size);
+
+	unsigned char* d = out;
+	dtMeshHeader* outHeader = dtGetThenAdvanceBufferPointer<dtMeshHeader>(d, dst.header);
+	memcpy(outHeader, header, sizeof(dtMeshHeader));
+	outHeader->version = DT_NAVMESH_VERSION;
+	float* outVerts = dtGetThenAdvanceBufferPointer<float>(d, dst.verts);
+	dequantizeVerts(verts, header->vertCount, *range, outVerts);
+	dtPoly* outPolys = dtGetThenAdvanceBufferPointer<dtPoly>(d, dst.polys);
+	memcpy(outPolys, polys, dst.polys);
+	d += dst.links; // Links are created on load.
+	memcpy(dtGetThenAdvanceBufferPointer<unsigned char>(d, dst.detailMeshes), detailMeshes, dst.detailMeshes);
+	dequantizeVerts(detailVerts, header->detailVertCount, *range, dtGetThenAdvanceBufferPointer<float>(d, dst.detailVerts));
+	memcpy(d, rest, dst.detailTris + dst.bvTree + dst.offMeshCons);
+	d += dst.detailTris + dst.bvTree + dst.offMeshCons;
+	buildBorderEdges(outVerts, outPolys, header->polyCount, (dtBorderEdge*)d, header->borderEdgeCount);
+
+	*outData = out;
+	*outDataSize = size;
+
+	return true;
+}
+
+bool dtGetQuantizedNavMeshDataError(const unsigned char* data, const int dataSize, float* error)
+{
+	const int rangeOffset = dtAlign4(sizeof(dtMeshHeader));
+	if (!data || !error || dataSize < rangeOffset + (int)sizeof(dtQuantizedVertRange))
+		return false;
+	const dtMeshHeader* header = (const dtMeshHeader*)data;
+	if (header->magic != DT_NAVMESH_MAGIC || header->version != DT_NAVMESH_QUANTIZED_VERSION)
+		return false;
+
+	const dtQuantizedVertRange* range = (const dtQuantizedVertRange*)(data + rangeOffset);
+	for (int i = 0; i < 3; ++i)
+		error[i] = range->step[i] * 0.5f;
+
+	return true;
+}
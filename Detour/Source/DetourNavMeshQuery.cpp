@@ -17,10 +17,13 @@
 //
 
 #include <float.h>
+#include <limits.h>
 #include <string.h>
 #include "DetourNavMeshQuery.h"
 #include "DetourNavMesh.h"
 #include "DetourNode.h"
+#include "DetourLandmarks.h"
+#include "DetourIslands.h"
 #include "DetourCommon.h"
 #include "DetourMath.h"
 #include "DetourAlloc.h"
@@ -83,24 +86,9 @@ float dtQueryFilter::getCost(const float* pa, const float* pb,
 {
 	return dtVdist(pa, pb) * m_areaCost[curPoly->getArea()];
 }
-#else
-inline bool dtQueryFilter::passFilter(const dtPolyRef /*ref*/,
-									  const dtMeshTile* /*tile*/,
-									  const dtPoly* poly) const
-{
-	return (poly->flags & m_includeFlags) != 0 && (poly->flags & m_excludeFlags) == 0;
-}
-
-inline float dtQueryFilter::getCost(const float* pa, const float* pb,
-									const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
-									const dtPolyRef /*curRef*/, const dtMeshTile* /*curTile*/, const dtPoly* curPoly,
-									const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
-{
-	return dtVdist(pa, pb) * m_areaCost[curPoly->getArea()];
-}
 #endif	
 	
-static const float H_SCALE = 0.999f; // Search heuristic scale.//ʽ
+static const float H_SCALE = DT_QUERY_HEURISTIC_SCALE;
 
 
 dtNavMeshQuery* dtAllocNavMeshQuery()
@@ -110,11 +98,19 @@ dtNavMeshQuery* dtAllocNavMeshQuery()
 	return new(mem) dtNavMeshQuery;
 }
 
+dtNavMeshQuery* dtAllocNavMeshQuery(dtAllocator* allocator)
+{
+	void* mem = dtAlloc(sizeof(dtNavMeshQuery), DT_ALLOC_PERM, allocator);
+	if (!mem) return 0;
+	return new(mem) dtNavMeshQuery(allocator);
+}
+
 void dtFreeNavMeshQuery(dtNavMeshQuery* navmesh)
 {
 	if (!navmesh) return;
+	dtAllocator* allocator = navmesh->getAllocator();
 	navmesh->~dtNavMeshQuery();
-	dtFree(navmesh);
+	dtFree(navmesh, allocator);
 	//add by huyf 2019.03.01
 	navmesh = 0x0;
 	//add end
@@ -128,9 +124,9 @@ void dtFreeNavMeshQuery(dtNavMeshQuery* navmesh)
 /// to hold the entire result set the return status of the method will include 
 /// the #DT_BUFFER_TOO_SMALL flag.
 ///
-/// Constant member functions can be used by multiple clients without side
-/// effects. (E.g. No change to the closed list. No impact on an in-progress
-/// sliced path query. Etc.)
+/// Constant member functions do not change the closed list or an in-progress
+/// sliced path query. When DT_QUERY_STATS is defined they do update the query
+/// statistics. (See: #getQueryStats)
 /// 
 /// Walls and portals: A @e wall is a polygon segment that is 
 /// considered impassable. A @e portal is a passable segment between polygons.
@@ -138,13 +134,25 @@ void dtFreeNavMeshQuery(dtNavMeshQuery* navmesh)
 ///
 /// @see dtNavMesh, dtQueryFilter, #dtAllocNavMeshQuery(), #dtAllocNavMeshQuery()
 
-dtNavMeshQuery::dtNavMeshQuery() :
+dtNavMeshQuery::dtNavMeshQuery(dtAllocator* allocator) :
 	m_nav(0),
+	m_allocator(allocator),
+	m_searches(0),
+	m_maxSearches(0),
+	m_queryStartTime(0),
+	m_lastQueryType(0),
+	m_queryDepth(0),
 	m_tinyNodePool(0),
 	m_nodePool(0),
-	m_openList(0)
+	m_openList(0),
+	m_backOpenList(0),
+	m_landmarks(0),
+	m_islands(0)
 {
 	memset(&m_query, 0, sizeof(dtQueryData));
+	dtResetTimeBudgetStats(m_slicedStats);
+	memset(&m_lastQueryCounters, 0, sizeof(dtQueryCounters));
+	resetQueryStats();
 }
 
 dtNavMeshQuery::~dtNavMeshQuery()
@@ -155,9 +163,13 @@ dtNavMeshQuery::~dtNavMeshQuery()
 		m_nodePool->~dtNodePool();
 	if (m_openList)
 		m_openList->~dtNodeQueue();
-	dtFree(m_tinyNodePool);
-	dtFree(m_nodePool);
-	dtFree(m_openList);
+	if (m_backOpenList)
+		m_backOpenList->~dtNodeQueue();
+	dtFree(m_tinyNodePool, m_allocator);
+	dtFree(m_nodePool, m_allocator);
+	dtFree(m_openList, m_allocator);
+	dtFree(m_backOpenList, m_allocator);
+	purgeSlicedSearches();
 }
 
 /// @par 
@@ -166,10 +178,12 @@ dtNavMeshQuery::~dtNavMeshQuery()
 /// functions are used.
 ///
 /// This function can be used multiple times.
-dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
+dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes, const int openListType)
 {
 	if (maxNodes > DT_NULL_IDX || maxNodes > (1 << DT_NODE_PARENT_BITS) - 1)
 		return DT_FAILURE | DT_INVALID_PARAM;
+	if (openListType != DT_NODE_QUEUE_HEAP && openListType != DT_NODE_QUEUE_RADIX)
+		return DT_FAILURE | DT_INVALID_PARAM;
 
 	m_nav = nav;
 	
@@ -178,11 +192,11 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 		if (m_nodePool)
 		{
 			m_nodePool->~dtNodePool();
-			dtFree(m_nodePool);
+			dtFree(m_nodePool, m_allocator);
 			m_nodePool = 0;
 		}
 		//alloc dtNodePool
-		m_nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, dtNextPow2(maxNodes/4));
+		m_nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM, m_allocator)) dtNodePool(maxNodes, dtNextPow2(maxNodes/4), m_allocator);
 		if (!m_nodePool)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
 	}
@@ -194,7 +208,7 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 	if (!m_tinyNodePool)
 	{
 		//alloc dtNodePool
-		m_tinyNodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(64, 32);
+		m_tinyNodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM, m_allocator)) dtNodePool(64, 32, m_allocator);
 		if (!m_tinyNodePool)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
 	}
@@ -203,16 +217,16 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 		m_tinyNodePool->clear();
 	}
 	
-	if (!m_openList || m_openList->getCapacity() < maxNodes)
+	if (!m_openList || m_openList->getCapacity() < maxNodes || m_openList->getType() != openListType)
 	{
 		if (m_openList)
 		{
 			m_openList->~dtNodeQueue();
-			dtFree(m_openList);
+			dtFree(m_openList, m_allocator);
 			m_openList = 0;
 		}
 		//alloc dtNodeQueue
-		m_openList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM)) dtNodeQueue(maxNodes);
+		m_openList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM, m_allocator)) dtNodeQueue(maxNodes, openListType, m_allocator);
 		if (!m_openList)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
 	}
@@ -221,6 +235,23 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 		m_openList->clear();
 	}
 	
+	if (!m_backOpenList || m_backOpenList->getCapacity() < maxNodes || m_backOpenList->getType() != openListType)
+	{
+		if (m_backOpenList)
+		{
+			m_backOpenList->~dtNodeQueue();
+			dtFree(m_backOpenList, m_allocator);
+			m_backOpenList = 0;
+		}
+		m_backOpenList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM, m_allocator)) dtNodeQueue(maxNodes, openListType, m_allocator);
+		if (!m_backOpenList)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	else
+	{
+		m_backOpenList->clear();
+	}
+	
 	return DT_SUCCESS;
 }
 
@@ -233,7 +264,7 @@ dtStatus dtNavMeshQuery::findRandomPoint(const dtQueryFilter* filter, float (*fr
 	// ѡһƬƬͬ
 	const dtMeshTile* tile = 0;
 	float tsum = 0.0f;
-	for (int i = 0; i < m_nav->getMaxTiles(); i++)
+	for (int i = 0; i < m_nav->getTileSlotCount(); i++)
 	{
 		const dtMeshTile* t = m_nav->getTile(i);
 		if (!t || !t->header) continue;
@@ -793,6 +824,8 @@ dtStatus dtNavMeshQuery::findNearestPoly(const float* center, const float* halfE
 										 const dtQueryFilter* filter,
 										 dtPolyRef* nearestRef, float* nearestPt) const
 {
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_FIND_NEAREST_POLY);
+
 	dtAssert(m_nav);
 
 	if (!nearestRef)
@@ -817,6 +850,8 @@ void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qm
 										 const dtQueryFilter* filter, dtPolyQuery* query) const
 {
 	dtAssert(m_nav);
+	DT_QUERY_STATS_ADD(tilesTouched, 1);
+
 	static const int batchSize = 32;
 	dtPolyRef polyRefs[batchSize];
 	dtPoly* polys[batchSize];
@@ -851,6 +886,7 @@ void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qm
 		const dtPolyRef base = m_nav->getPolyRefBase(tile);
 		while (node < end)
 		{
+			DT_QUERY_STATS_ADD(bvNodesVisited, 1);
 			const bool overlap = dtOverlapQuantBounds(bmin, bmax, node->bmin, node->bmax);
 			const bool isLeafNode = node->i >= 0;
 
@@ -889,6 +925,7 @@ void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qm
 		const dtPolyRef base = m_nav->getPolyRefBase(tile);
 		for (int i = 0; i < tile->header->polyCount; ++i)
 		{
+			DT_QUERY_STATS_ADD(bvNodesVisited, 1);
 			dtPoly* p = &tile->polys[i];
 			// Do not return off-mesh connection polygons.
 			if (p->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
@@ -1001,6 +1038,8 @@ dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExt
 dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExtents,
 									   const dtQueryFilter* filter, dtPolyQuery* query) const
 {
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_QUERY_POLYGONS);
+
 	dtAssert(m_nav);
 
 	if (!center || !halfExtents || !filter || !query)
@@ -1033,21 +1072,26 @@ dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExt
 	return DT_SUCCESS;
 }
 
-/// @par
-///
-/// If the end polygon cannot be reached through the navigation graph,
-/// the last polygon in the path will be the nearest the end polygon.
-///
-/// If the path array is to small to hold the full result, it will be filled as 
-/// far as possible from the start polygon toward the end polygon.
-///
-/// The start and end positions are used to calculate traversal costs. 
-/// (The y-values impact the result.)
-///
-dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
-								  const float* startPos, const float* endPos,
-								  const dtQueryFilter* filter,
-								  dtPolyRef* path, int* pathCount, const int maxPath) const
+float dtNavMeshQuery::getLandmarkHeuristic(dtPolyRef from, dtPolyRef to) const
+{
+	return m_landmarks->getHeuristic(from, to);
+}
+
+// The island table only knows about the polygons passing the flags it was built with, so
+// it is ignored for filters with other flags.
+bool dtNavMeshQuery::isIslandConnected(dtPolyRef from, dtPolyRef to, const dtQueryFilter* filter) const
+{
+	if (!m_islands || !filter || !m_islands->matchesFilter(filter))
+		return true;
+	return m_islands->isConnected(from, to);
+}
+
+// Validates the input of findPath() and returns the paths that need no search. Otherwise starts
+// the search from the start polygon and returns DT_IN_PROGRESS.
+dtStatus dtNavMeshQuery::beginFindPath(dtPolyRef startRef, dtPolyRef endRef,
+									   const float* startPos, const float* endPos, const void* filter,
+									   const dtQueryFilter* islandFilter,
+									   dtPolyRef* path, int* pathCount, const int maxPath, dtNode** startNode) const
 {
 	dtAssert(m_nav);
 	dtAssert(m_nodePool);
@@ -1068,169 +1112,73 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 		*pathCount = 1;
 		return DT_SUCCESS;
 	}
+
+	if (!isIslandConnected(startRef, endRef, islandFilter))
+	{
+		path[0] = startRef;
+		*pathCount = 1;
+		return DT_SUCCESS | DT_PARTIAL_RESULT;
+	}
 	
 	m_nodePool->clear();
 	m_openList->clear();
 	
-	dtNode* startNode = m_nodePool->getNode(startRef);
-	dtVcopy(startNode->pos, startPos);
-	startNode->pidx = 0;
-	startNode->cost = 0;
-	startNode->total = dtVdist(startPos, endPos) * H_SCALE;
-	startNode->id = startRef;
-	startNode->flags = DT_NODE_OPEN;
-	m_openList->push(startNode);
-	
-	dtNode* lastBestNode = startNode;
-	float lastBestNodeCost = startNode->total;
-	
-	bool outOfNodes = false;
-	
-	while (!m_openList->empty())
-	{
-		// Remove node from open list and put it in closed list.
-		dtNode* bestNode = m_openList->pop();
-		bestNode->flags &= ~DT_NODE_OPEN;
-		bestNode->flags |= DT_NODE_CLOSED;
-		
-		// Reached the goal, stop searching.
-		if (bestNode->id == endRef)
-		{
-			lastBestNode = bestNode;
-			break;
-		}
-		
-		// Get current poly and tile.
-		// The API input has been cheked already, skip checking internal data.
-		const dtPolyRef bestRef = bestNode->id;
-		const dtMeshTile* bestTile = 0;
-		const dtPoly* bestPoly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
-		
-		// Get parent poly and tile.
-		dtPolyRef parentRef = 0;
-		const dtMeshTile* parentTile = 0;
-		const dtPoly* parentPoly = 0;
-		if (bestNode->pidx)
-			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
-		if (parentRef)
-			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
-		
-		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
-		{
-			dtPolyRef neighbourRef = bestTile->links[i].ref;
-			
-			// Skip invalid ids and do not expand back to where we came from.
-			if (!neighbourRef || neighbourRef == parentRef)
-				continue;
-			
-			// Get neighbour poly and tile.
-			// The API input has been cheked already, skip checking internal data.
-			const dtMeshTile* neighbourTile = 0;
-			const dtPoly* neighbourPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);			
-			
-			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
-				continue;
-
-			// deal explicitly with crossing tile boundaries
-			unsigned char crossSide = 0;
-			if (bestTile->links[i].side != 0xff)
-				crossSide = bestTile->links[i].side >> 1;
-
-			// get the node
-			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, crossSide);
-			if (!neighbourNode)
-			{
-				outOfNodes = true;
-				continue;
-			}
-			
-			// If the node is visited the first time, calculate node position.
-			if (neighbourNode->flags == 0)
-			{
-				getEdgeMidPoint(bestRef, bestPoly, bestTile,
-								neighbourRef, neighbourPoly, neighbourTile,
-								neighbourNode->pos);
-			}
-
-			// Calculate cost and heuristic.
-			float cost = 0;
-			float heuristic = 0;
-			
-			// Special case for last node.
-			if (neighbourRef == endRef)
-			{
-				// Cost
-				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
-													  parentRef, parentTile, parentPoly,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly);
-				const float endCost = filter->getCost(neighbourNode->pos, endPos,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly,
-													  0, 0, 0);
-				
-				cost = bestNode->cost + curCost + endCost;
-				heuristic = 0;
-			}
-			else
-			{
-				// Cost
-				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
-													  parentRef, parentTile, parentPoly,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly);
-				cost = bestNode->cost + curCost;
-				heuristic = dtVdist(neighbourNode->pos, endPos)*H_SCALE;
-			}
-
-			const float total = cost + heuristic;
-			
-			// The node is already in open list and the new result is worse, skip.
-			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
-				continue;
-			// The node is already visited and process, and the new result is worse, skip.
-			if ((neighbourNode->flags & DT_NODE_CLOSED) && total >= neighbourNode->total)
-				continue;
-			
-			// Add or update the node.
-			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
-			neighbourNode->id = neighbourRef;
-			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
-			neighbourNode->cost = cost;
-			neighbourNode->total = total;
-			
-			if (neighbourNode->flags & DT_NODE_OPEN)
-			{
-				// Already in open, update node location.
-				m_openList->modify(neighbourNode);
-			}
-			else
-			{
-				// Put the node in open list.
-				neighbourNode->flags |= DT_NODE_OPEN;
-				m_openList->push(neighbourNode);
-			}
-			
-			// Update nearest node to target so far.
-			if (heuristic < lastBestNodeCost)
-			{
-				lastBestNodeCost = heuristic;
-				lastBestNode = neighbourNode;
-			}
-		}
-	}
+	dtNode* node = m_nodePool->getNode(startRef);
+	dtVcopy(node->pos, startPos);
+	node->pidx = 0;
+	node->cost = 0;
+	node->total = dtVdist(startPos, endPos) * H_SCALE;
+	node->id = startRef;
+	node->flags = DT_NODE_OPEN;
+	m_openList->push(node);
+	*startNode = node;
 
-	dtStatus status = getPathToNode(lastBestNode, path, pathCount, maxPath);
+	return DT_IN_PROGRESS;
+}
 
-	if (lastBestNode->id != endRef)
-		status |= DT_PARTIAL_RESULT;
+/// @par
+///
+/// If the end polygon cannot be reached through the navigation graph,
+/// the last polygon in the path will be the nearest the end polygon.
+///
+/// If an island table is set and the end polygon is on another island than the
+/// start polygon, the search is skipped and the path is only the start polygon.
+///
+/// With #DT_FINDPATH_BIDIRECTIONAL a second search runs backward from the end polygon,
+/// and the path is joined where the two searches meet. Each search only needs to cover
+/// about half the distance, which pays off for long paths around obstacles the heuristic
+/// does not see. Both searches share the node pool. If no path exists the search 
+/// continues forward only, so the partial result is the same as without the option.
+///
+/// If the path array is to small to hold the full result, it will be filled as 
+/// far as possible from the start polygon toward the end polygon.
+///
+/// The start and end positions are used to calculate traversal costs. 
+/// (The y-values impact the result.)
+///
+dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
+								  const float* startPos, const float* endPos,
+								  const dtQueryFilter* filter,
+								  dtPolyRef* path, int* pathCount, const int maxPath,
+								  const unsigned int options) const
+{
+	return findPath<dtQueryFilter>(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath, options);
+}
 
-	if (outOfNodes)
-		status |= DT_OUT_OF_NODES;
-	
-	return status;
+/// @par
+///
+/// The limits bound the work of a single call below the size of the node pool. A deadline is
+/// checked every #DT_FINDPATH_DEADLINE_CHECK_NODES expanded nodes, so the search can run past it by
+/// the time of that many expansions.
+///
+/// The search is the one directional search of findPath(), as the best partial path of a
+/// bidirectional search would not start from the start polygon.
+dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
+								  const float* startPos, const float* endPos,
+								  const dtQueryFilter* filter, const dtFindPathLimits& limits,
+								  dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	return findPath<dtQueryFilter>(startRef, endRef, startPos, endPos, filter, limits, path, pathCount, maxPath);
 }
 
 dtStatus dtNavMeshQuery::getPathToNode(dtNode* endNode, dtPolyRef* path, int* pathCount, int maxPath) const
@@ -1273,6 +1221,35 @@ dtStatus dtNavMeshQuery::getPathToNode(dtNode* endNode, dtPolyRef* path, int* pa
 	return DT_SUCCESS;
 }
 
+dtStatus dtNavMeshQuery::getBidirectionalPath(const dtQueryData& query, dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	const dtStatus details = query.status & DT_STATUS_DETAIL_MASK;
+
+	if (!query.meetNode)
+	{
+		dtStatus status = getPathToNode(query.lastBestNode, path, pathCount, maxPath);
+		if (query.lastBestNode->id != query.endRef)
+			status |= DT_PARTIAL_RESULT;
+		return status | details;
+	}
+
+	// The forward nodes lead back from the meeting to the start, the backward nodes on to the end.
+	dtStatus status = getPathToNode(query.meetNode, path, pathCount, maxPath);
+	int n = *pathCount;
+	for (const dtNode* node = m_nodePool->getNodeAtIdx(query.meetBackNode->pidx); node; node = m_nodePool->getNodeAtIdx(node->pidx))
+	{
+		if (n >= maxPath)
+		{
+			status |= DT_BUFFER_TOO_SMALL;
+			break;
+		}
+		path[n++] = node->id;
+	}
+	*pathCount = n;
+
+	return status | details;
+}
+
 
 /// @par
 ///
@@ -1282,6 +1259,9 @@ dtStatus dtNavMeshQuery::getPathToNode(dtNode* endNode, dtPolyRef* path, int* pa
 /// The @p filter pointer is stored and used for the duration of the sliced
 /// path query.
 ///
+/// #DT_FINDPATH_BIDIRECTIONAL searches as described for findPath(). Each iteration
+/// expands one node of either search, and #DT_FINDPATH_ANY_ANGLE is ignored.
+///
 dtStatus dtNavMeshQuery::initSlicedFindPath(dtPolyRef startRef, dtPolyRef endRef,
 											const float* startPos, const float* endPos,
 											const dtQueryFilter* filter, const unsigned int options)
@@ -1341,12 +1321,21 @@ dtStatus dtNavMeshQuery::initSlicedFindPath(dtPolyRef startRef, dtPolyRef endRef
 	m_query.status = DT_IN_PROGRESS;
 	m_query.lastBestNode = startNode;
 	m_query.lastBestNodeCost = startNode->total;
+
+	if (options & DT_FINDPATH_BIDIRECTIONAL)
+		initBackwardSearch(m_query, filter);
+
+	// Nothing to search for, finalizing returns the start polygon as a partial path.
+	if (!isIslandConnected(startRef, endRef, filter))
+		m_query.status = DT_SUCCESS;
 	
 	return m_query.status;
 }
 	
 dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 {
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_SLICED_FIND_PATH);
+
 	if (!dtStatusInProgress(m_query.status))
 		return m_query.status;
 
@@ -1357,6 +1346,9 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 		return DT_FAILURE;
 	}
 
+	if (m_query.options & DT_FINDPATH_BIDIRECTIONAL)
+		return updateBidirectionalSearch(m_query, m_query.filter, maxIter, doneIters);
+
 	dtRaycastHit rayHit;
 	rayHit.maxPath = 0;
 		
@@ -1369,6 +1361,7 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 		dtNode* bestNode = m_openList->pop();
 		bestNode->flags &= ~DT_NODE_OPEN;
 		bestNode->flags |= DT_NODE_CLOSED;
+		DT_QUERY_STATS_ADD(nodesExpanded, 1);
 		
 		// Reached the goal, stop searching.
 		if (bestNode->id == m_query.endRef)
@@ -1444,12 +1437,16 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			
 			if (!m_query.filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
 				continue;
+
+			if (neighbourTile != bestTile)
+				DT_QUERY_STATS_ADD(tilesTouched, 1);
 			
 			// get the neighbor node
 			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, 0);
 			if (!neighbourNode)
 			{
 				m_query.status |= DT_OUT_OF_NODES;
+				DT_QUERY_STATS_ADD(outOfNodes, 1);
 				continue;
 			}
 			
@@ -1508,6 +1505,8 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			else
 			{
 				heuristic = dtVdist(neighbourNode->pos, m_query.endPos)*H_SCALE;
+				if (m_landmarks)
+					heuristic = dtMax(heuristic, m_landmarks->getHeuristic(neighbourRef, m_query.endRef)*H_SCALE);
 			}
 			
 			const float total = cost + heuristic;
@@ -1519,6 +1518,9 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			if ((neighbourNode->flags & DT_NODE_CLOSED) && total >= neighbourNode->total)
 				continue;
 			
+			if (neighbourNode->flags & DT_NODE_CLOSED)
+				DT_QUERY_STATS_ADD(nodesReopened, 1);
+
 			// Add or update the node.
 			neighbourNode->pidx = foundShortCut ? bestNode->pidx : m_nodePool->getNodeIdx(bestNode);
 			neighbourNode->id = neighbourRef;
@@ -1562,6 +1564,46 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 	return m_query.status;
 }
 
+/// @par
+///
+/// The search runs in slices of @p checkIters iterations and the clock is read after each
+/// slice, so the update can overrun the budget by the time of one slice. At least one slice is
+/// run, even with a zero budget, so that every update makes progress. Smaller values follow
+/// the budget more closely at the cost of more clock reads.
+///
+/// The time and iterations of each call are added to the statistics returned by getSlicedStats().
+dtStatus dtNavMeshQuery::updateSlicedFindPathTimed(const int maxTime, const int checkIters, int* doneIters)
+{
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_SLICED_FIND_PATH);
+
+	if (doneIters)
+		*doneIters = 0;
+	if (maxTime < 0 || checkIters <= 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!dtStatusInProgress(m_query.status))
+		return m_query.status;
+
+	const dtTimeVal startTime = dtGetTimeUsec();
+	dtTimeVal elapsed = 0;
+	int iters = 0;
+	dtStatus status = m_query.status;
+	do
+	{
+		int sliceIters = 0;
+		status = updateSlicedFindPath(checkIters, &sliceIters);
+		iters += sliceIters;
+		elapsed = dtGetTimeUsec() - startTime;
+	}
+	while (dtStatusInProgress(status) && elapsed < maxTime);
+
+	dtAddTimeBudgetUpdate(m_slicedStats, iters, elapsed, maxTime);
+
+	if (doneIters)
+		*doneIters = iters;
+
+	return status;
+}
+
 dtStatus dtNavMeshQuery::finalizeSlicedFindPath(dtPolyRef* path, int* pathCount, const int maxPath)
 {
 	*pathCount = 0;
@@ -1580,6 +1622,10 @@ dtStatus dtNavMeshQuery::finalizeSlicedFindPath(dtPolyRef* path, int* pathCount,
 		// Special case: the search starts and ends at same poly.
 		path[n++] = m_query.startRef;
 	}
+	else if (m_query.options & DT_FINDPATH_BIDIRECTIONAL)
+	{
+		m_query.status |= getBidirectionalPath(m_query, path, &n, maxPath) & DT_STATUS_DETAIL_MASK;
+	}
 	else
 	{
 		// Reverse the path.
@@ -1677,7 +1723,8 @@ dtStatus dtNavMeshQuery::finalizeSlicedFindPathPartial(const dtPolyRef* existing
 		dtNode* node = 0;
 		for (int i = existingSize-1; i >= 0; --i)
 		{
-			m_nodePool->findNodes(existing[i], &node, 1);
+			// Bidirectional searches keep the backward nodes in another state.
+			node = m_nodePool->findNode(existing[i], 0);
 			if (node)
 				break;
 		}
@@ -1746,23 +1793,306 @@ dtStatus dtNavMeshQuery::finalizeSlicedFindPathPartial(const dtPolyRef* existing
 	return DT_SUCCESS | details;
 }
 
-
-dtStatus dtNavMeshQuery::appendVertex(const float* pos, const unsigned char flags, const dtPolyRef ref,
-									  float* straightPath, unsigned char* straightPathFlags, dtPolyRef* straightPathRefs,
-									  int* straightPathCount, const int maxStraightPath) const
+void dtNavMeshQuery::purgeSlicedSearches()
 {
-	if ((*straightPathCount) > 0 && dtVequal(&straightPath[((*straightPathCount)-1)*3], pos))
-	{
-		// The vertices are equal, update flags and poly.
-		if (straightPathFlags)
-			straightPathFlags[(*straightPathCount)-1] = flags;
-		if (straightPathRefs)
-			straightPathRefs[(*straightPathCount)-1] = ref;
+	for (int i = 0; i < m_maxSearches; ++i)
+	{
+		dtSlicedSearch& search = m_searches[i];
+		if (search.nodePool)
+			search.nodePool->~dtNodePool();
+		if (search.openList)
+			search.openList->~dtNodeQueue();
+		if (search.backOpenList)
+			search.backOpenList->~dtNodeQueue();
+		dtFree(search.nodePool, m_allocator);
+		dtFree(search.openList, m_allocator);
+		dtFree(search.backOpenList, m_allocator);
 	}
-	else
-	{
-		// Append new vertex.
-		dtVcopy(&straightPath[(*straightPathCount)*3], pos);
+	dtFree(m_searches, m_allocator);
+	m_searches = 0;
+	m_maxSearches = 0;
+}
+
+/// @par
+///
+/// Each concurrent query gets its own node pool and open lists of @p maxNodes nodes, so the
+/// memory used is bounded by @p maxSearches times the memory of a single search. The open
+/// lists are of the type passed to init(), which must be called first.
+///
+/// The queries share the filter-independent state of the query object, such as the landmark
+/// and island tables, and add to the statistics returned by getSlicedStats().
+dtStatus dtNavMeshQuery::initSlicedSearches(const int maxSearches, const int maxNodes)
+{
+	if (!m_openList)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (maxSearches < 0 || maxSearches > DT_MAX_SLICED_SEARCHES)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (maxNodes <= 0 || maxNodes > DT_NULL_IDX || maxNodes > (1 << DT_NODE_PARENT_BITS) - 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	purgeSlicedSearches();
+	if (maxSearches == 0)
+		return DT_SUCCESS;
+
+	m_searches = (dtSlicedSearch*)dtAlloc(sizeof(dtSlicedSearch)*maxSearches, DT_ALLOC_PERM, m_allocator);
+	if (!m_searches)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_searches, 0, sizeof(dtSlicedSearch)*maxSearches);
+	m_maxSearches = maxSearches;
+
+	const int openListType = m_openList->getType();
+	for (int i = 0; i < maxSearches; ++i)
+	{
+		dtSlicedSearch& search = m_searches[i];
+		search.salt = 1;
+		search.nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM, m_allocator)) dtNodePool(maxNodes, dtNextPow2(maxNodes/4), m_allocator);
+		search.openList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM, m_allocator)) dtNodeQueue(maxNodes, openListType, m_allocator);
+		search.backOpenList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM, m_allocator)) dtNodeQueue(maxNodes, openListType, m_allocator);
+		if (!search.nodePool || !search.openList || !search.backOpenList)
+		{
+			purgeSlicedSearches();
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+	}
+
+	return DT_SUCCESS;
+}
+
+// The handle stores the slot index in the low 8 bits and the salt of the slot above them.
+dtNavMeshQuery::dtSlicedSearch* dtNavMeshQuery::getSlicedSearch(dtSlicedSearchRef searchRef) const
+{
+	const int index = (int)(searchRef & 0xff);
+	if (index >= m_maxSearches)
+		return 0;
+	dtSlicedSearch& search = m_searches[index];
+	if (!search.inUse || search.salt != (searchRef >> 8))
+		return 0;
+	return &search;
+}
+
+void dtNavMeshQuery::swapSlicedSearch(dtSlicedSearch& search)
+{
+	dtSwap(m_query, search.query);
+	dtSwap(m_nodePool, search.nodePool);
+	dtSwap(m_openList, search.openList);
+	dtSwap(m_backOpenList, search.backOpenList);
+}
+
+void dtNavMeshQuery::releaseSlicedSearch(dtSlicedSearch& search)
+{
+	memset(&search.query, 0, sizeof(dtQueryData));
+	search.inUse = false;
+	search.salt = (search.salt + 1) & 0xffffff;
+	if (search.salt == 0)
+		search.salt = 1;
+}
+
+/// @par
+///
+/// Fails with #DT_BUFFER_TOO_SMALL if all the queries set up by initSlicedSearches() are in flight.
+/// A query that is started keeps its handle until it is finalized or cancelled, even if it
+/// completed during initialization.
+dtStatus dtNavMeshQuery::initSlicedFindPath(dtPolyRef startRef, dtPolyRef endRef,
+											const float* startPos, const float* endPos,
+											const dtQueryFilter* filter, const unsigned int options,
+											dtSlicedSearchRef* searchRef)
+{
+	if (!searchRef)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	*searchRef = 0;
+
+	int index = -1;
+	for (int i = 0; i < m_maxSearches && index < 0; ++i)
+	{
+		if (!m_searches[i].inUse)
+			index = i;
+	}
+	if (index < 0)
+		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+
+	dtSlicedSearch& search = m_searches[index];
+	swapSlicedSearch(search);
+	const dtStatus status = initSlicedFindPath(startRef, endRef, startPos, endPos, filter, options);
+	swapSlicedSearch(search);
+	if (dtStatusFailed(status))
+	{
+		memset(&search.query, 0, sizeof(dtQueryData));
+		return status;
+	}
+
+	search.inUse = true;
+	*searchRef = (search.salt << 8) | (unsigned int)index;
+
+	return status;
+}
+
+dtStatus dtNavMeshQuery::updateSlicedFindPath(dtSlicedSearchRef searchRef, const int maxIter, int* doneIters)
+{
+	dtSlicedSearch* search = getSlicedSearch(searchRef);
+	if (!search)
+	{
+		if (doneIters)
+			*doneIters = 0;
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	swapSlicedSearch(*search);
+	const dtStatus status = updateSlicedFindPath(maxIter, doneIters);
+	swapSlicedSearch(*search);
+
+	return status;
+}
+
+dtStatus dtNavMeshQuery::updateSlicedFindPathTimed(dtSlicedSearchRef searchRef, const int maxTime, const int checkIters, int* doneIters)
+{
+	dtSlicedSearch* search = getSlicedSearch(searchRef);
+	if (!search)
+	{
+		if (doneIters)
+			*doneIters = 0;
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	swapSlicedSearch(*search);
+	const dtStatus status = updateSlicedFindPathTimed(maxTime, checkIters, doneIters);
+	swapSlicedSearch(*search);
+
+	return status;
+}
+
+dtStatus dtNavMeshQuery::finalizeSlicedFindPath(dtSlicedSearchRef searchRef, dtPolyRef* path, int* pathCount, const int maxPath)
+{
+	dtSlicedSearch* search = getSlicedSearch(searchRef);
+	if (!search)
+	{
+		*pathCount = 0;
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	swapSlicedSearch(*search);
+	const dtStatus status = finalizeSlicedFindPath(path, pathCount, maxPath);
+	swapSlicedSearch(*search);
+	releaseSlicedSearch(*search);
+
+	return status;
+}
+
+dtStatus dtNavMeshQuery::finalizeSlicedFindPathPartial(dtSlicedSearchRef searchRef, const dtPolyRef* existing, const int existingSize,
+													   dtPolyRef* path, int* pathCount, const int maxPath)
+{
+	dtSlicedSearch* search = getSlicedSearch(searchRef);
+	if (!search)
+	{
+		*pathCount = 0;
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	swapSlicedSearch(*search);
+	const dtStatus status = finalizeSlicedFindPathPartial(existing, existingSize, path, pathCount, maxPath);
+	swapSlicedSearch(*search);
+	releaseSlicedSearch(*search);
+
+	return status;
+}
+
+dtStatus dtNavMeshQuery::cancelSlicedFindPath(dtSlicedSearchRef searchRef)
+{
+	dtSlicedSearch* search = getSlicedSearch(searchRef);
+	if (!search)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	releaseSlicedSearch(*search);
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMeshQuery::getSlicedFindPathStatus(dtSlicedSearchRef searchRef) const
+{
+	const dtSlicedSearch* search = getSlicedSearch(searchRef);
+	if (!search)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	return search->query.status;
+}
+
+int dtNavMeshQuery::getSlicedSearchCount() const
+{
+	int count = 0;
+	for (int i = 0; i < m_maxSearches; ++i)
+	{
+		if (m_searches[i].inUse)
+			count++;
+	}
+	return count;
+}
+
+void dtNavMeshQuery::resetQueryStats()
+{
+	memset(&m_queryStats, 0, sizeof(dtQueryStats));
+}
+
+void dtNavMeshQuery::beginQueryStats() const
+{
+	// Nested queries are counted as part of the outermost one.
+	if (m_queryDepth++ > 0)
+		return;
+	memset(&m_lastQueryCounters, 0, sizeof(dtQueryCounters));
+	m_queryStartTime = dtGetTimeUsec();
+}
+
+// Returns the histogram bucket of the value, see dtQueryTypeStats.
+static int getQueryStatsBucket(int64_t value)
+{
+	int bucket = 0;
+	while (value > 0 && bucket < DT_QUERYSTATS_HISTOGRAM_SIZE-1)
+	{
+		value >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+void dtNavMeshQuery::endQueryStats(const int type) const
+{
+	if (--m_queryDepth > 0)
+		return;
+
+	dtQueryCounters& last = m_lastQueryCounters;
+	last.time = dtGetTimeUsec() - m_queryStartTime;
+	m_lastQueryType = type;
+
+	dtQueryTypeStats& stats = m_queryStats.types[type];
+	stats.calls++;
+	stats.total.nodesExpanded += last.nodesExpanded;
+	stats.total.nodesReopened += last.nodesReopened;
+	stats.total.tilesTouched += last.tilesTouched;
+	stats.total.bvNodesVisited += last.bvNodesVisited;
+	stats.total.outOfNodes += last.outOfNodes;
+	stats.total.time += last.time;
+	stats.max.nodesExpanded = dtMax(stats.max.nodesExpanded, last.nodesExpanded);
+	stats.max.nodesReopened = dtMax(stats.max.nodesReopened, last.nodesReopened);
+	stats.max.tilesTouched = dtMax(stats.max.tilesTouched, last.tilesTouched);
+	stats.max.bvNodesVisited = dtMax(stats.max.bvNodesVisited, last.bvNodesVisited);
+	stats.max.outOfNodes = dtMax(stats.max.outOfNodes, last.outOfNodes);
+	stats.max.time = dtMax(stats.max.time, last.time);
+	stats.timeHistogram[getQueryStatsBucket(last.time)]++;
+	stats.nodesHistogram[getQueryStatsBucket(last.nodesExpanded)]++;
+}
+
+
+dtStatus dtNavMeshQuery::appendVertex(const float* pos, const unsigned char flags, const dtPolyRef ref,
+									  float* straightPath, unsigned char* straightPathFlags, dtPolyRef* straightPathRefs,
+									  int* straightPathCount, const int maxStraightPath) const
+{
+	if ((*straightPathCount) > 0 && dtVequal(&straightPath[((*straightPathCount)-1)*3], pos))
+	{
+		// The vertices are equal, update flags and poly.
+		if (straightPathFlags)
+			straightPathFlags[(*straightPathCount)-1] = flags;
+		if (straightPathRefs)
+			straightPathRefs[(*straightPathCount)-1] = ref;
+	}
+	else
+	{
+		// Append new vertex.
+		dtVcopy(&straightPath[(*straightPathCount)*3], pos);
 		if (straightPathFlags)
 			straightPathFlags[(*straightPathCount)] = flags;
 		if (straightPathRefs)
@@ -1858,6 +2188,8 @@ dtStatus dtNavMeshQuery::findStraightPath(const float* startPos, const float* en
 										  float* straightPath, unsigned char* straightPathFlags, dtPolyRef* straightPathRefs,
 										  int* straightPathCount, const int maxStraightPath, const int options) const
 {
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_FIND_STRAIGHT_PATH);
+
 	dtAssert(m_nav);
 	
 	*straightPathCount = 0;
@@ -2109,197 +2441,8 @@ dtStatus dtNavMeshQuery::moveAlongSurface(dtPolyRef startRef, const float* start
 										  const dtQueryFilter* filter,
 										  float* resultPos, dtPolyRef* visited, int* visitedCount, const int maxVisitedSize) const
 {
-	dtAssert(m_nav);
-	dtAssert(m_tinyNodePool);
-
-	*visitedCount = 0;
-	
-	// Validate input
-	if (!startRef)
-		return DT_FAILURE | DT_INVALID_PARAM;
-	if (!m_nav->isValidPolyRef(startRef))
-		return DT_FAILURE | DT_INVALID_PARAM;
-	
-	dtStatus status = DT_SUCCESS;
-	
-	static const int MAX_STACK = 48;
-	dtNode* stack[MAX_STACK];
-	int nstack = 0;
-	
-	m_tinyNodePool->clear();
-	
-	dtNode* startNode = m_tinyNodePool->getNode(startRef);
-	startNode->pidx = 0;
-	startNode->cost = 0;
-	startNode->total = 0;
-	startNode->id = startRef;
-	startNode->flags = DT_NODE_CLOSED;
-	stack[nstack++] = startNode;
-	
-	float bestPos[3];
-	float bestDist = FLT_MAX;
-	dtNode* bestNode = 0;
-	dtVcopy(bestPos, startPos);
-	
-	// Search constraints
-	float searchPos[3], searchRadSqr;
-	dtVlerp(searchPos, startPos, endPos, 0.5f);
-	searchRadSqr = dtSqr(dtVdist(startPos, endPos)/2.0f + 0.001f);
-	
-	float verts[DT_VERTS_PER_POLYGON*3];
-	
-	while (nstack)
-	{
-		// Pop front.
-		dtNode* curNode = stack[0];
-		for (int i = 0; i < nstack-1; ++i)
-			stack[i] = stack[i+1];
-		nstack--;
-		
-		// Get poly and tile.
-		// The API input has been cheked already, skip checking internal data.
-		const dtPolyRef curRef = curNode->id;
-		const dtMeshTile* curTile = 0;
-		const dtPoly* curPoly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(curRef, &curTile, &curPoly);			
-		
-		// Collect vertices.
-		const int nverts = curPoly->vertCount;
-		for (int i = 0; i < nverts; ++i)
-			dtVcopy(&verts[i*3], &curTile->verts[curPoly->verts[i]*3]);
-		
-		// If target is inside the poly, stop search.
-		if (dtPointInPolygon(endPos, verts, nverts))
-		{
-			bestNode = curNode;
-			dtVcopy(bestPos, endPos);
-			break;
-		}
-		
-		// Find wall edges and find nearest point inside the walls.
-		for (int i = 0, j = (int)curPoly->vertCount-1; i < (int)curPoly->vertCount; j = i++)
-		{
-			// Find links to neighbours.
-			static const int MAX_NEIS = 8;
-			int nneis = 0;
-			dtPolyRef neis[MAX_NEIS];
-			
-			if (curPoly->neis[j] & DT_EXT_LINK)
-			{
-				// Tile border.
-				for (unsigned int k = curPoly->firstLink; k != DT_NULL_LINK; k = curTile->links[k].next)
-				{
-					const dtLink* link = &curTile->links[k];
-					if (link->edge == j)
-					{
-						if (link->ref != 0)
-						{
-							const dtMeshTile* neiTile = 0;
-							const dtPoly* neiPoly = 0;
-							m_nav->getTileAndPolyByRefUnsafe(link->ref, &neiTile, &neiPoly);
-							if (filter->passFilter(link->ref, neiTile, neiPoly))
-							{
-								if (nneis < MAX_NEIS)
-									neis[nneis++] = link->ref;
-							}
-						}
-					}
-				}
-			}
-			else if (curPoly->neis[j])
-			{
-				const unsigned int idx = (unsigned int)(curPoly->neis[j]-1);
-				const dtPolyRef ref = m_nav->getPolyRefBase(curTile) | idx;
-				if (filter->passFilter(ref, curTile, &curTile->polys[idx]))
-				{
-					// Internal edge, encode id.
-					neis[nneis++] = ref;
-				}
-			}
-			
-			if (!nneis)
-			{
-				// Wall edge, calc distance.
-				const float* vj = &verts[j*3];
-				const float* vi = &verts[i*3];
-				float tseg;
-				const float distSqr = dtDistancePtSegSqr2D(endPos, vj, vi, tseg);
-				if (distSqr < bestDist)
-				{
-                    // Update nearest distance.
-					dtVlerp(bestPos, vj,vi, tseg);
-					bestDist = distSqr;
-					bestNode = curNode;
-				}
-			}
-			else
-			{
-				for (int k = 0; k < nneis; ++k)
-				{
-					// Skip if no node can be allocated.
-					dtNode* neighbourNode = m_tinyNodePool->getNode(neis[k]);
-					if (!neighbourNode)
-						continue;
-					// Skip if already visited.
-					if (neighbourNode->flags & DT_NODE_CLOSED)
-						continue;
-					
-					// Skip the link if it is too far from search constraint.
-					// TODO: Maybe should use getPortalPoints(), but this one is way faster.
-					const float* vj = &verts[j*3];
-					const float* vi = &verts[i*3];
-					float tseg;
-					float distSqr = dtDistancePtSegSqr2D(searchPos, vj, vi, tseg);
-					if (distSqr > searchRadSqr)
-						continue;
-					
-					// Mark as the node as visited and push to queue.
-					if (nstack < MAX_STACK)
-					{
-						neighbourNode->pidx = m_tinyNodePool->getNodeIdx(curNode);
-						neighbourNode->flags |= DT_NODE_CLOSED;
-						stack[nstack++] = neighbourNode;
-					}
-				}
-			}
-		}
-	}
-	
-	int n = 0;
-	if (bestNode)
-	{
-		// Reverse the path.
-		dtNode* prev = 0;
-		dtNode* node = bestNode;
-		do
-		{
-			dtNode* next = m_tinyNodePool->getNodeAtIdx(node->pidx);
-			node->pidx = m_tinyNodePool->getNodeIdx(prev);
-			prev = node;
-			node = next;
-		}
-		while (node);
-		
-		// Store result
-		node = prev;
-		do
-		{
-			visited[n++] = node->id;
-			if (n >= maxVisitedSize)
-			{
-				status |= DT_BUFFER_TOO_SMALL;
-				break;
-			}
-			node = m_tinyNodePool->getNodeAtIdx(node->pidx);
-		}
-		while (node);
-	}
-	
-	dtVcopy(resultPos, bestPos);
-	
-	*visitedCount = n;
-	
-	return status;
+	return moveAlongSurface<dtQueryFilter>(startRef, startPos, endPos, filter,
+										   resultPos, visited, visitedCount, maxVisitedSize);
 }
 
 
@@ -2525,218 +2668,7 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 								 const dtQueryFilter* filter, const unsigned int options,
 								 dtRaycastHit* hit, dtPolyRef prevRef) const
 {
-	dtAssert(m_nav);
-	
-	hit->t = 0;
-	hit->pathCount = 0;
-	hit->pathCost = 0;
-
-	// Validate input
-	if (!startRef || !m_nav->isValidPolyRef(startRef))
-		return DT_FAILURE | DT_INVALID_PARAM;
-	if (prevRef && !m_nav->isValidPolyRef(prevRef))
-		return DT_FAILURE | DT_INVALID_PARAM;
-	
-	float dir[3], curPos[3], lastPos[3];
-	float verts[DT_VERTS_PER_POLYGON*3+3];	
-	int n = 0;
-
-	dtVcopy(curPos, startPos);
-	dtVsub(dir, endPos, startPos);
-	dtVset(hit->hitNormal, 0, 0, 0);
-
-	dtStatus status = DT_SUCCESS;
-
-	const dtMeshTile* prevTile, *tile, *nextTile;
-	const dtPoly* prevPoly, *poly, *nextPoly;
-	dtPolyRef curRef;
-
-	// The API input has been checked already, skip checking internal data.
-	curRef = startRef;
-	tile = 0;
-	poly = 0;
-	m_nav->getTileAndPolyByRefUnsafe(curRef, &tile, &poly);
-	nextTile = prevTile = tile;
-	nextPoly = prevPoly = poly;
-	if (prevRef)
-		m_nav->getTileAndPolyByRefUnsafe(prevRef, &prevTile, &prevPoly);
-
-	while (curRef)
-	{
-		// Cast ray against current polygon.
-		
-		// Collect vertices.
-		int nv = 0;
-		for (int i = 0; i < (int)poly->vertCount; ++i)
-		{
-			dtVcopy(&verts[nv*3], &tile->verts[poly->verts[i]*3]);
-			nv++;
-		}
-		
-		float tmin, tmax;
-		int segMin, segMax;
-		if (!dtIntersectSegmentPoly2D(startPos, endPos, verts, nv, tmin, tmax, segMin, segMax))
-		{
-			// Could not hit the polygon, keep the old t and report hit.
-			hit->pathCount = n;
-			return status;
-		}
-
-		hit->hitEdgeIndex = segMax;
-
-		// Keep track of furthest t so far.
-		if (tmax > hit->t)
-			hit->t = tmax;
-		
-		// Store visited polygons.
-		if (n < hit->maxPath)
-			hit->path[n++] = curRef;
-		else
-			status |= DT_BUFFER_TOO_SMALL;
-
-		// Ray end is completely inside the polygon.
-		if (segMax == -1)
-		{
-			hit->t = FLT_MAX;
-			hit->pathCount = n;
-			
-			// add the cost
-			if (options & DT_RAYCAST_USE_COSTS)
-				hit->pathCost += filter->getCost(curPos, endPos, prevRef, prevTile, prevPoly, curRef, tile, poly, curRef, tile, poly);
-			return status;
-		}
-
-		// Follow neighbours.
-		dtPolyRef nextRef = 0;
-		
-		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
-		{
-			const dtLink* link = &tile->links[i];
-			
-			// Find link which contains this edge.
-			if ((int)link->edge != segMax)
-				continue;
-			
-			// Get pointer to the next polygon.
-			nextTile = 0;
-			nextPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(link->ref, &nextTile, &nextPoly);
-			
-			// Skip off-mesh connections.
-			if (nextPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
-				continue;
-			
-			// Skip links based on filter.
-			if (!filter->passFilter(link->ref, nextTile, nextPoly))
-				continue;
-			
-			// If the link is internal, just return the ref.
-			if (link->side == 0xff)
-			{
-				nextRef = link->ref;
-				break;
-			}
-			
-			// If the link is at tile boundary,
-			
-			// Check if the link spans the whole edge, and accept.
-			if (link->bmin == 0 && link->bmax == 255)
-			{
-				nextRef = link->ref;
-				break;
-			}
-			
-			// Check for partial edge links.
-			const int v0 = poly->verts[link->edge];
-			const int v1 = poly->verts[(link->edge+1) % poly->vertCount];
-			const float* left = &tile->verts[v0*3];
-			const float* right = &tile->verts[v1*3];
-			
-			// Check that the intersection lies inside the link portal.
-			if (link->side == 0 || link->side == 4)
-			{
-				// Calculate link size.
-				const float s = 1.0f/255.0f;
-				float lmin = left[2] + (right[2] - left[2])*(link->bmin*s);
-				float lmax = left[2] + (right[2] - left[2])*(link->bmax*s);
-				if (lmin > lmax) dtSwap(lmin, lmax);
-				
-				// Find Z intersection.
-				float z = startPos[2] + (endPos[2]-startPos[2])*tmax;
-				if (z >= lmin && z <= lmax)
-				{
-					nextRef = link->ref;
-					break;
-				}
-			}
-			else if (link->side == 2 || link->side == 6)
-			{
-				// Calculate link size.
-				const float s = 1.0f/255.0f;
-				float lmin = left[0] + (right[0] - left[0])*(link->bmin*s);
-				float lmax = left[0] + (right[0] - left[0])*(link->bmax*s);
-				if (lmin > lmax) dtSwap(lmin, lmax);
-				
-				// Find X intersection.
-				float x = startPos[0] + (endPos[0]-startPos[0])*tmax;
-				if (x >= lmin && x <= lmax)
-				{
-					nextRef = link->ref;
-					break;
-				}
-			}
-		}
-		
-		// add the cost
-		if (options & DT_RAYCAST_USE_COSTS)
-		{
-			// compute the intersection point at the furthest end of the polygon
-			// and correct the height (since the raycast moves in 2d)
-			dtVcopy(lastPos, curPos);
-			dtVmad(curPos, startPos, dir, hit->t);
-			float* e1 = &verts[segMax*3];
-			float* e2 = &verts[((segMax+1)%nv)*3];
-			float eDir[3], diff[3];
-			dtVsub(eDir, e2, e1);
-			dtVsub(diff, curPos, e1);
-			float s = dtSqr(eDir[0]) > dtSqr(eDir[2]) ? diff[0] / eDir[0] : diff[2] / eDir[2];
-			curPos[1] = e1[1] + eDir[1] * s;
-
-			hit->pathCost += filter->getCost(lastPos, curPos, prevRef, prevTile, prevPoly, curRef, tile, poly, nextRef, nextTile, nextPoly);
-		}
-
-		if (!nextRef)
-		{
-			// No neighbour, we hit a wall.
-			
-			// Calculate hit normal.
-			const int a = segMax;
-			const int b = segMax+1 < nv ? segMax+1 : 0;
-			const float* va = &verts[a*3];
-			const float* vb = &verts[b*3];
-			const float dx = vb[0] - va[0];
-			const float dz = vb[2] - va[2];
-			hit->hitNormal[0] = dz;
-			hit->hitNormal[1] = 0;
-			hit->hitNormal[2] = -dx;
-			dtVnormalize(hit->hitNormal);
-			
-			hit->pathCount = n;
-			return status;
-		}
-
-		// No hit, advance to neighbour polygon.
-		prevRef = curRef;
-		curRef = nextRef;
-		prevTile = tile;
-		tile = nextTile;
-		prevPoly = poly;
-		poly = nextPoly;
-	}
-	
-	hit->pathCount = n;
-	
-	return status;
+	return raycast<dtQueryFilter>(startRef, startPos, endPos, filter, options, hit, prevRef);
 }
 
 /// @par
@@ -2773,6 +2705,8 @@ dtStatus dtNavMeshQuery::findPolysAroundCircle(dtPolyRef startRef, const float*
 											   dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
 											   int* resultCount, const int maxResult) const
 {
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_FIND_POLYS_AROUND);
+
 	dtAssert(m_nav);
 	dtAssert(m_nodePool);
 	dtAssert(m_openList);
@@ -2806,6 +2740,7 @@ dtStatus dtNavMeshQuery::findPolysAroundCircle(dtPolyRef startRef, const float*
 		dtNode* bestNode = m_openList->pop();
 		bestNode->flags &= ~DT_NODE_OPEN;
 		bestNode->flags |= DT_NODE_CLOSED;
+		DT_QUERY_STATS_ADD(nodesExpanded, 1);
 		
 		// Get poly and tile.
 		// The API input has been cheked already, skip checking internal data.
@@ -2870,6 +2805,7 @@ dtStatus dtNavMeshQuery::findPolysAroundCircle(dtPolyRef startRef, const float*
 			if (!neighbourNode)
 			{
 				status |= DT_OUT_OF_NODES;
+				DT_QUERY_STATS_ADD(outOfNodes, 1);
 				continue;
 			}
 				
@@ -2940,6 +2876,8 @@ dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* v
 											  dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
 											  int* resultCount, const int maxResult) const
 {
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_FIND_POLYS_AROUND);
+
 	dtAssert(m_nav);
 	dtAssert(m_nodePool);
 	dtAssert(m_openList);
@@ -2976,6 +2914,7 @@ dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* v
 		dtNode* bestNode = m_openList->pop();
 		bestNode->flags &= ~DT_NODE_OPEN;
 		bestNode->flags |= DT_NODE_CLOSED;
+		DT_QUERY_STATS_ADD(nodesExpanded, 1);
 		
 		// Get poly and tile.
 		// The API input has been cheked already, skip checking internal data.
@@ -3043,6 +2982,7 @@ dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* v
 			if (!neighbourNode)
 			{
 				status |= DT_OUT_OF_NODES;
+				DT_QUERY_STATS_ADD(outOfNodes, 1);
 				continue;
 			}
 			
@@ -3086,6 +3026,233 @@ dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* v
 	return status;
 }
 
+/// @par
+///
+/// Replaces a findPath() call per target when looking for the nearest of many
+/// candidate positions, such as cover points or resources. The search expands the
+/// polygons in the order of their cost from the start, like findPolysAroundCircle(),
+/// and returns the @p maxHits cheapest targets. The targets are reached in the order
+/// of the cost to enter their polygon, and the final leg from the polygon edge to the
+/// target position may make a later target cheaper than an earlier one. The search
+/// therefore goes on until no open polygon is cheaper than the last of the cheapest
+/// targets found so far, and the targets that are reached but not among the cheapest
+/// are returned as not reached. Targets that cost the same as the last of the cheapest
+/// are all returned, so @p hitCount may exceed @p maxHits.
+///
+/// The costs are comparable to the cost of the corridors returned by findPath(). Use
+/// getPathFromDijkstraSearch() with the polygon of a reached target to get its path.
+///
+/// Targets that are invalid or do not pass the filter are never reached. If an island
+/// table is set, the search also stops once every target on the island of the start
+/// polygon has been reached.
+///
+dtStatus dtNavMeshQuery::findCostsToPolys(dtPolyRef startRef, const float* startPos,
+										  const dtPolyRef* targetRefs, const float* targetPos, const int targetCount,
+										  const dtQueryFilter* filter, const int maxHits,
+										  float* resultCost, int* hitCount) const
+{
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_FIND_COSTS);
+
+	if (!hitCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	*hitCount = 0;
+
+	if (!startRef || !m_nav->isValidPolyRef(startRef) || !startPos || !filter ||
+		targetCount < 0 || (targetCount && (!targetRefs || !targetPos || !resultCost)))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	return findCostsToTargets(startRef, startPos, targetRefs, targetPos, targetCount,
+							  filter, maxHits, false, resultCost, hitCount);
+}
+
+/// @par
+///
+/// The counterpart of findCostsToPolys() for finding which of many agents is
+/// closest to a position. The search runs backwards from the end polygon over the
+/// reversed links, so one-way off-mesh connections are respected, and the costs are
+/// those of the paths from each start to the end.
+///
+/// Use getPathFromDijkstraSearch() with the polygon of a reached start to get its
+/// path. The path leads from the start polygon to the end polygon.
+///
+dtStatus dtNavMeshQuery::findCostsFromPolys(const dtPolyRef* startRefs, const float* startPos, const int startCount,
+											dtPolyRef endRef, const float* endPos,
+											const dtQueryFilter* filter, const int maxHits,
+											float* resultCost, int* hitCount) const
+{
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_FIND_COSTS);
+
+	if (!hitCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	*hitCount = 0;
+
+	if (!endRef || !m_nav->isValidPolyRef(endRef) || !endPos || !filter ||
+		startCount < 0 || (startCount && (!startRefs || !startPos || !resultCost)))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	return findCostsToTargets(endRef, endPos, startRefs, startPos, startCount,
+							  filter, maxHits, true, resultCost, hitCount);
+}
+
+dtStatus dtNavMeshQuery::findCostsToTargets(dtPolyRef rootRef, const float* rootPos,
+											const dtPolyRef* targetRefs, const float* targetPos, const int targetCount,
+											const dtQueryFilter* filter, const int maxHits, const bool backward,
+											float* resultCost, int* hitCount) const
+{
+	dtAssert(m_nav);
+	dtAssert(m_nodePool);
+	dtAssert(m_openList);
+
+	m_nodePool->clear();
+	m_openList->clear();
+	m_backOpenList->clear();
+
+	const unsigned char state = backward ? DT_BACKWARD_NODE_STATE : 0;
+	dtNodeQueue* openList = backward ? m_backOpenList : m_openList;
+
+	// Mark the polygons of the targets that can be reached. The search stops early
+	// once there are no more to find.
+	int reachable = 0;
+	for (int i = 0; i < targetCount; ++i)
+	{
+		resultCost[i] = FLT_MAX;
+
+		const dtPolyRef ref = targetRefs[i];
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		if (!ref || dtStatusFailed(m_nav->getTileAndPolyByRef(ref, &tile, &poly)))
+			continue;
+		if (ref != rootRef && !filter->passFilter(ref, tile, poly))
+			continue;
+		if (!(backward ? isIslandConnected(ref, rootRef, filter) : isIslandConnected(rootRef, ref, filter)))
+			continue;
+
+		dtNode* node = m_nodePool->getNode(ref, state);
+		if (!node)
+			return DT_FAILURE | DT_OUT_OF_NODES;
+		node->id = ref;
+		node->flags = DT_NODE_TARGET;
+		reachable++;
+	}
+	const int maxFound = dtMin(reachable, maxHits);
+	if (maxFound <= 0)
+		return DT_SUCCESS;
+
+	// The costs of the cheapest targets found so far, in ascending order.
+	float* bestCosts = (float*)dtAlloc(sizeof(float)*maxFound, DT_ALLOC_TEMP, m_allocator);
+	if (!bestCosts)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	int bestCount = 0;
+
+	dtQueryData query;
+	memset(&query, 0, sizeof(dtQueryData));
+	query.status = DT_SUCCESS;
+	query.filter = filter;
+	query.lastBestNodeCost = FLT_MAX;
+	query.meetCost = FLT_MAX;
+
+	dtNode* rootNode = m_nodePool->getNode(rootRef, state);
+	if (!rootNode)
+		return DT_FAILURE | DT_OUT_OF_NODES;
+	dtVcopy(rootNode->pos, rootPos);
+	rootNode->pidx = 0;
+	rootNode->cost = 0;
+	rootNode->total = 0;
+	rootNode->id = rootRef;
+	rootNode->flags = (rootNode->flags & DT_NODE_TARGET) | DT_NODE_OPEN;
+	openList->push(rootNode);
+
+	int found = 0;
+	while (!openList->empty())
+	{
+		// The final leg only adds to the cost of a target, so once the open polygons
+		// cost as much as the last of the cheapest targets none of them can lead to a
+		// cheaper one.
+		if (bestCount == maxFound && openList->top()->cost >= bestCosts[maxFound-1])
+			break;
+
+		dtNode* bestNode = openList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+		DT_QUERY_STATS_ADD(nodesExpanded, 1);
+
+		if (bestNode->flags & DT_NODE_TARGET)
+		{
+			const dtPolyRef bestRef = bestNode->id;
+			const dtMeshTile* bestTile = 0;
+			const dtPoly* bestPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
+
+			// The parent is the previous polygon of the forward search, and the next one of the backward search.
+			dtPolyRef parentRef = 0;
+			const dtMeshTile* parentTile = 0;
+			const dtPoly* parentPoly = 0;
+			if (bestNode->pidx)
+			{
+				parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
+				m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
+			}
+
+			for (int i = 0; i < targetCount; ++i)
+			{
+				// A reopened polygon keeps the cost of its targets from the first visit.
+				if (targetRefs[i] != bestRef || resultCost[i] != FLT_MAX)
+					continue;
+				const float* pos = &targetPos[i*3];
+				if (backward)
+				{
+					resultCost[i] = bestNode->cost +
+						filter->getCost(pos, bestNode->pos,
+										0, 0, 0,
+										bestRef, bestTile, bestPoly,
+										parentRef, parentTile, parentPoly);
+				}
+				else
+				{
+					resultCost[i] = bestNode->cost +
+						filter->getCost(bestNode->pos, pos,
+										parentRef, parentTile, parentPoly,
+										bestRef, bestTile, bestPoly,
+										0, 0, 0);
+				}
+				found++;
+
+				// Insert the cost into the cheapest ones, dropping the most expensive.
+				if (bestCount < maxFound || resultCost[i] < bestCosts[bestCount-1])
+				{
+					int j = bestCount < maxFound ? bestCount++ : bestCount-1;
+					for (; j > 0 && bestCosts[j-1] > resultCost[i]; --j)
+						bestCosts[j] = bestCosts[j-1];
+					bestCosts[j] = resultCost[i];
+				}
+			}
+			if (found >= reachable)
+				break;
+		}
+
+		if (backward)
+			expandBackward(query, filter, bestNode);
+		else
+			expandForward(query, filter, bestNode);
+	}
+
+	// Return only the cheapest targets.
+	const float maxCost = bestCount == maxFound ? bestCosts[maxFound-1] : FLT_MAX;
+	dtFree(bestCosts, m_allocator);
+	found = 0;
+	for (int i = 0; i < targetCount; ++i)
+	{
+		if (resultCost[i] > maxCost)
+			resultCost[i] = FLT_MAX;
+		else if (resultCost[i] != FLT_MAX)
+			found++;
+	}
+
+	*hitCount = found;
+
+	return DT_SUCCESS | (query.status & DT_STATUS_DETAIL_MASK);
+}
+
 dtStatus dtNavMeshQuery::getPathFromDijkstraSearch(dtPolyRef endRef, dtPolyRef* path, int* pathCount, int maxPath) const
 {
 	if (!m_nav->isValidPolyRef(endRef) || !path || !pathCount || maxPath < 0)
@@ -3098,6 +3265,23 @@ dtStatus dtNavMeshQuery::getPathFromDijkstraSearch(dtPolyRef endRef, dtPolyRef*
 		(endNode->flags & DT_NODE_CLOSED) == 0)
 		return DT_FAILURE | DT_INVALID_PARAM;
 
+	// The nodes of the backward search of findCostsFromPolys() lead on to the end of the search.
+	if (endNode->state == DT_BACKWARD_NODE_STATE)
+	{
+		int n = 0;
+		for (const dtNode* node = endNode; node; node = m_nodePool->getNodeAtIdx(node->pidx))
+		{
+			if (n >= maxPath)
+			{
+				*pathCount = n;
+				return DT_SUCCESS | DT_BUFFER_TOO_SMALL;
+			}
+			path[n++] = node->id;
+		}
+		*pathCount = n;
+		return DT_SUCCESS;
+	}
+
 	return getPathToNode(endNode, path, pathCount, maxPath);
 }
 
@@ -3128,6 +3312,8 @@ dtStatus dtNavMeshQuery::findLocalNeighbourhood(dtPolyRef startRef, const float*
 												dtPolyRef* resultRef, dtPolyRef* resultParent,
 												int* resultCount, const int maxResult) const
 {
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_FIND_LOCAL_NEIGHBOURHOOD);
+
 	dtAssert(m_nav);
 	dtAssert(m_tinyNodePool);
 	
@@ -3176,6 +3362,7 @@ dtStatus dtNavMeshQuery::findLocalNeighbourhood(dtPolyRef startRef, const float*
 		for (int i = 0; i < nstack-1; ++i)
 			stack[i] = stack[i+1];
 		nstack--;
+		DT_QUERY_STATS_ADD(nodesExpanded, 1);
 		
 		// Get poly and tile.
 		// The API input has been cheked already, skip checking internal data.
@@ -3195,7 +3382,10 @@ dtStatus dtNavMeshQuery::findLocalNeighbourhood(dtPolyRef startRef, const float*
 			// Skip if cannot alloca more nodes.
 			dtNode* neighbourNode = m_tinyNodePool->getNode(neighbourRef);
 			if (!neighbourNode)
+			{
+				DT_QUERY_STATS_ADD(outOfNodes, 1);
 				continue;
+			}
 			// Skip visited.
 			if (neighbourNode->flags & DT_NODE_CLOSED)
 				continue;
@@ -3493,6 +3683,8 @@ dtStatus dtNavMeshQuery::findDistanceToWall(dtPolyRef startRef, const float* cen
 											const dtQueryFilter* filter,
 											float* hitDist, float* hitPos, float* hitNormal) const
 {
+	DT_QUERY_STATS_SCOPE(DT_QUERYSTATS_FIND_DISTANCE_TO_WALL);
+
 	dtAssert(m_nav);
 	dtAssert(m_nodePool);
 	dtAssert(m_openList);
@@ -3522,6 +3714,7 @@ dtStatus dtNavMeshQuery::findDistanceToWall(dtPolyRef startRef, const float* cen
 		dtNode* bestNode = m_openList->pop();
 		bestNode->flags &= ~DT_NODE_OPEN;
 		bestNode->flags |= DT_NODE_CLOSED;
+		DT_QUERY_STATS_ADD(nodesExpanded, 1);
 		
 		// Get poly and tile.
 		// The API input has been cheked already, skip checking internal data.
@@ -3626,6 +3819,7 @@ dtStatus dtNavMeshQuery::findDistanceToWall(dtPolyRef startRef, const float* cen
 			if (!neighbourNode)
 			{
 				status |= DT_OUT_OF_NODES;
+				DT_QUERY_STATS_ADD(outOfNodes, 1);
 				continue;
 			}
 			
@@ -23,15 +23,14 @@
 #include <string.h>
 
 #ifdef DT_POLYREF64
-// From Thomas Wang, https://gist.github.com/badboy/6267743
+// The finalizer of MurmurHash3, every bit of the reference affects the low bits used by the tables.
 inline unsigned int dtHashRef(dtPolyRef a)
 {
-	a = (~a) + (a << 18); // a = (a << 18) - a - 1;
-	a = a ^ (a >> 31);
-	a = a * 21; // a = (a + (a << 2)) + (a << 4);
-	a = a ^ (a >> 11);
-	a = a + (a << 6);
-	a = a ^ (a >> 22);
+	a ^= a >> 33;
+	a *= 0xff51afd7ed558ccdULL;
+	a ^= a >> 33;
+	a *= 0xc4ceb9fe1a85ec53ULL;
+	a ^= a >> 33;
 	return (unsigned int)a;
 }
 #else
@@ -47,59 +46,76 @@ inline unsigned int dtHashRef(dtPolyRef a)
 }
 #endif
 
+// The open addressed table is kept at most half full so that probe sequences stay short.
+static int calcNodePoolHashSize(int maxNodes, int hashSize)
+{
+	return (int)dtNextPow2((unsigned int)dtMax(hashSize, maxNodes*2));
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
-dtNodePool::dtNodePool(int maxNodes, int hashSize) :
+dtNodePool::dtNodePool(int maxNodes, int hashSize, dtAllocator* allocator) :
+	m_allocator(allocator),
 	m_nodes(0),
-	m_first(0),
-	m_next(0),
+	m_slots(0),
+	m_stamps(0),
 	m_maxNodes(maxNodes),
-	m_hashSize(hashSize),
+	m_hashSize(calcNodePoolHashSize(maxNodes, hashSize)),
+	m_generation(1),
 	m_nodeCount(0)
 {
-	dtAssert(dtNextPow2(m_hashSize) == (unsigned int)m_hashSize);
+	dtAssert(dtNextPow2(hashSize) == (unsigned int)hashSize);
 	// pidx is special as 0 means "none" and 1 is the first node. For that reason
 	// we have 1 fewer nodes available than the number of values it can contain.
 	dtAssert(m_maxNodes > 0 && m_maxNodes <= DT_NULL_IDX && m_maxNodes <= (1 << DT_NODE_PARENT_BITS) - 1);
 
-	m_nodes = (dtNode*)dtAlloc(sizeof(dtNode)*m_maxNodes, DT_ALLOC_PERM);
-	m_next = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*m_maxNodes, DT_ALLOC_PERM);
-	m_first = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*hashSize, DT_ALLOC_PERM);
+	m_nodes = (dtNode*)dtAlloc(sizeof(dtNode)*m_maxNodes, DT_ALLOC_PERM, m_allocator);
+	m_slots = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*m_hashSize, DT_ALLOC_PERM, m_allocator);
+	m_stamps = (unsigned int*)dtAlloc(sizeof(unsigned int)*m_hashSize, DT_ALLOC_PERM, m_allocator);
 
 	dtAssert(m_nodes);
-	dtAssert(m_next);
-	dtAssert(m_first);
+	dtAssert(m_slots);
+	dtAssert(m_stamps);
 
-	memset(m_first, 0xff, sizeof(dtNodeIndex)*m_hashSize);
-	memset(m_next, 0xff, sizeof(dtNodeIndex)*m_maxNodes);
+	memset(m_slots, 0xff, sizeof(dtNodeIndex)*m_hashSize);
+	memset(m_stamps, 0, sizeof(unsigned int)*m_hashSize);
 }
 
 dtNodePool::~dtNodePool()
 {
-	dtFree(m_nodes);
-	dtFree(m_next);
-	dtFree(m_first);
+	dtFree(m_nodes, m_allocator);
+	dtFree(m_slots, m_allocator);
+	dtFree(m_stamps, m_allocator);
 }
 
 void dtNodePool::clear()
 {
-	memset(m_first, 0xff, sizeof(dtNodeIndex)*m_hashSize);
+	// Advancing the generation invalidates all slots at once.
+	m_generation++;
+	if (m_generation == 0)
+	{
+		// The counter wrapped around, stale stamps could alias the new generation.
+		memset(m_stamps, 0, sizeof(unsigned int)*m_hashSize);
+		m_generation = 1;
+	}
 	m_nodeCount = 0;
 }
 
 unsigned int dtNodePool::findNodes(dtPolyRef id, dtNode** nodes, const int maxNodes)
 {
+	const unsigned int mask = (unsigned int)m_hashSize-1;
 	int n = 0;
-	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
-	while (i != DT_NULL_IDX)
+	unsigned int slot = dtHashRef(id) & mask;
+	// All the states of a polygon hash to the same probe sequence.
+	while (m_stamps[slot] == m_generation)
 	{
-		if (m_nodes[i].id == id)
+		dtNode* node = &m_nodes[m_slots[slot]];
+		if (node->id == id)
 		{
 			if (n >= maxNodes)
 				return n;
-			nodes[n++] = &m_nodes[i];
+			nodes[n++] = node;
 		}
-		i = m_next[i];
+		slot = (slot+1) & mask;
 	}
 
 	return n;
@@ -107,37 +123,38 @@ unsigned int dtNodePool::findNodes(dtPolyRef id, dtNode** nodes, const int maxNo
 
 dtNode* dtNodePool::findNode(dtPolyRef id, unsigned char state)
 {
-	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
-	while (i != DT_NULL_IDX)
+	const unsigned int mask = (unsigned int)m_hashSize-1;
+	unsigned int slot = dtHashRef(id) & mask;
+	while (m_stamps[slot] == m_generation)
 	{
-		if (m_nodes[i].id == id && m_nodes[i].state == state)
-			return &m_nodes[i];
-		i = m_next[i];
+		dtNode* node = &m_nodes[m_slots[slot]];
+		if (node->id == id && node->state == state)
+			return node;
+		slot = (slot+1) & mask;
 	}
 	return 0;
 }
 
 dtNode* dtNodePool::getNode(dtPolyRef id, unsigned char state)
 {
-	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
-	dtNode* node = 0;
-	while (i != DT_NULL_IDX)
+	const unsigned int mask = (unsigned int)m_hashSize-1;
+	unsigned int slot = dtHashRef(id) & mask;
+	while (m_stamps[slot] == m_generation)
 	{
-		if (m_nodes[i].id == id && m_nodes[i].state == state)
-			return &m_nodes[i];
-		i = m_next[i];
+		dtNode* node = &m_nodes[m_slots[slot]];
+		if (node->id == id && node->state == state)
+			return node;
+		slot = (slot+1) & mask;
 	}
 	
 	if (m_nodeCount >= m_maxNodes)
 		return 0;
 	
-	i = (dtNodeIndex)m_nodeCount;
+	const dtNodeIndex i = (dtNodeIndex)m_nodeCount;
 	m_nodeCount++;
 	
 	// Init node
-	node = &m_nodes[i];
+	dtNode* node = &m_nodes[i];
 	node->pidx = 0;
 	node->cost = 0;
 	node->total = 0;
@@ -145,56 +162,209 @@ dtNode* dtNodePool::getNode(dtPolyRef id, unsigned char state)
 	node->state = state;
 	node->flags = 0;
 	
-	m_next[i] = m_first[bucket];
-	m_first[bucket] = i;
+	// The table is never more than half full, so the probe above always ends at a free slot.
+	m_slots[slot] = i;
+	m_stamps[slot] = m_generation;
 	
 	return node;
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-dtNodeQueue::dtNodeQueue(int n) :
+dtNodeQueue::dtNodeQueue(int n, int type, dtAllocator* allocator) :
+	m_allocator(allocator),
 	m_heap(0),
 	m_capacity(n),
-	m_size(0)
+	m_type(type),
+	m_size(0),
+	m_slotKey(0),
+	m_slotNext(0),
+	m_slotPrev(0),
+	m_slotBucket(0),
+	m_slotCount(0),
+	m_freeSlot(-1),
+	m_lastKey(0)
 {
 	dtAssert(m_capacity > 0);
+	dtAssert(m_type == DT_NODE_QUEUE_HEAP || m_type == DT_NODE_QUEUE_RADIX);
 	
-	m_heap = (dtNode**)dtAlloc(sizeof(dtNode*)*(m_capacity+1), DT_ALLOC_PERM);
+	m_heap = (dtNode**)dtAlloc(sizeof(dtNode*)*(m_capacity+1), DT_ALLOC_PERM, m_allocator);
 	dtAssert(m_heap);
+	
+	if (m_type == DT_NODE_QUEUE_RADIX)
+	{
+		m_slotKey = (unsigned int*)dtAlloc(sizeof(unsigned int)*m_capacity, DT_ALLOC_PERM, m_allocator);
+		m_slotNext = (int*)dtAlloc(sizeof(int)*m_capacity, DT_ALLOC_PERM, m_allocator);
+		m_slotPrev = (int*)dtAlloc(sizeof(int)*m_capacity, DT_ALLOC_PERM, m_allocator);
+		m_slotBucket = (unsigned char*)dtAlloc(sizeof(unsigned char)*m_capacity, DT_ALLOC_PERM, m_allocator);
+		dtAssert(m_slotKey);
+		dtAssert(m_slotNext);
+		dtAssert(m_slotPrev);
+		dtAssert(m_slotBucket);
+		radixClear();
+	}
 }
 
 dtNodeQueue::~dtNodeQueue()
 {
-	dtFree(m_heap);
+	dtFree(m_heap, m_allocator);
+	dtFree(m_slotKey, m_allocator);
+	dtFree(m_slotNext, m_allocator);
+	dtFree(m_slotPrev, m_allocator);
+	dtFree(m_slotBucket, m_allocator);
 }
 
 void dtNodeQueue::bubbleUp(int i, dtNode* node)
 {
-	int parent = (i-1)/2;
+	int parent = (i-1)/4;
 	// note: (index > 0) means there is a parent
 	while ((i > 0) && (m_heap[parent]->total > node->total))
 	{
 		m_heap[i] = m_heap[parent];
+		m_heap[i]->qidx = (unsigned int)i;
 		i = parent;
-		parent = (i-1)/2;
+		parent = (i-1)/4;
 	}
 	m_heap[i] = node;
+	node->qidx = (unsigned int)i;
 }
 
 void dtNodeQueue::trickleDown(int i, dtNode* node)
 {
-	int child = (i*2)+1;
+	int child = (i*4)+1;
 	while (child < m_size)
 	{
-		if (((child+1) < m_size) && 
-			(m_heap[child]->total > m_heap[child+1]->total))
+		// Find the smallest of the (up to) four children.
+		const int last = dtMin(child+4, m_size);
+		int best = child;
+		for (int c = child+1; c < last; ++c)
 		{
-			child++;
+			if (m_heap[c]->total < m_heap[best]->total)
+				best = c;
 		}
-		m_heap[i] = m_heap[child];
-		i = child;
-		child = (i*2)+1;
+		if (m_heap[best]->total >= node->total)
+			break;
+		m_heap[i] = m_heap[best];
+		m_heap[i]->qidx = (unsigned int)i;
+		i = best;
+		child = (i*4)+1;
+	}
+	m_heap[i] = node;
+	node->qidx = (unsigned int)i;
+}
+
+// Node totals are non-negative, so their bit patterns sort in the same order as the values.
+inline unsigned int dtRadixKey(const float total)
+{
+	union { float f; unsigned int i; } u;
+	u.f = total > 0.0f ? total : 0.0f;
+	return u.i;
+}
+
+void dtNodeQueue::radixClear()
+{
+	for (int i = 0; i < RADIX_BUCKETS; ++i)
+		m_bucketFirst[i] = -1;
+	m_slotCount = 0;
+	m_freeSlot = -1;
+	m_lastKey = 0;
+}
+
+void dtNodeQueue::radixLink(int slot)
+{
+	// Keys below the last popped key break monotonicity, they are treated as equal to it.
+	const unsigned int key = m_slotKey[slot];
+	const int bucket = key <= m_lastKey ? 0 : (int)dtIlog2(key ^ m_lastKey) + 1;
+	m_slotBucket[slot] = (unsigned char)bucket;
+	m_slotPrev[slot] = -1;
+	m_slotNext[slot] = m_bucketFirst[bucket];
+	if (m_bucketFirst[bucket] != -1)
+		m_slotPrev[m_bucketFirst[bucket]] = slot;
+	m_bucketFirst[bucket] = slot;
+}
+
+void dtNodeQueue::radixUnlink(int slot)
+{
+	const int prev = m_slotPrev[slot];
+	const int next = m_slotNext[slot];
+	if (prev != -1)
+		m_slotNext[prev] = next;
+	else
+		m_bucketFirst[m_slotBucket[slot]] = next;
+	if (next != -1)
+		m_slotPrev[next] = prev;
+}
+
+void dtNodeQueue::radixRedistribute()
+{
+	if (m_bucketFirst[0] != -1)
+		return;
+	
+	int bucket = 1;
+	while (bucket < RADIX_BUCKETS && m_bucketFirst[bucket] == -1)
+		bucket++;
+	if (bucket == RADIX_BUCKETS)
+		return;
+	
+	// The smallest key of the first non-empty bucket becomes the new reference,
+	// all the other keys in the bucket move to strictly lower buckets.
+	unsigned int minKey = 0xffffffff;
+	for (int s = m_bucketFirst[bucket]; s != -1; s = m_slotNext[s])
+		minKey = dtMin(minKey, m_slotKey[s]);
+	m_lastKey = minKey;
+	
+	int s = m_bucketFirst[bucket];
+	m_bucketFirst[bucket] = -1;
+	while (s != -1)
+	{
+		const int next = m_slotNext[s];
+		radixLink(s);
+		s = next;
 	}
-	bubbleUp(i, node);
+}
+
+dtNode* dtNodeQueue::radixTop()
+{
+	radixRedistribute();
+	return m_heap[m_bucketFirst[0]];
+}
+
+dtNode* dtNodeQueue::radixPop()
+{
+	radixRedistribute();
+	const int slot = m_bucketFirst[0];
+	dtNode* node = m_heap[slot];
+	radixUnlink(slot);
+	m_slotNext[slot] = m_freeSlot;
+	m_freeSlot = slot;
+	m_size--;
+	return node;
+}
+
+void dtNodeQueue::radixPush(dtNode* node)
+{
+	int slot;
+	if (m_freeSlot != -1)
+	{
+		slot = m_freeSlot;
+		m_freeSlot = m_slotNext[slot];
+	}
+	else
+	{
+		dtAssert(m_slotCount < m_capacity);
+		slot = m_slotCount++;
+	}
+	m_heap[slot] = node;
+	m_slotKey[slot] = dtRadixKey(node->total);
+	node->qidx = (unsigned int)slot;
+	radixLink(slot);
+	m_size++;
+}
+
+void dtNodeQueue::radixModify(dtNode* node)
+{
+	const int slot = (int)node->qidx;
+	radixUnlink(slot);
+	m_slotKey[slot] = dtRadixKey(node->total);
+	radixLink(slot);
 }
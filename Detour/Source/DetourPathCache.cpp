@@ -0,0 +1,382 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include <new>
+#include "DetourPathCache.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+
+static const int DT_PATH_CACHE_NULL = -1;
+
+dtPathCache* dtAllocPathCache()
+{
+	void* mem = dtAlloc(sizeof(dtPathCache), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtPathCache;
+}
+
+void dtFreePathCache(dtPathCache* cache)
+{
+	if (!cache) return;
+	cache->~dtPathCache();
+	dtFree(cache);
+}
+
+inline unsigned int dtHashPathCacheWord(unsigned int h, unsigned int v)
+{
+	// FNV-1a, a word at a time.
+	h ^= v;
+	h *= 16777619u;
+	return h;
+}
+
+inline unsigned int dtHashPathCacheRef(unsigned int h, dtPolyRef ref)
+{
+	h = dtHashPathCacheWord(h, (unsigned int)ref);
+#ifdef DT_POLYREF64
+	h = dtHashPathCacheWord(h, (unsigned int)(ref >> 32));
+#endif
+	return h;
+}
+
+/// @class dtPathCache
+///
+/// The cache holds a fixed pool of entries, found through a hash table and kept in a doubly
+/// linked list in the order they were last used. When the pool is full, the least recently used
+/// path is replaced.
+///
+/// Each tile counts the changes to its polygon flags, areas and links in dtMeshTile::revision,
+/// and adding or removing a tile also counts as a change in its neighbours. A cached path stores
+/// the revision of the tiles it passes through and is checked against them when it is looked up,
+/// so a change never needs to search the cache. A path is also checked against
+/// dtNavMesh::getTileAddCount() and dtNavMesh::getPolyChangeCount(), as a new tile or a polygon
+/// that became passable or cheaper can shorten paths that do not pass next to it.
+///
+/// The filter settings are stored with each path and compared exactly, the hash only picks the
+/// bucket. A filter derived from dtQueryFilter with state of its own is not told apart from one
+/// with the same flags and area costs.
+///
+/// Only complete paths are cached. Partial results depend on how far the search got, and
+/// would hide the path once the end becomes reachable.
+
+dtPathCache::dtPathCache() :
+	m_nav(0),
+	m_allocator(0),
+	m_entries(0),
+	m_paths(0),
+	m_tiles(0),
+	m_maxPaths(0),
+	m_maxPathSize(0),
+	m_buckets(0),
+	m_bucketMask(0),
+	m_head(DT_PATH_CACHE_NULL),
+	m_tail(DT_PATH_CACHE_NULL),
+	m_freeList(DT_PATH_CACHE_NULL),
+	m_pathCount(0),
+	m_hitCount(0),
+	m_missCount(0),
+	m_invalidationCount(0)
+{
+}
+
+dtPathCache::~dtPathCache()
+{
+	purge();
+}
+
+void dtPathCache::purge()
+{
+	dtFree(m_entries, m_allocator);
+	m_entries = 0;
+	dtFree(m_paths, m_allocator);
+	m_paths = 0;
+	dtFree(m_tiles, m_allocator);
+	m_tiles = 0;
+	dtFree(m_buckets, m_allocator);
+	m_buckets = 0;
+	m_bucketMask = 0;
+	m_maxPaths = 0;
+	m_maxPathSize = 0;
+	m_nav = 0;
+	m_allocator = 0;
+	m_head = m_tail = m_freeList = DT_PATH_CACHE_NULL;
+	m_pathCount = 0;
+}
+
+dtStatus dtPathCache::init(const dtNavMesh* nav, const int maxPaths, const int maxPathSize)
+{
+	purge();
+
+	if (!nav || maxPaths <= 0 || maxPathSize <= 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	m_nav = nav;
+	m_allocator = nav->getAllocator();
+	m_maxPaths = maxPaths;
+	m_maxPathSize = maxPathSize;
+	const int bucketCount = (int)dtNextPow2((unsigned int)maxPaths*2);
+	m_bucketMask = bucketCount-1;
+
+	m_entries = (Entry*)dtAlloc(sizeof(Entry)*maxPaths, DT_ALLOC_PERM, m_allocator);
+	m_paths = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*maxPaths*maxPathSize, DT_ALLOC_PERM, m_allocator);
+	m_tiles = (unsigned int*)dtAlloc(sizeof(unsigned int)*maxPaths*maxPathSize*2, DT_ALLOC_PERM, m_allocator);
+	m_buckets = (int*)dtAlloc(sizeof(int)*bucketCount, DT_ALLOC_PERM, m_allocator);
+	if (!m_entries || !m_paths || !m_tiles || !m_buckets)
+	{
+		purge();
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	clear();
+	m_hitCount = 0;
+	m_missCount = 0;
+	m_invalidationCount = 0;
+
+	return DT_SUCCESS;
+}
+
+void dtPathCache::clear()
+{
+	if (!m_entries)
+		return;
+	memset(m_entries, 0, sizeof(Entry)*m_maxPaths);
+	for (int i = 0; i <= m_bucketMask; ++i)
+		m_buckets[i] = DT_PATH_CACHE_NULL;
+	m_freeList = DT_PATH_CACHE_NULL;
+	for (int i = m_maxPaths-1; i >= 0; --i)
+	{
+		m_entries[i].next = m_freeList;
+		m_freeList = i;
+	}
+	m_head = m_tail = DT_PATH_CACHE_NULL;
+	m_pathCount = 0;
+}
+
+// Copies the settings of the default filter implementation into the key, and returns their hash.
+unsigned int dtPathCache::initFilterKey(const dtQueryFilter* filter, FilterKey& key)
+{
+	key.includeFlags = filter->getIncludeFlags();
+	key.excludeFlags = filter->getExcludeFlags();
+	unsigned int h = 2166136261u;
+	h = dtHashPathCacheWord(h, key.includeFlags);
+	h = dtHashPathCacheWord(h, key.excludeFlags);
+	for (int i = 0; i < DT_MAX_AREAS; ++i)
+	{
+		key.areaCost[i] = filter->getAreaCost(i);
+		unsigned int bits;
+		memcpy(&bits, &key.areaCost[i], sizeof(bits));
+		h = dtHashPathCacheWord(h, bits);
+	}
+	return h;
+}
+
+unsigned int dtPathCache::getBucket(dtPolyRef startRef, dtPolyRef endRef, unsigned int filterHash, unsigned int options) const
+{
+	unsigned int h = filterHash;
+	h = dtHashPathCacheRef(h, startRef);
+	h = dtHashPathCacheRef(h, endRef);
+	h = dtHashPathCacheWord(h, options);
+	return h & (unsigned int)m_bucketMask;
+}
+
+int dtPathCache::findEntry(dtPolyRef startRef, dtPolyRef endRef, const FilterKey& filter, unsigned int filterHash,
+						   unsigned int options) const
+{
+	int i = m_buckets[getBucket(startRef, endRef, filterHash, options)];
+	while (i != DT_PATH_CACHE_NULL)
+	{
+		const Entry& e = m_entries[i];
+		if (e.startRef == startRef && e.endRef == endRef && e.options == options &&
+			memcmp(&e.filter, &filter, sizeof(FilterKey)) == 0)
+			return i;
+		i = e.hashNext;
+	}
+	return DT_PATH_CACHE_NULL;
+}
+
+bool dtPathCache::isEntryValid(const int idx) const
+{
+	const Entry& e = m_entries[idx];
+	if (e.tileAddCount != m_nav->getTileAddCount() || e.polyChangeCount != m_nav->getPolyChangeCount())
+		return false;
+	const unsigned int* tiles = &m_tiles[idx*m_maxPathSize*2];
+	for (int i = 0; i < e.tileCount; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile((int)tiles[i*2]);
+		if (!tile->header || tile->revision != tiles[i*2+1])
+			return false;
+	}
+	return true;
+}
+
+void dtPathCache::unlinkEntry(const int idx)
+{
+	Entry& e = m_entries[idx];
+	if (e.prev != DT_PATH_CACHE_NULL)
+		m_entries[e.prev].next = e.next;
+	else
+		m_head = e.next;
+	if (e.next != DT_PATH_CACHE_NULL)
+		m_entries[e.next].prev = e.prev;
+	else
+		m_tail = e.prev;
+	e.prev = e.next = DT_PATH_CACHE_NULL;
+}
+
+void dtPathCache::pushFront(const int idx)
+{
+	Entry& e = m_entries[idx];
+	e.prev = DT_PATH_CACHE_NULL;
+	e.next = m_head;
+	if (m_head != DT_PATH_CACHE_NULL)
+		m_entries[m_head].prev = idx;
+	m_head = idx;
+	if (m_tail == DT_PATH_CACHE_NULL)
+		m_tail = idx;
+}
+
+void dtPathCache::removeEntry(const int idx)
+{
+	Entry& e = m_entries[idx];
+	dtAssert(e.startRef);
+
+	int* prev = &m_buckets[getBucket(e.startRef, e.endRef, e.filterHash, e.options)];
+	while (*prev != idx)
+	{
+		dtAssert(*prev != DT_PATH_CACHE_NULL);
+		prev = &m_entries[*prev].hashNext;
+	}
+	*prev = e.hashNext;
+
+	unlinkEntry(idx);
+	memset(&e, 0, sizeof(Entry));
+	e.next = m_freeList;
+	m_freeList = idx;
+	m_pathCount--;
+}
+
+int dtPathCache::allocEntry()
+{
+	if (m_freeList == DT_PATH_CACHE_NULL)
+		removeEntry(m_tail);
+	const int idx = m_freeList;
+	m_freeList = m_entries[idx].next;
+	m_pathCount++;
+	return idx;
+}
+
+void dtPathCache::storePath(dtPolyRef startRef, dtPolyRef endRef, const FilterKey& filter, unsigned int filterHash,
+							unsigned int options, const dtPolyRef* path, const int pathCount)
+{
+	const int idx = allocEntry();
+	Entry& e = m_entries[idx];
+	e.startRef = startRef;
+	e.endRef = endRef;
+	e.filter = filter;
+	e.filterHash = filterHash;
+	e.options = options;
+	e.pathCount = pathCount;
+	e.tileCount = 0;
+	e.tileAddCount = m_nav->getTileAddCount();
+	e.polyChangeCount = m_nav->getPolyChangeCount();
+	memcpy(&m_paths[idx*m_maxPathSize], path, sizeof(dtPolyRef)*pathCount);
+
+	// Paths stay within a tile for many polygons, store only where the tile changes.
+	unsigned int* tiles = &m_tiles[idx*m_maxPathSize*2];
+	for (int i = 0; i < pathCount; ++i)
+	{
+		const unsigned int it = m_nav->decodePolyIdTile(path[i]);
+		if (e.tileCount > 0 && tiles[(e.tileCount-1)*2] == it)
+			continue;
+		tiles[e.tileCount*2] = it;
+		tiles[e.tileCount*2+1] = m_nav->getTile((int)it)->revision;
+		e.tileCount++;
+	}
+
+	const unsigned int bucket = getBucket(startRef, endRef, filterHash, options);
+	e.hashNext = m_buckets[bucket];
+	m_buckets[bucket] = idx;
+	pushFront(idx);
+}
+
+/// @par
+///
+/// The result is the same as calling dtNavMeshQuery::findPath directly, as long as the filter
+/// only uses the default implementation's include flags, exclude flags and area costs.
+/// Results that are partial, ran out of nodes, or are longer than the cache's path size are
+/// returned but not cached.
+///
+/// The start and end positions are not part of the key. A cached path is returned for any
+/// positions within the same start and end polygons.
+///
+/// @see dtNavMeshQuery::findPath
+dtStatus dtPathCache::findPath(dtNavMeshQuery* query, dtPolyRef startRef, dtPolyRef endRef,
+							   const float* startPos, const float* endPos,
+							   const dtQueryFilter* filter,
+							   dtPolyRef* path, int* pathCount, const int maxPath,
+							   const unsigned int options)
+{
+	if (!pathCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	*pathCount = 0;
+
+	if (!m_entries || !query || !filter || !path || maxPath <= 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	FilterKey key;
+	const unsigned int filterHash = initFilterKey(filter, key);
+	if (startRef && endRef)
+	{
+		const int idx = findEntry(startRef, endRef, key, filterHash, options);
+		if (idx != DT_PATH_CACHE_NULL)
+		{
+			if (isEntryValid(idx))
+			{
+				const Entry& e = m_entries[idx];
+				const int n = dtMin(e.pathCount, maxPath);
+				memcpy(path, &m_paths[idx*m_maxPathSize], sizeof(dtPolyRef)*n);
+				*pathCount = n;
+				unlinkEntry(idx);
+				pushFront(idx);
+				m_hitCount++;
+				return n < e.pathCount ? (DT_SUCCESS | DT_BUFFER_TOO_SMALL) : DT_SUCCESS;
+			}
+			removeEntry(idx);
+			m_invalidationCount++;
+		}
+	}
+
+	m_missCount++;
+	const dtStatus status = query->findPath(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath, options);
+	if (status == DT_SUCCESS && *pathCount <= m_maxPathSize)
+		storePath(startRef, endRef, key, filterHash, options, path, *pathCount);
+
+	return status;
+}
+
+int dtPathCache::getMemUsed() const
+{
+	return sizeof(*this) +
+		(int)sizeof(Entry)*m_maxPaths +
+		(int)sizeof(dtPolyRef)*m_maxPaths*m_maxPathSize +
+		(int)sizeof(unsigned int)*m_maxPaths*m_maxPathSize*2 +
+		(int)sizeof(int)*(m_bucketMask+1);
+}
@@ -0,0 +1,210 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include "DetourPolyMaskFilter.h"
+#include "DetourAlloc.h"
+#include "DetourTileTracker.h"
+
+/// @class dtPolyMaskFilter
+///
+/// The filter only allocates memory for the tiles that have excluded or scaled polygons: a bit
+/// per polygon for the exclusions and a float per polygon for the cost scales. The masks are
+/// tied to the salt of the tile they were made for, so they stop applying when the tile is
+/// removed, and are reset when a polygon of a new tile in the same slot is changed.
+///
+/// The masks are indexed by tile slot and grow with the tile slots the navigation mesh has
+/// created, so a filter made for a mesh with a large tile limit stays small.
+
+dtPolyMaskFilter::dtPolyMaskFilter() :
+	m_nav(0),
+	m_allocator(0),
+	m_filter(0),
+	m_tiles(0),
+	m_maxTiles(0)
+{
+}
+
+dtPolyMaskFilter::~dtPolyMaskFilter()
+{
+	purge();
+}
+
+void dtPolyMaskFilter::freeTileMask(TileMask& mask)
+{
+	dtFree(mask.excluded, m_allocator);
+	dtFree(mask.costScales, m_allocator);
+	memset(&mask, 0, sizeof(TileMask));
+}
+
+void dtPolyMaskFilter::purge()
+{
+	clearPolys();
+	m_nav = 0;
+	m_allocator = 0;
+	m_filter = 0;
+}
+
+dtStatus dtPolyMaskFilter::init(const dtNavMesh* nav, const dtQueryFilter* filter)
+{
+	purge();
+
+	if (!nav || !filter)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	m_nav = nav;
+	m_allocator = nav->getAllocator();
+	m_filter = filter;
+
+	return DT_SUCCESS;
+}
+
+void dtPolyMaskFilter::clearPolys()
+{
+	for (int i = 0; i < m_maxTiles && m_tiles; ++i)
+		freeTileMask(m_tiles[i]);
+	dtFree(m_tiles, m_allocator);
+	m_tiles = 0;
+	m_maxTiles = 0;
+}
+
+// Returns the mask of the polygon's tile, reset if it was made for an earlier tile in the slot.
+dtPolyMaskFilter::TileMask* dtPolyMaskFilter::getTileMask(dtPolyRef ref, unsigned int& ip)
+{
+	if (!m_nav)
+		return 0;
+	const dtMeshTile* tile = 0;
+	const dtPoly* poly = 0;
+	if (dtStatusFailed(m_nav->getTileAndPolyByRef(ref, &tile, &poly)))
+		return 0;
+	const int it = (int)m_nav->decodePolyIdTile(ref);
+	if (it >= m_maxTiles)
+	{
+		// Grow to the slots the mesh has created, at least doubling to keep growth amortized.
+		const int newCount = dtMax(m_nav->getTileSlotCount(), dtMax(m_maxTiles*2, 16));
+		if (!dtGrowTileArray(m_tiles, m_maxTiles, newCount, m_allocator))
+			return 0;
+		m_maxTiles = newCount;
+	}
+	TileMask& mask = m_tiles[it];
+	if (mask.salt != tile->salt)
+	{
+		freeTileMask(mask);
+		mask.salt = tile->salt;
+		mask.polyCount = tile->header->polyCount;
+	}
+	ip = m_nav->decodePolyIdPoly(ref);
+	return &mask;
+}
+
+const dtPolyMaskFilter::TileMask* dtPolyMaskFilter::findTileMask(dtPolyRef ref, unsigned int& ip) const
+{
+	if (!m_nav || !m_nav->isValidPolyRef(ref))
+		return 0;
+	const unsigned int it = m_nav->decodePolyIdTile(ref);
+	if (it >= (unsigned int)m_maxTiles)
+		return 0;
+	const TileMask& mask = m_tiles[it];
+	if (mask.salt != m_nav->decodePolyIdSalt(ref))
+		return 0;
+	ip = m_nav->decodePolyIdPoly(ref);
+	return &mask;
+}
+
+dtStatus dtPolyMaskFilter::setPolyExcluded(dtPolyRef ref, bool excluded)
+{
+	unsigned int ip = 0;
+	TileMask* mask = getTileMask(ref, ip);
+	if (!mask)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	if (!mask->excluded)
+	{
+		if (!excluded)
+			return DT_SUCCESS;
+		const int nwords = (mask->polyCount + 31) / 32;
+		mask->excluded = (unsigned int*)dtAlloc(sizeof(unsigned int)*nwords, DT_ALLOC_PERM, m_allocator);
+		if (!mask->excluded)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		memset(mask->excluded, 0, sizeof(unsigned int)*nwords);
+	}
+
+	if (excluded)
+		mask->excluded[ip >> 5] |= 1u << (ip & 31);
+	else
+		mask->excluded[ip >> 5] &= ~(1u << (ip & 31));
+
+	return DT_SUCCESS;
+}
+
+bool dtPolyMaskFilter::isPolyExcluded(dtPolyRef ref) const
+{
+	unsigned int ip = 0;
+	const TileMask* mask = findTileMask(ref, ip);
+	if (!mask || !mask->excluded)
+		return false;
+	return (mask->excluded[ip >> 5] & (1u << (ip & 31))) != 0;
+}
+
+dtStatus dtPolyMaskFilter::setPolyCostScale(dtPolyRef ref, float scale)
+{
+	if (!(scale > 0.0f))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	unsigned int ip = 0;
+	TileMask* mask = getTileMask(ref, ip);
+	if (!mask)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	if (!mask->costScales)
+	{
+		if (scale == 1.0f)
+			return DT_SUCCESS;
+		mask->costScales = (float*)dtAlloc(sizeof(float)*mask->polyCount, DT_ALLOC_PERM, m_allocator);
+		if (!mask->costScales)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		for (int i = 0; i < mask->polyCount; ++i)
+			mask->costScales[i] = 1.0f;
+	}
+	mask->costScales[ip] = scale;
+
+	return DT_SUCCESS;
+}
+
+float dtPolyMaskFilter::getPolyCostScale(dtPolyRef ref) const
+{
+	unsigned int ip = 0;
+	const TileMask* mask = findTileMask(ref, ip);
+	if (!mask || !mask->costScales)
+		return 1.0f;
+	return mask->costScales[ip];
+}
+
+int dtPolyMaskFilter::getMemUsed() const
+{
+	int size = sizeof(*this) + (int)sizeof(TileMask)*m_maxTiles;
+	for (int i = 0; i < m_maxTiles && m_tiles; ++i)
+	{
+		const TileMask& mask = m_tiles[i];
+		if (mask.excluded)
+			size += (int)sizeof(unsigned int)*((mask.polyCount + 31) / 32);
+		if (mask.costScales)
+			size += (int)sizeof(float)*mask.polyCount;
+	}
+	return size;
+}
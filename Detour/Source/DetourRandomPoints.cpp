@@ -0,0 +1,281 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include <new>
+#include "DetourRandomPoints.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+
+dtRandomPointTable* dtAllocRandomPointTable()
+{
+	void* mem = dtAlloc(sizeof(dtRandomPointTable), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtRandomPointTable;
+}
+
+void dtFreeRandomPointTable(dtRandomPointTable* table)
+{
+	if (!table) return;
+	table->~dtRandomPointTable();
+	dtFree(table);
+}
+
+// Returns the first index whose running sum is above the value, stepping back over empty
+// entries when the value is at the very end of the sums.
+template<class T>
+static int findSumIndex(const T* sums, const int n, const T value)
+{
+	int lo = 0, hi = n-1;
+	while (lo < hi)
+	{
+		const int mid = (lo + hi) / 2;
+		if (sums[mid] > value)
+			hi = mid;
+		else
+			lo = mid+1;
+	}
+	while (lo > 0 && sums[lo] == sums[lo-1])
+		lo--;
+	return lo;
+}
+
+/// @class dtRandomPointTable
+///
+/// Each tile slot keeps the running sum of its polygon areas, and the table keeps the running
+/// sum of the tile areas over all tile slots. A point picks the tile and then the polygon with a
+/// binary search each, so the cost is O(log(tileSlotCount) + log(polyCount)) with four calls to the
+/// random function. The tile sums are kept in double precision, so large worlds with small
+/// polygons do not lose the small areas.
+///
+/// An update recomputes the areas of the tiles that were added, removed or revised, and the
+/// tile sums, which is a pass over the tile slots.
+
+dtRandomPointTable::dtRandomPointTable() :
+	m_nav(0),
+	m_allocator(0),
+	m_filter(0),
+	m_tiles(0),
+	m_tileSums(0),
+	m_maxTiles(0),
+	m_tileCapacity(0)
+{
+}
+
+dtRandomPointTable::~dtRandomPointTable()
+{
+	purge();
+}
+
+void dtRandomPointTable::purge()
+{
+	for (int i = 0; i < m_maxTiles && m_tiles; ++i)
+		dtFree(m_tiles[i].areaSums, m_allocator);
+	dtFree(m_tiles, m_allocator);
+	m_tiles = 0;
+	dtFree(m_tileSums, m_allocator);
+	m_tileSums = 0;
+	m_maxTiles = 0;
+	m_tileCapacity = 0;
+	m_tracker.purge();
+	m_nav = 0;
+	m_allocator = 0;
+	m_filter = 0;
+}
+
+dtStatus dtRandomPointTable::computeTile(const int tileIdx)
+{
+	const dtMeshTile* tile = m_nav->getTile(tileIdx);
+	TileData& data = m_tiles[tileIdx];
+	dtFree(data.areaSums, m_allocator);
+	memset(&data, 0, sizeof(TileData));
+	if (!tile->header)
+		return DT_SUCCESS;
+
+	const int npolys = tile->header->polyCount;
+	data.areaSums = (float*)dtAlloc(sizeof(float)*dtMax(npolys, 1), DT_ALLOC_PERM, m_allocator);
+	if (!data.areaSums)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	data.salt = tile->salt;
+	data.polyCount = npolys;
+
+	const dtPolyRef base = m_nav->getPolyRefBase(tile);
+	float sum = 0.0f;
+	for (int i = 0; i < npolys; ++i)
+	{
+		const dtPoly* p = &tile->polys[i];
+		// Do not return off-mesh connection polygons.
+		if (p->getType() == DT_POLYTYPE_GROUND && m_filter->passFilter(base | (dtPolyRef)i, tile, p))
+		{
+			const float* va = &tile->verts[p->verts[0]*3];
+			for (int j = 2; j < p->vertCount; ++j)
+				sum += dtTriArea2D(va, &tile->verts[p->verts[j-1]*3], &tile->verts[p->verts[j]*3]);
+		}
+		data.areaSums[i] = sum;
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtRandomPointTable::init(const dtNavMesh* nav, const dtQueryFilter* filter)
+{
+	purge();
+
+	if (!nav || !filter)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtStatus status = m_tracker.init(nav);
+	if (dtStatusFailed(status))
+		return status;
+
+	m_nav = nav;
+	m_allocator = nav->getAllocator();
+	m_filter = filter;
+
+	return update();
+}
+
+// Grows the per tile slot arrays to the tile slots the navigation mesh created.
+dtStatus dtRandomPointTable::reserveTiles()
+{
+	const dtStatus status = m_tracker.reserve();
+	if (dtStatusFailed(status))
+		return status;
+	const int capacity = m_tracker.getSlotCapacity();
+	if (capacity > m_tileCapacity)
+	{
+		if (!dtGrowTileArray(m_tiles, m_tileCapacity, capacity, m_allocator) ||
+			!dtGrowTileArray(m_tileSums, m_tileCapacity, capacity, m_allocator))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		m_tileCapacity = capacity;
+	}
+	m_maxTiles = m_tracker.getSlotCount();
+	return DT_SUCCESS;
+}
+
+dtStatus dtRandomPointTable::update()
+{
+	if (!m_nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtStatus status = reserveTiles();
+	if (dtStatusFailed(status))
+	{
+		purge();
+		return status;
+	}
+
+	if (!m_tracker.poll())
+		return DT_SUCCESS;
+
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (!m_tracker.getChanges(i))
+			continue;
+		const dtStatus status = computeTile(i);
+		if (dtStatusFailed(status))
+		{
+			purge();
+			return status;
+		}
+	}
+
+	double sum = 0.0;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const TileData& data = m_tiles[i];
+		if (data.polyCount > 0)
+			sum += data.areaSums[data.polyCount-1];
+		m_tileSums[i] = sum;
+	}
+
+	return DT_SUCCESS;
+}
+
+float dtRandomPointTable::getTotalArea() const
+{
+	return m_maxTiles > 0 ? (float)m_tileSums[m_maxTiles-1] : 0.0f;
+}
+
+/// @par
+///
+/// The point is picked like dtNavMeshQuery::findRandomPoint, except that every part of the
+/// area counted by the table is equally likely.
+///
+/// Fails if the point falls in a tile that was removed or replaced since the last update().
+///
+/// @see dtNavMeshQuery::findRandomPoint
+dtStatus dtRandomPointTable::findRandomPoint(const dtNavMeshQuery* query, float (*frand)(),
+											 dtPolyRef* randomRef, float* randomPt) const
+{
+	if (!m_nav || !query || !frand || !randomRef || !randomPt)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (m_maxTiles <= 0)
+		return DT_FAILURE;
+
+	const double total = m_tileSums[m_maxTiles-1];
+	if (total <= 0.0)
+		return DT_FAILURE;
+
+	// Pick the tile, and the polygon within the tile, weighted by area.
+	const int tileIdx = findSumIndex(m_tileSums, m_maxTiles, (double)frand() * total);
+	const TileData& data = m_tiles[tileIdx];
+	const int polyIdx = findSumIndex(data.areaSums, data.polyCount, frand() * data.areaSums[data.polyCount-1]);
+
+	// The tile may have been removed or replaced since the last update.
+	const dtMeshTile* tile = m_nav->getTile(tileIdx);
+	if (!tile->header || tile->salt != data.salt || polyIdx >= tile->header->polyCount)
+		return DT_FAILURE;
+	const dtPoly* poly = &tile->polys[polyIdx];
+	const dtPolyRef polyRef = m_nav->getPolyRefBase(tile) | (dtPolyRef)polyIdx;
+
+	// Randomly pick point on polygon.
+	float verts[3*DT_VERTS_PER_POLYGON];
+	float areas[DT_VERTS_PER_POLYGON];
+	for (int j = 0; j < poly->vertCount; ++j)
+		dtVcopy(&verts[j*3], &tile->verts[poly->verts[j]*3]);
+
+	const float s = frand();
+	const float t = frand();
+
+	float pt[3];
+	dtRandomPointInConvexPoly(verts, poly->vertCount, areas, s, t, pt);
+
+	float h = 0.0f;
+	dtStatus status = query->getPolyHeight(polyRef, pt, &h);
+	if (dtStatusFailed(status))
+		return status;
+	pt[1] = h;
+
+	dtVcopy(randomPt, pt);
+	*randomRef = polyRef;
+
+	return DT_SUCCESS;
+}
+
+int dtRandomPointTable::getMemUsed() const
+{
+	int size = sizeof(*this) + m_tracker.getMemUsed() + (int)(sizeof(TileData) + sizeof(double))*m_tileCapacity;
+	for (int i = 0; i < m_maxTiles && m_tiles; ++i)
+	{
+		if (m_tiles[i].areaSums)
+			size += (int)sizeof(float)*dtMax(m_tiles[i].polyCount, 1);
+	}
+	return size;
+}
@@ -0,0 +1,784 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <float.h>
+#include <string.h>
+#include <new>
+#include "DetourTileGraph.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+
+static const float DT_TILEGRAPH_INF = FLT_MAX;
+static const unsigned short DT_TILEGRAPH_NO_NODE = 0xffff;
+static const float H_SCALE = 0.999f; // Search heuristic scale.
+
+dtTileGraph* dtAllocTileGraph()
+{
+	void* mem = dtAlloc(sizeof(dtTileGraph), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtTileGraph;
+}
+
+void dtFreeTileGraph(dtTileGraph* graph)
+{
+	if (!graph) return;
+	graph->~dtTileGraph();
+	dtFree(graph);
+}
+
+/// @class dtTileGraph
+///
+/// The cost between two polygons is measured from polygon center to polygon center through
+/// the midpoint of the portal between them, using dtQueryFilter::getCost(). The waypoints
+/// are placed at the centers of the border polygons, so the refined path is close to, but
+/// not necessarily as short as, the path a single dtNavMeshQuery::findPath() call would find
+/// with unlimited nodes. The search assumes the in-tile costs are the same in both directions.
+///
+/// Memory use per tile is quadratic in the number of border polygons of the tile.
+///
+/// @see dtNavMeshQuery
+
+dtTileGraph::dtTileGraph() :
+	m_nav(0),
+	m_allocator(0),
+	m_filter(0),
+	m_tiles(0),
+	m_maxTiles(0),
+	m_tileCapacity(0),
+	m_marks(0),
+	m_stamp(0),
+	m_polyDist(0),
+	m_startDist(0),
+	m_endDist(0),
+	m_polyCapacity(0)
+{
+}
+
+dtTileGraph::~dtTileGraph()
+{
+	purge();
+}
+
+void dtTileGraph::purge()
+{
+	if (m_tiles)
+	{
+		for (int i = 0; i < m_maxTiles; ++i)
+			freeTileData(m_tiles[i]);
+		dtFree(m_tiles, m_allocator);
+	}
+	m_tiles = 0;
+	m_maxTiles = 0;
+	m_tileCapacity = 0;
+	m_tracker.purge();
+	dtFree(m_marks, m_allocator);
+	m_marks = 0;
+	m_heap.purge();
+	dtFree(m_polyDist, m_allocator);
+	dtFree(m_startDist, m_allocator);
+	dtFree(m_endDist, m_allocator);
+	m_polyDist = 0;
+	m_startDist = 0;
+	m_endDist = 0;
+	m_polyCapacity = 0;
+	m_nav = 0;
+	m_allocator = 0;
+	m_filter = 0;
+}
+
+void dtTileGraph::freeTileData(TileData& data)
+{
+	dtFree(data.centers, m_allocator);
+	dtFree(data.polyNode, m_allocator);
+	dtFree(data.nodePoly, m_allocator);
+	dtFree(data.costs, m_allocator);
+	dtFree(data.firstEdge, m_allocator);
+	dtFree(data.edgeRefs, m_allocator);
+	dtFree(data.edgeCosts, m_allocator);
+	dtFree(data.states, m_allocator);
+	memset(&data, 0, sizeof(TileData));
+}
+
+bool dtTileGraph::reservePolys(const int count)
+{
+	if (count <= m_polyCapacity)
+		return true;
+	dtFree(m_polyDist, m_allocator);
+	dtFree(m_startDist, m_allocator);
+	dtFree(m_endDist, m_allocator);
+	m_polyCapacity = dtNextPow2((unsigned int)count);
+	m_polyDist = (float*)dtAlloc(sizeof(float)*m_polyCapacity, DT_ALLOC_PERM, m_allocator);
+	m_startDist = (float*)dtAlloc(sizeof(float)*m_polyCapacity, DT_ALLOC_PERM, m_allocator);
+	m_endDist = (float*)dtAlloc(sizeof(float)*m_polyCapacity, DT_ALLOC_PERM, m_allocator);
+	if (!m_polyDist || !m_startDist || !m_endDist)
+	{
+		m_polyCapacity = 0;
+		return false;
+	}
+	return true;
+}
+
+void dtTileGraph::markNeighbours(const int x, const int y, unsigned char* marks)
+{
+	const dtMeshTile* tiles[DT_MAX_TILE_LAYERS];
+	for (int dy = -1; dy <= 1; ++dy)
+	{
+		for (int dx = -1; dx <= 1; ++dx)
+		{
+			const int n = m_nav->getTilesAt(x+dx, y+dy, tiles, DT_MAX_TILE_LAYERS);
+			for (int i = 0; i < n; ++i)
+				marks[m_nav->decodePolyIdTile(m_nav->getPolyRefBase(tiles[i]))] = 1;
+		}
+	}
+}
+
+// Dijkstra over the polygons of a tile, from the start position in the start polygon to the center
+// of every polygon. The search does not leave the tile.
+dtStatus dtTileGraph::calcTileCosts(const int tileIdx, dtPolyRef startRef, const float* startPos, float* dist)
+{
+	const dtMeshTile* tile = m_nav->getTile(tileIdx);
+	const TileData& data = m_tiles[tileIdx];
+	const dtPolyRef base = m_nav->getPolyRefBase(tile);
+
+	for (int i = 0; i < data.polyCount; ++i)
+		dist[i] = DT_TILEGRAPH_INF;
+
+	const int startIdx = (int)m_nav->decodePolyIdPoly(startRef);
+	dist[startIdx] = 0.0f;
+	m_heap.clear();
+	dtCostHeapItem start;
+	start.total = 0.0f;
+	start.cost = 0.0f;
+	start.tile = tileIdx;
+	start.index = (unsigned int)startIdx;
+	if (!m_heap.push(start))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	while (!m_heap.empty())
+	{
+		const dtCostHeapItem item = m_heap.pop();
+		if (item.cost > dist[item.index])
+			continue;
+
+		const dtPolyRef curRef = base | (dtPolyRef)item.index;
+		const dtPoly* curPoly = &tile->polys[item.index];
+		const float* curPos = (int)item.index == startIdx ? startPos : &data.centers[item.index*3];
+
+		for (unsigned int i = curPoly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			const dtLink* link = &tile->links[i];
+			if (!link->ref || (int)m_nav->decodePolyIdTile(link->ref) != tileIdx)
+				continue;
+			const unsigned int nextIdx = m_nav->decodePolyIdPoly(link->ref);
+			const dtPoly* nextPoly = &tile->polys[nextIdx];
+			if (!m_filter->passFilter(link->ref, tile, nextPoly))
+				continue;
+
+			float mid[3];
+			m_nav->getLinkMidPoint(curRef, tile, curPoly, link, mid);
+			const float cost = item.cost +
+				m_filter->getCost(curPos, mid, 0, 0, 0, curRef, tile, curPoly, link->ref, tile, nextPoly) +
+				m_filter->getCost(mid, &data.centers[nextIdx*3], curRef, tile, curPoly, link->ref, tile, nextPoly, 0, 0, 0);
+			if (cost < dist[nextIdx])
+			{
+				dist[nextIdx] = cost;
+				dtCostHeapItem next;
+				next.total = cost;
+				next.cost = cost;
+				next.tile = tileIdx;
+				next.index = (unsigned int)nextIdx;
+				if (!m_heap.push(next))
+					return DT_FAILURE | DT_OUT_OF_MEMORY;
+			}
+		}
+	}
+	return DT_SUCCESS;
+}
+
+dtStatus dtTileGraph::buildTile(const int tileIdx)
+{
+	TileData& data = m_tiles[tileIdx];
+	freeTileData(data);
+
+	const dtMeshTile* tile = m_nav->getTile(tileIdx);
+	if (!tile->header)
+		return DT_SUCCESS;
+
+	const int npolys = tile->header->polyCount;
+	const dtPolyRef base = m_nav->getPolyRefBase(tile);
+	if (!reservePolys(npolys))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	data.salt = tile->salt;
+	data.x = tile->header->x;
+	data.y = tile->header->y;
+	data.polyCount = npolys;
+	data.centers = (float*)dtAlloc(sizeof(float)*3*dtMax(npolys, 1), DT_ALLOC_PERM, m_allocator);
+	data.polyNode = (unsigned short*)dtAlloc(sizeof(unsigned short)*dtMax(npolys, 1), DT_ALLOC_PERM, m_allocator);
+	if (!data.centers || !data.polyNode)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	for (int i = 0; i < npolys; ++i)
+	{
+		const dtPoly* poly = &tile->polys[i];
+		float* c = &data.centers[i*3];
+		dtVset(c, 0, 0, 0);
+		for (int j = 0; j < (int)poly->vertCount; ++j)
+			dtVadd(c, c, &tile->verts[poly->verts[j]*3]);
+		dtVscale(c, c, 1.0f / (float)dtMax((int)poly->vertCount, 1));
+		data.polyNode[i] = DT_TILEGRAPH_NO_NODE;
+	}
+
+	// Border polygons link to another tile, or are linked from one.
+	int nedges = 0;
+	for (int i = 0; i < npolys; ++i)
+	{
+		const dtPoly* poly = &tile->polys[i];
+		for (unsigned int j = poly->firstLink; j != DT_NULL_LINK; j = tile->links[j].next)
+		{
+			const dtPolyRef ref = tile->links[j].ref;
+			if (ref && (int)m_nav->decodePolyIdTile(ref) != tileIdx)
+			{
+				data.polyNode[i] = 0;
+				nedges++;
+			}
+		}
+	}
+	const dtMeshTile* neis[DT_MAX_TILE_LAYERS];
+	for (int dy = -1; dy <= 1; ++dy)
+	{
+		for (int dx = -1; dx <= 1; ++dx)
+		{
+			const int nneis = m_nav->getTilesAt(data.x+dx, data.y+dy, neis, DT_MAX_TILE_LAYERS);
+			for (int n = 0; n < nneis; ++n)
+			{
+				const dtMeshTile* nei = neis[n];
+				if (nei == tile)
+					continue;
+				for (int j = 0; j < nei->header->maxLinkCount; ++j)
+				{
+					const dtPolyRef ref = nei->links[j].ref;
+					if (ref && (int)m_nav->decodePolyIdTile(ref) == tileIdx && m_nav->decodePolyIdSalt(ref) == tile->salt)
+						data.polyNode[m_nav->decodePolyIdPoly(ref)] = 0;
+				}
+			}
+		}
+	}
+
+	int nnodes = 0;
+	for (int i = 0; i < npolys; ++i)
+	{
+		if (data.polyNode[i] != DT_TILEGRAPH_NO_NODE && m_filter->passFilter(base | (dtPolyRef)i, tile, &tile->polys[i]))
+			data.polyNode[i] = (unsigned short)nnodes++;
+		else
+			data.polyNode[i] = DT_TILEGRAPH_NO_NODE;
+	}
+
+	data.nodeCount = nnodes;
+	data.nodePoly = (unsigned short*)dtAlloc(sizeof(unsigned short)*dtMax(nnodes, 1), DT_ALLOC_PERM, m_allocator);
+	data.costs = (float*)dtAlloc(sizeof(float)*dtMax(nnodes*nnodes, 1), DT_ALLOC_PERM, m_allocator);
+	data.firstEdge = (int*)dtAlloc(sizeof(int)*(nnodes+1), DT_ALLOC_PERM, m_allocator);
+	data.edgeRefs = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*dtMax(nedges, 1), DT_ALLOC_PERM, m_allocator);
+	data.edgeCosts = (float*)dtAlloc(sizeof(float)*dtMax(nedges, 1), DT_ALLOC_PERM, m_allocator);
+	data.states = (NodeState*)dtAlloc(sizeof(NodeState)*dtMax(nnodes, 1), DT_ALLOC_PERM, m_allocator);
+	if (!data.nodePoly || !data.costs || !data.firstEdge || !data.edgeRefs || !data.edgeCosts || !data.states)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(data.states, 0, sizeof(NodeState)*dtMax(nnodes, 1));
+
+	for (int i = 0; i < npolys; ++i)
+	{
+		if (data.polyNode[i] != DT_TILEGRAPH_NO_NODE)
+			data.nodePoly[data.polyNode[i]] = (unsigned short)i;
+	}
+
+	// Edges leaving the tile.
+	data.edgeCount = 0;
+	for (int i = 0; i < nnodes; ++i)
+	{
+		data.firstEdge[i] = data.edgeCount;
+		const int ip = data.nodePoly[i];
+		const dtPolyRef curRef = base | (dtPolyRef)ip;
+		const dtPoly* curPoly = &tile->polys[ip];
+		for (unsigned int j = curPoly->firstLink; j != DT_NULL_LINK; j = tile->links[j].next)
+		{
+			const dtLink* link = &tile->links[j];
+			if (!link->ref || (int)m_nav->decodePolyIdTile(link->ref) == tileIdx)
+				continue;
+			const dtMeshTile* nextTile = 0;
+			const dtPoly* nextPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(link->ref, &nextTile, &nextPoly);
+			if (!m_filter->passFilter(link->ref, nextTile, nextPoly))
+				continue;
+
+			// The center of the polygon in the other tile, the tile may not be built yet.
+			float nextCenter[3];
+			dtVset(nextCenter, 0, 0, 0);
+			for (int k = 0; k < (int)nextPoly->vertCount; ++k)
+				dtVadd(nextCenter, nextCenter, &nextTile->verts[nextPoly->verts[k]*3]);
+			dtVscale(nextCenter, nextCenter, 1.0f / (float)dtMax((int)nextPoly->vertCount, 1));
+
+			float mid[3];
+			m_nav->getLinkMidPoint(curRef, tile, curPoly, link, mid);
+			data.edgeRefs[data.edgeCount] = link->ref;
+			data.edgeCosts[data.edgeCount] =
+				m_filter->getCost(&data.centers[ip*3], mid, 0, 0, 0, curRef, tile, curPoly, link->ref, nextTile, nextPoly) +
+				m_filter->getCost(mid, nextCenter, curRef, tile, curPoly, link->ref, nextTile, nextPoly, 0, 0, 0);
+			data.edgeCount++;
+		}
+	}
+	data.firstEdge[nnodes] = data.edgeCount;
+
+	// Costs between the nodes within the tile.
+	for (int i = 0; i < nnodes; ++i)
+	{
+		const int ip = data.nodePoly[i];
+		const dtStatus status = calcTileCosts(tileIdx, base | (dtPolyRef)ip, &data.centers[ip*3], m_polyDist);
+		if (dtStatusFailed(status))
+			return status;
+		for (int j = 0; j < nnodes; ++j)
+			data.costs[i*nnodes+j] = m_polyDist[data.nodePoly[j]];
+	}
+
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// The cost of building the graph is one search over the polygons of a tile per border polygon.
+dtStatus dtTileGraph::init(const dtNavMesh* nav, const dtQueryFilter* filter)
+{
+	purge();
+
+	if (!nav || !filter)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	dtStatus status = m_tracker.init(nav);
+	if (dtStatusFailed(status))
+		return status;
+
+	m_nav = nav;
+	m_allocator = nav->getAllocator();
+	m_heap.setAllocator(m_allocator);
+	m_filter = filter;
+	status = reserveTiles();
+	if (dtStatusFailed(status))
+	{
+		purge();
+		return status;
+	}
+
+	m_tracker.poll();
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		status = buildTile(i);
+		if (dtStatusFailed(status))
+		{
+			purge();
+			return status;
+		}
+	}
+
+	return DT_SUCCESS;
+}
+
+// Grows the per tile slot arrays to the tile slots the navigation mesh created.
+dtStatus dtTileGraph::reserveTiles()
+{
+	const dtStatus status = m_tracker.reserve();
+	if (dtStatusFailed(status))
+		return status;
+	const int capacity = m_tracker.getSlotCapacity();
+	if (capacity > m_tileCapacity)
+	{
+		if (!dtGrowTileArray(m_tiles, m_tileCapacity, capacity, m_allocator) ||
+			!dtGrowTileArray(m_marks, m_tileCapacity, capacity, m_allocator))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		m_tileCapacity = capacity;
+	}
+	m_maxTiles = m_tracker.getSlotCount();
+	return DT_SUCCESS;
+}
+
+dtStatus dtTileGraph::update()
+{
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtStatus status = reserveTiles();
+	if (dtStatusFailed(status))
+	{
+		purge();
+		return status;
+	}
+
+	if (!m_tracker.poll())
+		return DT_SUCCESS;
+
+	memset(m_marks, 0, sizeof(unsigned char)*m_maxTiles);
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const unsigned char changes = m_tracker.getChanges(i);
+		if (!(changes & (DT_TILE_REMOVED | DT_TILE_ADDED)))
+			continue;
+		// The links of the neighbours changed too.
+		m_marks[i] = 1;
+		if (changes & DT_TILE_REMOVED)
+			markNeighbours(m_tiles[i].x, m_tiles[i].y, m_marks);
+		if (changes & DT_TILE_ADDED)
+		{
+			const dtMeshTile* tile = m_nav->getTile(i);
+			markNeighbours(tile->header->x, tile->header->y, m_marks);
+		}
+	}
+
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (!m_marks[i])
+			continue;
+		const dtStatus status = buildTile(i);
+		if (dtStatusFailed(status))
+		{
+			purge();
+			return status;
+		}
+	}
+
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// If the start and end polygons are in the same tile and connected within it, the only waypoint is
+/// the end polygon. Otherwise the waypoints are the border polygons the path passes through. If the
+/// end cannot be reached, the waypoints lead to the node closest to the end, and the status
+/// includes #DT_PARTIAL_RESULT.
+dtStatus dtTileGraph::findWaypoints(dtPolyRef startRef, dtPolyRef endRef,
+									const float* startPos, const float* endPos,
+									dtPolyRef* refs, float* pos, int* count, const int maxCount)
+{
+	if (count)
+		*count = 0;
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!m_nav->isValidPolyRef(startRef) || !m_nav->isValidPolyRef(endRef) ||
+		!startPos || !endPos || !refs || !pos || !count || maxCount <= 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const int startTile = (int)m_nav->decodePolyIdTile(startRef);
+	const int endTile = (int)m_nav->decodePolyIdTile(endRef);
+	if (startTile >= m_maxTiles || endTile >= m_maxTiles)
+		return DT_FAILURE | DT_INVALID_PARAM;	// The graph is out of date.
+	const TileData& startData = m_tiles[startTile];
+	const TileData& endData = m_tiles[endTile];
+	if (startData.salt != m_nav->decodePolyIdSalt(startRef) || endData.salt != m_nav->decodePolyIdSalt(endRef))
+		return DT_FAILURE | DT_INVALID_PARAM;	// The graph is out of date.
+
+	if (!reservePolys(dtMax(startData.polyCount, endData.polyCount)))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	dtStatus status = calcTileCosts(startTile, startRef, startPos, m_startDist);
+	if (dtStatusFailed(status))
+		return status;
+	const unsigned int endIdx = m_nav->decodePolyIdPoly(endRef);
+	if (startTile == endTile && m_startDist[endIdx] < DT_TILEGRAPH_INF)
+	{
+		refs[0] = endRef;
+		dtVcopy(pos, endPos);
+		*count = 1;
+		return DT_SUCCESS;
+	}
+	status = calcTileCosts(endTile, endRef, endPos, m_endDist);
+	if (dtStatusFailed(status))
+		return status;
+
+	m_stamp++;
+	if (m_stamp == 0)
+	{
+		// Wrapped around, make sure no stale state matches.
+		for (int i = 0; i < m_maxTiles; ++i)
+		{
+			TileData& data = m_tiles[i];
+			if (data.states)
+				memset(data.states, 0, sizeof(NodeState)*data.nodeCount);
+		}
+		m_stamp = 1;
+	}
+
+	// Seed the search with the border polygons reachable from the start.
+	m_heap.clear();
+	for (int i = 0; i < startData.nodeCount; ++i)
+	{
+		const float cost = m_startDist[startData.nodePoly[i]];
+		if (cost >= DT_TILEGRAPH_INF)
+			continue;
+		NodeState& state = startData.states[i];
+		state.cost = cost;
+		state.stamp = m_stamp;
+		state.parentTile = -1;
+		state.parentNode = 0;
+		dtCostHeapItem item;
+		item.cost = cost;
+		item.total = cost + dtVdist(&startData.centers[startData.nodePoly[i]*3], endPos)*H_SCALE;
+		item.tile = startTile;
+		item.index = (unsigned int)i;
+		if (!m_heap.push(item))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	int bestTile = -1;
+	unsigned short bestNode = 0;
+	float bestDist = DT_TILEGRAPH_INF;
+	bool found = false;
+
+	while (!m_heap.empty())
+	{
+		const dtCostHeapItem item = m_heap.pop();
+		if (item.tile < 0)
+		{
+			// Reached the end through the node stored in the item.
+			bestTile = endTile;
+			bestNode = (unsigned short)item.index;
+			found = true;
+			break;
+		}
+
+		const TileData& data = m_tiles[item.tile];
+		const NodeState& state = data.states[item.index];
+		if (item.cost > state.cost)
+			continue;
+
+		const int ip = data.nodePoly[item.index];
+		const float dist = dtVdist(&data.centers[ip*3], endPos);
+		if (dist < bestDist)
+		{
+			bestDist = dist;
+			bestTile = item.tile;
+			bestNode = (unsigned short)item.index;
+		}
+
+		if (item.tile == endTile && m_endDist[ip] < DT_TILEGRAPH_INF)
+		{
+			dtCostHeapItem goal;
+			goal.cost = item.cost + m_endDist[ip];
+			goal.total = goal.cost;
+			goal.tile = -1;
+			goal.index = item.index;
+			if (!m_heap.push(goal))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+
+		// Other nodes in the same tile.
+		for (int j = 0; j < data.nodeCount; ++j)
+		{
+			const float edgeCost = data.costs[item.index*data.nodeCount+j];
+			if (j == (int)item.index || edgeCost >= DT_TILEGRAPH_INF)
+				continue;
+			const float cost = item.cost + edgeCost;
+			NodeState& next = data.states[j];
+			if (next.stamp == m_stamp && cost >= next.cost)
+				continue;
+			next.cost = cost;
+			next.stamp = m_stamp;
+			next.parentTile = item.tile;
+			next.parentNode = (unsigned short)item.index;
+			dtCostHeapItem nextItem;
+			nextItem.cost = cost;
+			nextItem.total = cost + dtVdist(&data.centers[data.nodePoly[j]*3], endPos)*H_SCALE;
+			nextItem.tile = item.tile;
+			nextItem.index = (unsigned int)j;
+			if (!m_heap.push(nextItem))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+
+		// Nodes in the neighbour tiles.
+		for (int j = data.firstEdge[item.index]; j < data.firstEdge[item.index+1]; ++j)
+		{
+			const dtPolyRef ref = data.edgeRefs[j];
+			const int nextTile = (int)m_nav->decodePolyIdTile(ref);
+			const TileData& nextData = m_tiles[nextTile];
+			if (nextData.salt != m_nav->decodePolyIdSalt(ref))
+				continue;
+			const int nextPoly = (int)m_nav->decodePolyIdPoly(ref);
+			const unsigned short nextNode = nextData.polyNode[nextPoly];
+			if (nextNode == DT_TILEGRAPH_NO_NODE)
+				continue;
+			const float cost = item.cost + data.edgeCosts[j];
+			NodeState& next = nextData.states[nextNode];
+			if (next.stamp == m_stamp && cost >= next.cost)
+				continue;
+			next.cost = cost;
+			next.stamp = m_stamp;
+			next.parentTile = item.tile;
+			next.parentNode = (unsigned short)item.index;
+			dtCostHeapItem nextItem;
+			nextItem.cost = cost;
+			nextItem.total = cost + dtVdist(&nextData.centers[nextPoly*3], endPos)*H_SCALE;
+			nextItem.tile = nextTile;
+			nextItem.index = nextNode;
+			if (!m_heap.push(nextItem))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+	}
+
+	if (bestTile < 0)
+	{
+		// No border polygon is reachable, stay in the start polygon.
+		refs[0] = startRef;
+		dtVcopy(pos, startPos);
+		*count = 1;
+		return DT_SUCCESS | DT_PARTIAL_RESULT;
+	}
+
+	// Count the nodes on the path, then store them in order.
+	int n = found ? 1 : 0;
+	for (int t = bestTile, i = bestNode; t >= 0; )
+	{
+		const NodeState& state = m_tiles[t].states[i];
+		n++;
+		i = state.parentNode;
+		t = state.parentTile;
+	}
+
+	status = DT_SUCCESS;
+	if (n > maxCount)
+		status |= DT_BUFFER_TOO_SMALL;
+	if (!found)
+		status |= DT_PARTIAL_RESULT;
+
+	int idx = n-1;
+	if (found)
+	{
+		if (idx < maxCount)
+		{
+			refs[idx] = endRef;
+			dtVcopy(&pos[idx*3], endPos);
+		}
+		idx--;
+	}
+	for (int t = bestTile, i = bestNode; t >= 0; idx--)
+	{
+		const TileData& data = m_tiles[t];
+		if (idx < maxCount)
+		{
+			refs[idx] = m_nav->getPolyRefBase(m_nav->getTile(t)) | (dtPolyRef)data.nodePoly[i];
+			dtVcopy(&pos[idx*3], &data.centers[data.nodePoly[i]*3]);
+		}
+		const NodeState& state = data.states[i];
+		i = state.parentNode;
+		t = state.parentTile;
+	}
+
+	*count = dtMin(n, maxCount);
+	return status;
+}
+
+/// @par
+///
+/// The legs between the waypoints are found with dtNavMeshQuery::findPath() using the filter of
+/// the graph. The query only needs enough nodes for a leg, which spans about a tile. If a leg cannot
+/// be completed, the path ends where the leg ended and the status includes #DT_PARTIAL_RESULT.
+dtStatus dtTileGraph::findPath(const dtNavMeshQuery* query, dtPolyRef startRef, dtPolyRef endRef,
+							   const float* startPos, const float* endPos,
+							   dtPolyRef* path, int* pathCount, const int maxPath)
+{
+	if (pathCount)
+		*pathCount = 0;
+	if (!query || !path || !pathCount || maxPath <= 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	static const int MAX_WAYPOINTS = 256;
+	dtPolyRef refs[MAX_WAYPOINTS];
+	float pos[MAX_WAYPOINTS*3];
+	int nrefs = 0;
+	dtStatus status = findWaypoints(startRef, endRef, startPos, endPos, refs, pos, &nrefs, MAX_WAYPOINTS);
+	if (dtStatusFailed(status))
+		return status;
+	if (dtStatusDetail(status, DT_BUFFER_TOO_SMALL))
+	{
+		// Not enough room for all the waypoints, follow them as far as they go.
+		status &= ~DT_BUFFER_TOO_SMALL;
+		status |= DT_PARTIAL_RESULT;
+	}
+
+	path[0] = startRef;
+	int n = 1;
+	dtPolyRef curRef = startRef;
+	const float* curPos = startPos;
+	for (int i = 0; i < nrefs; ++i)
+	{
+		if (refs[i] == curRef)
+			continue;
+		if (n >= maxPath)
+		{
+			status |= DT_BUFFER_TOO_SMALL;
+			break;
+		}
+
+		// The leg starts with the current polygon, which is already in the path.
+		int nleg = 0;
+		const dtStatus legStatus = query->findPath(curRef, refs[i], curPos, &pos[i*3], m_filter,
+												   &path[n-1], &nleg, maxPath-(n-1));
+		if (dtStatusFailed(legStatus))
+			return legStatus;
+		n += dtMax(nleg-1, 0);
+		if (dtStatusDetail(legStatus, DT_BUFFER_TOO_SMALL))
+		{
+			status |= DT_BUFFER_TOO_SMALL;
+			break;
+		}
+		if (dtStatusDetail(legStatus, DT_PARTIAL_RESULT))
+		{
+			status |= DT_PARTIAL_RESULT;
+			break;
+		}
+		curRef = refs[i];
+		curPos = &pos[i*3];
+	}
+
+	*pathCount = n;
+	return status;
+}
+
+int dtTileGraph::getNodeCount() const
+{
+	int n = 0;
+	for (int i = 0; i < m_maxTiles && m_tiles; ++i)
+		n += m_tiles[i].nodeCount;
+	return n;
+}
+
+int dtTileGraph::getMemUsed() const
+{
+	int size = sizeof(*this) + m_tracker.getMemUsed() +
+		(int)sizeof(TileData)*m_tileCapacity +
+		(int)sizeof(unsigned char)*m_tileCapacity +
+		m_heap.getMemUsed() +
+		(int)sizeof(float)*m_polyCapacity*3;
+	for (int i = 0; i < m_maxTiles && m_tiles; ++i)
+	{
+		const TileData& data = m_tiles[i];
+		if (!data.salt)
+			continue;
+		size += data.polyCount*(int)(sizeof(float)*3 + sizeof(unsigned short));
+		size += data.nodeCount*(int)(sizeof(unsigned short) + sizeof(int) + sizeof(NodeState));
+		size += data.nodeCount*data.nodeCount*(int)sizeof(float);
+		size += data.edgeCount*(int)(sizeof(dtPolyRef) + sizeof(float));
+	}
+	return size;
+}
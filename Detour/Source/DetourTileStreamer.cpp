@@ -0,0 +1,584 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <float.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include "DetourTileStreamer.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourCommon.h"
+#include "DetourMath.h"
+#include "DetourAlloc.h"
+
+int dtGetTileArchiveIndexSize(const dtTileArchiveHeader* header)
+{
+	return (int)(sizeof(dtTileArchiveHeader) + sizeof(dtTileArchiveEntry)*header->tileCount);
+}
+
+/// @par
+///
+/// The tiles are stored in the order of their tile slots, each aligned to 4 bytes. Quantized
+/// tiles are about 40% smaller, which saves reading time, but have to be decoded when loaded.
+///
+/// @see dtTileStreamer
+dtStatus dtCreateTileArchive(const dtNavMesh* nav, const bool quantize, unsigned char** outData, int* outDataSize)
+{
+	if (!nav || !outData || !outDataSize)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	*outData = 0;
+	*outDataSize = 0;
+
+	int tileCount = 0;
+	for (int i = 0; i < nav->getTileSlotCount(); ++i)
+	{
+		if (nav->getTile(i)->header)
+			tileCount++;
+	}
+
+	dtTileArchiveHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = DT_TILE_ARCHIVE_MAGIC;
+	header.version = DT_TILE_ARCHIVE_VERSION;
+	header.tileCount = tileCount;
+	memcpy(&header.params, nav->getParams(), sizeof(dtNavMeshParams));
+	const int indexSize = dtGetTileArchiveIndexSize(&header);
+
+	// Store the tiles first to know the size of the archive.
+	unsigned char** stored = (unsigned char**)dtAlloc(sizeof(unsigned char*)*(tileCount+1), DT_ALLOC_TEMP);
+	int* storedSizes = (int*)dtAlloc(sizeof(int)*(tileCount+1), DT_ALLOC_TEMP);
+	if (!stored || !storedSizes)
+	{
+		dtFree(stored);
+		dtFree(storedSizes);
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memset(stored, 0, sizeof(unsigned char*)*(tileCount+1));
+
+	dtStatus status = DT_SUCCESS;
+	int dataSize = indexSize;
+	int n = 0;
+	for (int i = 0; i < nav->getTileSlotCount() && dtStatusSucceed(status); ++i)
+	{
+		const dtMeshTile* tile = nav->getTile(i);
+		if (!tile->header)
+			continue;
+		if (quantize)
+		{
+			if (!dtQuantizeNavMeshData(tile->data, tile->dataSize, &stored[n], &storedSizes[n]))
+				status = DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+		else
+		{
+			storedSizes[n] = tile->dataSize;
+		}
+		dataSize += dtAlign4(storedSizes[n]);
+		n++;
+	}
+
+	unsigned char* data = 0;
+	if (dtStatusSucceed(status))
+	{
+		data = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_PERM);
+		if (!data)
+			status = DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	if (dtStatusSucceed(status))
+	{
+		memset(data, 0, dataSize);
+		memcpy(data, &header, sizeof(header));
+		dtTileArchiveEntry* entries = (dtTileArchiveEntry*)(data + sizeof(dtTileArchiveHeader));
+		int offset = indexSize;
+		n = 0;
+		for (int i = 0; i < nav->getTileSlotCount(); ++i)
+		{
+			const dtMeshTile* tile = nav->getTile(i);
+			if (!tile->header)
+				continue;
+			dtTileArchiveEntry& entry = entries[n];
+			entry.x = tile->header->x;
+			entry.y = tile->header->y;
+			entry.layer = tile->header->layer;
+			entry.flags = quantize ? DT_TILE_ARCHIVE_QUANTIZED : 0;
+			entry.offset = offset;
+			entry.dataSize = storedSizes[n];
+			entry.tileSize = tile->dataSize;
+			memcpy(data + offset, quantize ? stored[n] : tile->data, storedSizes[n]);
+			offset += dtAlign4(storedSizes[n]);
+			n++;
+		}
+		*outData = data;
+		*outDataSize = dataSize;
+	}
+
+	for (int i = 0; i < tileCount; ++i)
+		dtFree(stored[i]);
+	dtFree(stored);
+	dtFree(storedSizes);
+
+	return status;
+}
+
+dtTileStreamer* dtAllocTileStreamer()
+{
+	void* mem = dtAlloc(sizeof(dtTileStreamer), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtTileStreamer;
+}
+
+void dtFreeTileStreamer(dtTileStreamer* streamer)
+{
+	if (!streamer) return;
+	streamer->~dtTileStreamer();
+	dtFree(streamer);
+}
+
+/// @class dtTileStreamer
+///
+/// The streamer keeps the index of the archive sorted by tile location, so the tiles around a
+/// focus point are found with a binary search per tile column. Each update ranks the tiles by
+/// their distance to the closest focus point: tiles outside every radius are removed from the
+/// navigation mesh, and the missing tiles are loaded closest first.
+///
+/// The resident size counts the loaded tiles and the tiles being loaded, so jobs are not started
+/// past the memory budget. The read budget limits the stored bytes requested per update, to
+/// spread the IO of a teleport over several updates.
+///
+/// Removing a tile invalidates the polygon references into it. Paths kept by the caller can be
+/// checked with checkPath().
+
+dtTileStreamer::dtTileStreamer() :
+	m_nav(0),
+	m_reader(0),
+	m_tiles(0),
+	m_candidates(0),
+	m_tileCount(0),
+	m_focus(0),
+	m_jobs(0),
+	m_jobCount(0),
+	m_loadedCount(0),
+	m_residentSize(0)
+{
+	memset(&m_params, 0, sizeof(m_params));
+}
+
+dtTileStreamer::~dtTileStreamer()
+{
+	purge();
+}
+
+void dtTileStreamer::purge()
+{
+	for (int i = 0; i < m_params.maxJobs && m_jobs; ++i)
+	{
+		if (m_jobs[i].used)
+			dtFree(m_jobs[i].job.data, m_nav->getAllocator());
+	}
+	dtFree(m_tiles);
+	dtFree(m_candidates);
+	dtFree(m_focus);
+	dtFree(m_jobs);
+	m_tiles = 0;
+	m_candidates = 0;
+	m_tileCount = 0;
+	m_focus = 0;
+	m_jobs = 0;
+	m_jobCount = 0;
+	m_loadedCount = 0;
+	m_residentSize = 0;
+	m_nav = 0;
+	m_reader = 0;
+	memset(&m_params, 0, sizeof(m_params));
+}
+
+static int compareTiles(const dtTileArchiveEntry& a, const dtTileArchiveEntry& b)
+{
+	if (a.x != b.x) return a.x < b.x ? -1 : 1;
+	if (a.y != b.y) return a.y < b.y ? -1 : 1;
+	if (a.layer != b.layer) return a.layer < b.layer ? -1 : 1;
+	return 0;
+}
+
+static int compareTileLocations(const void* va, const void* vb)
+{
+	return compareTiles(*(const dtTileArchiveEntry*)va, *(const dtTileArchiveEntry*)vb);
+}
+
+static int compareCandidates(const void* va, const void* vb)
+{
+	const float a = *(const float*)va;
+	const float b = *(const float*)vb;
+	if (a < b) return -1;
+	if (a > b) return 1;
+	return 0;
+}
+
+dtStatus dtTileStreamer::init(dtNavMesh* nav, const unsigned char* index, const int indexSize,
+							  dtTileArchiveReader* reader, const dtTileStreamerParams* params)
+{
+	purge();
+
+	if (!nav || !index || !reader || !params || indexSize < (int)sizeof(dtTileArchiveHeader) ||
+		params->maxFocus <= 0 || params->maxJobs <= 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtTileArchiveHeader* header = (const dtTileArchiveHeader*)index;
+	if (header->magic != DT_TILE_ARCHIVE_MAGIC)
+		return DT_FAILURE | DT_WRONG_MAGIC;
+	if (header->version != DT_TILE_ARCHIVE_VERSION)
+		return DT_FAILURE | DT_WRONG_VERSION;
+	if (header->tileCount < 0 || indexSize < dtGetTileArchiveIndexSize(header))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	// The tiles must land where they were stored from.
+	const dtNavMeshParams* navParams = nav->getParams();
+	if (!dtVequal(navParams->orig, header->params.orig) ||
+		navParams->tileWidth != header->params.tileWidth || navParams->tileHeight != header->params.tileHeight)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	m_tileCount = header->tileCount;
+	m_tiles = (Tile*)dtAlloc(sizeof(Tile)*(m_tileCount+1), DT_ALLOC_PERM);
+	m_candidates = (Candidate*)dtAlloc(sizeof(Candidate)*(m_tileCount+1), DT_ALLOC_PERM);
+	m_focus = (Focus*)dtAlloc(sizeof(Focus)*params->maxFocus, DT_ALLOC_PERM);
+	m_jobs = (JobSlot*)dtAlloc(sizeof(JobSlot)*params->maxJobs, DT_ALLOC_PERM);
+	if (!m_tiles || !m_candidates || !m_focus || !m_jobs)
+	{
+		purge();
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memset(m_tiles, 0, sizeof(Tile)*(m_tileCount+1));
+	memset(m_focus, 0, sizeof(Focus)*params->maxFocus);
+	memset(m_jobs, 0, sizeof(JobSlot)*params->maxJobs);
+
+	const dtTileArchiveEntry* entries = (const dtTileArchiveEntry*)(index + sizeof(dtTileArchiveHeader));
+	for (int i = 0; i < m_tileCount; ++i)
+	{
+		const dtTileArchiveEntry& entry = entries[i];
+		if (entry.offset < 0 || entry.dataSize <= 0 || entry.tileSize <= 0)
+		{
+			purge();
+			return DT_FAILURE | DT_INVALID_PARAM;
+		}
+		m_tiles[i].entry = entry;
+		m_tiles[i].priority = FLT_MAX;
+		m_tiles[i].state = TILE_UNLOADED;
+	}
+	// The entry is the first member of the tile.
+	qsort(m_tiles, m_tileCount, sizeof(Tile), compareTileLocations);
+
+	m_nav = nav;
+	m_reader = reader;
+	memcpy(&m_params, params, sizeof(dtTileStreamerParams));
+
+	return DT_SUCCESS;
+}
+
+int dtTileStreamer::addFocus(const float* pos, const float radius)
+{
+	for (int i = 0; i < m_params.maxFocus; ++i)
+	{
+		if (m_focus[i].used)
+			continue;
+		m_focus[i].used = true;
+		setFocus(i, pos, radius);
+		return i;
+	}
+	return -1;
+}
+
+void dtTileStreamer::setFocus(const int id, const float* pos, const float radius)
+{
+	if (id < 0 || id >= m_params.maxFocus || !m_focus[id].used)
+		return;
+	dtVcopy(m_focus[id].pos, pos);
+	m_focus[id].radius = radius;
+}
+
+void dtTileStreamer::removeFocus(const int id)
+{
+	if (id < 0 || id >= m_params.maxFocus)
+		return;
+	m_focus[id].used = false;
+}
+
+// Returns the index of the first tile at the location, or -1 if there is none.
+int dtTileStreamer::findFirstTile(const int x, const int y) const
+{
+	dtTileArchiveEntry key;
+	key.x = x;
+	key.y = y;
+	key.layer = INT_MIN;
+	int lo = 0, hi = m_tileCount;
+	while (lo < hi)
+	{
+		const int mid = (lo + hi) / 2;
+		if (compareTiles(m_tiles[mid].entry, key) < 0)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	if (lo < m_tileCount && m_tiles[lo].entry.x == x && m_tiles[lo].entry.y == y)
+		return lo;
+	return -1;
+}
+
+void dtTileStreamer::prioritizeTiles()
+{
+	for (int i = 0; i < m_tileCount; ++i)
+		m_tiles[i].priority = FLT_MAX;
+
+	const dtNavMeshParams* params = m_nav->getParams();
+	for (int i = 0; i < m_params.maxFocus; ++i)
+	{
+		const Focus& focus = m_focus[i];
+		if (!focus.used)
+			continue;
+		const float r = focus.radius;
+		const int minx = (int)dtMathFloorf((focus.pos[0] - r - params->orig[0]) / params->tileWidth);
+		const int maxx = (int)dtMathFloorf((focus.pos[0] + r - params->orig[0]) / params->tileWidth);
+		const int miny = (int)dtMathFloorf((focus.pos[2] - r - params->orig[2]) / params->tileHeight);
+		const int maxy = (int)dtMathFloorf((focus.pos[2] + r - params->orig[2]) / params->tileHeight);
+		for (int x = minx; x <= maxx; ++x)
+		{
+			for (int y = miny; y <= maxy; ++y)
+			{
+				int first = findFirstTile(x, y);
+				if (first < 0)
+					continue;
+				// Squared distance from the focus point to the tile rectangle.
+				const float bx = params->orig[0] + x*params->tileWidth;
+				const float bz = params->orig[2] + y*params->tileHeight;
+				const float dx = dtMax(0.0f, dtMax(bx - focus.pos[0], focus.pos[0] - (bx + params->tileWidth)));
+				const float dz = dtMax(0.0f, dtMax(bz - focus.pos[2], focus.pos[2] - (bz + params->tileHeight)));
+				const float d = dx*dx + dz*dz;
+				if (d > r*r)
+					continue;
+				for (int j = first; j < m_tileCount && m_tiles[j].entry.x == x && m_tiles[j].entry.y == y; ++j)
+					m_tiles[j].priority = dtMin(m_tiles[j].priority, d);
+			}
+		}
+	}
+}
+
+void dtTileStreamer::unloadTile(Tile& tile)
+{
+	// The tile may have been removed by the caller already.
+	if (m_nav->getTileByRef(tile.ref))
+		m_nav->removeTile(tile.ref, 0, 0);
+	tile.ref = 0;
+	tile.state = TILE_UNLOADED;
+	m_residentSize -= tile.entry.tileSize;
+	m_loadedCount--;
+}
+
+/// @par
+///
+/// Returns #DT_SUCCESS | #DT_OUT_OF_MEMORY if the tiles needed by the focus points do not fit in
+/// the resident size. The closest tiles are loaded.
+dtStatus dtTileStreamer::update()
+{
+	if (!m_tiles)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	prioritizeTiles();
+
+	int ncandidates = 0;
+	for (int i = 0; i < m_tileCount; ++i)
+	{
+		Tile& tile = m_tiles[i];
+		if (tile.state == TILE_LOADED && (tile.priority == FLT_MAX || !m_nav->getTileByRef(tile.ref)))
+			unloadTile(tile);
+		if (tile.state == TILE_UNLOADED && tile.priority != FLT_MAX)
+		{
+			m_candidates[ncandidates].priority = tile.priority;
+			m_candidates[ncandidates].tile = i;
+			ncandidates++;
+		}
+	}
+	qsort(m_candidates, ncandidates, sizeof(Candidate), compareCandidates);
+
+	dtStatus status = DT_SUCCESS;
+	int readSize = 0;
+	int slot = 0;
+	for (int i = 0; i < ncandidates && m_jobCount < m_params.maxJobs; ++i)
+	{
+		Tile& tile = m_tiles[m_candidates[i].tile];
+		if (m_residentSize + tile.entry.tileSize > m_params.maxResidentSize)
+		{
+			status |= DT_OUT_OF_MEMORY;
+			break;
+		}
+		if (readSize > 0 && readSize + tile.entry.dataSize > m_params.maxReadSize)
+			break;
+
+		while (m_jobs[slot].used)
+			slot++;
+		JobSlot& job = m_jobs[slot];
+		memset(&job, 0, sizeof(JobSlot));
+		job.used = true;
+		job.job.entry = m_candidates[i].tile;
+		job.job.offset = tile.entry.offset;
+		job.job.dataSize = tile.entry.dataSize;
+		job.job.flags = tile.entry.flags;
+		job.job.status = DT_IN_PROGRESS;
+
+		tile.state = TILE_LOADING;
+		m_residentSize += tile.entry.tileSize;
+		readSize += tile.entry.dataSize;
+		m_jobCount++;
+	}
+
+	return status;
+}
+
+int dtTileStreamer::getJobs(dtTileStreamJob** jobs, const int maxJobs)
+{
+	int n = 0;
+	for (int i = 0; i < m_params.maxJobs && n < maxJobs; ++i)
+	{
+		JobSlot& slot = m_jobs[i];
+		if (!slot.used || slot.handedOut)
+			continue;
+		slot.handedOut = true;
+		jobs[n++] = &slot.job;
+	}
+	return n;
+}
+
+void dtTileStreamer::runJob(dtTileStreamJob* job) const
+{
+	job->data = 0;
+	job->tileSize = 0;
+
+	const bool quantized = (job->flags & DT_TILE_ARCHIVE_QUANTIZED) != 0;
+	dtAllocator* allocator = m_nav->getAllocator();
+	unsigned char* stored = (unsigned char*)dtAlloc(job->dataSize, quantized ? DT_ALLOC_TEMP : DT_ALLOC_PERM, allocator);
+	if (!stored)
+	{
+		job->status = DT_FAILURE | DT_OUT_OF_MEMORY;
+		return;
+	}
+	job->status = m_reader->read(job->offset, job->dataSize, stored);
+	if (dtStatusFailed(job->status))
+	{
+		dtFree(stored, allocator);
+		return;
+	}
+
+	if (quantized)
+	{
+		if (!dtDequantizeNavMeshData(stored, job->dataSize, &job->data, &job->tileSize, allocator))
+			job->status = DT_FAILURE | DT_WRONG_VERSION;
+		dtFree(stored, allocator);
+	}
+	else
+	{
+		job->data = stored;
+		job->tileSize = job->dataSize;
+	}
+}
+
+dtStatus dtTileStreamer::finishJob(dtTileStreamJob* job)
+{
+	if (!m_jobs || job < &m_jobs[0].job || job > &m_jobs[m_params.maxJobs-1].job)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	// The job is the first member of its slot.
+	JobSlot& slot = *(JobSlot*)job;
+	if (!slot.used || !slot.handedOut)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	Tile& tile = m_tiles[job->entry];
+	dtStatus status = job->status;
+	if (dtStatusFailed(status) || !job->data)
+	{
+		// Do not try to load a broken tile again.
+		dtFree(job->data, m_nav->getAllocator());
+		tile.state = TILE_FAILED;
+		m_residentSize -= tile.entry.tileSize;
+		status = DT_FAILURE | (status & DT_STATUS_DETAIL_MASK);
+	}
+	else if (tile.priority == FLT_MAX)
+	{
+		// The focus points moved away while the tile was loading.
+		dtFree(job->data, m_nav->getAllocator());
+		tile.state = TILE_UNLOADED;
+		m_residentSize -= tile.entry.tileSize;
+	}
+	else
+	{
+		status = m_nav->addTile(job->data, job->tileSize, DT_TILE_FREE_DATA, 0, &tile.ref);
+		if (dtStatusFailed(status))
+		{
+			dtFree(job->data, m_nav->getAllocator());
+			tile.state = TILE_FAILED;
+			m_residentSize -= tile.entry.tileSize;
+		}
+		else
+		{
+			tile.state = TILE_LOADED;
+			m_loadedCount++;
+		}
+	}
+
+	job->data = 0;
+	slot.used = false;
+	slot.handedOut = false;
+	m_jobCount--;
+
+	return status;
+}
+
+dtStatus dtTileStreamer::checkPath(const dtPolyRef* path, const int pathCount, const float* endPos) const
+{
+	if (!m_tiles || !path || pathCount < 0 || !endPos)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	for (int i = 0; i < pathCount; ++i)
+	{
+		if (!m_nav->isValidPolyRef(path[i]))
+			return DT_FAILURE | DT_TILE_NOT_LOADED;
+	}
+
+	int tx = 0, ty = 0;
+	m_nav->calcTileLoc(endPos, &tx, &ty);
+	if (findFirstTile(tx, ty) >= 0 && !isTileLoaded(tx, ty))
+		return DT_SUCCESS | DT_TILE_NOT_LOADED;
+
+	return DT_SUCCESS;
+}
+
+bool dtTileStreamer::isTileLoaded(const int x, const int y) const
+{
+	const int first = findFirstTile(x, y);
+	if (first < 0)
+		return false;
+	for (int i = first; i < m_tileCount && m_tiles[i].entry.x == x && m_tiles[i].entry.y == y; ++i)
+	{
+		if (m_tiles[i].state == TILE_LOADED)
+			return true;
+	}
+	return false;
+}
+
+int dtTileStreamer::getMemUsed() const
+{
+	return (int)(sizeof(*this) + (sizeof(Tile) + sizeof(Candidate))*m_tileCount +
+				 sizeof(Focus)*m_params.maxFocus + sizeof(JobSlot)*m_params.maxJobs);
+}
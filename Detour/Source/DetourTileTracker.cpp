@@ -0,0 +1,134 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#include <string.h>
+#include "DetourTileTracker.h"
+#include "DetourAlloc.h"
+
+/// @class dtTileTracker
+///
+/// A tile slot that held a tile with a different salt at the last poll reports the old tile
+/// as removed and the new one as added, so a table can drop the data of the old tile before
+/// building the new one. A tile restored with the lastRef of dtNavMesh::addTile keeps the salt,
+/// and is told apart by its header. A tile with the same salt and header but another revision
+/// reports #DT_TILE_REVISED. Adding or removing a tile also revises the neighbours it linked to.
+///
+/// @see dtLandmarkTable, dtTileGraph, dtIslandTable, dtFlowField, dtRandomPointTable
+
+dtTileTracker::dtTileTracker() :
+	m_nav(0),
+	m_allocator(0),
+	m_slots(0),
+	m_slotCount(0),
+	m_slotCapacity(0)
+{
+}
+
+dtTileTracker::~dtTileTracker()
+{
+	purge();
+}
+
+void dtTileTracker::purge()
+{
+	dtFree(m_slots, m_allocator);
+	m_slots = 0;
+	m_slotCount = 0;
+	m_slotCapacity = 0;
+	m_nav = 0;
+	m_allocator = 0;
+}
+
+dtStatus dtTileTracker::init(const dtNavMesh* nav)
+{
+	purge();
+
+	if (!nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	m_nav = nav;
+	m_allocator = nav->getAllocator();
+	const dtStatus status = reserve();
+	if (dtStatusFailed(status))
+		purge();
+	return status;
+}
+
+dtStatus dtTileTracker::reserve()
+{
+	const int count = m_nav->getTileSlotCount();
+	if (count <= m_slotCount && m_slots)
+		return DT_SUCCESS;
+	if (count > m_slotCapacity || !m_slots)
+	{
+		int capacity = dtMax(m_slotCapacity, 16);
+		while (capacity < count)
+			capacity *= 2;
+		if (!dtGrowTileArray(m_slots, m_slotCapacity, capacity, m_allocator))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		m_slotCapacity = capacity;
+	}
+	m_slotCount = count;
+	return DT_SUCCESS;
+}
+
+unsigned char dtTileTracker::findChanges(const int i) const
+{
+	const dtMeshTile* tile = m_nav->getTile(i);
+	const unsigned int salt = tile->header ? tile->salt : 0;
+	if (i >= m_slotCount)
+		return salt ? DT_TILE_ADDED : 0;
+	const Slot& slot = m_slots[i];
+	unsigned char changes = 0;
+	if (slot.salt != salt || slot.header != tile->header)
+	{
+		if (slot.salt)
+			changes |= DT_TILE_REMOVED;
+		if (salt)
+			changes |= DT_TILE_ADDED;
+	}
+	else if (salt && slot.revision != tile->revision)
+	{
+		changes |= DT_TILE_REVISED;
+	}
+	return changes;
+}
+
+bool dtTileTracker::poll()
+{
+	bool changed = false;
+	for (int i = 0; i < m_slotCount; ++i)
+	{
+		Slot& slot = m_slots[i];
+		slot.changes = findChanges(i);
+		if (!slot.changes)
+			continue;
+		const dtMeshTile* tile = m_nav->getTile(i);
+		slot.salt = tile->header ? tile->salt : 0;
+		slot.revision = tile->revision;
+		slot.header = tile->header;
+		changed = true;
+	}
+	return changed;
+}
+
+int dtTileTracker::getMemUsed() const
+{
+	return (int)sizeof(Slot)*m_slotCapacity;
+}
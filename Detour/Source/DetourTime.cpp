@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#include "DetourTime.h"
+
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#else
+#	include <time.h>
+#	include <sys/time.h>
+#endif
+
+#if defined(_WIN32)
+
+static dtTimeVal dtGetTimeDefault()
+{
+	static LARGE_INTEGER freq = { 0 };
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+	LARGE_INTEGER count;
+	QueryPerformanceCounter(&count);
+	// Split the conversion so that large counts do not overflow.
+	const dtTimeVal secs = count.QuadPart / freq.QuadPart;
+	const dtTimeVal rem = count.QuadPart % freq.QuadPart;
+	return secs*1000000 + rem*1000000 / freq.QuadPart;
+}
+
+#elif defined(CLOCK_MONOTONIC)
+
+static dtTimeVal dtGetTimeDefault()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (dtTimeVal)now.tv_sec*1000000 + now.tv_nsec/1000;
+}
+
+#else
+
+static dtTimeVal dtGetTimeDefault()
+{
+	timeval now;
+	gettimeofday(&now, 0);
+	return (dtTimeVal)now.tv_sec*1000000 + now.tv_usec;
+}
+
+#endif
+
+static dtTimeFunc* sTimeFunc = dtGetTimeDefault;
+
+void dtTimeSetCustom(dtTimeFunc* timeFunc)
+{
+	sTimeFunc = timeFunc ? timeFunc : dtGetTimeDefault;
+}
+
+dtTimeVal dtGetTimeUsec()
+{
+	return sTimeFunc();
+}
+
+void dtResetTimeBudgetStats(dtTimeBudgetStats& stats)
+{
+	stats.updates = 0;
+	stats.overruns = 0;
+	stats.iterations = 0;
+	stats.time = 0;
+	stats.maxTime = 0;
+}
+
+void dtAddTimeBudgetUpdate(dtTimeBudgetStats& stats, const int iterations, const dtTimeVal time, const int budget)
+{
+	stats.updates++;
+	if (time > budget)
+		stats.overruns++;
+	stats.iterations += iterations;
+	stats.time += time;
+	if (time > stats.maxTime)
+		stats.maxTime = time;
+}
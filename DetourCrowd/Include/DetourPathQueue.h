@@ -21,6 +21,7 @@
 
 #include "DetourNavMesh.h"
 #include "DetourNavMeshQuery.h"
+#include "DetourTime.h"
 
 static const unsigned int DT_PATHQ_INVALID = 0;
 
@@ -49,8 +50,10 @@ class dtPathQueue
 	int m_maxPathSize;
 	int m_queueHead;
 	dtNavMeshQuery* m_navquery;
+	dtTimeBudgetStats m_stats;
 	
 	void purge();
+	int updateRequests(const int maxIters, const int maxTime, const int checkIters, const dtTimeVal startTime);
 	
 public:
 	dtPathQueue();
@@ -60,6 +63,11 @@ public:
 	
 	void update(const int maxIters);
 	
+	/// Updates the path requests until they are done or the time budget is used.
+	///  @param[in]		maxTime		The time budget of the update. [Units: us] [Limit: >= 0]
+	///  @param[in]		checkIters	The number of search iterations performed between reads of the clock. [Limit: > 0]
+	void updateTimed(const int maxTime, const int checkIters);
+	
 	dtPathQueueRef request(dtPolyRef startRef, dtPolyRef endRef,
 						   const float* startPos, const float* endPos, 
 						   const dtQueryFilter* filter);
@@ -69,6 +77,12 @@ public:
 	dtStatus getPathResult(dtPathQueueRef ref, dtPolyRef* path, int* pathSize, const int maxPath);
 	
 	inline const dtNavMeshQuery* getNavQuery() const { return m_navquery; }
+	
+	/// Returns the statistics of the updateTimed() calls since the last reset.
+	inline const dtTimeBudgetStats& getStats() const { return m_stats; }
+	
+	/// Clears the statistics returned by getStats().
+	inline void resetStats() { dtResetTimeBudgetStats(m_stats); }
 
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
@@ -17,6 +17,7 @@
 //
 
 #include <string.h>
+#include <limits.h>
 #include "DetourPathQueue.h"
 #include "DetourNavMesh.h"
 #include "DetourNavMeshQuery.h"
@@ -32,6 +33,7 @@ dtPathQueue::dtPathQueue() :
 {
 	for (int i = 0; i < MAX_QUEUE; ++i)
 		m_queue[i].path = 0;
+	dtResetTimeBudgetStats(m_stats);
 }
 
 dtPathQueue::~dtPathQueue()
@@ -75,12 +77,35 @@ bool dtPathQueue::init(const int maxPathSize, const int maxSearchNodeCount, dtNa
 }
 
 void dtPathQueue::update(const int maxIters)
+{
+	updateRequests(maxIters, -1, 0, 0);
+}
+
+/// @par
+///
+/// The time spent initializing and finalizing the requests counts against the budget. The
+/// budget can be overrun by the time of @p checkIters search iterations. The updates are
+/// counted by #getStats only, not by the sliced search statistics of the query.
+/// (See: dtNavMeshQuery::getSlicedStats)
+void dtPathQueue::updateTimed(const int maxTime, const int checkIters)
+{
+	if (maxTime < 0 || checkIters <= 0)
+		return;
+	const dtTimeVal startTime = dtGetTimeUsec();
+	const int iters = updateRequests(INT_MAX, maxTime, checkIters, startTime);
+	dtAddTimeBudgetUpdate(m_stats, iters, dtGetTimeUsec() - startTime, maxTime);
+}
+
+// Updates the requests with an iteration budget, and with a time budget too if maxTime >= 0.
+// Returns the number of search iterations performed.
+int dtPathQueue::updateRequests(const int maxIters, const int maxTime, const int checkIters, const dtTimeVal startTime)
 {
 	static const int MAX_KEEP_ALIVE = 2; // in update ticks.
 
 	// Update path request until there is nothing to update
 	// or upto maxIters pathfinder iterations has been consumed.
 	int iterCount = maxIters;
+	bool outOfTime = false;
 	
 	for (int i = 0; i < MAX_QUEUE; ++i)
 	{
@@ -117,19 +142,40 @@ void dtPathQueue::update(const int maxIters)
 		if (dtStatusInProgress(q.status))
 		{
 			int iters = 0;
-			q.status = m_navquery->updateSlicedFindPath(iterCount, &iters);
+			if (maxTime >= 0)
+			{
+				// Slices of checkIters iterations until the budget of the whole update is used.
+				// The budget is tracked here, so the updates are not counted by the sliced
+				// search statistics of the query as well.
+				do
+				{
+					int sliceIters = 0;
+					q.status = m_navquery->updateSlicedFindPath(checkIters, &sliceIters);
+					iters += sliceIters;
+					outOfTime = dtGetTimeUsec() - startTime >= maxTime;
+				}
+				while (dtStatusInProgress(q.status) && !outOfTime);
+			}
+			else
+			{
+				q.status = m_navquery->updateSlicedFindPath(iterCount, &iters);
+			}
 			iterCount -= iters;
 		}
 		if (dtStatusSucceed(q.status))
 		{
 			q.status = m_navquery->finalizeSlicedFindPath(q.path, &q.npath, m_maxPathSize);
 		}
+		if (maxTime >= 0)
+			outOfTime = dtGetTimeUsec() - startTime >= maxTime;
 
-		if (iterCount <= 0)
+		if (iterCount <= 0 || outOfTime)
 			break;
 
 		m_queueHead++;
 	}
+	
+	return maxIters - iterCount;
 }
 
 dtPathQueueRef dtPathQueue::request(dtPolyRef startRef, dtPolyRef endRef,
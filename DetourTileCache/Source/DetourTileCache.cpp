@@ -734,6 +734,7 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 	
 	dtNavMeshCreateParams params;
 	memset(&params, 0, sizeof(params));
+	params.allocator = navmesh->getAllocator();
 	params.verts = bc.lmesh->verts;
 	params.vertCount = bc.lmesh->nverts;
 	params.polys = bc.lmesh->polys;
@@ -66,7 +66,7 @@ public:
 	
 	bool init(const dtNavMesh* nav)
 	{
-		m_ntiles = nav->getMaxTiles();
+		m_ntiles = nav->getTileSlotCount();
 		if (!m_ntiles)
 			return true;
 		m_tiles = (TileFlags*)dtAlloc(sizeof(TileFlags)*m_ntiles, DT_ALLOC_TEMP);
@@ -77,7 +77,7 @@ public:
 		memset(m_tiles, 0, sizeof(TileFlags)*m_ntiles);
 		
 		// Alloc flags for each tile.
-		for (int i = 0; i < nav->getMaxTiles(); ++i)
+		for (int i = 0; i < nav->getTileSlotCount(); ++i)
 		{
 			const dtMeshTile* tile = nav->getTile(i);
 			if (!tile->header) continue;
@@ -169,7 +169,7 @@ static void floodNavmesh(dtNavMesh* nav, NavmeshFlags* flags, dtPolyRef start, u
 
 static void disableUnvisitedPolys(dtNavMesh* nav, NavmeshFlags* flags)
 {
-	for (int i = 0; i < nav->getMaxTiles(); ++i)
+	for (int i = 0; i < nav->getTileSlotCount(); ++i)
 	{
 		const dtMeshTile* tile = ((const dtNavMesh*)nav)->getTile(i);
 		if (!tile->header) continue;
@@ -293,7 +293,7 @@ void NavMeshPruneTool::handleRender()
 	const dtNavMesh* nav = m_sample->getNavMesh();
 	if (m_flags && nav)
 	{
-		for (int i = 0; i < nav->getMaxTiles(); ++i)
+		for (int i = 0; i < nav->getTileSlotCount(); ++i)
 		{
 			const dtMeshTile* tile = nav->getTile(i);
 			if (!tile->header) continue;
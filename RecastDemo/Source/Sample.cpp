@@ -478,7 +478,7 @@ void Sample::saveAll(const char* path, const dtNavMesh* mesh)
 	header.magic = NAVMESHSET_MAGIC;
 	header.version = NAVMESHSET_VERSION;
 	header.numTiles = 0;
-	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	for (int i = 0; i < mesh->getTileSlotCount(); ++i)
 	{
 		const dtMeshTile* tile = mesh->getTile(i);
 		if (!tile || !tile->header || !tile->dataSize) continue;
@@ -488,7 +488,7 @@ void Sample::saveAll(const char* path, const dtNavMesh* mesh)
 	fwrite(&header, sizeof(NavMeshSetHeader), 1, fp);
 
 	// Store tiles.
-	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	for (int i = 0; i < mesh->getTileSlotCount(); ++i)
 	{
 		const dtMeshTile* tile = mesh->getTile(i);
 		if (!tile || !tile->header || !tile->dataSize) continue;
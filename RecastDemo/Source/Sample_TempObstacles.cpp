@@ -1361,7 +1361,7 @@ bool Sample_TempObstacles::handleBuild()
 
 	const dtNavMesh* nav = m_navMesh;
 	int navmeshMemUsage = 0;
-	for (int i = 0; i < nav->getMaxTiles(); ++i)
+	for (int i = 0; i < nav->getTileSlotCount(); ++i)
 	{
 		const dtMeshTile* tile = nav->getTile(i);
 		if (tile->header)
@@ -0,0 +1,507 @@
+#ifndef TESTNAVMESH_H
+#define TESTNAVMESH_H
+
+// Helpers for building tiled navigation meshes out of the RecastDemo test meshes.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Recast.h"
+#include "DetourAlloc.h"
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourNode.h"
+
+#ifndef RECAST_TEST_MESH_DIR
+#define RECAST_TEST_MESH_DIR "../RecastDemo/Meshes"
+#endif
+
+struct TestGeom
+{
+	std::vector<float> verts;
+	std::vector<int> tris;
+	float bmin[3], bmax[3];
+};
+
+/// Build settings matching the defaults of the demo .gset files.
+struct TestBuildSettings
+{
+	TestBuildSettings() :
+		cellSize(0.3f), cellHeight(0.2f),
+		agentHeight(2.0f), agentRadius(0.6f), agentMaxClimb(0.9f), agentMaxSlope(45.0f),
+		regionMinSize(8), regionMergeSize(20),
+		edgeMaxLen(12.0f), edgeMaxError(1.3f),
+		detailSampleDist(6.0f), detailSampleMaxError(1.0f),
+		tileSize(32),
+		tileFlags(DT_TILE_FREE_DATA)
+	{
+	}
+
+	float cellSize, cellHeight;
+	float agentHeight, agentRadius, agentMaxClimb, agentMaxSlope;
+	int regionMinSize, regionMergeSize;
+	float edgeMaxLen, edgeMaxError;
+	float detailSampleDist, detailSampleMaxError;
+	int tileSize;
+	int tileFlags;		///< Flags passed to dtNavMesh::addTile. (See: #dtTileFlags)
+
+	/// Off-mesh connections, stored in the tiles containing their start points.
+	std::vector<float> offMeshVerts;		// [(ax, ay, az, bx, by, bz) * count]
+	std::vector<float> offMeshRads;
+	std::vector<unsigned char> offMeshDirs;
+
+	void addOffMeshConnection(const float* a, const float* b, const float rad, const bool bidir)
+	{
+		offMeshVerts.insert(offMeshVerts.end(), a, a+3);
+		offMeshVerts.insert(offMeshVerts.end(), b, b+3);
+		offMeshRads.push_back(rad);
+		offMeshDirs.push_back(bidir ? DT_OFFMESH_CON_BIDIR : 0);
+	}
+};
+
+/// Loads vertices and (fan triangulated) faces of a Wavefront .obj from the test mesh directory.
+inline bool loadTestGeom(const char* name, TestGeom& geom)
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s", RECAST_TEST_MESH_DIR, name);
+	FILE* fp = fopen(path, "r");
+	if (!fp)
+		return false;
+
+	geom.verts.clear();
+	geom.tris.clear();
+
+	char line[1024];
+	while (fgets(line, sizeof(line), fp))
+	{
+		if (line[0] == 'v' && line[1] == ' ')
+		{
+			float x, y, z;
+			if (sscanf(line+2, "%f %f %f", &x, &y, &z) == 3)
+			{
+				geom.verts.push_back(x);
+				geom.verts.push_back(y);
+				geom.verts.push_back(z);
+			}
+		}
+		else if (line[0] == 'f' && line[1] == ' ')
+		{
+			int face[32];
+			int nface = 0;
+			char* s = line+2;
+			while (*s && nface < 32)
+			{
+				while (*s == ' ' || *s == '\t') s++;
+				if (!*s || *s == '\n' || *s == '\r') break;
+				int vi = atoi(s);
+				const int nv = (int)geom.verts.size()/3;
+				face[nface++] = vi < 0 ? nv + vi : vi - 1;
+				while (*s && *s != ' ' && *s != '\t') s++;
+			}
+			for (int i = 2; i < nface; ++i)
+			{
+				geom.tris.push_back(face[0]);
+				geom.tris.push_back(face[i-1]);
+				geom.tris.push_back(face[i]);
+			}
+		}
+	}
+	fclose(fp);
+
+	if (geom.verts.empty() || geom.tris.empty())
+		return false;
+	rcCalcBounds(&geom.verts[0], (int)geom.verts.size()/3, geom.bmin, geom.bmax);
+	return true;
+}
+
+inline void calcTestTileCount(const TestGeom& geom, const TestBuildSettings& s, int& tw, int& th)
+{
+	int gw = 0, gh = 0;
+	rcCalcGridSize(geom.bmin, geom.bmax, s.cellSize, &gw, &gh);
+	tw = (gw + s.tileSize-1) / s.tileSize;
+	th = (gh + s.tileSize-1) / s.tileSize;
+}
+
+/// Builds the Detour tile data for tile (tx,ty). All polygons get area 0 and flags 1.
+/// Returns null if the tile is empty.
+inline unsigned char* buildTestTile(const TestGeom& geom, const TestBuildSettings& s, const int tx, const int ty, int* dataSize)
+{
+	rcContext ctx(false);
+
+	rcConfig cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.cs = s.cellSize;
+	cfg.ch = s.cellHeight;
+	cfg.walkableSlopeAngle = s.agentMaxSlope;
+	cfg.walkableHeight = (int)ceilf(s.agentHeight / cfg.ch);
+	cfg.walkableClimb = (int)floorf(s.agentMaxClimb / cfg.ch);
+	cfg.walkableRadius = (int)ceilf(s.agentRadius / cfg.cs);
+	cfg.maxEdgeLen = (int)(s.edgeMaxLen / cfg.cs);
+	cfg.maxSimplificationError = s.edgeMaxError;
+	cfg.minRegionArea = s.regionMinSize*s.regionMinSize;
+	cfg.mergeRegionArea = s.regionMergeSize*s.regionMergeSize;
+	cfg.maxVertsPerPoly = DT_VERTS_PER_POLYGON;
+	cfg.tileSize = s.tileSize;
+	cfg.borderSize = cfg.walkableRadius + 3;
+	cfg.width = cfg.tileSize + cfg.borderSize*2;
+	cfg.height = cfg.tileSize + cfg.borderSize*2;
+	cfg.detailSampleDist = cfg.cs * s.detailSampleDist;
+	cfg.detailSampleMaxError = cfg.ch * s.detailSampleMaxError;
+
+	const float tcs = s.tileSize*s.cellSize;
+	cfg.bmin[0] = geom.bmin[0] + tx*tcs - cfg.borderSize*cfg.cs;
+	cfg.bmin[1] = geom.bmin[1];
+	cfg.bmin[2] = geom.bmin[2] + ty*tcs - cfg.borderSize*cfg.cs;
+	cfg.bmax[0] = geom.bmin[0] + (tx+1)*tcs + cfg.borderSize*cfg.cs;
+	cfg.bmax[1] = geom.bmax[1];
+	cfg.bmax[2] = geom.bmin[2] + (ty+1)*tcs + cfg.borderSize*cfg.cs;
+
+	const float* verts = &geom.verts[0];
+	const int nverts = (int)geom.verts.size()/3;
+	const int* tris = &geom.tris[0];
+	const int ntris = (int)geom.tris.size()/3;
+
+	unsigned char* navData = 0;
+	*dataSize = 0;
+
+	rcHeightfield* solid = rcAllocHeightfield();
+	rcCompactHeightfield* chf = 0;
+	rcContourSet* cset = 0;
+	rcPolyMesh* pmesh = 0;
+	rcPolyMeshDetail* dmesh = 0;
+	std::vector<unsigned char> areas(ntris, 0);
+
+	bool ok = rcCreateHeightfield(&ctx, *solid, cfg.width, cfg.height, cfg.bmin, cfg.bmax, cfg.cs, cfg.ch);
+	if (ok)
+	{
+		rcMarkWalkableTriangles(&ctx, cfg.walkableSlopeAngle, verts, nverts, tris, ntris, &areas[0]);
+		ok = rcRasterizeTriangles(&ctx, verts, nverts, tris, &areas[0], ntris, *solid, cfg.walkableClimb);
+	}
+	if (ok)
+	{
+		rcFilterLowHangingWalkableObstacles(&ctx, cfg.walkableClimb, *solid);
+		rcFilterLedgeSpans(&ctx, cfg.walkableHeight, cfg.walkableClimb, *solid);
+		rcFilterWalkableLowHeightSpans(&ctx, cfg.walkableHeight, *solid);
+		chf = rcAllocCompactHeightfield();
+		ok = rcBuildCompactHeightfield(&ctx, cfg.walkableHeight, cfg.walkableClimb, *solid, *chf) &&
+			 rcErodeWalkableArea(&ctx, cfg.walkableRadius, *chf) &&
+			 rcBuildDistanceField(&ctx, *chf) &&
+			 rcBuildRegions(&ctx, *chf, cfg.borderSize, cfg.minRegionArea, cfg.mergeRegionArea);
+	}
+	if (ok)
+	{
+		cset = rcAllocContourSet();
+		ok = rcBuildContours(&ctx, *chf, cfg.maxSimplificationError, cfg.maxEdgeLen, *cset) && cset->nconts > 0;
+	}
+	if (ok)
+	{
+		pmesh = rcAllocPolyMesh();
+		dmesh = rcAllocPolyMeshDetail();
+		ok = rcBuildPolyMesh(&ctx, *cset, cfg.maxVertsPerPoly, *pmesh) &&
+			 rcBuildPolyMeshDetail(&ctx, *pmesh, *chf, cfg.detailSampleDist, cfg.detailSampleMaxError, *dmesh) &&
+			 pmesh->npolys > 0;
+	}
+	if (ok)
+	{
+		for (int i = 0; i < pmesh->npolys; ++i)
+		{
+			pmesh->areas[i] = 0;
+			pmesh->flags[i] = 1;
+		}
+
+		dtNavMeshCreateParams params;
+		memset(&params, 0, sizeof(params));
+		params.verts = pmesh->verts;
+		params.vertCount = pmesh->nverts;
+		params.polys = pmesh->polys;
+		params.polyAreas = pmesh->areas;
+		params.polyFlags = pmesh->flags;
+		params.polyCount = pmesh->npolys;
+		params.nvp = pmesh->nvp;
+		params.detailMeshes = dmesh->meshes;
+		params.detailVerts = dmesh->verts;
+		params.detailVertsCount = dmesh->nverts;
+		params.detailTris = dmesh->tris;
+		params.detailTriCount = dmesh->ntris;
+		params.walkableHeight = s.agentHeight;
+		params.walkableRadius = s.agentRadius;
+		params.walkableClimb = s.agentMaxClimb;
+		params.tileX = tx;
+		params.tileY = ty;
+		params.tileLayer = 0;
+		rcVcopy(params.bmin, pmesh->bmin);
+		rcVcopy(params.bmax, pmesh->bmax);
+		params.cs = cfg.cs;
+		params.ch = cfg.ch;
+		params.buildBvTree = true;
+
+		const int ncons = (int)s.offMeshRads.size();
+		std::vector<unsigned char> conAreas(ncons, 0);
+		std::vector<unsigned short> conFlags(ncons, 1);
+		std::vector<unsigned int> conIds(ncons);
+		for (int i = 0; i < ncons; ++i)
+			conIds[i] = (unsigned int)i;
+		if (ncons > 0)
+		{
+			params.offMeshConVerts = &s.offMeshVerts[0];
+			params.offMeshConRad = &s.offMeshRads[0];
+			params.offMeshConDir = &s.offMeshDirs[0];
+			params.offMeshConAreas = &conAreas[0];
+			params.offMeshConFlags = &conFlags[0];
+			params.offMeshConUserID = &conIds[0];
+			params.offMeshConCount = ncons;
+		}
+
+		if (!dtCreateNavMeshData(&params, &navData, dataSize))
+			navData = 0;
+	}
+
+	rcFreeHeightField(solid);
+	rcFreeCompactHeightfield(chf);
+	rcFreeContourSet(cset);
+	rcFreePolyMesh(pmesh);
+	rcFreePolyMeshDetail(dmesh);
+
+	return navData;
+}
+
+/// Fills navmesh init params for a tiled mesh covering @p geom.
+inline void calcTestNavMeshParams(const TestGeom& geom, const TestBuildSettings& s, dtNavMeshParams& params)
+{
+	int tw = 0, th = 0;
+	calcTestTileCount(geom, s, tw, th);
+	const int tileBits = dtMin((int)dtIlog2(dtNextPow2(tw*th)), 14);
+	const int polyBits = 22 - tileBits;
+
+	memset(&params, 0, sizeof(params));
+	rcVcopy(params.orig, geom.bmin);
+	params.tileWidth = s.tileSize*s.cellSize;
+	params.tileHeight = s.tileSize*s.cellSize;
+	params.maxTiles = 1 << tileBits;
+	params.maxPolys = 1 << polyBits;
+}
+
+/// Builds a tiled navmesh from the given test mesh. Returns null on failure.
+inline dtNavMesh* buildTestNavMesh(const char* name, const TestBuildSettings& s = TestBuildSettings())
+{
+	TestGeom geom;
+	if (!loadTestGeom(name, geom))
+		return 0;
+
+	dtNavMeshParams params;
+	calcTestNavMeshParams(geom, s, params);
+
+	dtNavMesh* nav = dtAllocNavMesh();
+	if (!nav || dtStatusFailed(nav->init(&params)))
+	{
+		dtFreeNavMesh(nav);
+		return 0;
+	}
+
+	int tw = 0, th = 0;
+	calcTestTileCount(geom, s, tw, th);
+	for (int y = 0; y < th; ++y)
+	{
+		for (int x = 0; x < tw; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* data = buildTestTile(geom, s, x, y, &dataSize);
+			if (!data)
+				continue;
+			if (dtStatusFailed(nav->addTile(data, dataSize, s.tileFlags, 0, 0)))
+				dtFree(data);
+		}
+	}
+
+	return nav;
+}
+
+/// The tile data of a test mesh, built once and shared by the sections of a test case,
+/// which would otherwise run Recast over the whole mesh for each section.
+class TestTileCache
+{
+public:
+	TestTileCache() : m_tw(0), m_th(0) { memset(&m_params, 0, sizeof(m_params)); }
+
+	/// Builds the tiles of the test mesh. Returns false on failure.
+	bool build(const char* name, const TestBuildSettings& s)
+	{
+		TestGeom geom;
+		if (!loadTestGeom(name, geom))
+			return false;
+		calcTestNavMeshParams(geom, s, m_params);
+		calcTestTileCount(geom, s, m_tw, m_th);
+		m_tiles.assign(m_tw*m_th, std::vector<unsigned char>());
+		for (int y = 0; y < m_th; ++y)
+		{
+			for (int x = 0; x < m_tw; ++x)
+			{
+				int dataSize = 0;
+				unsigned char* data = buildTestTile(geom, s, x, y, &dataSize);
+				if (!data)
+					continue;
+				m_tiles[x + y*m_tw].assign(data, data + dataSize);
+				dtFree(data);
+			}
+		}
+		return true;
+	}
+
+	bool isBuilt() const { return !m_tiles.empty(); }
+	int getTileCountX() const { return m_tw; }
+	int getTileCountY() const { return m_th; }
+
+	/// Returns a copy of the data of tile (tx,ty), allocated with #dtAlloc, or null if the tile is empty.
+	unsigned char* copyTile(const int tx, const int ty, int* dataSize) const
+	{
+		const std::vector<unsigned char>& tile = m_tiles[tx + ty*m_tw];
+		*dataSize = (int)tile.size();
+		if (tile.empty())
+			return 0;
+		unsigned char* data = (unsigned char*)dtAlloc(tile.size(), DT_ALLOC_PERM);
+		if (data)
+			memcpy(data, &tile[0], tile.size());
+		return data;
+	}
+
+	/// Creates a navmesh owning copies of the tiles, added with #DT_TILE_FREE_DATA and @p flags.
+	/// Returns null on failure.
+	dtNavMesh* createNavMesh(const int flags = 0) const
+	{
+		dtNavMesh* nav = dtAllocNavMesh();
+		if (!nav || dtStatusFailed(nav->init(&m_params)))
+		{
+			dtFreeNavMesh(nav);
+			return 0;
+		}
+		for (int y = 0; y < m_th; ++y)
+		{
+			for (int x = 0; x < m_tw; ++x)
+			{
+				int dataSize = 0;
+				unsigned char* data = copyTile(x, y, &dataSize);
+				if (data && dtStatusFailed(nav->addTile(data, dataSize, DT_TILE_FREE_DATA | flags, 0, 0)))
+					dtFree(data);
+			}
+		}
+		return nav;
+	}
+
+private:
+	dtNavMeshParams m_params;
+	int m_tw, m_th;
+	std::vector<std::vector<unsigned char> > m_tiles;
+};
+
+/// The seed testRandom() starts from.
+static const unsigned int TEST_RANDOM_SEED = 0x3456789;
+
+/// The state of testRandom(), shared by all test files.
+inline unsigned int& testRandomSeed()
+{
+	static unsigned int seed = TEST_RANDOM_SEED;
+	return seed;
+}
+
+/// Restarts the testRandom() sequence, so a test picks the same locations whether it runs
+/// alone or after other tests.
+inline void seedTestRandom(const unsigned int seed = TEST_RANDOM_SEED)
+{
+	testRandomSeed() = seed;
+}
+
+/// Deterministic random number generator for the tests, returns [0..1).
+inline float testRandom()
+{
+	unsigned int& seed = testRandomSeed();
+	seed = seed * 1103515245u + 12345u;
+	return (float)((seed >> 8) & 0xffff) / 65536.0f;
+}
+
+/// Picks @p count random (start, end) locations on the navmesh.
+inline int pickTestPathEnds(const dtNavMeshQuery& query, const dtQueryFilter& filter, const int count,
+							dtPolyRef* refs, float* pos)
+{
+	int n = 0;
+	for (int i = 0; i < count*4 && n < count*2; ++i)
+	{
+		if (dtStatusSucceed(query.findRandomPoint(&filter, testRandom, &refs[n], &pos[n*3])))
+			n++;
+	}
+	return n/2;
+}
+
+/// Returns the cost of the last path found by the query, or a negative value if the end was not reached.
+inline float getTestPathCost(const dtNavMeshQuery& query, dtPolyRef endRef)
+{
+	dtNode* nodes[DT_MAX_STATES_PER_NODE];
+	const int n = (int)query.getNodePool()->findNodes(endRef, nodes, DT_MAX_STATES_PER_NODE);
+	float cost = -1.0f;
+	for (int i = 0; i < n; ++i)
+	{
+		if (cost < 0.0f || nodes[i]->total < cost)
+			cost = nodes[i]->total;
+	}
+	return cost;
+}
+
+/// Returns true if every polygon of the path links to the next one.
+inline bool isTestPathConnected(const dtNavMesh& nav, const dtPolyRef* path, const int npath)
+{
+	for (int i = 0; i+1 < npath; ++i)
+	{
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		if (dtStatusFailed(nav.getTileAndPolyByRef(path[i], &tile, &poly)))
+			return false;
+		bool linked = false;
+		for (unsigned int j = poly->firstLink; j != DT_NULL_LINK && !linked; j = tile->links[j].next)
+			linked = tile->links[j].ref == path[i+1];
+		if (!linked)
+			return false;
+	}
+	return true;
+}
+
+/// Adds up to @p maxCount off-mesh connections between random locations of the navmesh the
+/// settings build, every other one one-way. Their ends must be in neighbouring tiles to get linked.
+/// Returns the number of connections added.
+inline int addTestOffMeshConnections(const char* name, TestBuildSettings& settings, const int maxCount)
+{
+	static const int MAX_CANDIDATES = 1000;
+	dtNavMesh* nav = buildTestNavMesh(name, settings);
+	if (!nav)
+		return 0;
+	dtNavMeshQuery query;
+	if (dtStatusFailed(query.init(nav, 2048)))
+	{
+		dtFreeNavMesh(nav);
+		return 0;
+	}
+	dtQueryFilter filter;
+	std::vector<dtPolyRef> refs(MAX_CANDIDATES*2);
+	std::vector<float> pos(MAX_CANDIDATES*2*3);
+	const int ncandidates = pickTestPathEnds(query, filter, MAX_CANDIDATES, &refs[0], &pos[0]);
+	int count = 0;
+	for (int i = 0; i < ncandidates && count < maxCount; ++i)
+	{
+		const dtMeshTile* a = 0;
+		const dtMeshTile* b = 0;
+		const dtPoly* poly = 0;
+		nav->getTileAndPolyByRefUnsafe(refs[i*2], &a, &poly);
+		nav->getTileAndPolyByRefUnsafe(refs[i*2+1], &b, &poly);
+		if (dtAbs(a->header->x - b->header->x) > 1 || dtAbs(a->header->y - b->header->y) > 1)
+			continue;
+		settings.addOffMeshConnection(&pos[i*2*3], &pos[(i*2+1)*3], 1.0f, (count & 1) != 0);
+		count++;
+	}
+	dtFreeNavMesh(nav);
+	return count;
+}
+
+#endif // TESTNAVMESH_H
@@ -1,6 +1,7 @@
 #include "catch.hpp"
 
 #include "DetourCommon.h"
+#include "DetourNode.h"
 
 TEST_CASE("dtRandomPointInConvexPoly")
 {
@@ -31,3 +32,44 @@ TEST_CASE("dtRandomPointInConvexPoly")
 		REQUIRE(out[2] == Approx(0));
 	}
 }
+
+TEST_CASE("dtNodePool")
+{
+	dtNodePool pool(16, 4);
+
+	SECTION("Nodes are found by reference and state")
+	{
+		dtNode* a = pool.getNode(1, 0);
+		dtNode* b = pool.getNode(1, 1);
+		dtNode* c = pool.getNode(2, 0);
+		REQUIRE(a != 0);
+		REQUIRE(b != 0);
+		REQUIRE(c != 0);
+		REQUIRE(a != b);
+		REQUIRE(pool.getNode(1, 0) == a);
+		REQUIRE(pool.findNode(1, 1) == b);
+		REQUIRE(pool.findNode(3, 0) == 0);
+
+		dtNode* nodes[DT_MAX_STATES_PER_NODE];
+		REQUIRE(pool.findNodes(1, nodes, DT_MAX_STATES_PER_NODE) == 2);
+		REQUIRE(pool.getNodeCount() == 3);
+	}
+
+	SECTION("Clear forgets all nodes")
+	{
+		for (int i = 0; i < 16; ++i)
+			REQUIRE(pool.getNode((dtPolyRef)(i+1)) != 0);
+		REQUIRE(pool.getNode(100) == 0);
+
+		pool.clear();
+		REQUIRE(pool.getNodeCount() == 0);
+		for (int i = 0; i < 16; ++i)
+			REQUIRE(pool.findNode((dtPolyRef)(i+1), 0) == 0);
+
+		dtNode* node = pool.getNode(100);
+		REQUIRE(node != 0);
+		REQUIRE(node->id == 100);
+		REQUIRE(node->flags == 0);
+		REQUIRE(pool.getNodeAtIdx(1) == node);
+	}
+}
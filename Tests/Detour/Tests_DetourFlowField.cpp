@@ -0,0 +1,260 @@
+#include <float.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "catch.hpp"
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourFlowField.h"
+
+#include "TestNavMesh.h"
+
+static const int TEST_MAX_PATH = 2048;
+static const int TEST_AGENTS = 300;
+
+TEST_CASE("dtFlowField")
+{
+	seedTestRandom();
+
+	TestBuildSettings settings;
+	REQUIRE(addTestOffMeshConnections("nav_test.obj", settings, 20) > 0);
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 65535)));
+
+	// The first point is the goal, the others are the agents.
+	static dtPolyRef refs[(TEST_AGENTS+1)*2];
+	static float pos[(TEST_AGENTS+1)*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_AGENTS/2+1, refs, pos);
+	REQUIRE(npairs == TEST_AGENTS/2+1);
+	const dtPolyRef goalRef = refs[0];
+	const float* goalPos = &pos[0];
+	const dtPolyRef* agentRefs = &refs[1];
+	const float* agentPos = &pos[3];
+	const int nagents = npairs*2-1;
+
+	dtFlowField* field = dtAllocFlowField();
+	REQUIRE(field != 0);
+	REQUIRE(dtStatusFailed(field->build(goalRef, goalPos, FLT_MAX, FLT_MAX)));
+	REQUIRE(dtStatusFailed(field->init(0, &filter)));
+	REQUIRE(dtStatusSucceed(field->init(nav, &filter)));
+	REQUIRE(dtStatusFailed(field->build(0, goalPos, FLT_MAX, FLT_MAX)));
+	REQUIRE(field->getPolyCount() == 0);
+	REQUIRE(dtStatusSucceed(field->build(goalRef, goalPos, FLT_MAX, FLT_MAX)));
+	REQUIRE(!field->isStale());
+	const int fullCount = field->getPolyCount();
+	REQUIRE(fullCount > 1);
+
+	static dtPolyRef path[TEST_MAX_PATH];
+
+	SECTION("Routes match findPath")
+	{
+		float plainTotal = 0.0f, fieldTotal = 0.0f;
+		int reached = 0;
+		for (int i = 0; i < nagents; ++i)
+		{
+			const dtPolyRef ref = agentRefs[i];
+			const float cost = field->getCost(ref, &agentPos[i*3]);
+
+			int npath = 0;
+			const dtStatus status = query.findPath(ref, goalRef, &agentPos[i*3], goalPos,
+												   &filter, path, &npath, TEST_MAX_PATH);
+			REQUIRE(dtStatusSucceed(status));
+			REQUIRE(dtStatusDetail(status, DT_PARTIAL_RESULT) == (cost == FLT_MAX));
+			if (cost == FLT_MAX)
+			{
+				REQUIRE(field->getNextPoly(ref) == 0);
+				continue;
+			}
+			reached++;
+			const float plainCost = getTestPathCost(query, goalRef);
+			if (plainCost >= 0.0f)
+			{
+				plainTotal += plainCost;
+				fieldTotal += cost;
+			}
+
+			REQUIRE(field->getCost(ref) <= cost);
+			REQUIRE(dtStatusSucceed(field->getPath(ref, path, &npath, TEST_MAX_PATH)));
+			REQUIRE(path[0] == ref);
+			REQUIRE(path[npath-1] == goalRef);
+			REQUIRE(isTestPathConnected(*nav, path, npath));
+			for (int j = 0; j+1 < npath; ++j)
+			{
+				REQUIRE(field->getNextPoly(path[j]) == path[j+1]);
+				REQUIRE(field->getCost(path[j+1]) <= field->getCost(path[j]));
+			}
+
+			float left[3], right[3];
+			REQUIRE(dtStatusSucceed(field->getNextPortal(ref, left, right)));
+			if (ref == goalRef)
+			{
+				REQUIRE(dtVequal(left, goalPos));
+				REQUIRE(dtVequal(right, goalPos));
+			}
+		}
+		REQUIRE(reached > 0);
+		REQUIRE(plainTotal > 0.0f);
+		// findPath keeps a node for each tile border a polygon is entered across, and fixes
+		// node positions on the first visit, so the costs only agree closely.
+		REQUIRE(fieldTotal <= plainTotal * 1.05f);
+		REQUIRE(fieldTotal >= plainTotal * 0.95f);
+	}
+
+	SECTION("Bounds limit the field")
+	{
+		const float maxCost = 20.0f;
+		REQUIRE(dtStatusSucceed(field->build(goalRef, goalPos, FLT_MAX, maxCost)));
+		const int costCount = field->getPolyCount();
+		REQUIRE(costCount < fullCount);
+		for (int i = 0; i < nagents; ++i)
+		{
+			const float cost = field->getCost(agentRefs[i]);
+			REQUIRE((cost == FLT_MAX || cost <= maxCost));
+		}
+
+		const float maxRadius = 10.0f;
+		REQUIRE(dtStatusSucceed(field->build(goalRef, goalPos, maxRadius, FLT_MAX)));
+		REQUIRE(field->getPolyCount() < fullCount);
+		for (int i = 0; i < nagents; ++i)
+		{
+			if (field->getCost(agentRefs[i]) == FLT_MAX)
+				continue;
+			float left[3], right[3];
+			REQUIRE(dtStatusSucceed(field->getNextPortal(agentRefs[i], left, right)));
+			float t;
+			REQUIRE(dtDistancePtSegSqr2D(goalPos, left, right, t) <= dtSqr(maxRadius) + 0.001f);
+		}
+	}
+
+	SECTION("Becomes stale when tiles change")
+	{
+		// Remove a tile the field reached, away from the goal.
+		dtPolyRef removedRef = 0;
+		for (int i = 0; i < nagents && !removedRef; ++i)
+		{
+			if (field->getCost(agentRefs[i]) != FLT_MAX &&
+				nav->decodePolyIdTile(agentRefs[i]) != nav->decodePolyIdTile(goalRef))
+				removedRef = agentRefs[i];
+		}
+		REQUIRE(removedRef != 0);
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		nav->getTileAndPolyByRefUnsafe(removedRef, &tile, &poly);
+		const int tx = tile->header->x, ty = tile->header->y;
+		REQUIRE(dtStatusSucceed(nav->removeTile(nav->getTileRef(tile), 0, 0)));
+		REQUIRE(field->isStale());
+		REQUIRE(field->getCost(removedRef) == FLT_MAX);
+
+		REQUIRE(dtStatusSucceed(field->update()));
+		REQUIRE(!field->isStale());
+		REQUIRE(field->getPolyCount() < fullCount);
+		REQUIRE(field->getCost(goalRef) == 0.0f);
+
+		// Adding the tile back next to the field makes it stale again.
+		TestGeom geom;
+		REQUIRE(loadTestGeom("nav_test.obj", geom));
+		int dataSize = 0;
+		unsigned char* data = buildTestTile(geom, settings, tx, ty, &dataSize);
+		REQUIRE(data != 0);
+		REQUIRE(dtStatusSucceed(nav->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		REQUIRE(field->isStale());
+		REQUIRE(dtStatusSucceed(field->update()));
+		REQUIRE(field->getPolyCount() == fullCount);
+
+		// Without the goal polygon there is no field.
+		const dtMeshTile* goalTile = 0;
+		nav->getTileAndPolyByRefUnsafe(goalRef, &goalTile, &poly);
+		REQUIRE(dtStatusSucceed(nav->removeTile(nav->getTileRef(goalTile), 0, 0)));
+		REQUIRE(field->isStale());
+		REQUIRE(dtStatusFailed(field->update()));
+		REQUIRE(field->getPolyCount() == 0);
+		REQUIRE(!field->isStale());
+	}
+
+	SECTION("Becomes stale when polygon flags change")
+	{
+		// Close a polygon the field reached, away from the goal.
+		dtPolyRef closedRef = 0;
+		for (int i = 0; i < nagents && !closedRef; ++i)
+		{
+			if (field->getCost(agentRefs[i]) != FLT_MAX && agentRefs[i] != goalRef)
+				closedRef = agentRefs[i];
+		}
+		REQUIRE(closedRef != 0);
+		unsigned short flags = 0;
+		REQUIRE(dtStatusSucceed(nav->getPolyFlags(closedRef, &flags)));
+
+		// Setting the same flags is not a change.
+		REQUIRE(dtStatusSucceed(nav->setPolyFlags(closedRef, flags)));
+		REQUIRE(!field->isStale());
+
+		REQUIRE(dtStatusSucceed(nav->setPolyFlags(closedRef, 0)));
+		REQUIRE(field->isStale());
+		REQUIRE(dtStatusSucceed(field->update()));
+		REQUIRE(!field->isStale());
+		REQUIRE(field->getCost(closedRef) == FLT_MAX);
+		REQUIRE(field->getPolyCount() < fullCount);
+
+		REQUIRE(dtStatusSucceed(nav->setPolyFlags(closedRef, flags)));
+		REQUIRE(field->isStale());
+		REQUIRE(dtStatusSucceed(field->update()));
+		REQUIRE(field->getCost(closedRef) != FLT_MAX);
+		REQUIRE(field->getPolyCount() == fullCount);
+	}
+
+	dtFreeFlowField(field);
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtFlowField benchmark agents converging on a goal", "[.][benchmark]")
+{
+	seedTestRandom();
+
+	TestBuildSettings settings;
+	REQUIRE(addTestOffMeshConnections("nav_test.obj", settings, 20) > 0);
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 65535)));
+
+	static dtPolyRef refs[(TEST_AGENTS+1)*2];
+	static float pos[(TEST_AGENTS+1)*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_AGENTS/2+1, refs, pos);
+	REQUIRE(npairs == TEST_AGENTS/2+1);
+	const dtPolyRef goalRef = refs[0];
+	const float* goalPos = &pos[0];
+	const dtPolyRef* agentRefs = &refs[1];
+	const float* agentPos = &pos[3];
+	const int nagents = npairs*2-1;
+
+	dtFlowField* field = dtAllocFlowField();
+	REQUIRE(field != 0);
+	REQUIRE(dtStatusSucceed(field->init(nav, &filter)));
+
+	static dtPolyRef path[TEST_MAX_PATH];
+	int npath = 0;
+	clock_t begin = clock();
+	for (int i = 0; i < nagents; ++i)
+		query.findPath(agentRefs[i], goalRef, &agentPos[i*3], goalPos, &filter, path, &npath, TEST_MAX_PATH);
+	const double plainMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+
+	begin = clock();
+	field->build(goalRef, goalPos, FLT_MAX, FLT_MAX);
+	for (int i = 0; i < nagents; ++i)
+		field->getPath(agentRefs[i], path, &npath, TEST_MAX_PATH);
+	const double fieldMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+
+	printf("BM_converge_findPath   %d agents in %8.2f ms\n", nagents, plainMs);
+	printf("BM_converge_flowField  %d agents in %8.2f ms (%d polygons, %d bytes)\n",
+		   nagents, fieldMs, field->getPolyCount(), field->getMemUsed());
+
+	dtFreeFlowField(field);
+	dtFreeNavMesh(nav);
+}
@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "catch.hpp"
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourIslands.h"
+#include "DetourPolyMaskFilter.h"
+
+#include "TestNavMesh.h"
+
+static const int TEST_MAX_PATH = 2048;
+static const int TEST_PATH_PAIRS = 300;
+
+static void requireSameIslands(const dtIslandTable& a, const dtIslandTable& b, const dtPolyRef* refs, const int npairs)
+{
+	for (int i = 0; i < npairs; ++i)
+		REQUIRE(a.isConnected(refs[i*2], refs[i*2+1]) == b.isConnected(refs[i*2], refs[i*2+1]));
+}
+
+TEST_CASE("dtIslandTable")
+{
+	seedTestRandom();
+
+	TestBuildSettings settings;
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtIslandTable* islands = dtAllocIslandTable();
+	REQUIRE(islands != 0);
+	REQUIRE(dtStatusFailed(islands->init(0, &filter)));
+	REQUIRE(islands->isConnected(1, 2));
+	REQUIRE(dtStatusSucceed(islands->init(nav, &filter)));
+	REQUIRE(islands->getIslandCount() > 1);
+
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 65535)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	static dtPolyRef path[TEST_MAX_PATH];
+
+	SECTION("Rejects only unreachable pairs")
+	{
+		int rejected = 0;
+		for (int i = 0; i < npairs; ++i)
+		{
+			int npath = 0;
+			query.setIslandTable(0);
+			const dtStatus fullStatus = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+													   &filter, path, &npath, TEST_MAX_PATH);
+			REQUIRE(dtStatusSucceed(fullStatus));
+			const bool connected = islands->isConnected(refs[i*2], refs[i*2+1]);
+			REQUIRE(islands->getIsland(refs[i*2]) != 0);
+			if (!connected)
+			{
+				REQUIRE(dtStatusDetail(fullStatus, DT_PARTIAL_RESULT));
+				rejected++;
+			}
+
+			query.setIslandTable(islands);
+			const dtStatus status = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+												   &filter, path, &npath, TEST_MAX_PATH);
+			REQUIRE(dtStatusSucceed(status));
+			REQUIRE(dtStatusDetail(status, DT_PARTIAL_RESULT) == dtStatusDetail(fullStatus, DT_PARTIAL_RESULT));
+			if (!connected)
+			{
+				REQUIRE(npath == 1);
+				REQUIRE(path[0] == refs[i*2]);
+			}
+		}
+		REQUIRE(rejected > 0);
+	}
+
+	SECTION("Sliced path finder rejects unreachable pairs")
+	{
+		query.setIslandTable(islands);
+		for (int i = 0; i < npairs; ++i)
+		{
+			if (islands->isConnected(refs[i*2], refs[i*2+1]))
+				continue;
+			REQUIRE(query.initSlicedFindPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter) == DT_SUCCESS);
+			int npath = 0;
+			const dtStatus status = query.finalizeSlicedFindPath(path, &npath, TEST_MAX_PATH);
+			REQUIRE(dtStatusSucceed(status));
+			REQUIRE(dtStatusDetail(status, DT_PARTIAL_RESULT));
+			REQUIRE(npath == 1);
+			REQUIRE(path[0] == refs[i*2]);
+		}
+	}
+
+	SECTION("Update after removing and adding tiles")
+	{
+		int removed = 0;
+		for (int i = 0; i < nav->getMaxTiles(); i += 3)
+		{
+			const dtMeshTile* tile = ((const dtNavMesh*)nav)->getTile(i);
+			if (!tile->header)
+				continue;
+			REQUIRE(dtStatusSucceed(nav->removeTile(nav->getTileRef(tile), 0, 0)));
+			removed++;
+		}
+		REQUIRE(removed > 0);
+
+		// Removed polygons are unknown to the table.
+		REQUIRE(dtStatusSucceed(islands->update()));
+		for (int i = 0; i < npairs*2; ++i)
+		{
+			if (!nav->isValidPolyRef(refs[i]))
+				REQUIRE(islands->getIsland(refs[i]) == 0);
+		}
+
+		dtIslandTable fresh;
+		REQUIRE(dtStatusSucceed(fresh.init(nav, &filter)));
+		REQUIRE(islands->getIslandCount() == fresh.getIslandCount());
+		requireSameIslands(*islands, fresh, refs, npairs);
+
+		TestGeom geom;
+		REQUIRE(loadTestGeom("nav_test.obj", geom));
+		int tw = 0, th = 0;
+		calcTestTileCount(geom, settings, tw, th);
+		for (int y = 0; y < th; ++y)
+		{
+			for (int x = 0; x < tw; ++x)
+			{
+				if (nav->getTileAt(x, y, 0))
+					continue;
+				int dataSize = 0;
+				unsigned char* data = buildTestTile(geom, settings, x, y, &dataSize);
+				if (data && dtStatusFailed(nav->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)))
+					dtFree(data);
+			}
+		}
+		REQUIRE(dtStatusSucceed(islands->update()));
+		REQUIRE(dtStatusSucceed(fresh.init(nav, &filter)));
+		REQUIRE(islands->getIslandCount() == fresh.getIslandCount());
+
+		const int npairs2 = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+		requireSameIslands(*islands, fresh, refs, npairs2);
+	}
+
+	SECTION("Update after changing polygon flags")
+	{
+		const int islandCount = islands->getIslandCount();
+		const dtMeshTile* tile = nav->getTileByRef(refs[0]);
+		const dtPolyRef base = nav->getPolyRefBase(tile);
+		const int npolys = tile->header->polyCount;
+
+		// Closing the polygons of a tile removes them from the islands and may split others.
+		for (int i = 0; i < npolys; ++i)
+			REQUIRE(dtStatusSucceed(nav->setPolyFlags(base | (dtPolyRef)i, 0)));
+		REQUIRE(dtStatusSucceed(islands->update()));
+		REQUIRE(islands->getIsland(refs[0]) == 0);
+
+		dtIslandTable fresh;
+		REQUIRE(dtStatusSucceed(fresh.init(nav, &filter)));
+		REQUIRE(islands->getIslandCount() == fresh.getIslandCount());
+		requireSameIslands(*islands, fresh, refs, npairs);
+
+		// Reopening them joins the islands again.
+		for (int i = 0; i < npolys; ++i)
+			REQUIRE(dtStatusSucceed(nav->setPolyFlags(base | (dtPolyRef)i, 1)));
+		REQUIRE(dtStatusSucceed(islands->update()));
+		REQUIRE(islands->getIsland(refs[0]) != 0);
+		REQUIRE(islands->getIslandCount() == islandCount);
+		REQUIRE(dtStatusSucceed(fresh.init(nav, &filter)));
+		requireSameIslands(*islands, fresh, refs, npairs);
+	}
+
+	SECTION("Queries with other flags ignore the table")
+	{
+		// Passes the same polygons, but the table cannot know that.
+		dtQueryFilter other;
+		other.setExcludeFlags(0x8000);
+		REQUIRE(!islands->matchesFilter(&other));
+		int checked = 0;
+		for (int i = 0; i < npairs; ++i)
+		{
+			if (islands->isConnected(refs[i*2], refs[i*2+1]))
+				continue;
+			int npath = 0;
+			query.setIslandTable(0);
+			const dtStatus fullStatus = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+													   &other, path, &npath, TEST_MAX_PATH);
+			const int fullCount = npath;
+			query.setIslandTable(islands);
+			const dtStatus status = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+												   &other, path, &npath, TEST_MAX_PATH);
+			REQUIRE(status == fullStatus);
+			REQUIRE(npath == fullCount);
+			checked++;
+		}
+		REQUIRE(checked > 0);
+	}
+
+	SECTION("Queries with the same flags share the table")
+	{
+		dtQueryFilter same;
+		same.setAreaCost(0, 2.0f);
+		REQUIRE(islands->matchesFilter(&same));
+		dtPolyMaskFilter mask;
+		REQUIRE(dtStatusSucceed(mask.init(nav, &same)));
+		query.setIslandTable(islands);
+		int checked = 0;
+		for (int i = 0; i < npairs; ++i)
+		{
+			if (islands->isConnected(refs[i*2], refs[i*2+1]))
+				continue;
+			int npath = 0;
+			const dtStatus status = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+												   &same, path, &npath, TEST_MAX_PATH);
+			REQUIRE(status == (DT_SUCCESS | DT_PARTIAL_RESULT));
+			REQUIRE(npath == 1);
+			REQUIRE(path[0] == refs[i*2]);
+			// The mask filter passes fewer polygons, so the table rules out its paths too.
+			npath = 0;
+			REQUIRE(query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+								   &mask, path, &npath, TEST_MAX_PATH) == (DT_SUCCESS | DT_PARTIAL_RESULT));
+			REQUIRE(npath == 1);
+			checked++;
+		}
+		REQUIRE(checked > 0);
+	}
+
+	dtFreeIslandTable(islands);
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtIslandTable benchmark unreachable pairs", "[.][benchmark]")
+{
+	seedTestRandom();
+
+	TestBuildSettings settings;
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtIslandTable islands;
+	REQUIRE(dtStatusSucceed(islands.init(nav, &filter)));
+
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 65535)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	static dtPolyRef path[TEST_MAX_PATH];
+	const char* names[] = { "findPath", "findPathIslands" };
+	for (int q = 0; q < 2; ++q)
+	{
+		query.setIslandTable(q ? &islands : 0);
+		int count = 0;
+		const clock_t begin = clock();
+		for (int i = 0; i < npairs; ++i)
+		{
+			if (islands.isConnected(refs[i*2], refs[i*2+1]))
+				continue;
+			int npath = 0;
+			query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+						   &filter, path, &npath, TEST_MAX_PATH);
+			count++;
+		}
+		const double ms = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+		printf("BM_%-16s %d paths in %8.2f ms: %8.2f us/path (%d islands, %d bytes)\n",
+			   names[q], count, ms, count ? ms * 1000.0 / count : 0.0, islands.getIslandCount(), islands.getMemUsed());
+	}
+
+	query.setIslandTable(0);
+	dtFreeNavMesh(nav);
+}
@@ -0,0 +1,1332 @@
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "DetourAlloc.h"
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourTileTracker.h"
+#include "DetourIslands.h"
+#include "DetourLandmarks.h"
+#include "DetourTileGraph.h"
+#include "DetourFlowField.h"
+#include "DetourRandomPoints.h"
+#include "DetourPathCache.h"
+#include "DetourPolyMaskFilter.h"
+
+#include "TestNavMesh.h"
+
+static const int TEST_MAX_NODES = 2048;
+static const int TEST_MAX_PATH = 256;
+static const int TEST_PATH_PAIRS = 500;
+
+// Returns the number of links of the navmesh that are not followed by the next link in memory.
+static int countTestLinkJumps(const dtNavMesh& nav)
+{
+	int jumps = 0;
+	for (int i = 0; i < nav.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = nav.getTile(i);
+		if (!tile->header)
+			continue;
+		for (int j = 0; j < tile->header->polyCount; ++j)
+		{
+			for (unsigned int k = tile->polys[j].firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			{
+				if (tile->links[k].next != DT_NULL_LINK && tile->links[k].next != k+1)
+					jumps++;
+			}
+		}
+	}
+	return jumps;
+}
+
+// Returns the number of cache lines holding the links of the polygon, counted from the start of the links.
+static int countTestLinkLines(const dtMeshTile* tile, const dtPoly* poly)
+{
+	static const size_t CACHE_LINE_SIZE = 64;
+	size_t lines[DT_VERTS_PER_POLYGON*4];
+	int nlines = 0;
+	for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+	{
+		const size_t line = k*sizeof(dtLink) / CACHE_LINE_SIZE;
+		int j = 0;
+		while (j < nlines && lines[j] != line)
+			j++;
+		if (j == nlines && nlines < DT_VERTS_PER_POLYGON*4)
+			lines[nlines++] = line;
+	}
+	return nlines;
+}
+
+// Returns the number of cache lines holding the links of the polygons of the navmesh.
+static int countTestLinkLines(const dtNavMesh& nav)
+{
+	int lines = 0;
+	for (int i = 0; i < nav.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = nav.getTile(i);
+		if (!tile->header)
+			continue;
+		for (int j = 0; j < tile->header->polyCount; ++j)
+			lines += countTestLinkLines(tile, &tile->polys[j]);
+	}
+	return lines;
+}
+
+// Returns the number of cache lines holding the links of the polygons the last search visited.
+static int countTestSearchLinkLines(const dtNavMesh& nav, const dtNavMeshQuery& query)
+{
+	const dtNodePool* pool = query.getNodePool();
+	int lines = 0;
+	for (int i = 1; i <= pool->getNodeCount(); ++i)
+	{
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		if (dtStatusSucceed(nav.getTileAndPolyByRef(pool->getNodeAtIdx(i)->id, &tile, &poly)))
+			lines += countTestLinkLines(tile, poly);
+	}
+	return lines;
+}
+
+// Requires the polygons of both navmeshes to have the same links in the same order.
+static void compareTestLinks(const dtNavMesh& a, const dtNavMesh& b)
+{
+	REQUIRE(a.getMaxTiles() == b.getMaxTiles());
+	for (int i = 0; i < a.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* ta = a.getTile(i);
+		const dtMeshTile* tb = b.getTile(i);
+		REQUIRE((ta->header != 0) == (tb->header != 0));
+		if (!ta->header)
+			continue;
+		for (int j = 0; j < ta->header->polyCount; ++j)
+		{
+			unsigned int ka = ta->polys[j].firstLink, kb = tb->polys[j].firstLink;
+			for (; ka != DT_NULL_LINK && kb != DT_NULL_LINK; ka = ta->links[ka].next, kb = tb->links[kb].next)
+			{
+				const dtLink& la = ta->links[ka];
+				const dtLink& lb = tb->links[kb];
+				REQUIRE(la.ref == lb.ref);
+				REQUIRE(la.edge == lb.edge);
+				REQUIRE(la.side == lb.side);
+				REQUIRE(la.bmin == lb.bmin);
+				REQUIRE(la.bmax == lb.bmax);
+			}
+			REQUIRE(ka == DT_NULL_LINK);
+			REQUIRE(kb == DT_NULL_LINK);
+		}
+	}
+}
+
+// Removes about half of the tiles of both navmeshes and adds them back in another order, so the
+// links to the neighbours are handed out from the freed slots in a new order each round.
+static void scatterTestLinks(const TestTileCache& tiles, dtNavMesh* nav, dtNavMesh* compact, const int rounds)
+{
+	dtNavMesh* navs[] = { nav, compact };
+	std::vector<int> removed;
+	for (int r = 0; r < rounds; ++r)
+	{
+		removed.clear();
+		for (int y = 0; y < tiles.getTileCountY(); ++y)
+		{
+			for (int x = 0; x < tiles.getTileCountX(); ++x)
+			{
+				if (!nav->getTileAt(x, y, 0) || testRandom() < 0.5f)
+					continue;
+				for (int n = 0; n < 2; ++n)
+					REQUIRE(dtStatusSucceed(navs[n]->removeTile(navs[n]->getTileRefAt(x, y, 0), 0, 0)));
+				removed.push_back(x + y*tiles.getTileCountX());
+			}
+		}
+		REQUIRE(countTestLinkJumps(*compact) == 0);
+		compareTestLinks(*nav, *compact);
+
+		for (int i = (int)removed.size()-1; i > 0; --i)
+			std::swap(removed[i], removed[(int)(testRandom() * (i+1))]);
+		for (int i = 0; i < (int)removed.size(); ++i)
+		{
+			const int x = removed[i] % tiles.getTileCountX(), y = removed[i] / tiles.getTileCountX();
+			for (int n = 0; n < 2; ++n)
+			{
+				int dataSize = 0;
+				unsigned char* data = tiles.copyTile(x, y, &dataSize);
+				REQUIRE(data != 0);
+				REQUIRE(dtStatusSucceed(navs[n]->addTile(data, dataSize, DT_TILE_FREE_DATA | (n ? DT_TILE_COMPACT_LINKS : 0), 0, 0)));
+			}
+		}
+		REQUIRE(countTestLinkJumps(*compact) == 0);
+		compareTestLinks(*nav, *compact);
+	}
+}
+
+TEST_CASE("dtNavMesh compact links")
+{
+	seedTestRandom();
+
+	// The tiles are built once for all sections.
+	static TestTileCache tiles;
+	if (!tiles.isBuilt())
+		REQUIRE(tiles.build("nav_test.obj", TestBuildSettings()));
+	dtNavMesh* nav = tiles.createNavMesh();
+	REQUIRE(nav != 0);
+	dtNavMesh* compact = tiles.createNavMesh(DT_TILE_COMPACT_LINKS);
+	REQUIRE(compact != 0);
+
+	REQUIRE(countTestLinkJumps(*nav) > 0);
+	REQUIRE(countTestLinkJumps(*compact) == 0);
+	compareTestLinks(*nav, *compact);
+
+	scatterTestLinks(tiles, nav, compact, 20);
+
+	// The compacted links of a polygon spread over fewer cache lines.
+	REQUIRE(countTestLinkLines(*compact) < countTestLinkLines(*nav));
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, TEST_MAX_NODES)));
+	dtNavMeshQuery compactQuery;
+	REQUIRE(dtStatusSucceed(compactQuery.init(compact, TEST_MAX_NODES)));
+
+	// Both navmeshes went through the same changes, so the references are the same.
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	dtPolyRef path[TEST_MAX_PATH];
+	dtPolyRef compactPath[TEST_MAX_PATH];
+
+	SECTION("Paths do not change")
+	{
+		int searchLines = 0, compactSearchLines = 0;
+		for (int i = 0; i < npairs; ++i)
+		{
+			int npath = 0, ncompact = 0;
+			const dtStatus status = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter,
+												   path, &npath, TEST_MAX_PATH);
+			searchLines += countTestSearchLinkLines(*nav, query);
+			const dtStatus compactStatus = compactQuery.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter,
+																 compactPath, &ncompact, TEST_MAX_PATH);
+			compactSearchLines += countTestSearchLinkLines(*compact, compactQuery);
+			REQUIRE(compactStatus == status);
+			REQUIRE(ncompact == npath);
+			REQUIRE(memcmp(compactPath, path, sizeof(dtPolyRef)*npath) == 0);
+		}
+		// The searches read the links from fewer cache lines.
+		REQUIRE(compactSearchLines < searchLines);
+	}
+
+	dtFreeNavMesh(compact);
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMesh benchmark findPath with compact links", "[.][benchmark]")
+{
+	seedTestRandom();
+
+	TestTileCache tiles;
+	REQUIRE(tiles.build("nav_test.obj", TestBuildSettings()));
+	dtNavMesh* nav = tiles.createNavMesh();
+	REQUIRE(nav != 0);
+	dtNavMesh* compact = tiles.createNavMesh(DT_TILE_COMPACT_LINKS);
+	REQUIRE(compact != 0);
+	scatterTestLinks(tiles, nav, compact, 20);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, TEST_MAX_NODES)));
+	dtNavMeshQuery compactQuery;
+	REQUIRE(dtStatusSucceed(compactQuery.init(compact, TEST_MAX_NODES)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	dtPolyRef path[TEST_MAX_PATH];
+	const int rounds = 5;
+	const dtNavMesh* meshes[] = { nav, compact };
+	dtNavMeshQuery* queries[] = { &query, &compactQuery };
+	const char* names[] = { "scattered", "compact" };
+	for (int q = 0; q < 2; ++q)
+	{
+		const clock_t begin = clock();
+		for (int r = 0; r < rounds; ++r)
+		{
+			for (int i = 0; i < npairs; ++i)
+			{
+				int npath = 0;
+				queries[q]->findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, path, &npath, TEST_MAX_PATH);
+			}
+		}
+		const double ms = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+
+		// The cache lines the link lists of the visited polygons are read from.
+		int lines = 0;
+		for (int i = 0; i < npairs; ++i)
+		{
+			int npath = 0;
+			queries[q]->findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, path, &npath, TEST_MAX_PATH);
+			lines += countTestSearchLinkLines(*meshes[q], *queries[q]);
+		}
+		printf("BM_findPath_links_%-9s %d paths in %8.2f ms: %8.2f us/path, %6.2f link cache lines/path\n",
+			   names[q], rounds*npairs, ms, ms * 1000.0 / (rounds*npairs), (float)lines / npairs);
+	}
+
+	dtFreeNavMesh(compact);
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMesh images")
+{
+	seedTestRandom();
+
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+	const dtNavMesh& cnav = *nav;
+
+	const int imageSize = nav->getImageSize();
+	REQUIRE(imageSize > 0);
+	unsigned char* stored = new unsigned char[imageSize];
+	REQUIRE(nav->storeImage(stored, imageSize - 1) == (DT_FAILURE | DT_BUFFER_TOO_SMALL));
+	REQUIRE(dtStatusSucceed(nav->storeImage(stored, imageSize)));
+
+	// The image does not depend on where it is loaded.
+	unsigned char* image = new unsigned char[imageSize];
+	memcpy(image, stored, imageSize);
+	delete [] stored;
+
+	dtNavMesh* loaded = dtAllocNavMesh();
+	REQUIRE(loaded != 0);
+	REQUIRE(dtStatusSucceed(loaded->initFromImage(image, imageSize, DT_TILE_FREE_DATA)));
+	const dtNavMesh& cloaded = *loaded;
+
+	REQUIRE(memcmp(nav->getParams(), loaded->getParams(), sizeof(dtNavMeshParams)) == 0);
+	for (int i = 0; i < cnav.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = cnav.getTile(i);
+		const dtMeshTile* loadedTile = cloaded.getTile(i);
+		REQUIRE((tile->header != 0) == (loadedTile->header != 0));
+		if (!tile->header)
+			continue;
+		REQUIRE(nav->getTileRef(tile) == loaded->getTileRef(loadedTile));
+		REQUIRE(loadedTile->data >= image);
+		REQUIRE(loadedTile->data + loadedTile->dataSize <= image + imageSize);
+		REQUIRE((loadedTile->flags & DT_TILE_FREE_DATA) == 0);
+		REQUIRE(loadedTile->linksFreeList == tile->linksFreeList);
+		REQUIRE(loaded->getTileAt(tile->header->x, tile->header->y, tile->header->layer) == loadedTile);
+	}
+	compareTestLinks(*nav, *loaded);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, TEST_MAX_NODES)));
+	dtNavMeshQuery loadedQuery;
+	REQUIRE(dtStatusSucceed(loadedQuery.init(loaded, TEST_MAX_NODES)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	SECTION("Paths do not change")
+	{
+		dtPolyRef path[TEST_MAX_PATH];
+		dtPolyRef loadedPath[TEST_MAX_PATH];
+		for (int i = 0; i < npairs; ++i)
+		{
+			int npath = 0, nloaded = 0;
+			const dtStatus status = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+												   &filter, path, &npath, TEST_MAX_PATH);
+			const dtStatus loadedStatus = loadedQuery.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+															   &filter, loadedPath, &nloaded, TEST_MAX_PATH);
+			REQUIRE(loadedStatus == status);
+			REQUIRE(nloaded == npath);
+			REQUIRE(memcmp(loadedPath, path, sizeof(dtPolyRef)*npath) == 0);
+		}
+	}
+
+	SECTION("Tiles can be removed and added")
+	{
+		TestGeom geom;
+		REQUIRE(loadTestGeom("nav_test.obj", geom));
+		TestBuildSettings settings;
+		const int tileIdx[] = { 0, 3 };
+		for (int k = 0; k < 2; ++k)
+		{
+			const dtMeshTile* tile = cnav.getTile(tileIdx[k]);
+			REQUIRE(tile->header != 0);
+			const int tx = tile->header->x, ty = tile->header->y;
+			const dtTileRef ref = nav->getTileRef(tile);
+
+			// The data of a tile of the image is handed back and can be added again.
+			unsigned char* imageData = 0;
+			int imageDataSize = 0;
+			REQUIRE(dtStatusSucceed(loaded->removeTile(ref, &imageData, &imageDataSize)));
+			REQUIRE(imageData >= image);
+			REQUIRE(imageData < image + imageSize);
+			REQUIRE(dtStatusSucceed(nav->removeTile(ref, 0, 0)));
+			compareTestLinks(*nav, *loaded);
+
+			int dataSize = 0;
+			unsigned char* data = buildTestTile(geom, settings, tx, ty, &dataSize);
+			REQUIRE(data != 0);
+			REQUIRE(dtStatusSucceed(nav->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+			REQUIRE(dtStatusSucceed(loaded->addTile(imageData, imageDataSize, 0, 0, 0)));
+			compareTestLinks(*nav, *loaded);
+		}
+	}
+
+	SECTION("Invalid images are rejected")
+	{
+		dtNavMesh* other = dtAllocNavMesh();
+		REQUIRE(other != 0);
+		unsigned char* copy = new unsigned char[imageSize];
+		memcpy(copy, image, imageSize);
+		REQUIRE(other->initFromImage(copy, imageSize / 2, 0) == (DT_FAILURE | DT_INVALID_PARAM));
+		REQUIRE(other->getTileAddCount() == 0);
+
+		// The tile count follows the magic, version and reference size.
+		int* tileCount = (int*)copy + 3;
+		const int storedCount = *tileCount;
+		*tileCount = -1;
+		REQUIRE(other->initFromImage(copy, imageSize, 0) == (DT_FAILURE | DT_INVALID_PARAM));
+		*tileCount = 0x7fffffff;
+		REQUIRE(other->initFromImage(copy, imageSize, 0) == (DT_FAILURE | DT_INVALID_PARAM));
+		*tileCount = storedCount;
+
+		// A tile header describing more data than the tile has.
+		const dtMeshTile* firstTile = 0;
+		for (int i = 0; i < cloaded.getMaxTiles() && !firstTile; ++i)
+		{
+			if (cloaded.getTile(i)->header)
+				firstTile = cloaded.getTile(i);
+		}
+		REQUIRE(firstTile != 0);
+		dtMeshHeader* tileHeader = (dtMeshHeader*)(copy + (firstTile->data - image));
+		const int polyCount = tileHeader->polyCount;
+		tileHeader->polyCount = firstTile->dataSize;
+		REQUIRE(other->initFromImage(copy, imageSize, 0) == (DT_FAILURE | DT_INVALID_PARAM));
+		REQUIRE(other->getTileAddCount() == 0);
+		tileHeader->polyCount = polyCount;
+		REQUIRE(dtStatusSucceed(other->initFromImage(copy, imageSize, 0)));
+
+		copy[0] ^= 0xff;
+		REQUIRE(other->initFromImage(copy, imageSize, 0) == (DT_FAILURE | DT_WRONG_MAGIC));
+		delete [] copy;
+		dtFreeNavMesh(other);
+	}
+
+	dtFreeNavMesh(loaded);
+	delete [] image;
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMesh benchmark loading tiles", "[.][benchmark]")
+{
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+	const dtNavMesh& cnav = *nav;
+
+	const int imageSize = nav->getImageSize();
+	REQUIRE(imageSize > 0);
+	unsigned char* image = new unsigned char[imageSize];
+	REQUIRE(dtStatusSucceed(nav->storeImage(image, imageSize)));
+
+	const int rounds = 20;
+	int ntiles = 0;
+	for (int i = 0; i < cnav.getMaxTiles(); ++i)
+	{
+		if (cnav.getTile(i)->header)
+			ntiles++;
+	}
+
+	double ms[2] = { 0.0, 0.0 };
+	for (int r = 0; r < rounds; ++r)
+	{
+		// addTile copies the tile data out of the file and builds the links.
+		clock_t begin = clock();
+		dtNavMesh* added = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(added->init(nav->getParams())));
+		for (int i = 0; i < cnav.getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = cnav.getTile(i);
+			if (!tile->header)
+				continue;
+			unsigned char* data = (unsigned char*)dtAlloc(tile->dataSize, DT_ALLOC_PERM);
+			memcpy(data, tile->data, tile->dataSize);
+			REQUIRE(dtStatusSucceed(added->addTile(data, tile->dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+		ms[0] += (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+		dtFreeNavMesh(added);
+
+		begin = clock();
+		dtNavMesh* mapped = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(mapped->initFromImage(image, imageSize, 0)));
+		ms[1] += (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+		dtFreeNavMesh(mapped);
+	}
+	printf("BM_loadTiles_addTile        %d tiles in %8.3f ms\n", ntiles, ms[0] / rounds);
+	printf("BM_loadTiles_initFromImage  %d tiles in %8.3f ms (%d byte image)\n", ntiles, ms[1] / rounds, imageSize);
+
+	delete [] image;
+	dtFreeNavMesh(nav);
+}
+
+static bool compareTestLinkOrder(const dtLink& a, const dtLink& b)
+{
+	if (a.ref != b.ref) return a.ref < b.ref;
+	if (a.edge != b.edge) return a.edge < b.edge;
+	if (a.side != b.side) return a.side < b.side;
+	if (a.bmin != b.bmin) return a.bmin < b.bmin;
+	return a.bmax < b.bmax;
+}
+
+// Requires the polygons of both navmeshes to have the same links, in any order, and the same vertices.
+static void compareTestLinkSets(const dtNavMesh& a, const dtNavMesh& b)
+{
+	REQUIRE(a.getMaxTiles() == b.getMaxTiles());
+	std::vector<dtLink> la, lb;
+	for (int i = 0; i < a.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* ta = a.getTile(i);
+		const dtMeshTile* tb = b.getTile(i);
+		REQUIRE((ta->header != 0) == (tb->header != 0));
+		if (!ta->header)
+			continue;
+		REQUIRE(a.getTileRef(ta) == b.getTileRef(tb));
+		REQUIRE(memcmp(ta->verts, tb->verts, sizeof(float)*3*ta->header->vertCount) == 0);
+		for (int j = 0; j < ta->header->polyCount; ++j)
+		{
+			la.clear();
+			lb.clear();
+			for (unsigned int k = ta->polys[j].firstLink; k != DT_NULL_LINK; k = ta->links[k].next)
+				la.push_back(ta->links[k]);
+			for (unsigned int k = tb->polys[j].firstLink; k != DT_NULL_LINK; k = tb->links[k].next)
+				lb.push_back(tb->links[k]);
+			REQUIRE(la.size() == lb.size());
+			std::sort(la.begin(), la.end(), compareTestLinkOrder);
+			std::sort(lb.begin(), lb.end(), compareTestLinkOrder);
+			for (size_t k = 0; k < la.size(); ++k)
+			{
+				REQUIRE(!compareTestLinkOrder(la[k], lb[k]));
+				REQUIRE(!compareTestLinkOrder(lb[k], la[k]));
+			}
+		}
+	}
+}
+
+// Runs the tasks backwards.
+struct TestReverseRunner : public dtTaskRunner
+{
+	virtual void run(void (*task)(void* context, int index), void* context, int count)
+	{
+		for (int i = count-1; i >= 0; --i)
+			task(context, i);
+	}
+};
+
+// Runs the tasks on threads started for each call.
+struct TestThreadRunner : public dtTaskRunner
+{
+	int threadCount;
+
+	static void work(void (*task)(void*, int), void* context, int count, std::atomic<int>* next)
+	{
+		for (int i = (*next)++; i < count; i = (*next)++)
+			task(context, i);
+	}
+
+	virtual void run(void (*task)(void* context, int index), void* context, int count)
+	{
+		std::atomic<int> next(0);
+		std::vector<std::thread> threads;
+		for (int i = 0; i < threadCount; ++i)
+			threads.push_back(std::thread(work, task, context, count, &next));
+		for (size_t i = 0; i < threads.size(); ++i)
+			threads[i].join();
+	}
+};
+
+// Adds off-mesh connections between the first polygons of neighbouring tiles.
+static void addTestTileConnections(TestBuildSettings& settings)
+{
+	dtNavMesh* plain = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(plain != 0);
+	for (int i = 0; i < plain->getMaxTiles() && settings.offMeshRads.size() < 20; ++i)
+	{
+		const dtMeshTile* a = ((const dtNavMesh*)plain)->getTile(i);
+		if (!a->header || !a->header->polyCount)
+			continue;
+		const dtMeshTile* b = plain->getTileAt(a->header->x+1, a->header->y, a->header->layer);
+		if (!b || !b->header->polyCount)
+			continue;
+		float pa[3] = { 0, 0, 0 }, pb[3] = { 0, 0, 0 };
+		for (int j = 0; j < a->polys[0].vertCount; ++j)
+			dtVmad(pa, pa, &a->verts[a->polys[0].verts[j]*3], 1.0f / a->polys[0].vertCount);
+		for (int j = 0; j < b->polys[0].vertCount; ++j)
+			dtVmad(pb, pb, &b->verts[b->polys[0].verts[j]*3], 1.0f / b->polys[0].vertCount);
+		settings.addOffMeshConnection(pa, pb, 1.0f, (i & 1) != 0);
+	}
+	dtFreeNavMesh(plain);
+	REQUIRE(settings.offMeshRads.size() > 0);
+}
+
+TEST_CASE("dtNavMesh addTiles")
+{
+	TestBuildSettings settings;
+	addTestTileConnections(settings);
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+	const dtNavMesh& cnav = *nav;
+
+	// Copies of the tile data in slot order.
+	std::vector<unsigned char*> data;
+	std::vector<int> dataSize;
+	for (int i = 0; i < cnav.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = cnav.getTile(i);
+		if (!tile->header)
+			continue;
+		unsigned char* copy = (unsigned char*)dtAlloc(tile->dataSize, DT_ALLOC_PERM);
+		memcpy(copy, tile->data, tile->dataSize);
+		data.push_back(copy);
+		dataSize.push_back(tile->dataSize);
+	}
+	const int count = (int)data.size();
+	REQUIRE(count > 0);
+
+	TestReverseRunner reverseRunner;
+	TestThreadRunner threadRunner;
+	threadRunner.threadCount = 4;
+
+	SECTION("Links match adding the tiles one by one")
+	{
+		dtTaskRunner* runners[] = { 0, &reverseRunner, &threadRunner };
+		for (int r = 0; r < 3; ++r)
+		{
+			dtNavMesh* batch = dtAllocNavMesh();
+			REQUIRE(dtStatusSucceed(batch->init(nav->getParams())));
+			std::vector<dtTileRef> refs(count);
+			REQUIRE(batch->addTiles(&data[0], &dataSize[0], count, 0, 0, runners[r], &refs[0]) == DT_SUCCESS);
+			compareTestLinkSets(*nav, *batch);
+			REQUIRE(batch->getTileAddCount() == (unsigned int)count);
+			for (int i = 0; i < count; ++i)
+				REQUIRE(((const dtNavMesh*)batch)->getTileByRef(refs[i])->data == data[i]);
+			dtFreeNavMesh(batch);
+		}
+	}
+
+	SECTION("Tiles are connected to the tiles already added")
+	{
+		dtNavMesh* batch = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(batch->init(nav->getParams())));
+		std::vector<unsigned char*> rest;
+		std::vector<int> restSize;
+		std::vector<dtTileRef> restRefs;
+		for (int i = 0; i < count; ++i)
+		{
+			const dtMeshHeader* header = (const dtMeshHeader*)data[i];
+			if ((header->x + header->y) % 2)
+			{
+				rest.push_back(data[i]);
+				restSize.push_back(dataSize[i]);
+				restRefs.push_back(nav->getTileRef(cnav.getTileAt(header->x, header->y, header->layer)));
+				continue;
+			}
+			REQUIRE(dtStatusSucceed(batch->addTile(data[i], dataSize[i], 0, nav->getTileRef(cnav.getTileAt(header->x, header->y, header->layer)), 0)));
+		}
+		REQUIRE(rest.size() > 0);
+		std::vector<unsigned int> revisions(batch->getMaxTiles());
+		for (int i = 0; i < batch->getMaxTiles(); ++i)
+			revisions[i] = ((const dtNavMesh*)batch)->getTile(i)->revision;
+		REQUIRE(batch->addTiles(&rest[0], &restSize[0], (int)rest.size(), 0, &restRefs[0], &threadRunner, 0) == DT_SUCCESS);
+		compareTestLinkSets(*nav, *batch);
+
+		// The tiles already added change revision once.
+		int changed = 0;
+		for (int i = 0; i < batch->getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = ((const dtNavMesh*)batch)->getTile(i);
+			if (!tile->header || (tile->header->x + tile->header->y) % 2)
+				continue;
+			REQUIRE(tile->revision - revisions[i] <= 1);
+			changed += tile->revision - revisions[i];
+		}
+		REQUIRE(changed > 0);
+		dtFreeNavMesh(batch);
+	}
+
+	SECTION("A failed batch adds no tiles")
+	{
+		dtNavMesh* batch = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(batch->init(nav->getParams())));
+		std::vector<unsigned char*> twice(data);
+		twice.push_back(data[0]);
+		std::vector<int> twiceSize(dataSize);
+		twiceSize.push_back(dataSize[0]);
+		REQUIRE(batch->addTiles(&twice[0], &twiceSize[0], count+1, DT_TILE_FREE_DATA, 0, 0, 0) == (DT_FAILURE | DT_ALREADY_OCCUPIED));
+		for (int i = 0; i < batch->getMaxTiles(); ++i)
+			REQUIRE(((const dtNavMesh*)batch)->getTile(i)->header == 0);
+
+		// The mesh is still usable.
+		REQUIRE(batch->addTiles(&data[0], &dataSize[0], count, 0, 0, 0, 0) == DT_SUCCESS);
+		for (int i = 0; i < count; ++i)
+			REQUIRE(batch->getTileAt(((const dtMeshHeader*)data[i])->x, ((const dtMeshHeader*)data[i])->y, ((const dtMeshHeader*)data[i])->layer) != 0);
+		dtFreeNavMesh(batch);
+	}
+
+	for (int i = 0; i < count; ++i)
+		dtFree(data[i]);
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMesh benchmark adding tiles", "[.][benchmark]")
+{
+	TestBuildSettings settings;
+	addTestTileConnections(settings);
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+	const dtNavMesh& cnav = *nav;
+
+	std::vector<unsigned char*> data;
+	std::vector<int> dataSize;
+	for (int i = 0; i < cnav.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = cnav.getTile(i);
+		if (!tile->header)
+			continue;
+		unsigned char* copy = (unsigned char*)dtAlloc(tile->dataSize, DT_ALLOC_PERM);
+		memcpy(copy, tile->data, tile->dataSize);
+		data.push_back(copy);
+		dataSize.push_back(tile->dataSize);
+	}
+	const int count = (int)data.size();
+	REQUIRE(count > 0);
+
+	TestThreadRunner threadRunner;
+	threadRunner.threadCount = 4;
+
+	const int rounds = 20;
+	const char* names[] = { "addTile", "addTiles", "addTiles_threads" };
+	for (int m = 0; m < 3; ++m)
+	{
+		const clock_t begin = clock();
+		for (int r = 0; r < rounds; ++r)
+		{
+			dtNavMesh* batch = dtAllocNavMesh();
+			REQUIRE(dtStatusSucceed(batch->init(nav->getParams())));
+			if (m == 0)
+			{
+				for (int i = 0; i < count; ++i)
+					batch->addTile(data[i], dataSize[i], 0, 0, 0);
+			}
+			else
+			{
+				batch->addTiles(&data[0], &dataSize[0], count, 0, 0, m == 2 ? &threadRunner : 0, 0);
+			}
+			dtFreeNavMesh(batch);
+		}
+		const double ms = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+		printf("BM_%-17s %d tiles in %8.3f ms (%u hardware threads)\n", names[m], count, ms / rounds,
+			   std::thread::hardware_concurrency());
+	}
+
+	for (int i = 0; i < count; ++i)
+		dtFree(data[i]);
+	dtFreeNavMesh(nav);
+}
+
+// The connections of a border edge as found by scanning every polygon of the target tile.
+static int findTestConnectingPolys(const dtNavMesh& nav, const float* va, const float* vb,
+								   const dtMeshTile* tile, const int side, dtPolyRef* con, const int maxcon)
+{
+	const int axis = (side == 0 || side == 4) ? 2 : 0;
+	const float apos = (side == 0 || side == 4) ? va[0] : va[2];
+	const float amin = dtMin(va[axis], vb[axis]), amax = dtMax(va[axis], vb[axis]);
+	const float ay0 = va[axis] < vb[axis] ? va[1] : vb[1], ay1 = va[axis] < vb[axis] ? vb[1] : va[1];
+	const float climb = tile->header->walkableClimb;
+	int n = 0;
+	for (int i = 0; i < tile->header->polyCount; ++i)
+	{
+		const dtPoly* poly = &tile->polys[i];
+		for (int j = 0; j < poly->vertCount; ++j)
+		{
+			if (poly->neis[j] != (DT_EXT_LINK | side))
+				continue;
+			const float* vc = &tile->verts[poly->verts[j]*3];
+			const float* vd = &tile->verts[poly->verts[(j+1) % poly->vertCount]*3];
+			if (dtAbs(apos - ((side == 0 || side == 4) ? vc[0] : vc[2])) > 0.01f)
+				continue;
+			const float bmin = dtMin(vc[axis], vd[axis]), bmax = dtMax(vc[axis], vd[axis]);
+			const float by0 = vc[axis] < vd[axis] ? vc[1] : vd[1], by1 = vc[axis] < vd[axis] ? vd[1] : vc[1];
+			const float minx = dtMax(amin+0.01f, bmin+0.01f), maxx = dtMin(amax-0.01f, bmax-0.01f);
+			if (minx > maxx)
+				continue;
+			const float ad = (ay1-ay0) / (amax-amin), ak = ay0 - ad*amin;
+			const float bd = (by1-by0) / (bmax-bmin), bk = by0 - bd*bmin;
+			const float dmin = (bd*minx + bk) - (ad*minx + ak);
+			const float dmax = (bd*maxx + bk) - (ad*maxx + ak);
+			const float thr = dtSqr(climb*2);
+			if (!(dmin*dmax < 0) && dmin*dmin > thr && dmax*dmax > thr)
+				continue;
+			if (n < maxcon)
+				con[n++] = nav.getPolyRefBase(tile) | (dtPolyRef)i;
+			break;
+		}
+	}
+	return n;
+}
+
+TEST_CASE("dtNavMesh border edges")
+{
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+	const dtNavMesh& cnav = *nav;
+
+	SECTION("Edges are sorted along each side")
+	{
+		for (int i = 0; i < cnav.getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = cnav.getTile(i);
+			if (!tile->header)
+				continue;
+			int portals = 0;
+			for (int j = 0; j < tile->header->polyCount; ++j)
+			{
+				for (int k = 0; k < tile->polys[j].vertCount; ++k)
+				{
+					if (tile->polys[j].neis[k] & DT_EXT_LINK)
+						portals++;
+				}
+			}
+			REQUIRE(tile->header->borderEdgeCount == portals);
+			for (int j = 0; j < tile->header->borderEdgeCount; ++j)
+			{
+				const dtBorderEdge& edge = tile->borderEdges[j];
+				const dtPoly& poly = tile->polys[edge.poly];
+				REQUIRE(poly.neis[edge.edge] == (DT_EXT_LINK | edge.side));
+				REQUIRE(edge.min <= edge.max);
+				if (j > 0 && tile->borderEdges[j-1].side == edge.side)
+				{
+					REQUIRE(tile->borderEdges[j-1].min <= edge.min);
+					REQUIRE(edge.reach == dtMax(tile->borderEdges[j-1].reach, edge.max));
+				}
+				else
+				{
+					REQUIRE((j == 0 || tile->borderEdges[j-1].side < edge.side));
+					REQUIRE(edge.reach == edge.max);
+				}
+			}
+		}
+	}
+
+	SECTION("Links match a scan of all polygons")
+	{
+		int nlinks = 0;
+		for (int i = 0; i < cnav.getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = cnav.getTile(i);
+			if (!tile->header)
+				continue;
+			for (int j = 0; j < tile->header->polyCount; ++j)
+			{
+				const dtPoly* poly = &tile->polys[j];
+				for (int k = 0; k < poly->vertCount; ++k)
+				{
+					if (!(poly->neis[k] & DT_EXT_LINK))
+						continue;
+					const int side = poly->neis[k] & 0xff;
+					const int dx[] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+					const int dy[] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+					const dtMeshTile* neis[32];
+					const int nneis = cnav.getTilesAt(tile->header->x + dx[side], tile->header->y + dy[side], neis, 32);
+
+					std::vector<dtPolyRef> expected;
+					for (int n = 0; n < nneis; ++n)
+					{
+						dtPolyRef con[4];
+						const int ncon = findTestConnectingPolys(cnav, &tile->verts[poly->verts[k]*3],
+																 &tile->verts[poly->verts[(k+1) % poly->vertCount]*3],
+																 neis[n], dtOppositeTile(side), con, 4);
+						expected.insert(expected.end(), con, con + ncon);
+					}
+					std::vector<dtPolyRef> links;
+					for (unsigned int l = poly->firstLink; l != DT_NULL_LINK; l = tile->links[l].next)
+					{
+						if (tile->links[l].edge == k)
+							links.push_back(tile->links[l].ref);
+					}
+					std::sort(expected.begin(), expected.end());
+					std::sort(links.begin(), links.end());
+					REQUIRE(links == expected);
+					nlinks += (int)links.size();
+				}
+			}
+		}
+		REQUIRE(nlinks > 0);
+	}
+
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMesh benchmark connecting tiles", "[.][benchmark]")
+{
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+	const dtNavMesh& cnav = *nav;
+
+	// Re-add the tiles without ownership of their data, the mesh gets it back in the last round.
+	for (int i = 0; i < nav->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = cnav.getTile(i);
+		if (!tile->header)
+			continue;
+		const int dataSize = tile->dataSize;
+		unsigned char* data = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_PERM);
+		REQUIRE(data != 0);
+		memcpy(data, tile->data, dataSize);
+		const dtTileRef ref = nav->getTileRef(tile);
+		REQUIRE(dtStatusSucceed(nav->removeTile(ref, 0, 0)));
+		REQUIRE(dtStatusSucceed(nav->addTile(data, dataSize, 0, ref, 0)));
+	}
+
+	const int rounds = 20;
+	int ntiles = 0;
+	const clock_t begin = clock();
+	for (int r = 0; r < rounds; ++r)
+	{
+		for (int i = 0; i < nav->getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = cnav.getTile(i);
+			if (!tile->header)
+				continue;
+			unsigned char* data = 0;
+			int dataSize = 0;
+			const dtTileRef ref = nav->getTileRef(tile);
+			REQUIRE(dtStatusSucceed(nav->removeTile(ref, &data, &dataSize)));
+			REQUIRE(dtStatusSucceed(nav->addTile(data, dataSize, r == rounds-1 ? DT_TILE_FREE_DATA : 0, ref, 0)));
+			ntiles++;
+		}
+	}
+	const double ms = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+	printf("BM_connectTile       %d tiles in %8.2f ms: %8.2f us/tile\n", ntiles, ms, ms * 1000.0 / ntiles);
+
+	dtFreeNavMesh(nav);
+}
+
+// An arena that hands out memory from a single block and never reuses it, so everything
+// allocated from it is released at once by freeing the block.
+struct TestArenaAllocator : public dtAllocator
+{
+	unsigned char* block;
+	size_t capacity, used;
+	int live;
+
+	explicit TestArenaAllocator(size_t size) : block(new unsigned char[size]), capacity(size), used(0), live(0) {}
+	~TestArenaAllocator() { delete [] block; }
+
+	void* allocate(size_t size, dtAllocHint /*hint*/)
+	{
+		const size_t begin = (used + 15) & ~(size_t)15;
+		if (begin + size > capacity)
+			return 0;
+		used = begin + size;
+		live++;
+		return block + begin;
+	}
+
+	void deallocate(void* ptr)
+	{
+		REQUIRE((unsigned char*)ptr >= block);
+		REQUIRE((unsigned char*)ptr < block + capacity);
+		live--;
+	}
+};
+
+static int testGlobalAllocs = 0;
+
+static void* countingAlloc(size_t size, dtAllocHint /*hint*/)
+{
+	testGlobalAllocs++;
+	return malloc(size);
+}
+
+static void countingFree(void* ptr)
+{
+	free(ptr);
+}
+
+// Returns the center of the first polygon of the tile.
+static dtPolyRef getTestTileCenter(const dtNavMesh& nav, const dtMeshTile* tile, float* center)
+{
+	const dtPoly& poly = tile->polys[0];
+	dtVset(center, 0, 0, 0);
+	for (int i = 0; i < poly.vertCount; ++i)
+		dtVadd(center, center, &tile->verts[poly.verts[i]*3]);
+	dtVscale(center, center, 1.0f / poly.vertCount);
+	return nav.getPolyRefBase(tile);
+}
+
+TEST_CASE("dtNavMesh allocators")
+{
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+	const dtNavMesh& cnav = *nav;
+
+	TestArenaAllocator arena(64*1024*1024);
+	testGlobalAllocs = 0;
+	dtAllocSetCustom(countingAlloc, countingFree);
+
+	// Copies the tiles into a navigation mesh that uses the arena.
+	dtNavMesh* arenaNav = dtAllocNavMesh(&arena);
+	REQUIRE(arenaNav != 0);
+	REQUIRE(arenaNav->getAllocator() == &arena);
+	REQUIRE(dtStatusSucceed(arenaNav->init(nav->getParams())));
+	const dtMeshTile* tiles[256];
+	int ntiles = 0;
+	for (int i = 0; i < cnav.getMaxTiles() && ntiles < 256; ++i)
+	{
+		const dtMeshTile* tile = cnav.getTile(i);
+		if (!tile->header || tile->header->polyCount == 0)
+			continue;
+		unsigned char* data = (unsigned char*)dtAlloc(tile->dataSize, DT_ALLOC_PERM, &arena);
+		REQUIRE(data != 0);
+		memcpy(data, tile->data, tile->dataSize);
+		REQUIRE(dtStatusSucceed(arenaNav->addTile(data, tile->dataSize, DT_TILE_FREE_DATA, nav->getTileRef(tile), 0)));
+		tiles[ntiles++] = tile;
+	}
+	REQUIRE(ntiles > 1);
+	compareTestLinks(*nav, *arenaNav);
+
+	dtNavMeshQuery* arenaQuery = dtAllocNavMeshQuery(&arena);
+	REQUIRE(arenaQuery != 0);
+	REQUIRE(arenaQuery->getAllocator() == &arena);
+	REQUIRE(dtStatusSucceed(arenaQuery->init(arenaNav, TEST_MAX_NODES, DT_NODE_QUEUE_RADIX)));
+	REQUIRE(dtStatusSucceed(arenaQuery->initSlicedSearches(2, TEST_MAX_NODES)));
+	REQUIRE(testGlobalAllocs == 0);
+	dtAllocSetCustom(0, 0);
+	REQUIRE(arena.live > 0);
+
+	SECTION("Paths do not change")
+	{
+		dtQueryFilter filter;
+		dtNavMeshQuery query;
+		REQUIRE(dtStatusSucceed(query.init(nav, TEST_MAX_NODES)));
+		dtPolyRef path[TEST_MAX_PATH], arenaPath[TEST_MAX_PATH];
+		for (int i = 0; i < ntiles; ++i)
+		{
+			float startPos[3], endPos[3];
+			const dtPolyRef startRef = getTestTileCenter(cnav, tiles[i], startPos);
+			const dtPolyRef endRef = getTestTileCenter(cnav, tiles[(i*7+3) % ntiles], endPos);
+			int npath = 0, narena = 0;
+			const dtStatus status = query.findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, TEST_MAX_PATH);
+			REQUIRE(arenaQuery->findPath(startRef, endRef, startPos, endPos, &filter, arenaPath, &narena, TEST_MAX_PATH) == status);
+			REQUIRE(narena == npath);
+			REQUIRE(memcmp(path, arenaPath, sizeof(dtPolyRef)*npath) == 0);
+		}
+	}
+
+	SECTION("Dequantized tiles are allocated from the arena")
+	{
+		const dtMeshTile* tile = tiles[0];
+		const dtTileRef ref = arenaNav->getTileRefAt(tile->header->x, tile->header->y, tile->header->layer);
+		REQUIRE(dtStatusSucceed(arenaNav->removeTile(ref, 0, 0)));
+
+		unsigned char* quantized = 0;
+		int quantizedSize = 0;
+		REQUIRE(dtQuantizeNavMeshData(tile->data, tile->dataSize, &quantized, &quantizedSize));
+		unsigned char* data = 0;
+		int dataSize = 0;
+		REQUIRE(dtDequantizeNavMeshData(quantized, quantizedSize, &data, &dataSize, &arena));
+		dtFree(quantized);
+		REQUIRE(data >= arena.block);
+		REQUIRE(data < arena.block + arena.capacity);
+		REQUIRE(dtStatusSucceed(arenaNav->addTile(data, dataSize, DT_TILE_FREE_DATA, ref, 0)));
+	}
+
+	SECTION("Tables take their memory from the allocator of the navmesh")
+	{
+		dtQueryFilter filter;
+		float startPos[3], endPos[3];
+		const dtPolyRef startRef = getTestTileCenter(cnav, tiles[0], startPos);
+		const dtPolyRef endRef = getTestTileCenter(cnav, tiles[ntiles-1], endPos);
+
+		const int live = arena.live;
+		testGlobalAllocs = 0;
+		dtAllocSetCustom(countingAlloc, countingFree);
+		{
+			dtTileTracker tracker;
+			REQUIRE(dtStatusSucceed(tracker.init(arenaNav)));
+			dtIslandTable islands;
+			REQUIRE(dtStatusSucceed(islands.init(arenaNav, &filter)));
+			REQUIRE(dtStatusSucceed(islands.update()));
+			dtLandmarkTable landmarks;
+			REQUIRE(dtStatusSucceed(landmarks.init(arenaNav, &filter, 2)));
+			dtTileGraph graph;
+			REQUIRE(dtStatusSucceed(graph.init(arenaNav, &filter)));
+			dtFlowField field;
+			REQUIRE(dtStatusSucceed(field.init(arenaNav, &filter)));
+			REQUIRE(dtStatusSucceed(field.build(endRef, endPos, FLT_MAX, FLT_MAX)));
+			dtRandomPointTable points;
+			REQUIRE(dtStatusSucceed(points.init(arenaNav, &filter)));
+			REQUIRE(dtStatusSucceed(points.update()));
+			dtPathCache cache;
+			REQUIRE(dtStatusSucceed(cache.init(arenaNav, 16, TEST_MAX_PATH)));
+			dtPolyRef path[TEST_MAX_PATH];
+			int npath = 0;
+			REQUIRE(dtStatusSucceed(cache.findPath(arenaQuery, startRef, endRef, startPos, endPos, &filter, path, &npath, TEST_MAX_PATH)));
+			dtPolyMaskFilter mask;
+			REQUIRE(dtStatusSucceed(mask.init(arenaNav, &filter)));
+			REQUIRE(dtStatusSucceed(mask.setPolyExcluded(startRef, true)));
+			REQUIRE(arena.live > live);
+		}
+		REQUIRE(testGlobalAllocs == 0);
+		dtAllocSetCustom(0, 0);
+		REQUIRE(arena.live == live);
+	}
+
+	SECTION("Running out of the budget fails the allocation")
+	{
+		// The tile position lookup fits, the first page of tile slots does not.
+		TestArenaAllocator small(4096);
+		dtNavMesh* smallNav = dtAllocNavMesh(&small);
+		REQUIRE(smallNav != 0);
+		REQUIRE(dtStatusSucceed(smallNav->init(nav->getParams())));
+		REQUIRE(smallNav->addTile(tiles[0]->data, tiles[0]->dataSize, 0, 0, 0) == (DT_FAILURE | DT_OUT_OF_MEMORY));
+		REQUIRE(smallNav->getTileSlotCount() == 0);
+		dtFreeNavMesh(smallNav);
+		REQUIRE(small.live == 0);
+	}
+
+	// Everything allocated from the arena is returned to it.
+	dtFreeNavMeshQuery(arenaQuery);
+	dtFreeNavMesh(arenaNav);
+	REQUIRE(arena.live == 0);
+
+	dtFreeNavMesh(nav);
+}
+
+// Requires the tiles of both navmeshes to be in the same slots and their polygons to have the
+// same links, comparing the references by their tile and polygon indices.
+static void compareTestLinkIndices(const dtNavMesh& a, const dtNavMesh& b)
+{
+	const int count = dtMax(a.getTileSlotCount(), b.getTileSlotCount());
+	for (int i = 0; i < count; ++i)
+	{
+		const dtMeshTile* ta = a.getTile(i);
+		const dtMeshTile* tb = b.getTile(i);
+		REQUIRE((ta->header != 0) == (tb->header != 0));
+		if (!ta->header)
+			continue;
+		for (int j = 0; j < ta->header->polyCount; ++j)
+		{
+			unsigned int ka = ta->polys[j].firstLink, kb = tb->polys[j].firstLink;
+			for (; ka != DT_NULL_LINK && kb != DT_NULL_LINK; ka = ta->links[ka].next, kb = tb->links[kb].next)
+			{
+				const dtLink& la = ta->links[ka];
+				const dtLink& lb = tb->links[kb];
+				REQUIRE(a.decodePolyIdTile(la.ref) == b.decodePolyIdTile(lb.ref));
+				REQUIRE(a.decodePolyIdPoly(la.ref) == b.decodePolyIdPoly(lb.ref));
+				REQUIRE(la.edge == lb.edge);
+				REQUIRE(la.side == lb.side);
+			}
+			REQUIRE(ka == DT_NULL_LINK);
+			REQUIRE(kb == DT_NULL_LINK);
+		}
+	}
+}
+
+// Adds a copy of the tile data, allocated with the allocator of the navmesh, at the location and
+// in the slot, or in a free slot if the slot is negative.
+static dtStatus addTestTileCopy(dtNavMesh& nav, const dtMeshTile* tile, const int x, const int y,
+								const int slot, dtTileRef* result)
+{
+	unsigned char* data = (unsigned char*)dtAlloc(tile->dataSize, DT_ALLOC_PERM, nav.getAllocator());
+	REQUIRE(data != 0);
+	memcpy(data, tile->data, tile->dataSize);
+	dtMeshHeader* header = (dtMeshHeader*)data;
+	header->x = x;
+	header->y = y;
+	const dtTileRef lastRef = slot >= 0 ? (dtTileRef)nav.encodePolyId(tile->salt, (unsigned int)slot, 0) : 0;
+	const dtStatus status = nav.addTile(data, tile->dataSize, DT_TILE_FREE_DATA, lastRef, result);
+	if (dtStatusFailed(status))
+		dtFree(data, nav.getAllocator());
+	return status;
+}
+
+TEST_CASE("dtNavMesh large worlds")
+{
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+	const dtNavMesh& cnav = *nav;
+
+	const dtMeshTile* tiles[256];
+	int ntiles = 0;
+	int maxPolys = 1;
+	for (int i = 0; i < cnav.getMaxTiles() && ntiles < 256; ++i)
+	{
+		const dtMeshTile* tile = cnav.getTile(i);
+		if (!tile->header || tile->header->polyCount == 0)
+			continue;
+		tiles[ntiles++] = tile;
+		maxPolys = dtMax(maxPolys, tile->header->polyCount);
+	}
+	REQUIRE(ntiles > 1);
+
+	// With 64-bit references all tiles the references can address are allowed, with 32-bit
+	// references the bits not needed by the polygons go to the tiles.
+	dtNavMeshParams params = *nav->getParams();
+#ifdef DT_POLYREF64
+	params.maxTiles = 0;
+	const int maxTiles = 1 << DT_TILE_BITS;
+#else
+	params.maxPolys = maxPolys;
+	params.maxTiles = 1 << (22 - dtIlog2(dtNextPow2((unsigned int)maxPolys)));
+	const int maxTiles = params.maxTiles;
+#endif
+	REQUIRE(maxTiles > cnav.getMaxTiles());
+
+	TestArenaAllocator arena(64*1024*1024);
+	dtNavMesh* large = dtAllocNavMesh(&arena);
+	REQUIRE(large != 0);
+	REQUIRE(dtStatusSucceed(large->init(&params)));
+	REQUIRE(large->getMaxTiles() == maxTiles);
+	REQUIRE(large->getParams()->maxTiles == maxTiles);
+
+	// Nothing is allocated for the tile slots up front.
+	REQUIRE(arena.used < 4096);
+	REQUIRE(large->getTileSlotCount() == 0);
+	REQUIRE(large->getTile(maxTiles-1)->header == 0);
+
+	// Copies the tiles into their slots.
+	size_t dataSize = 0;
+	for (int i = 0; i < ntiles; ++i)
+	{
+		const dtMeshTile* tile = tiles[i];
+		REQUIRE(dtStatusSucceed(addTestTileCopy(*large, tile, tile->header->x, tile->header->y, (int)tile->index, 0)));
+		dataSize += (tile->dataSize + 15) & ~15;
+	}
+	const int slotCount = (int)tiles[ntiles-1]->index + 1;
+	REQUIRE(large->getTileSlotCount() == slotCount);
+	REQUIRE(arena.used - dataSize < 64*1024);
+	compareTestLinkIndices(cnav, *large);
+
+	SECTION("Paths match the dense navmesh")
+	{
+		dtQueryFilter filter;
+		dtNavMeshQuery query, largeQuery;
+		REQUIRE(dtStatusSucceed(query.init(nav, TEST_MAX_NODES)));
+		REQUIRE(dtStatusSucceed(largeQuery.init(large, TEST_MAX_NODES)));
+		dtPolyRef path[TEST_MAX_PATH], largePath[TEST_MAX_PATH];
+		for (int i = 0; i < ntiles; ++i)
+		{
+			float startPos[3], endPos[3];
+			const dtMeshTile* start = tiles[i];
+			const dtMeshTile* end = tiles[(i*7+3) % ntiles];
+			const dtPolyRef startRef = getTestTileCenter(cnav, start, startPos);
+			const dtPolyRef endRef = getTestTileCenter(cnav, end, endPos);
+			const dtPolyRef largeStartRef = large->getPolyRefBase(large->getTile(start->index));
+			const dtPolyRef largeEndRef = large->getPolyRefBase(large->getTile(end->index));
+			int npath = 0, nlarge = 0;
+			const dtStatus status = query.findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, TEST_MAX_PATH);
+			REQUIRE(largeQuery.findPath(largeStartRef, largeEndRef, startPos, endPos, &filter, largePath, &nlarge, TEST_MAX_PATH) == status);
+			REQUIRE(nlarge == npath);
+			for (int j = 0; j < npath; ++j)
+			{
+				REQUIRE(large->decodePolyIdTile(largePath[j]) == cnav.decodePolyIdTile(path[j]));
+				REQUIRE(large->decodePolyIdPoly(largePath[j]) == cnav.decodePolyIdPoly(path[j]));
+			}
+		}
+	}
+
+	SECTION("Slots are created as they are used")
+	{
+		// References to slots that were never used are invalid.
+		const int farSlot = slotCount + 1000;
+		const dtPolyRef farRef = large->encodePolyId(1, (unsigned int)farSlot, 0);
+		REQUIRE(large->getTile(farSlot)->header == 0);
+		REQUIRE(large->getTileByRef((dtTileRef)farRef) == 0);
+		REQUIRE(!large->isValidPolyRef(farRef));
+		REQUIRE(large->removeTile((dtTileRef)farRef, 0, 0) == (DT_FAILURE | DT_INVALID_PARAM));
+
+		// Moving a tile to a far slot creates the slots up to it.
+		const dtMeshTile* moved = tiles[0];
+		REQUIRE(dtStatusSucceed(large->removeTile(large->getTileRefAt(moved->header->x, moved->header->y, moved->header->layer), 0, 0)));
+		dtTileRef ref = 0;
+		REQUIRE(dtStatusSucceed(addTestTileCopy(*large, moved, moved->header->x, moved->header->y, farSlot, &ref)));
+		REQUIRE(large->decodePolyIdTile((dtPolyRef)ref) == (unsigned int)farSlot);
+		REQUIRE(large->getTileSlotCount() == farSlot + 1);
+		REQUIRE(large->getTileByRef(ref) == large->getTileAt(moved->header->x, moved->header->y, moved->header->layer));
+
+		// A removed slot is reused first, then the lowest free slot.
+		const dtMeshTile* readded = tiles[ntiles-1];
+		REQUIRE(dtStatusSucceed(large->removeTile(large->getTileRefAt(readded->header->x, readded->header->y, readded->header->layer), 0, 0)));
+		REQUIRE(dtStatusSucceed(addTestTileCopy(*large, readded, readded->header->x, readded->header->y, -1, &ref)));
+		REQUIRE(large->decodePolyIdTile((dtPolyRef)ref) == readded->index);
+		REQUIRE(dtStatusSucceed(addTestTileCopy(*large, readded, 1 << 20, 1 << 20, -1, &ref)));
+		REQUIRE(large->decodePolyIdTile((dtPolyRef)ref) == moved->index);
+		REQUIRE(dtStatusSucceed(addTestTileCopy(*large, readded, (1 << 20) + 2, 1 << 20, -1, &ref)));
+		REQUIRE(large->decodePolyIdTile((dtPolyRef)ref) == (unsigned int)slotCount);
+
+		// The moved tile is still connected to its neighbours.
+		dtQueryFilter filter;
+		dtNavMeshQuery query, largeQuery;
+		REQUIRE(dtStatusSucceed(query.init(nav, TEST_MAX_NODES)));
+		REQUIRE(dtStatusSucceed(largeQuery.init(large, TEST_MAX_NODES)));
+		float startPos[3], endPos[3];
+		const dtPolyRef startRef = getTestTileCenter(cnav, moved, startPos);
+		const dtPolyRef endRef = getTestTileCenter(cnav, tiles[1], endPos);
+		const dtPolyRef largeStartRef = large->getPolyRefBase(large->getTile(farSlot));
+		const dtPolyRef largeEndRef = large->getPolyRefBase(large->getTile(tiles[1]->index));
+		dtPolyRef path[TEST_MAX_PATH], largePath[TEST_MAX_PATH];
+		int npath = 0, nlarge = 0;
+		const dtStatus status = query.findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, TEST_MAX_PATH);
+		REQUIRE(largeQuery.findPath(largeStartRef, largeEndRef, startPos, endPos, &filter, largePath, &nlarge, TEST_MAX_PATH) == status);
+		REQUIRE(nlarge == npath);
+	}
+
+	SECTION("The position lookup grows with the tiles")
+	{
+		// Copies of the smallest tile, spread far apart so they have no neighbours.
+		const dtMeshTile* small = tiles[0];
+		for (int i = 1; i < ntiles; ++i)
+		{
+			if (tiles[i]->dataSize < small->dataSize)
+				small = tiles[i];
+		}
+		const int ncopies = 1000;
+		static dtTileRef copies[ncopies];
+		for (int i = 0; i < ncopies; ++i)
+			REQUIRE(dtStatusSucceed(addTestTileCopy(*large, small, (i+1)*100003, -(i+1)*7919, -1, &copies[i])));
+		REQUIRE(large->getTileSlotCount() == slotCount + ncopies);
+
+		for (int i = 0; i < ncopies; ++i)
+		{
+			REQUIRE(large->getTileRefAt((i+1)*100003, -(i+1)*7919, small->header->layer) == copies[i]);
+			REQUIRE(large->getTileByRef(copies[i])->header->polyCount == small->header->polyCount);
+		}
+
+		for (int i = 0; i < ncopies; ++i)
+			REQUIRE(dtStatusSucceed(large->removeTile(copies[i], 0, 0)));
+		for (int i = 0; i < ncopies; ++i)
+			REQUIRE(large->getTileRefAt((i+1)*100003, -(i+1)*7919, small->header->layer) == 0);
+		compareTestLinkIndices(cnav, *large);
+	}
+
+	dtFreeNavMesh(large);
+	REQUIRE(arena.live == 0);
+
+	dtFreeNavMesh(nav);
+}
@@ -0,0 +1,152 @@
+#include <math.h>
+#include <string.h>
+
+#include "catch.hpp"
+
+#include "DetourAlloc.h"
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourNavMeshQuery.h"
+
+#include "TestNavMesh.h"
+
+static const int TEST_MAX_PATH = 256;
+static const int TEST_PATH_PAIRS = 300;
+
+// Requires the vertices to be within the error of the original ones, allowing for float rounding.
+static void checkQuantizedVerts(const float* verts, const float* orig, const int nverts, const float* error)
+{
+	for (int i = 0; i < nverts*3; ++i)
+		REQUIRE(fabsf(verts[i] - orig[i]) <= error[i % 3] + fabsf(orig[i]) * 1e-6f);
+}
+
+// Requires the vertices on the voxel grid to be restored exactly along x and z, allowing for float rounding.
+static void checkGridVerts(const float* verts, const float* orig, const int nverts)
+{
+	for (int i = 0; i < nverts; ++i)
+	{
+		REQUIRE(fabsf(verts[i*3+0] - orig[i*3+0]) <= fabsf(orig[i*3+0]) * 1e-6f + 1e-6f);
+		REQUIRE(fabsf(verts[i*3+2] - orig[i*3+2]) <= fabsf(orig[i*3+2]) * 1e-6f + 1e-6f);
+	}
+}
+
+TEST_CASE("dtQuantizeNavMeshData")
+{
+	seedTestRandom();
+
+	TestBuildSettings settings;
+	TestGeom geom;
+	REQUIRE(loadTestGeom("nav_test.obj", geom));
+	dtNavMeshParams params;
+	calcTestNavMeshParams(geom, settings, params);
+	int tw = 0, th = 0;
+	calcTestTileCount(geom, settings, tw, th);
+
+	// The same tiles added as built and after being quantized.
+	dtNavMesh* nav = dtAllocNavMesh();
+	dtNavMesh* restored = dtAllocNavMesh();
+	REQUIRE(dtStatusSucceed(nav->init(&params)));
+	REQUIRE(dtStatusSucceed(restored->init(&params)));
+
+	int size = 0, quantizedSize = 0;
+	float maxError[3] = { 0, 0, 0 };
+	for (int y = 0; y < th; ++y)
+	{
+		for (int x = 0; x < tw; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* data = buildTestTile(geom, settings, x, y, &dataSize);
+			if (!data)
+				continue;
+
+			unsigned char* qdata = 0;
+			int qdataSize = 0;
+			REQUIRE(dtQuantizeNavMeshData(data, dataSize, &qdata, &qdataSize));
+			REQUIRE(qdataSize < dataSize);
+			REQUIRE(!dtQuantizeNavMeshData(qdata, qdataSize, &qdata, &qdataSize));
+			float error[3];
+			REQUIRE(!dtGetQuantizedNavMeshDataError(data, dataSize, error));
+			REQUIRE(dtGetQuantizedNavMeshDataError(qdata, qdataSize, error));
+			dtVmax(maxError, error);
+
+			// Quantized data is not accepted until it is converted back.
+			REQUIRE(restored->addTile(qdata, qdataSize, 0, 0, 0) == (DT_FAILURE | DT_WRONG_VERSION));
+
+			unsigned char* rdata = 0;
+			int rdataSize = 0;
+			REQUIRE(!dtDequantizeNavMeshData(data, dataSize, &rdata, &rdataSize));
+			REQUIRE(dtDequantizeNavMeshData(qdata, qdataSize, &rdata, &rdataSize));
+			REQUIRE(rdataSize == dataSize);
+			size += dataSize;
+			quantizedSize += qdataSize;
+			dtFree(qdata);
+
+			dtTileRef ref = 0, rref = 0;
+			REQUIRE(dtStatusSucceed(nav->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, &ref)));
+			REQUIRE(dtStatusSucceed(restored->addTile(rdata, rdataSize, DT_TILE_FREE_DATA, 0, &rref)));
+
+			const dtMeshTile* tile = nav->getTileByRef(ref);
+			const dtMeshTile* rtile = restored->getTileByRef(rref);
+			checkQuantizedVerts(rtile->verts, tile->verts, tile->header->vertCount, error);
+			checkGridVerts(rtile->verts, tile->verts, tile->header->vertCount);
+			checkQuantizedVerts(rtile->detailVerts, tile->detailVerts, tile->header->detailVertCount, error);
+			REQUIRE(memcmp(rtile->polys, tile->polys, sizeof(dtPoly)*tile->header->polyCount) == 0);
+			REQUIRE(memcmp(rtile->bvTree, tile->bvTree, sizeof(dtBVNode)*tile->header->bvNodeCount) == 0);
+			REQUIRE(memcmp(rtile->detailTris, tile->detailTris, 4*tile->header->detailTriCount) == 0);
+		}
+	}
+	REQUIRE(size > 0);
+	REQUIRE(quantizedSize < size);
+
+	// The steps are fractions of the cell size.
+	REQUIRE(maxError[0] <= settings.cellSize*0.5f);
+	REQUIRE(maxError[1] <= settings.cellSize*0.5f);
+	REQUIRE(maxError[2] <= settings.cellSize*0.5f);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query, rquery;
+	REQUIRE(dtStatusSucceed(query.init(nav, 2048)));
+	REQUIRE(dtStatusSucceed(rquery.init(restored, 2048)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	// The queries find the same polygons, and positions within the error.
+	const float tolerance = dtMax(maxError[0], dtMax(maxError[1], maxError[2])) * 4.0f + 1e-4f;
+	const float halfExtents[3] = { 2.0f, 4.0f, 2.0f };
+	for (int i = 0; i < npairs*2; ++i)
+	{
+		dtPolyRef ref = 0, rref = 0;
+		float pt[3], rpt[3];
+		REQUIRE(dtStatusSucceed(query.findNearestPoly(&pos[i*3], halfExtents, &filter, &ref, pt)));
+		REQUIRE(dtStatusSucceed(rquery.findNearestPoly(&pos[i*3], halfExtents, &filter, &rref, rpt)));
+		REQUIRE(rref == ref);
+		REQUIRE(dtVdist(pt, rpt) <= tolerance);
+
+		float h = 0.0f, rh = 0.0f;
+		REQUIRE(dtStatusSucceed(query.getPolyHeight(ref, &pos[i*3], &h)));
+		REQUIRE(dtStatusSucceed(rquery.getPolyHeight(ref, &pos[i*3], &rh)));
+		REQUIRE(fabsf(h - rh) <= tolerance);
+	}
+
+	// The search fixes the node positions on first visit, so paths of nearly equal cost may swap,
+	// but the same ends are reached.
+	for (int i = 0; i < npairs; ++i)
+	{
+		dtPolyRef path[TEST_MAX_PATH], rpath[TEST_MAX_PATH];
+		int npath = 0, nrpath = 0;
+		const dtStatus status = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, path, &npath, TEST_MAX_PATH);
+		const dtStatus rstatus = rquery.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, rpath, &nrpath, TEST_MAX_PATH);
+		REQUIRE(rstatus == status);
+		REQUIRE(isTestPathConnected(*restored, rpath, nrpath));
+		REQUIRE(rpath[0] == path[0]);
+		if (status == DT_SUCCESS)
+			REQUIRE(rpath[nrpath-1] == path[npath-1]);
+	}
+
+	dtFreeNavMesh(restored);
+	dtFreeNavMesh(nav);
+}
@@ -0,0 +1,1464 @@
+#include <float.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "catch.hpp"
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourNode.h"
+#include "DetourLandmarks.h"
+#include "DetourIslands.h"
+
+#include "TestNavMesh.h"
+
+static const int TEST_MAX_NODES = 2048;
+static const int TEST_MAX_PATH = 256;
+static const int TEST_PATH_PAIRS = 500;
+
+// Returns the cost of walking the path corridor through the midpoints of its portals.
+static float getTestCorridorCost(const dtNavMesh& nav, const dtQueryFilter& filter, const dtPolyRef* path, const int npath,
+								 const float* startPos, const float* endPos)
+{
+	float cost = 0.0f;
+	float pos[3];
+	dtVcopy(pos, startPos);
+	for (int i = 0; i < npath; ++i)
+	{
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		nav.getTileAndPolyByRefUnsafe(path[i], &tile, &poly);
+		float next[3];
+		dtVcopy(next, endPos);
+		if (i+1 < npath)
+		{
+			for (unsigned int j = poly->firstLink; j != DT_NULL_LINK; j = tile->links[j].next)
+			{
+				if (tile->links[j].ref == path[i+1])
+				{
+					nav.getLinkMidPoint(path[i], tile, poly, &tile->links[j], next);
+					break;
+				}
+			}
+		}
+		cost += filter.getCost(pos, next, 0, 0, 0, path[i], tile, poly, 0, 0, 0);
+		dtVcopy(pos, next);
+	}
+	return cost;
+}
+
+// Runs all path queries with and without the landmark heuristic and checks that they agree.
+// Returns the number of nodes visited by each variant. The path finder fixes the node positions
+// on first visit, so a different heuristic may find slightly different paths in both directions.
+static void compareLandmarkPaths(dtNavMeshQuery& plainQuery, dtNavMeshQuery& altQuery, const dtQueryFilter& filter,
+								 const int npairs, const dtPolyRef* refs, const float* pos,
+								 int& plainNodes, int& altNodes)
+{
+	plainNodes = 0;
+	altNodes = 0;
+	float plainTotal = 0.0f, altTotal = 0.0f;
+	for (int i = 0; i < npairs; ++i)
+	{
+		const dtPolyRef startRef = refs[i*2], endRef = refs[i*2+1];
+		// Same polygon paths do not touch the node pool.
+		if (startRef == endRef ||
+			!plainQuery.getAttachedNavMesh()->isValidPolyRef(startRef) ||
+			!plainQuery.getAttachedNavMesh()->isValidPolyRef(endRef))
+			continue;
+
+		dtPolyRef plainPath[TEST_MAX_PATH], altPath[TEST_MAX_PATH];
+		int nplain = 0, nalt = 0;
+		const dtStatus plainStatus = plainQuery.findPath(startRef, endRef, &pos[i*2*3], &pos[(i*2+1)*3],
+														 &filter, plainPath, &nplain, TEST_MAX_PATH);
+		const float plainCost = getTestPathCost(plainQuery, endRef);
+		plainNodes += plainQuery.getNodePool()->getNodeCount();
+		const dtStatus altStatus = altQuery.findPath(startRef, endRef, &pos[i*2*3], &pos[(i*2+1)*3],
+													 &filter, altPath, &nalt, TEST_MAX_PATH);
+		const float altCost = getTestPathCost(altQuery, endRef);
+		altNodes += altQuery.getNodePool()->getNodeCount();
+
+		REQUIRE(dtStatusSucceed(plainStatus));
+		REQUIRE(dtStatusSucceed(altStatus));
+		REQUIRE((plainCost < 0.0f) == (altCost < 0.0f));
+		REQUIRE(dtStatusDetail(plainStatus, DT_PARTIAL_RESULT) == dtStatusDetail(altStatus, DT_PARTIAL_RESULT));
+		if (plainCost >= 0.0f)
+		{
+			REQUIRE(altCost <= plainCost * 1.2f);
+			plainTotal += plainCost;
+			altTotal += altCost;
+		}
+	}
+	REQUIRE(altTotal <= plainTotal * 1.01f);
+}
+
+TEST_CASE("dtNavMeshQuery open list types")
+{
+	seedTestRandom();
+
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery heapQuery;
+	dtNavMeshQuery radixQuery;
+	REQUIRE(dtStatusSucceed(heapQuery.init(nav, TEST_MAX_NODES, DT_NODE_QUEUE_HEAP)));
+	REQUIRE(dtStatusSucceed(radixQuery.init(nav, TEST_MAX_NODES, DT_NODE_QUEUE_RADIX)));
+	REQUIRE(dtStatusFailed(heapQuery.init(nav, TEST_MAX_NODES, 42)));
+	REQUIRE(dtStatusSucceed(heapQuery.init(nav, TEST_MAX_NODES, DT_NODE_QUEUE_HEAP)));
+
+	dtPolyRef refs[TEST_PATH_PAIRS*2];
+	float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(heapQuery, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	SECTION("Both open lists find the same paths")
+	{
+		for (int i = 0; i < npairs; ++i)
+		{
+			dtPolyRef heapPath[TEST_MAX_PATH], radixPath[TEST_MAX_PATH];
+			int nheap = 0, nradix = 0;
+			const dtStatus heapStatus = heapQuery.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+														   &filter, heapPath, &nheap, TEST_MAX_PATH);
+			const dtStatus radixStatus = radixQuery.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+															 &filter, radixPath, &nradix, TEST_MAX_PATH);
+			REQUIRE(dtStatusSucceed(heapStatus));
+			REQUIRE(dtStatusSucceed(radixStatus));
+			REQUIRE(dtStatusDetail(heapStatus, DT_PARTIAL_RESULT) == dtStatusDetail(radixStatus, DT_PARTIAL_RESULT));
+			REQUIRE(nheap > 0);
+			REQUIRE(nradix > 0);
+			REQUIRE(heapPath[0] == radixPath[0]);
+			if (!dtStatusDetail(heapStatus, DT_PARTIAL_RESULT))
+				REQUIRE(heapPath[nheap-1] == radixPath[nradix-1]);
+		}
+	}
+
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMeshQuery benchmark findPath with each open list", "[.][benchmark]")
+{
+	seedTestRandom();
+
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery heapQuery;
+	dtNavMeshQuery radixQuery;
+	REQUIRE(dtStatusSucceed(heapQuery.init(nav, TEST_MAX_NODES, DT_NODE_QUEUE_HEAP)));
+	REQUIRE(dtStatusSucceed(radixQuery.init(nav, TEST_MAX_NODES, DT_NODE_QUEUE_RADIX)));
+
+	dtPolyRef refs[TEST_PATH_PAIRS*2];
+	float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(heapQuery, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	dtNavMeshQuery* queries[] = { &heapQuery, &radixQuery };
+	const char* names[] = { "heap", "radix" };
+	for (int q = 0; q < 2; ++q)
+	{
+		const clock_t begin = clock();
+		int expanded = 0;
+		for (int i = 0; i < npairs; ++i)
+		{
+			dtPolyRef path[TEST_MAX_PATH];
+			int npath = 0;
+			queries[q]->findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+								 &filter, path, &npath, TEST_MAX_PATH);
+			expanded += queries[q]->getNodePool()->getNodeCount();
+		}
+		const double ms = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+		printf("BM_findPath_%-8s %d paths, %d nodes in %8.2f ms: %8.2f us/path\n",
+			   names[q], npairs, expanded, ms, ms * 1000.0 / npairs);
+	}
+
+	dtFreeNavMesh(nav);
+}
+
+// Makes some of the polygons expensive so that the straight line distance is a poor estimate.
+static void setTestExpensiveAreas(dtNavMesh* nav, dtQueryFilter& filter)
+{
+	for (int i = 0; i < nav->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = ((const dtNavMesh*)nav)->getTile(i);
+		if (!tile->header)
+			continue;
+		const dtPolyRef base = nav->getPolyRefBase(tile);
+		for (int j = 0; j < tile->header->polyCount; ++j)
+		{
+			if ((j % 3) == 0)
+				nav->setPolyArea(base | (dtPolyRef)j, 1);
+		}
+	}
+	filter.setAreaCost(1, 10.0f);
+}
+
+TEST_CASE("dtNavMeshQuery landmark heuristic")
+{
+	seedTestRandom();
+
+	dtNavMesh* nav = buildTestNavMesh("dungeon.obj");
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	setTestExpensiveAreas(nav, filter);
+
+	dtLandmarkTable* table = dtAllocLandmarkTable();
+	REQUIRE(table != 0);
+	REQUIRE(dtStatusFailed(table->init(nav, &filter, 0)));
+	REQUIRE(dtStatusFailed(table->init(nav, &filter, DT_MAX_LANDMARKS+1)));
+	REQUIRE(dtStatusSucceed(table->init(nav, &filter, 8)));
+	REQUIRE(table->getLandmarkCount() == 8);
+	for (int i = 0; i < table->getLandmarkCount(); ++i)
+		REQUIRE(nav->isValidPolyRef(table->getLandmark(i)));
+
+	dtNavMeshQuery plainQuery;
+	dtNavMeshQuery altQuery;
+	REQUIRE(dtStatusSucceed(plainQuery.init(nav, TEST_MAX_NODES)));
+	REQUIRE(dtStatusSucceed(altQuery.init(nav, TEST_MAX_NODES)));
+	altQuery.setLandmarkTable(table);
+	REQUIRE(altQuery.getLandmarkTable() == table);
+
+	dtPolyRef refs[TEST_PATH_PAIRS*2];
+	float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(plainQuery, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	SECTION("Landmarks find paths as cheap as the plain heuristic with fewer nodes")
+	{
+		int plainNodes = 0, altNodes = 0;
+		compareLandmarkPaths(plainQuery, altQuery, filter, npairs, refs, pos, plainNodes, altNodes);
+		REQUIRE(altNodes < plainNodes);
+	}
+
+	SECTION("Heuristic is a lower bound of the path cost")
+	{
+		for (int i = 0; i < npairs; ++i)
+		{
+			if (refs[i*2] == refs[i*2+1])
+				continue;
+			dtPolyRef path[TEST_MAX_PATH];
+			int npath = 0;
+			plainQuery.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+								&filter, path, &npath, TEST_MAX_PATH);
+			const float cost = getTestPathCost(plainQuery, refs[i*2+1]);
+			if (cost < 0.0f)
+				continue;
+			// The heuristic is measured between portals, allow the distance to the portals as slack.
+			REQUIRE(table->getHeuristic(refs[i*2], refs[i*2+1]) * 0.9f <= cost + 1.0f);
+		}
+	}
+
+	SECTION("Update after removing and re-adding tiles")
+	{
+		// Remove a few tiles that have polygons.
+		const int MAX_REMOVED = 4;
+		int removedX[MAX_REMOVED], removedY[MAX_REMOVED];
+		int nremoved = 0;
+		for (int i = 0; i < nav->getMaxTiles() && nremoved < MAX_REMOVED; i += 3)
+		{
+			const dtMeshTile* tile = ((const dtNavMesh*)nav)->getTile(i);
+			if (!tile->header || tile->header->polyCount == 0)
+				continue;
+			removedX[nremoved] = tile->header->x;
+			removedY[nremoved] = tile->header->y;
+			REQUIRE(dtStatusSucceed(nav->removeTile(nav->getTileRef(tile), 0, 0)));
+			nremoved++;
+		}
+		REQUIRE(nremoved > 0);
+		REQUIRE(dtStatusSucceed(table->update()));
+
+		int plainNodes = 0, altNodes = 0;
+		compareLandmarkPaths(plainQuery, altQuery, filter, npairs, refs, pos, plainNodes, altNodes);
+
+		// Build the tiles again, the polygon references change with the salt.
+		TestGeom geom;
+		REQUIRE(loadTestGeom("dungeon.obj", geom));
+		for (int i = 0; i < nremoved; ++i)
+		{
+			int dataSize = 0;
+			unsigned char* data = buildTestTile(geom, TestBuildSettings(), removedX[i], removedY[i], &dataSize);
+			REQUIRE(data != 0);
+			REQUIRE(dtStatusSucceed(nav->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+		REQUIRE(dtStatusSucceed(table->update()));
+
+		const int npairs2 = pickTestPathEnds(plainQuery, filter, TEST_PATH_PAIRS, refs, pos);
+		REQUIRE(npairs2 > 0);
+		compareLandmarkPaths(plainQuery, altQuery, filter, npairs2, refs, pos, plainNodes, altNodes);
+		REQUIRE(altNodes < plainNodes);
+
+		// The incrementally updated table must be as good as a rebuilt one.
+		dtLandmarkTable* rebuilt = dtAllocLandmarkTable();
+		REQUIRE(rebuilt != 0);
+		dtPolyRef landmarks[DT_MAX_LANDMARKS];
+		int nlandmarks = 0;
+		for (int i = 0; i < table->getLandmarkCount(); ++i)
+		{
+			// Landmarks in the removed tiles are gone for good.
+			if (nav->isValidPolyRef(table->getLandmark(i)))
+				landmarks[nlandmarks++] = table->getLandmark(i);
+		}
+		REQUIRE(nlandmarks > 0);
+		REQUIRE(dtStatusSucceed(rebuilt->init(nav, &filter, nlandmarks, landmarks)));
+		for (int i = 0; i < npairs2; ++i)
+		{
+			const float a = table->getHeuristic(refs[i*2], refs[i*2+1]);
+			const float b = rebuilt->getHeuristic(refs[i*2], refs[i*2+1]);
+			REQUIRE(a <= b + 0.01f);
+		}
+		dtFreeLandmarkTable(rebuilt);
+	}
+
+	dtFreeLandmarkTable(table);
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMeshQuery benchmark findPath with and without landmarks", "[.][benchmark]")
+{
+	seedTestRandom();
+
+	dtNavMesh* nav = buildTestNavMesh("dungeon.obj");
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	setTestExpensiveAreas(nav, filter);
+
+	dtLandmarkTable* table = dtAllocLandmarkTable();
+	REQUIRE(table != 0);
+	REQUIRE(dtStatusSucceed(table->init(nav, &filter, 8)));
+
+	dtNavMeshQuery plainQuery;
+	dtNavMeshQuery altQuery;
+	REQUIRE(dtStatusSucceed(plainQuery.init(nav, TEST_MAX_NODES)));
+	REQUIRE(dtStatusSucceed(altQuery.init(nav, TEST_MAX_NODES)));
+	altQuery.setLandmarkTable(table);
+
+	dtPolyRef refs[TEST_PATH_PAIRS*2];
+	float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(plainQuery, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	dtNavMeshQuery* queries[] = { &plainQuery, &altQuery };
+	const char* names[] = { "plain", "landmarks" };
+	for (int q = 0; q < 2; ++q)
+	{
+		const clock_t begin = clock();
+		int expanded = 0;
+		for (int i = 0; i < npairs; ++i)
+		{
+			dtPolyRef path[TEST_MAX_PATH];
+			int npath = 0;
+			queries[q]->findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+								 &filter, path, &npath, TEST_MAX_PATH);
+			expanded += queries[q]->getNodePool()->getNodeCount();
+		}
+		const double ms = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+		printf("BM_findPath_%-10s %d paths, %d nodes in %8.2f ms: %8.2f us/path (table %d bytes)\n",
+			   names[q], npairs, expanded, ms, ms * 1000.0 / npairs, table->getMemUsed());
+	}
+
+	dtFreeLandmarkTable(table);
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMeshQuery bidirectional search")
+{
+	seedTestRandom();
+
+	static const int MAX_NODES = 65535;
+	static const int MAX_CONS = 40;
+
+	// Small tiles make for long searches. The tiles are built once for all sections.
+	static TestBuildSettings settings;
+	static TestTileCache tiles;
+	if (!tiles.isBuilt())
+	{
+		settings.tileSize = 8;
+		REQUIRE(addTestOffMeshConnections("dungeon.obj", settings, MAX_CONS) > 0);
+		REQUIRE(tiles.build("dungeon.obj", settings));
+	}
+	seedTestRandom();
+	dtNavMesh* nav = tiles.createNavMesh();
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, MAX_NODES)));
+
+	static dtPolyRef refs[(TEST_PATH_PAIRS+MAX_CONS)*2];
+	static float pos[(TEST_PATH_PAIRS+MAX_CONS)*2*3];
+	int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+	// Random pairs rarely pass an off-mesh connection, query along each one too.
+	const float ext[3] = { 2.0f, 4.0f, 2.0f };
+	for (int i = 0; i < (int)settings.offMeshRads.size(); ++i)
+	{
+		for (int j = 0; j < 2; ++j)
+		{
+			const float* p = &settings.offMeshVerts[(i*2+j)*3];
+			REQUIRE(dtStatusSucceed(query.findNearestPoly(p, ext, &filter, &refs[npairs*2+j], &pos[(npairs*2+j)*3])));
+		}
+		if (refs[npairs*2] && refs[npairs*2+1])
+			npairs++;
+	}
+
+	static dtPolyRef path[TEST_MAX_PATH];
+	static dtPolyRef bidirPath[TEST_MAX_PATH];
+
+	SECTION("Finds the same paths")
+	{
+		float plainTotal = 0.0f, bidirTotal = 0.0f;
+		int compared = 0, worse = 0, offMesh = 0;
+		for (int i = 0; i < npairs; ++i)
+		{
+			const dtPolyRef startRef = refs[i*2], endRef = refs[i*2+1];
+			const float* startPos = &pos[i*2*3];
+			const float* endPos = &pos[(i*2+1)*3];
+			int npath = 0, nbidir = 0;
+			const dtStatus status = query.findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, TEST_MAX_PATH);
+			const dtStatus bidirStatus = query.findPath(startRef, endRef, startPos, endPos, &filter,
+														bidirPath, &nbidir, TEST_MAX_PATH, DT_FINDPATH_BIDIRECTIONAL);
+			REQUIRE(dtStatusSucceed(status));
+			REQUIRE(dtStatusSucceed(bidirStatus));
+			REQUIRE(!dtStatusDetail(bidirStatus, DT_OUT_OF_NODES));
+			REQUIRE(dtStatusDetail(status, DT_PARTIAL_RESULT) == dtStatusDetail(bidirStatus, DT_PARTIAL_RESULT));
+			REQUIRE(nbidir > 0);
+			REQUIRE(bidirPath[0] == startRef);
+			REQUIRE(isTestPathConnected(*nav, bidirPath, nbidir));
+			if (dtStatusDetail(status, DT_PARTIAL_RESULT))
+			{
+				REQUIRE(bidirPath[nbidir-1] != endRef);
+				continue;
+			}
+			REQUIRE(bidirPath[nbidir-1] == endRef);
+			for (int j = 0; j < nbidir; ++j)
+			{
+				const dtMeshTile* tile = 0;
+				const dtPoly* poly = 0;
+				nav->getTileAndPolyByRefUnsafe(bidirPath[j], &tile, &poly);
+				if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+					offMesh++;
+			}
+
+			const float cost = getTestCorridorCost(*nav, filter, path, npath, startPos, endPos);
+			const float bidirCost = getTestCorridorCost(*nav, filter, bidirPath, nbidir, startPos, endPos);
+			if (bidirCost > cost * 1.2f)
+				worse++;
+			compared++;
+			plainTotal += cost;
+			bidirTotal += bidirCost;
+		}
+		REQUIRE(compared > 0);
+		REQUIRE(offMesh > 0);
+		REQUIRE(worse * 50 <= compared);
+		// Both searches fix node positions on the first visit, and the two frontiers meet between
+		// positions picked from opposite directions, so the corridors only agree approximately.
+		REQUIRE(bidirTotal <= plainTotal * 1.03f);
+	}
+
+	SECTION("Sliced search finds the same paths")
+	{
+		for (int i = 0; i < npairs; ++i)
+		{
+			const dtPolyRef startRef = refs[i*2], endRef = refs[i*2+1];
+			const float* startPos = &pos[i*2*3];
+			const float* endPos = &pos[(i*2+1)*3];
+			int nbidir = 0;
+			const dtStatus bidirStatus = query.findPath(startRef, endRef, startPos, endPos, &filter,
+														bidirPath, &nbidir, TEST_MAX_PATH, DT_FINDPATH_BIDIRECTIONAL);
+
+			dtStatus status = query.initSlicedFindPath(startRef, endRef, startPos, endPos, &filter, DT_FINDPATH_BIDIRECTIONAL);
+			while (dtStatusInProgress(status))
+			{
+				int iters = 0;
+				status = query.updateSlicedFindPath(16, &iters);
+				REQUIRE(iters <= 16);
+			}
+			int npath = 0;
+			status = query.finalizeSlicedFindPath(path, &npath, TEST_MAX_PATH);
+			REQUIRE(status == bidirStatus);
+			REQUIRE(npath == nbidir);
+			for (int j = 0; j < npath; ++j)
+				REQUIRE(path[j] == bidirPath[j]);
+		}
+	}
+
+	SECTION("Small path buffer keeps the start of the path")
+	{
+		for (int i = 0; i < npairs; ++i)
+		{
+			int nbidir = 0;
+			query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter,
+						   bidirPath, &nbidir, TEST_MAX_PATH, DT_FINDPATH_BIDIRECTIONAL);
+			if (nbidir < 4)
+				continue;
+			int npath = 0;
+			const dtStatus status = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter,
+												   path, &npath, nbidir/2, DT_FINDPATH_BIDIRECTIONAL);
+			REQUIRE(dtStatusDetail(status, DT_BUFFER_TOO_SMALL));
+			REQUIRE(npath == nbidir/2);
+			for (int j = 0; j < npath; ++j)
+				REQUIRE(path[j] == bidirPath[j]);
+		}
+	}
+
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMeshQuery benchmark bidirectional search", "[.][benchmark]")
+{
+	static const int MAX_CONS = 40;
+
+	TestBuildSettings settings;
+	settings.tileSize = 8;
+	REQUIRE(addTestOffMeshConnections("dungeon.obj", settings, MAX_CONS) > 0);
+	TestTileCache tiles;
+	REQUIRE(tiles.build("dungeon.obj", settings));
+	seedTestRandom();
+	dtNavMesh* nav = tiles.createNavMesh();
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 65535)));
+
+	static dtPolyRef refs[(TEST_PATH_PAIRS+MAX_CONS)*2];
+	static float pos[(TEST_PATH_PAIRS+MAX_CONS)*2*3];
+	int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+	const float ext[3] = { 2.0f, 4.0f, 2.0f };
+	for (int i = 0; i < (int)settings.offMeshRads.size(); ++i)
+	{
+		for (int j = 0; j < 2; ++j)
+		{
+			const float* p = &settings.offMeshVerts[(i*2+j)*3];
+			REQUIRE(dtStatusSucceed(query.findNearestPoly(p, ext, &filter, &refs[npairs*2+j], &pos[(npairs*2+j)*3])));
+		}
+		if (refs[npairs*2] && refs[npairs*2+1])
+			npairs++;
+	}
+
+	// Only the paths that exist, the bidirectional search does not help with the others.
+	static dtPolyRef path[TEST_MAX_PATH];
+	int nreachable = 0;
+	for (int i = 0; i < npairs; ++i)
+	{
+		int npath = 0;
+		const dtStatus status = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+											   &filter, path, &npath, TEST_MAX_PATH);
+		if (dtStatusDetail(status, DT_PARTIAL_RESULT))
+			continue;
+		refs[nreachable*2] = refs[i*2];
+		refs[nreachable*2+1] = refs[i*2+1];
+		dtVcopy(&pos[nreachable*2*3], &pos[i*2*3]);
+		dtVcopy(&pos[(nreachable*2+1)*3], &pos[(i*2+1)*3]);
+		nreachable++;
+	}
+	REQUIRE(nreachable > 0);
+
+	const unsigned int options[] = { 0, DT_FINDPATH_BIDIRECTIONAL };
+	const char* names[] = { "plain", "bidir" };
+	for (int q = 0; q < 2; ++q)
+	{
+		const clock_t begin = clock();
+		int expanded = 0;
+		for (int i = 0; i < nreachable; ++i)
+		{
+			int npath = 0;
+			query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+						   &filter, path, &npath, TEST_MAX_PATH, options[q]);
+			expanded += query.getNodePool()->getNodeCount();
+		}
+		const double ms = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+		printf("BM_findPath_%-8s %d paths, %d nodes in %8.2f ms: %8.2f us/path\n",
+			   names[q], nreachable, expanded, ms, ms * 1000.0 / nreachable);
+	}
+
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMeshQuery cost queries")
+{
+	seedTestRandom();
+
+	static const int MAX_TARGETS = 50;
+	static const int ROUNDS = 10;
+	static const int MAX_HITS = 5;
+
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 65535)));
+
+	// Each round searches from one point to the next MAX_TARGETS points.
+	static dtPolyRef refs[(MAX_TARGETS+1)*ROUNDS];
+	static float pos[(MAX_TARGETS+1)*ROUNDS*3];
+	const int npairs = pickTestPathEnds(query, filter, (MAX_TARGETS+1)*ROUNDS/2, refs, pos);
+	REQUIRE(npairs == (MAX_TARGETS+1)*ROUNDS/2);
+
+	float costs[MAX_TARGETS];
+	static dtPolyRef path[TEST_MAX_PATH];
+
+	SECTION("One-to-many costs match findPath")
+	{
+		float plainTotal = 0.0f, total = 0.0f;
+		for (int r = 0; r < ROUNDS; ++r)
+		{
+			const dtPolyRef startRef = refs[r*(MAX_TARGETS+1)];
+			const float* startPos = &pos[r*(MAX_TARGETS+1)*3];
+			const dtPolyRef* targetRefs = &refs[r*(MAX_TARGETS+1)+1];
+			const float* targetPos = &pos[(r*(MAX_TARGETS+1)+1)*3];
+
+			int hits = 0;
+			REQUIRE(query.findCostsToPolys(startRef, startPos, targetRefs, targetPos, MAX_TARGETS,
+										   &filter, MAX_TARGETS, costs, &hits) == DT_SUCCESS);
+			int reached = 0;
+			for (int i = 0; i < MAX_TARGETS; ++i)
+			{
+				if (costs[i] == FLT_MAX)
+					continue;
+				reached++;
+				int npath = 0;
+				REQUIRE(query.getPathFromDijkstraSearch(targetRefs[i], path, &npath, TEST_MAX_PATH) == DT_SUCCESS);
+				REQUIRE(npath > 0);
+				REQUIRE(path[0] == startRef);
+				REQUIRE(path[npath-1] == targetRefs[i]);
+				REQUIRE(isTestPathConnected(*nav, path, npath));
+			}
+			REQUIRE(hits == reached);
+
+			for (int i = 0; i < MAX_TARGETS; ++i)
+			{
+				int npath = 0;
+				const dtStatus status = query.findPath(startRef, targetRefs[i], startPos, &targetPos[i*3],
+													   &filter, path, &npath, TEST_MAX_PATH);
+				REQUIRE(dtStatusSucceed(status));
+				REQUIRE(dtStatusDetail(status, DT_PARTIAL_RESULT) == (costs[i] == FLT_MAX));
+				const float plainCost = getTestPathCost(query, targetRefs[i]);
+				if (plainCost < 0.0f)
+					continue;
+				plainTotal += plainCost;
+				total += costs[i];
+			}
+		}
+		REQUIRE(plainTotal > 0.0f);
+		// findPath keeps a node for each tile border a polygon is entered across, the Dijkstra
+		// search keeps one per polygon, so its costs are a little higher.
+		REQUIRE(total <= plainTotal * 1.05f);
+		REQUIRE(total >= plainTotal * 0.95f);
+	}
+
+	SECTION("Many-to-one costs match findPath")
+	{
+		float plainTotal = 0.0f, total = 0.0f;
+		for (int r = 0; r < ROUNDS; ++r)
+		{
+			const dtPolyRef endRef = refs[r*(MAX_TARGETS+1)];
+			const float* endPos = &pos[r*(MAX_TARGETS+1)*3];
+			const dtPolyRef* startRefs = &refs[r*(MAX_TARGETS+1)+1];
+			const float* startPos = &pos[(r*(MAX_TARGETS+1)+1)*3];
+
+			int hits = 0;
+			REQUIRE(query.findCostsFromPolys(startRefs, startPos, MAX_TARGETS, endRef, endPos,
+											 &filter, MAX_TARGETS, costs, &hits) == DT_SUCCESS);
+			int reached = 0;
+			for (int i = 0; i < MAX_TARGETS; ++i)
+			{
+				if (costs[i] == FLT_MAX)
+					continue;
+				reached++;
+				int npath = 0;
+				REQUIRE(query.getPathFromDijkstraSearch(startRefs[i], path, &npath, TEST_MAX_PATH) == DT_SUCCESS);
+				REQUIRE(npath > 0);
+				REQUIRE(path[0] == startRefs[i]);
+				REQUIRE(path[npath-1] == endRef);
+				REQUIRE(isTestPathConnected(*nav, path, npath));
+			}
+			REQUIRE(hits == reached);
+
+			for (int i = 0; i < MAX_TARGETS; ++i)
+			{
+				int npath = 0;
+				const dtStatus status = query.findPath(startRefs[i], endRef, &startPos[i*3], endPos,
+													   &filter, path, &npath, TEST_MAX_PATH);
+				REQUIRE(dtStatusSucceed(status));
+				REQUIRE(dtStatusDetail(status, DT_PARTIAL_RESULT) == (costs[i] == FLT_MAX));
+				const float plainCost = getTestPathCost(query, endRef);
+				if (plainCost < 0.0f)
+					continue;
+				plainTotal += plainCost;
+				total += costs[i];
+			}
+		}
+		REQUIRE(plainTotal > 0.0f);
+		REQUIRE(total <= plainTotal * 1.05f);
+		REQUIRE(total >= plainTotal * 0.95f);
+	}
+
+	SECTION("Stops after the requested number of hits")
+	{
+		float limited[MAX_TARGETS];
+		for (int r = 0; r < ROUNDS; ++r)
+		{
+			const dtPolyRef startRef = refs[r*(MAX_TARGETS+1)];
+			const float* startPos = &pos[r*(MAX_TARGETS+1)*3];
+			const dtPolyRef* targetRefs = &refs[r*(MAX_TARGETS+1)+1];
+			const float* targetPos = &pos[(r*(MAX_TARGETS+1)+1)*3];
+
+			int hits = 0, limitedHits = 0;
+			REQUIRE(query.findCostsToPolys(startRef, startPos, targetRefs, targetPos, MAX_TARGETS,
+										   &filter, MAX_TARGETS, costs, &hits) == DT_SUCCESS);
+			REQUIRE(query.findCostsToPolys(startRef, startPos, targetRefs, targetPos, MAX_TARGETS,
+										   &filter, MAX_HITS, limited, &limitedHits) == DT_SUCCESS);
+			REQUIRE(limitedHits >= dtMin(hits, MAX_HITS));
+			int reached = 0;
+			float maxLimited = 0.0f;
+			for (int i = 0; i < MAX_TARGETS; ++i)
+			{
+				if (limited[i] == FLT_MAX)
+					continue;
+				// The search runs the same until it stops.
+				REQUIRE(limited[i] == costs[i]);
+				maxLimited = dtMax(maxLimited, limited[i]);
+				reached++;
+			}
+			REQUIRE(reached == limitedHits);
+			// The hits are the cheapest targets of the full search.
+			for (int i = 0; i < MAX_TARGETS; ++i)
+			{
+				if (limited[i] == FLT_MAX && costs[i] != FLT_MAX)
+					REQUIRE(costs[i] > maxLimited);
+			}
+		}
+	}
+
+	SECTION("Island table stops the search early")
+	{
+		dtIslandTable islands;
+		REQUIRE(dtStatusSucceed(islands.init(nav, &filter)));
+		float withIslands[MAX_TARGETS];
+		for (int r = 0; r < ROUNDS; ++r)
+		{
+			const dtPolyRef startRef = refs[r*(MAX_TARGETS+1)];
+			const float* startPos = &pos[r*(MAX_TARGETS+1)*3];
+			const dtPolyRef* targetRefs = &refs[r*(MAX_TARGETS+1)+1];
+			const float* targetPos = &pos[(r*(MAX_TARGETS+1)+1)*3];
+
+			int hits = 0, islandHits = 0;
+			query.setIslandTable(0);
+			REQUIRE(query.findCostsToPolys(startRef, startPos, targetRefs, targetPos, MAX_TARGETS,
+										   &filter, MAX_TARGETS, costs, &hits) == DT_SUCCESS);
+			query.setIslandTable(&islands);
+			REQUIRE(query.findCostsToPolys(startRef, startPos, targetRefs, targetPos, MAX_TARGETS,
+										   &filter, MAX_TARGETS, withIslands, &islandHits) == DT_SUCCESS);
+			REQUIRE(islandHits == hits);
+			for (int i = 0; i < MAX_TARGETS; ++i)
+				REQUIRE(withIslands[i] == costs[i]);
+		}
+		query.setIslandTable(0);
+	}
+
+	SECTION("Invalid input")
+	{
+		int hits = -1;
+		REQUIRE(dtStatusFailed(query.findCostsToPolys(refs[0], pos, &refs[1], &pos[3], 1, &filter, 1, costs, 0)));
+		REQUIRE(dtStatusFailed(query.findCostsToPolys(0, pos, &refs[1], &pos[3], 1, &filter, 1, costs, &hits)));
+		REQUIRE(hits == 0);
+		REQUIRE(dtStatusFailed(query.findCostsToPolys(refs[0], pos, 0, 0, 1, &filter, 1, costs, &hits)));
+		REQUIRE(dtStatusFailed(query.findCostsFromPolys(&refs[1], &pos[3], 1, 0, pos, &filter, 1, costs, &hits)));
+		REQUIRE(query.findCostsToPolys(refs[0], pos, 0, 0, 0, &filter, 1, 0, &hits) == DT_SUCCESS);
+		REQUIRE(hits == 0);
+
+		// Invalid targets are never reached.
+		unsigned int salt, it, ip;
+		nav->decodePolyId(refs[1], salt, it, ip);
+		const dtPolyRef invalid = nav->encodePolyId(salt+1, it, ip);
+		REQUIRE(!nav->isValidPolyRef(invalid));
+		REQUIRE(query.findCostsToPolys(refs[0], pos, &invalid, &pos[3], 1, &filter, 1, costs, &hits) == DT_SUCCESS);
+		REQUIRE(hits == 0);
+		REQUIRE(costs[0] == FLT_MAX);
+	}
+
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMeshQuery benchmark nearest target", "[.][benchmark]")
+{
+	seedTestRandom();
+
+	static const int MAX_TARGETS = 50;
+	static const int ROUNDS = 10;
+
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 65535)));
+
+	// Each round searches from one point to the next MAX_TARGETS points.
+	static dtPolyRef refs[(MAX_TARGETS+1)*ROUNDS];
+	static float pos[(MAX_TARGETS+1)*ROUNDS*3];
+	const int npairs = pickTestPathEnds(query, filter, (MAX_TARGETS+1)*ROUNDS/2, refs, pos);
+	REQUIRE(npairs == (MAX_TARGETS+1)*ROUNDS/2);
+
+	float costs[MAX_TARGETS];
+	static dtPolyRef path[TEST_MAX_PATH];
+	int count = 0;
+	const clock_t begin = clock();
+	for (int r = 0; r < ROUNDS; ++r)
+	{
+		const int base = r*(MAX_TARGETS+1);
+		for (int i = 0; i < MAX_TARGETS; ++i)
+		{
+			int npath = 0;
+			query.findPath(refs[base], refs[base+1+i], &pos[base*3], &pos[(base+1+i)*3],
+						   &filter, path, &npath, TEST_MAX_PATH);
+		}
+		count++;
+	}
+	const double plainMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+	printf("BM_nearest_findPath    %d x %d targets in %8.2f ms: %8.2f us/query\n",
+		   count, MAX_TARGETS, plainMs, plainMs * 1000.0 / count);
+
+	const int hitLimits[] = { MAX_TARGETS, 1 };
+	for (int q = 0; q < 2; ++q)
+	{
+		const clock_t costsBegin = clock();
+		for (int r = 0; r < ROUNDS; ++r)
+		{
+			const int base = r*(MAX_TARGETS+1);
+			int hits = 0;
+			query.findCostsToPolys(refs[base], &pos[base*3], &refs[base+1], &pos[(base+1)*3], MAX_TARGETS,
+								   &filter, hitLimits[q], costs, &hits);
+		}
+		const double ms = (double)(clock() - costsBegin) * 1000.0 / CLOCKS_PER_SEC;
+		printf("BM_nearest_costs_k%-4d %d x %d targets in %8.2f ms: %8.2f us/query\n",
+			   hitLimits[q], count, MAX_TARGETS, ms, ms * 1000.0 / count);
+	}
+
+	dtFreeNavMesh(nav);
+}
+
+// The rules of the default dtQueryFilter, in a class that does not derive from it.
+struct TestPlainFilter
+{
+	bool passFilter(const dtPolyRef /*ref*/, const dtMeshTile* /*tile*/, const dtPoly* poly) const
+	{
+		return poly->flags != 0;
+	}
+
+	float getCost(const float* pa, const float* pb,
+				  const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
+				  const dtPolyRef /*curRef*/, const dtMeshTile* /*curTile*/, const dtPoly* /*curPoly*/,
+				  const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
+	{
+		return dtVdist(pa, pb);
+	}
+};
+
+// Keeps out of a tile owned by another faction and doubles the cost in the tiles next to it.
+struct TestFactionFilter
+{
+	const dtNavMesh* nav;
+	int tx, ty;
+
+	bool passFilter(const dtPolyRef /*ref*/, const dtMeshTile* tile, const dtPoly* poly) const
+	{
+		return poly->flags != 0 && (tile->header->x != tx || tile->header->y != ty);
+	}
+
+	float getCost(const float* pa, const float* pb,
+				  const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
+				  const dtPolyRef /*curRef*/, const dtMeshTile* curTile, const dtPoly* /*curPoly*/,
+				  const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
+	{
+		const bool border = dtAbs(curTile->header->x - tx) <= 1 && dtAbs(curTile->header->y - ty) <= 1;
+		return dtVdist(pa, pb) * (border ? 2.0f : 1.0f);
+	}
+};
+
+TEST_CASE("dtNavMeshQuery template filters")
+{
+	seedTestRandom();
+
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	TestPlainFilter plain;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, TEST_MAX_NODES)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	dtPolyRef path[TEST_MAX_PATH], expected[TEST_MAX_PATH];
+
+	SECTION("A filter with the default rules gives the same results")
+	{
+		for (int i = 0; i < npairs; ++i)
+		{
+			const dtPolyRef startRef = refs[i*2], endRef = refs[i*2+1];
+			const float* startPos = &pos[i*2*3];
+			const float* endPos = &pos[(i*2+1)*3];
+
+			int npath = 0, nexpected = 0;
+			const dtStatus expectedStatus = query.findPath(startRef, endRef, startPos, endPos, &filter,
+														   expected, &nexpected, TEST_MAX_PATH);
+			const dtStatus status = query.findPath(startRef, endRef, startPos, endPos, &plain,
+												   path, &npath, TEST_MAX_PATH);
+			REQUIRE(status == expectedStatus);
+			REQUIRE(npath == nexpected);
+			for (int j = 0; j < npath; ++j)
+				REQUIRE(path[j] == expected[j]);
+
+			dtRaycastHit expectedHit, hit;
+			memset(&expectedHit, 0, sizeof(expectedHit));
+			memset(&hit, 0, sizeof(hit));
+			expectedHit.path = expected;
+			expectedHit.maxPath = TEST_MAX_PATH;
+			hit.path = path;
+			hit.maxPath = TEST_MAX_PATH;
+			REQUIRE(query.raycast(startRef, startPos, endPos, &filter, DT_RAYCAST_USE_COSTS, &expectedHit) ==
+					query.raycast(startRef, startPos, endPos, &plain, DT_RAYCAST_USE_COSTS, &hit));
+			REQUIRE(hit.t == expectedHit.t);
+			REQUIRE(hit.pathCost == expectedHit.pathCost);
+			REQUIRE(hit.pathCount == expectedHit.pathCount);
+
+			float expectedPos[3] = { 0, 0, 0 }, resultPos[3] = { 0, 0, 0 };
+			REQUIRE(query.moveAlongSurface(startRef, startPos, endPos, &filter, expectedPos, expected, &nexpected, TEST_MAX_PATH) ==
+					query.moveAlongSurface(startRef, startPos, endPos, &plain, resultPos, path, &npath, TEST_MAX_PATH));
+			REQUIRE(dtVequal(resultPos, expectedPos));
+			REQUIRE(npath == nexpected);
+		}
+	}
+
+	SECTION("A custom filter keeps out of the excluded tile")
+	{
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		nav->getTileAndPolyByRefUnsafe(refs[0], &tile, &poly);
+		TestFactionFilter faction;
+		faction.nav = nav;
+		faction.tx = tile->header->x;
+		faction.ty = tile->header->y;
+
+		int checked = 0;
+		for (int i = 0; i < npairs; ++i)
+		{
+			const dtPolyRef startRef = refs[i*2], endRef = refs[i*2+1];
+			const float* startPos = &pos[i*2*3];
+			const float* endPos = &pos[(i*2+1)*3];
+			nav->getTileAndPolyByRefUnsafe(startRef, &tile, &poly);
+			if (tile->header->x == faction.tx && tile->header->y == faction.ty)
+				continue;
+			checked++;
+
+			int npath = 0;
+			REQUIRE(dtStatusSucceed(query.findPath(startRef, endRef, startPos, endPos, &faction, path, &npath, TEST_MAX_PATH)));
+			for (int j = 1; j < npath; ++j)
+			{
+				nav->getTileAndPolyByRefUnsafe(path[j], &tile, &poly);
+				REQUIRE((tile->header->x != faction.tx || tile->header->y != faction.ty));
+			}
+
+			dtRaycastHit hit;
+			memset(&hit, 0, sizeof(hit));
+			hit.path = path;
+			hit.maxPath = TEST_MAX_PATH;
+			REQUIRE(dtStatusSucceed(query.raycast(startRef, startPos, endPos, &faction, 0, &hit)));
+			for (int j = 1; j < hit.pathCount; ++j)
+			{
+				nav->getTileAndPolyByRefUnsafe(path[j], &tile, &poly);
+				REQUIRE((tile->header->x != faction.tx || tile->header->y != faction.ty));
+			}
+
+			float resultPos[3];
+			REQUIRE(dtStatusSucceed(query.moveAlongSurface(startRef, startPos, endPos, &faction,
+														   resultPos, path, &npath, TEST_MAX_PATH)));
+			for (int j = 1; j < npath; ++j)
+			{
+				nav->getTileAndPolyByRefUnsafe(path[j], &tile, &poly);
+				REQUIRE((tile->header->x != faction.tx || tile->header->y != faction.ty));
+			}
+		}
+		REQUIRE(checked > 0);
+	}
+
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMeshQuery benchmark findPath with a template filter", "[.][benchmark]")
+{
+	seedTestRandom();
+
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	TestPlainFilter plain;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, TEST_MAX_NODES)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	dtPolyRef path[TEST_MAX_PATH];
+	const char* names[] = { "dtQueryFilter", "template" };
+	for (int q = 0; q < 2; ++q)
+	{
+		const clock_t begin = clock();
+		for (int i = 0; i < npairs; ++i)
+		{
+			int npath = 0;
+			if (q == 0)
+				query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, path, &npath, TEST_MAX_PATH);
+			else
+				query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &plain, path, &npath, TEST_MAX_PATH);
+		}
+		const double ms = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+		printf("BM_findPath_%-14s %d paths in %8.2f ms: %8.2f us/path\n", names[q], npairs, ms, ms * 1000.0 / npairs);
+	}
+
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMeshQuery concurrent sliced searches")
+{
+	seedTestRandom();
+
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, TEST_MAX_NODES)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	static const int MAX_SEARCHES = 8;
+	REQUIRE(dtStatusFailed(query.initSlicedSearches(DT_MAX_SLICED_SEARCHES+1, TEST_MAX_NODES)));
+	REQUIRE(dtStatusSucceed(query.initSlicedSearches(MAX_SEARCHES, TEST_MAX_NODES)));
+	REQUIRE(query.getMaxSlicedSearches() == MAX_SEARCHES);
+
+	dtPolyRef path[TEST_MAX_PATH];
+
+	SECTION("Interleaved searches find the same paths as a single search")
+	{
+		static dtPolyRef expected[TEST_PATH_PAIRS][TEST_MAX_PATH];
+		static int nexpected[TEST_PATH_PAIRS];
+		static dtStatus expectedStatus[TEST_PATH_PAIRS];
+		for (int i = 0; i < npairs; ++i)
+		{
+			const unsigned int options = (i & 1) ? DT_FINDPATH_BIDIRECTIONAL : 0;
+			dtStatus status = query.initSlicedFindPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, options);
+			while (dtStatusInProgress(status))
+				status = query.updateSlicedFindPath(INT_MAX, 0);
+			expectedStatus[i] = query.finalizeSlicedFindPath(expected[i], &nexpected[i], TEST_MAX_PATH);
+		}
+
+		// Keeps all the slots busy and advances the searches round-robin in small slices.
+		dtSlicedSearchRef searches[MAX_SEARCHES];
+		int pairs[MAX_SEARCHES];
+		int next = 0, done = 0;
+		memset(searches, 0, sizeof(searches));
+		while (done < npairs)
+		{
+			for (int s = 0; s < MAX_SEARCHES; ++s)
+			{
+				if (!searches[s] && next < npairs)
+				{
+					const int i = next++;
+					const unsigned int options = (i & 1) ? DT_FINDPATH_BIDIRECTIONAL : 0;
+					REQUIRE(!dtStatusFailed(query.initSlicedFindPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+																	 &filter, options, &searches[s])));
+					REQUIRE(searches[s] != 0);
+					pairs[s] = i;
+				}
+				if (!searches[s])
+					continue;
+
+				if (dtStatusInProgress(query.getSlicedFindPathStatus(searches[s])))
+				{
+					int iters = 0;
+					query.updateSlicedFindPath(searches[s], 8, &iters);
+					REQUIRE(iters <= 8);
+					continue;
+				}
+
+				const int i = pairs[s];
+				int npath = 0;
+				const dtStatus status = query.finalizeSlicedFindPath(searches[s], path, &npath, TEST_MAX_PATH);
+				REQUIRE(status == expectedStatus[i]);
+				REQUIRE(npath == nexpected[i]);
+				for (int j = 0; j < npath; ++j)
+					REQUIRE(path[j] == expected[i][j]);
+				REQUIRE(query.getSlicedFindPathStatus(searches[s]) == (DT_FAILURE | DT_INVALID_PARAM));
+				searches[s] = 0;
+				done++;
+			}
+		}
+		REQUIRE(query.getSlicedSearchCount() == 0);
+	}
+
+	SECTION("Handles are released by finalize and cancel")
+	{
+		dtSlicedSearchRef searches[MAX_SEARCHES+1];
+		for (int s = 0; s < MAX_SEARCHES; ++s)
+			REQUIRE(!dtStatusFailed(query.initSlicedFindPath(refs[0], refs[1], &pos[0], &pos[3], &filter, 0, &searches[s])));
+		REQUIRE(query.getSlicedSearchCount() == MAX_SEARCHES);
+
+		// All slots are busy.
+		const dtStatus full = query.initSlicedFindPath(refs[0], refs[1], &pos[0], &pos[3], &filter, 0, &searches[MAX_SEARCHES]);
+		REQUIRE(dtStatusFailed(full));
+		REQUIRE(dtStatusDetail(full, DT_BUFFER_TOO_SMALL));
+		REQUIRE(searches[MAX_SEARCHES] == 0);
+
+		// A stale handle does not reach the search that reuses its slot.
+		const dtSlicedSearchRef cancelled = searches[0];
+		REQUIRE(dtStatusSucceed(query.cancelSlicedFindPath(cancelled)));
+		REQUIRE(dtStatusFailed(query.cancelSlicedFindPath(cancelled)));
+		REQUIRE(!dtStatusFailed(query.initSlicedFindPath(refs[0], refs[1], &pos[0], &pos[3], &filter, 0, &searches[0])));
+		REQUIRE(searches[0] != cancelled);
+		REQUIRE(query.getSlicedFindPathStatus(cancelled) == (DT_FAILURE | DT_INVALID_PARAM));
+		int iters = -1;
+		REQUIRE(dtStatusFailed(query.updateSlicedFindPath(cancelled, 8, &iters)));
+		REQUIRE(iters == 0);
+		int npath = -1;
+		REQUIRE(dtStatusFailed(query.finalizeSlicedFindPath(cancelled, path, &npath, TEST_MAX_PATH)));
+		REQUIRE(npath == 0);
+		REQUIRE(dtStatusFailed(query.updateSlicedFindPath(0, 8, 0)));
+
+		// The searches do not disturb the sliced search of the query object.
+		dtPolyRef expected[TEST_MAX_PATH];
+		int nexpected = 0;
+		dtStatus status = query.initSlicedFindPath(refs[2], refs[3], &pos[6], &pos[9], &filter);
+		while (dtStatusInProgress(status))
+			status = query.updateSlicedFindPath(INT_MAX, 0);
+		const dtStatus expectedStatus = query.finalizeSlicedFindPath(expected, &nexpected, TEST_MAX_PATH);
+
+		status = query.initSlicedFindPath(refs[2], refs[3], &pos[6], &pos[9], &filter);
+		for (int s = 0; s < MAX_SEARCHES; ++s)
+		{
+			while (dtStatusInProgress(query.updateSlicedFindPath(searches[s], 16, 0)))
+				status = query.updateSlicedFindPath(1, 0);
+			REQUIRE(dtStatusSucceed(query.finalizeSlicedFindPath(searches[s], path, &npath, TEST_MAX_PATH)));
+		}
+		REQUIRE(query.getSlicedSearchCount() == 0);
+		while (dtStatusInProgress(status))
+			status = query.updateSlicedFindPath(INT_MAX, 0);
+		REQUIRE(query.finalizeSlicedFindPath(path, &npath, TEST_MAX_PATH) == expectedStatus);
+		REQUIRE(npath == nexpected);
+		REQUIRE(memcmp(path, expected, sizeof(dtPolyRef)*npath) == 0);
+
+		// Reinitializing cancels the searches in flight.
+		REQUIRE(!dtStatusFailed(query.initSlicedFindPath(refs[0], refs[1], &pos[0], &pos[3], &filter, 0, &searches[0])));
+		REQUIRE(dtStatusSucceed(query.initSlicedSearches(2, 64)));
+		REQUIRE(query.getSlicedSearchCount() == 0);
+		REQUIRE(query.getSlicedFindPathStatus(searches[0]) == (DT_FAILURE | DT_INVALID_PARAM));
+	}
+
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMeshQuery statistics")
+{
+	seedTestRandom();
+
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, TEST_MAX_NODES)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	query.resetQueryStats();
+	const dtQueryStats& stats = query.getQueryStats();
+	for (int t = 0; t < DT_QUERYSTATS_TYPE_COUNT; ++t)
+		REQUIRE(stats.types[t].calls == 0);
+
+	dtPolyRef path[TEST_MAX_PATH];
+	int64_t expanded = 0, maxExpanded = 0;
+	for (int i = 0; i < npairs; ++i)
+	{
+		int npath = 0;
+		query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, path, &npath, TEST_MAX_PATH);
+		const dtQueryCounters& last = query.getLastQueryCounters();
+		expanded += last.nodesExpanded;
+		maxExpanded = dtMax(maxExpanded, last.nodesExpanded);
+	}
+
+	const float halfExtents[3] = { 2, 4, 2 };
+	dtPolyRef nearest = 0;
+	REQUIRE(dtStatusSucceed(query.findNearestPoly(&pos[0], halfExtents, &filter, &nearest, 0)));
+
+	// A small node pool runs out of nodes.
+	dtNavMeshQuery small;
+	REQUIRE(dtStatusSucceed(small.init(nav, 16)));
+	bool outOfNodes = false;
+	for (int i = 0; i < npairs && !outOfNodes; ++i)
+	{
+		int npath = 0;
+		const dtStatus status = small.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, path, &npath, TEST_MAX_PATH);
+		outOfNodes = dtStatusDetail(status, DT_OUT_OF_NODES);
+	}
+	REQUIRE(outOfNodes);
+
+#ifdef DT_QUERY_STATS
+	const dtQueryTypeStats& paths = stats.types[DT_QUERYSTATS_FIND_PATH];
+	REQUIRE(paths.calls == npairs);
+	REQUIRE(paths.total.nodesExpanded == expanded);
+	REQUIRE(paths.max.nodesExpanded == maxExpanded);
+	REQUIRE(paths.total.nodesExpanded > 0);
+	REQUIRE(paths.total.tilesTouched > 0);
+	REQUIRE(paths.total.bvNodesVisited == 0);
+	REQUIRE(paths.total.time >= paths.max.time);
+	int64_t timeCount = 0, nodesCount = 0;
+	for (int i = 0; i < DT_QUERYSTATS_HISTOGRAM_SIZE; ++i)
+	{
+		timeCount += paths.timeHistogram[i];
+		nodesCount += paths.nodesHistogram[i];
+	}
+	REQUIRE(timeCount == npairs);
+	REQUIRE(nodesCount == npairs);
+
+	// The nested queryPolygons call is part of findNearestPoly.
+	REQUIRE(query.getLastQueryType() == DT_QUERYSTATS_FIND_NEAREST_POLY);
+	REQUIRE(stats.types[DT_QUERYSTATS_FIND_NEAREST_POLY].calls == 1);
+	REQUIRE(stats.types[DT_QUERYSTATS_QUERY_POLYGONS].calls == 0);
+	REQUIRE(query.getLastQueryCounters().tilesTouched > 0);
+	REQUIRE(query.getLastQueryCounters().bvNodesVisited > 0);
+
+	REQUIRE(small.getLastQueryCounters().outOfNodes > 0);
+	REQUIRE(small.getQueryStats().types[DT_QUERYSTATS_FIND_PATH].total.outOfNodes > 0);
+
+	query.resetQueryStats();
+	REQUIRE(stats.types[DT_QUERYSTATS_FIND_PATH].calls == 0);
+#else
+	// Without DT_QUERY_STATS nothing is counted.
+	REQUIRE(expanded == 0);
+	for (int t = 0; t < DT_QUERYSTATS_TYPE_COUNT; ++t)
+		REQUIRE(stats.types[t].calls == 0);
+	REQUIRE(small.getLastQueryCounters().outOfNodes == 0);
+#endif
+
+	dtFreeNavMesh(nav);
+}
+
+// Run in both the Tests and the TestsQueryStats executables to compare the cost of the statistics.
+TEST_CASE("dtNavMeshQuery benchmark statistics", "[.][benchmark]")
+{
+	seedTestRandom();
+
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, TEST_MAX_NODES)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	dtPolyRef path[TEST_MAX_PATH];
+	const clock_t begin = clock();
+	for (int i = 0; i < npairs; ++i)
+	{
+		int npath = 0;
+		query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, path, &npath, TEST_MAX_PATH);
+	}
+	const double ms = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+#ifdef DT_QUERY_STATS
+	const char* mode = "with DT_QUERY_STATS";
+#else
+	const char* mode = "without DT_QUERY_STATS";
+#endif
+	printf("BM_findPath %s: %d paths in %8.2f ms: %8.2f us/path\n", mode, npairs, ms, ms * 1000.0 / npairs);
+
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMeshQuery findPath limits")
+{
+	seedTestRandom();
+
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, TEST_MAX_NODES)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	static dtPolyRef expected[TEST_PATH_PAIRS][TEST_MAX_PATH];
+	static int nexpected[TEST_PATH_PAIRS];
+	static dtStatus expectedStatus[TEST_PATH_PAIRS];
+	for (int i = 0; i < npairs; ++i)
+	{
+		expectedStatus[i] = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter,
+										   expected[i], &nexpected[i], TEST_MAX_PATH);
+	}
+
+	dtPolyRef path[TEST_MAX_PATH];
+
+	SECTION("Generous limits do not change the result")
+	{
+		dtFindPathLimits limits;
+		limits.maxNodes = TEST_MAX_NODES;
+		limits.maxCost = FLT_MAX;
+		limits.deadline = dtGetTimeUsec() + 3600 * 1000000LL;
+		for (int i = 0; i < npairs; ++i)
+		{
+			int npath = 0;
+			const dtStatus status = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter,
+												   (i & 1) ? limits : DT_FINDPATH_NO_LIMITS, path, &npath, TEST_MAX_PATH);
+			REQUIRE(status == expectedStatus[i]);
+			REQUIRE(npath == nexpected[i]);
+			REQUIRE(memcmp(path, expected[i], sizeof(dtPolyRef)*npath) == 0);
+		}
+	}
+
+	SECTION("Node limit returns the best partial path")
+	{
+		dtFindPathLimits limits = DT_FINDPATH_NO_LIMITS;
+		limits.maxNodes = 16;
+		int limited = 0;
+		for (int i = 0; i < npairs; ++i)
+		{
+			int npath = 0;
+			const dtStatus status = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter,
+												   limits, path, &npath, TEST_MAX_PATH);
+			REQUIRE(dtStatusSucceed(status));
+			REQUIRE(npath >= 1);
+			REQUIRE(path[0] == refs[i*2]);
+			REQUIRE(isTestPathConnected(*nav, path, npath));
+			if (dtStatusDetail(status, DT_SEARCH_LIMIT))
+			{
+				limited++;
+				continue;
+			}
+			REQUIRE(status == expectedStatus[i]);
+			REQUIRE(npath == nexpected[i]);
+			REQUIRE(memcmp(path, expected[i], sizeof(dtPolyRef)*npath) == 0);
+		}
+		REQUIRE(limited > 0);
+		REQUIRE(limited < npairs);
+
+		// The template version stops at the same place.
+		for (int i = 0; i < npairs; ++i)
+		{
+			int nplain = 0, ntemplate = 0;
+			dtPolyRef templatePath[TEST_MAX_PATH];
+			const dtStatus plainStatus = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter,
+														limits, path, &nplain, TEST_MAX_PATH);
+			const dtStatus templateStatus = query.findPath<dtQueryFilter>(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+																		  &filter, limits, templatePath, &ntemplate, TEST_MAX_PATH);
+			REQUIRE(templateStatus == plainStatus);
+			REQUIRE(ntemplate == nplain);
+			REQUIRE(memcmp(templatePath, path, sizeof(dtPolyRef)*nplain) == 0);
+		}
+	}
+
+	SECTION("Cost limit stops the search")
+	{
+		int limited = 0;
+		for (int i = 0; i < npairs; ++i)
+		{
+			if (expectedStatus[i] != DT_SUCCESS || nexpected[i] < 4)
+				continue;
+			dtFindPathLimits limits = DT_FINDPATH_NO_LIMITS;
+			limits.maxCost = getTestCorridorCost(*nav, filter, expected[i], nexpected[i], &pos[i*2*3], &pos[(i*2+1)*3]) * 0.5f;
+			int npath = 0;
+			const dtStatus status = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter,
+												   limits, path, &npath, TEST_MAX_PATH);
+			REQUIRE(dtStatusSucceed(status));
+			REQUIRE(dtStatusDetail(status, DT_SEARCH_LIMIT));
+			REQUIRE(path[0] == refs[i*2]);
+			REQUIRE(isTestPathConnected(*nav, path, npath));
+			limited++;
+		}
+		REQUIRE(limited > 0);
+	}
+
+	SECTION("Passed deadline returns the start polygon")
+	{
+		dtFindPathLimits limits = DT_FINDPATH_NO_LIMITS;
+		limits.deadline = dtGetTimeUsec();
+		for (int i = 0; i < npairs; ++i)
+		{
+			if (refs[i*2] == refs[i*2+1])
+				continue;
+			int npath = 0;
+			const dtStatus status = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter,
+												   limits, path, &npath, TEST_MAX_PATH);
+			REQUIRE(status == (DT_SUCCESS | DT_PARTIAL_RESULT | DT_SEARCH_LIMIT));
+			REQUIRE(npath == 1);
+			REQUIRE(path[0] == refs[i*2]);
+		}
+	}
+
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMeshQuery benchmark findPath with node limits", "[.][benchmark]")
+{
+	seedTestRandom();
+
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj");
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, TEST_MAX_NODES)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	dtPolyRef path[TEST_MAX_PATH];
+	const int maxNodes[] = { 0, 256, 64 };
+	for (int k = 0; k < 3; ++k)
+	{
+		dtFindPathLimits limits = DT_FINDPATH_NO_LIMITS;
+		limits.maxNodes = maxNodes[k];
+		int limited = 0;
+		const clock_t begin = clock();
+		for (int i = 0; i < npairs; ++i)
+		{
+			int npath = 0;
+			if (dtStatusDetail(query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter,
+											  limits, path, &npath, TEST_MAX_PATH), DT_SEARCH_LIMIT))
+				limited++;
+		}
+		const double ms = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+		printf("BM_findPath maxNodes=%-4d %d paths in %8.2f ms: %8.2f us/path (%d limited)\n",
+			   maxNodes[k], npairs, ms, ms * 1000.0 / npairs, limited);
+	}
+
+	dtFreeNavMesh(nav);
+}
@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "catch.hpp"
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourPathCache.h"
+
+#include "TestNavMesh.h"
+
+static const int TEST_MAX_PATH = 2048;
+static const int TEST_PATH_PAIRS = 300;
+
+// Drops the pairs with the same start and end polygons as an earlier pair. The cache returns the
+// first corridor found for them, which may differ from the one findPath finds for other positions.
+static int removeDuplicatePairs(dtPolyRef* refs, float* pos, const int npairs)
+{
+	int n = 0;
+	for (int i = 0; i < npairs; ++i)
+	{
+		bool duplicate = false;
+		for (int j = 0; j < n && !duplicate; ++j)
+			duplicate = refs[j*2] == refs[i*2] && refs[j*2+1] == refs[i*2+1];
+		if (duplicate)
+			continue;
+		refs[n*2] = refs[i*2];
+		refs[n*2+1] = refs[i*2+1];
+		memmove(&pos[n*2*3], &pos[i*2*3], sizeof(float)*6);
+		n++;
+	}
+	return n;
+}
+
+TEST_CASE("dtPathCache")
+{
+	seedTestRandom();
+
+	TestBuildSettings settings;
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 65535)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = removeDuplicatePairs(refs, pos, pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos));
+	REQUIRE(npairs > 0);
+
+	dtPathCache* cache = dtAllocPathCache();
+	REQUIRE(cache != 0);
+	REQUIRE(dtStatusFailed(cache->init(0, TEST_PATH_PAIRS, TEST_MAX_PATH)));
+	REQUIRE(dtStatusSucceed(cache->init(nav, TEST_PATH_PAIRS, TEST_MAX_PATH)));
+
+	static dtPolyRef path[TEST_MAX_PATH];
+	static dtPolyRef expected[TEST_MAX_PATH];
+
+	// Finds each path with and without the cache and requires the same result.
+	struct Check
+	{
+		static void paths(dtPathCache& cache, dtNavMeshQuery& query, const dtQueryFilter& filter,
+						  const dtPolyRef* refs, const float* pos, const int npairs)
+		{
+			for (int i = 0; i < npairs; ++i)
+			{
+				int nexpected = 0;
+				const dtStatus expectedStatus = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+															   &filter, expected, &nexpected, TEST_MAX_PATH);
+				int npath = 0;
+				const dtStatus status = cache.findPath(&query, refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+													   &filter, path, &npath, TEST_MAX_PATH);
+				REQUIRE(status == expectedStatus);
+				REQUIRE(npath == nexpected);
+				REQUIRE(memcmp(path, expected, sizeof(dtPolyRef)*npath) == 0);
+			}
+		}
+	};
+
+	// Only complete paths are cached.
+	static int completePairs[TEST_PATH_PAIRS];
+	int complete = 0;
+	for (int i = 0; i < npairs; ++i)
+	{
+		int npath = 0;
+		if (query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, path, &npath, TEST_MAX_PATH) == DT_SUCCESS)
+			completePairs[complete++] = i;
+	}
+	REQUIRE(complete > 0);
+
+	SECTION("Hits return the findPath result")
+	{
+		Check::paths(*cache, query, filter, refs, pos, npairs);
+		REQUIRE(cache->getHitCount() == 0);
+		REQUIRE(cache->getMissCount() == npairs);
+		REQUIRE(cache->getPathCount() == complete);
+
+		Check::paths(*cache, query, filter, refs, pos, npairs);
+		REQUIRE(cache->getHitCount() == cache->getPathCount());
+		REQUIRE(cache->getHitCount() > 0);
+		REQUIRE(cache->getInvalidationCount() == 0);
+
+		// A different filter is a different key.
+		dtQueryFilter other;
+		other.setAreaCost(0, 2.0f);
+		const int hits = cache->getHitCount();
+		Check::paths(*cache, query, other, refs, pos, npairs);
+		REQUIRE(cache->getHitCount() == hits);
+		other.setAreaCost(0, filter.getAreaCost(0));
+		other.setExcludeFlags(0x8000);
+		Check::paths(*cache, query, other, refs, pos, npairs);
+		REQUIRE(cache->getHitCount() == hits);
+
+		// A short buffer gets the start of the path.
+		for (int i = 0; i < npairs; ++i)
+		{
+			int npath = 0;
+			dtStatus status = cache->findPath(&query, refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+											  &filter, path, &npath, TEST_MAX_PATH);
+			if (status != DT_SUCCESS || npath < 2)
+				continue;
+			const dtPolyRef start = path[0];
+			status = cache->findPath(&query, refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+									 &filter, path, &npath, 1);
+			REQUIRE(dtStatusSucceed(status));
+			REQUIRE(dtStatusDetail(status, DT_BUFFER_TOO_SMALL));
+			REQUIRE(npath == 1);
+			REQUIRE(path[0] == start);
+			break;
+		}
+	}
+
+	SECTION("Changing polygon flags drops all paths")
+	{
+		Check::paths(*cache, query, filter, refs, pos, npairs);
+		dtPolyRef changed = 0;
+		for (int i = 0; i < npairs && !changed; ++i)
+		{
+			int npath = 0;
+			if (cache->findPath(&query, refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+								&filter, path, &npath, TEST_MAX_PATH) == DT_SUCCESS && npath > 2)
+				changed = path[npath/2];
+		}
+		REQUIRE(changed != 0);
+
+		// Setting the same flags is not a change.
+		unsigned short flags = 0;
+		REQUIRE(dtStatusSucceed(nav->getPolyFlags(changed, &flags)));
+		REQUIRE(dtStatusSucceed(nav->setPolyFlags(changed, flags)));
+		Check::paths(*cache, query, filter, refs, pos, npairs);
+		REQUIRE(cache->getInvalidationCount() == 0);
+
+		// Closing the polygon drops the paths through it, and the paths elsewhere too.
+		REQUIRE(dtStatusSucceed(nav->setPolyFlags(changed, 0)));
+		const int closed = cache->getPathCount();
+		Check::paths(*cache, query, filter, refs, pos, npairs);
+		REQUIRE(cache->getInvalidationCount() == closed);
+
+		// Opening it again may shorten paths that do not pass through its tile, which is
+		// what Check::paths compares against.
+		REQUIRE(dtStatusSucceed(nav->setPolyFlags(changed, flags)));
+		const int opened = cache->getPathCount();
+		Check::paths(*cache, query, filter, refs, pos, npairs);
+		REQUIRE(cache->getInvalidationCount() == closed + opened);
+	}
+
+	SECTION("Removing tiles drops the paths next to them, adding tiles drops all paths")
+	{
+		Check::paths(*cache, query, filter, refs, pos, npairs);
+		const int npaths = cache->getPathCount();
+		REQUIRE(npaths > 0);
+
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		nav->getTileAndPolyByRefUnsafe(refs[0], &tile, &poly);
+		const int tx = tile->header->x, ty = tile->header->y;
+		REQUIRE(dtStatusSucceed(nav->removeTile(nav->getTileRef(tile), 0, 0)));
+
+		Check::paths(*cache, query, filter, refs, pos, npairs);
+		const int removed = cache->getInvalidationCount();
+		REQUIRE(removed > 0);
+		REQUIRE(removed < npaths);
+
+		TestGeom geom;
+		REQUIRE(loadTestGeom("nav_test.obj", geom));
+		int dataSize = 0;
+		unsigned char* data = buildTestTile(geom, settings, tx, ty, &dataSize);
+		REQUIRE(data != 0);
+		REQUIRE(dtStatusSucceed(nav->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+
+		const int cached = cache->getPathCount();
+		Check::paths(*cache, query, filter, refs, pos, npairs);
+		REQUIRE(cache->getInvalidationCount() == removed + cached);
+	}
+
+	SECTION("Least recently used path is replaced")
+	{
+		REQUIRE(complete >= 4);
+		dtPathCache small;
+		REQUIRE(dtStatusSucceed(small.init(nav, 3, TEST_MAX_PATH)));
+		const int order[] = { 0, 1, 2, 0, 3, 0, 2, 1 };
+		const bool hit[] = { false, false, false, true, false, true, true, false };
+		for (int k = 0; k < 8; ++k)
+		{
+			const int i = completePairs[order[k]];
+			const int hits = small.getHitCount();
+			int npath = 0;
+			REQUIRE(small.findPath(&query, refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+								   &filter, path, &npath, TEST_MAX_PATH) == DT_SUCCESS);
+			REQUIRE((small.getHitCount() > hits) == hit[k]);
+		}
+		REQUIRE(small.getPathCount() == 3);
+
+		small.clear();
+		REQUIRE(small.getPathCount() == 0);
+	}
+
+	dtFreePathCache(cache);
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtPathCache benchmark repeated queries", "[.][benchmark]")
+{
+	seedTestRandom();
+
+	TestBuildSettings settings;
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 65535)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = removeDuplicatePairs(refs, pos, pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos));
+	REQUIRE(npairs > 0);
+
+	dtPathCache cache;
+	REQUIRE(dtStatusSucceed(cache.init(nav, TEST_PATH_PAIRS, TEST_MAX_PATH)));
+
+	// Only complete paths are cached.
+	static dtPolyRef path[TEST_MAX_PATH];
+	static int completePairs[TEST_PATH_PAIRS];
+	int complete = 0;
+	for (int i = 0; i < npairs; ++i)
+	{
+		int npath = 0;
+		if (query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, path, &npath, TEST_MAX_PATH) == DT_SUCCESS)
+			completePairs[complete++] = i;
+	}
+	REQUIRE(complete > 0);
+
+	const int rounds = 10;
+	int npath = 0;
+	clock_t begin = clock();
+	for (int r = 0; r < rounds; ++r)
+	{
+		for (int k = 0; k < complete; ++k)
+		{
+			const int i = completePairs[k];
+			query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, path, &npath, TEST_MAX_PATH);
+		}
+	}
+	const double plainMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+
+	begin = clock();
+	for (int r = 0; r < rounds; ++r)
+	{
+		for (int k = 0; k < complete; ++k)
+		{
+			const int i = completePairs[k];
+			cache.findPath(&query, refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, path, &npath, TEST_MAX_PATH);
+		}
+	}
+	const double cachedMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+
+	const int count = rounds * complete;
+	printf("BM_findPath          %d paths in %8.2f ms: %8.2f us/path\n", count, plainMs, plainMs * 1000.0 / count);
+	printf("BM_findPathCached    %d paths in %8.2f ms: %8.2f us/path (%d hits, %d bytes)\n",
+		   count, cachedMs, cachedMs * 1000.0 / count, cache.getHitCount(), cache.getMemUsed());
+
+	dtFreeNavMesh(nav);
+}
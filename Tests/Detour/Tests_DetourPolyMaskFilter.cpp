@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "catch.hpp"
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourPolyMaskFilter.h"
+
+#include "TestNavMesh.h"
+
+static const int TEST_MAX_PATH = 2048;
+static const int TEST_PATH_PAIRS = 300;
+
+static bool pathContains(const dtPolyRef* path, const int npath, dtPolyRef ref)
+{
+	for (int i = 0; i < npath; ++i)
+	{
+		if (path[i] == ref)
+			return true;
+	}
+	return false;
+}
+
+TEST_CASE("dtPolyMaskFilter")
+{
+	seedTestRandom();
+
+	TestBuildSettings settings;
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 65535)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	dtPolyMaskFilter mask;
+	REQUIRE(dtStatusFailed(mask.setPolyExcluded(refs[0], true)));
+	REQUIRE(dtStatusFailed(mask.init(0, &filter)));
+	REQUIRE(dtStatusFailed(mask.init(nav, 0)));
+	REQUIRE(dtStatusSucceed(mask.init(nav, &filter)));
+	REQUIRE(mask.getFilter() == &filter);
+	const int emptySize = mask.getMemUsed();
+
+	static dtPolyRef path[TEST_MAX_PATH];
+	static dtPolyRef maskPath[TEST_MAX_PATH];
+
+	// Finds a complete path with a polygon between the ends.
+	int pair = -1;
+	int npath = 0;
+	for (int i = 0; i < npairs && pair < 0; ++i)
+	{
+		if (query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter,
+						   path, &npath, TEST_MAX_PATH) == DT_SUCCESS && npath > 4)
+			pair = i;
+	}
+	REQUIRE(pair >= 0);
+	const dtPolyRef startRef = refs[pair*2], endRef = refs[pair*2+1];
+	const float* startPos = &pos[pair*2*3];
+	const float* endPos = &pos[(pair*2+1)*3];
+	const dtPolyRef blocked = path[npath/2];
+
+	SECTION("Without changes the results match dtQueryFilter")
+	{
+		for (int i = 0; i < npairs; ++i)
+		{
+			int nexpected = 0, nmask = 0;
+			const dtStatus expectedStatus = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+														   &filter, path, &nexpected, TEST_MAX_PATH);
+			const dtStatus status = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+												   &mask, maskPath, &nmask, TEST_MAX_PATH);
+			REQUIRE(status == expectedStatus);
+			REQUIRE(nmask == nexpected);
+			for (int j = 0; j < nmask; ++j)
+				REQUIRE(maskPath[j] == path[j]);
+
+			// The bidirectional search is run with the filter too.
+			const dtStatus expectedBidirStatus = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+																&filter, path, &nexpected, TEST_MAX_PATH, DT_FINDPATH_BIDIRECTIONAL);
+			const dtStatus bidirStatus = query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+														&mask, maskPath, &nmask, TEST_MAX_PATH, DT_FINDPATH_BIDIRECTIONAL);
+			REQUIRE(bidirStatus == expectedBidirStatus);
+			REQUIRE(nmask == nexpected);
+			for (int j = 0; j < nmask; ++j)
+				REQUIRE(maskPath[j] == path[j]);
+		}
+		REQUIRE(mask.getMemUsed() == emptySize);
+	}
+
+	SECTION("Excluded polygons are avoided without changing the mesh")
+	{
+		unsigned short flags = 0;
+		REQUIRE(dtStatusSucceed(nav->getPolyFlags(blocked, &flags)));
+
+		REQUIRE(dtStatusSucceed(mask.setPolyExcluded(blocked, true)));
+		REQUIRE(mask.isPolyExcluded(blocked));
+		REQUIRE(!mask.isPolyExcluded(startRef));
+		REQUIRE(mask.getMemUsed() > emptySize);
+
+		int nmask = 0;
+		REQUIRE(dtStatusSucceed(query.findPath(startRef, endRef, startPos, endPos, &mask, maskPath, &nmask, TEST_MAX_PATH)));
+		REQUIRE(!pathContains(maskPath, nmask, blocked));
+		REQUIRE(isTestPathConnected(*nav, maskPath, nmask));
+		int nbidir = 0;
+		REQUIRE(dtStatusSucceed(query.findPath(startRef, endRef, startPos, endPos, &mask, path, &nbidir, TEST_MAX_PATH,
+											   DT_FINDPATH_BIDIRECTIONAL)));
+		REQUIRE(!pathContains(path, nbidir, blocked));
+		REQUIRE(isTestPathConnected(*nav, path, nbidir));
+		REQUIRE(path[nbidir-1] == endRef);
+
+		// The mesh and other filters are not affected.
+		unsigned short flagsAfter = 0;
+		REQUIRE(dtStatusSucceed(nav->getPolyFlags(blocked, &flagsAfter)));
+		REQUIRE(flagsAfter == flags);
+		int nplain = 0;
+		REQUIRE(dtStatusSucceed(query.findPath(startRef, endRef, startPos, endPos, &filter, path, &nplain, TEST_MAX_PATH)));
+		REQUIRE(pathContains(path, nplain, blocked));
+
+		dtPolyMaskFilter other;
+		REQUIRE(dtStatusSucceed(other.init(nav, &filter)));
+		REQUIRE(!other.isPolyExcluded(blocked));
+
+		// Moving and ray casts stop at the excluded polygon.
+		float resultPos[3];
+		int nvisited = 0;
+		REQUIRE(dtStatusSucceed(query.moveAlongSurface(startRef, startPos, endPos, &mask, resultPos, maskPath, &nvisited, TEST_MAX_PATH)));
+		REQUIRE(!pathContains(maskPath, nvisited, blocked));
+		dtRaycastHit hit;
+		memset(&hit, 0, sizeof(hit));
+		hit.path = maskPath;
+		hit.maxPath = TEST_MAX_PATH;
+		REQUIRE(dtStatusSucceed(query.raycast(startRef, startPos, endPos, &mask, 0, &hit)));
+		REQUIRE(!pathContains(maskPath, hit.pathCount, blocked));
+
+		REQUIRE(dtStatusSucceed(mask.setPolyExcluded(blocked, false)));
+		REQUIRE(!mask.isPolyExcluded(blocked));
+		REQUIRE(dtStatusSucceed(query.findPath(startRef, endRef, startPos, endPos, &mask, maskPath, &nmask, TEST_MAX_PATH)));
+		REQUIRE(pathContains(maskPath, nmask, blocked));
+	}
+
+	SECTION("Cost scales steer the path")
+	{
+		REQUIRE(dtStatusFailed(mask.setPolyCostScale(blocked, 0.0f)));
+		REQUIRE(mask.getPolyCostScale(blocked) == 1.0f);
+		REQUIRE(dtStatusSucceed(mask.setPolyCostScale(blocked, 1000.0f)));
+		REQUIRE(mask.getPolyCostScale(blocked) == 1000.0f);
+
+		int nmask = 0;
+		REQUIRE(dtStatusSucceed(query.findPath(startRef, endRef, startPos, endPos, &mask, maskPath, &nmask, TEST_MAX_PATH)));
+		REQUIRE(!pathContains(maskPath, nmask, blocked));
+
+		mask.clearPolys();
+		REQUIRE(mask.getPolyCostScale(blocked) == 1.0f);
+		REQUIRE(mask.getMemUsed() == emptySize);
+	}
+
+	SECTION("Masks do not carry over to a new tile")
+	{
+		REQUIRE(dtStatusSucceed(mask.setPolyExcluded(blocked, true)));
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		nav->getTileAndPolyByRefUnsafe(blocked, &tile, &poly);
+		const int tx = tile->header->x, ty = tile->header->y;
+		REQUIRE(dtStatusSucceed(nav->removeTile(nav->getTileRef(tile), 0, 0)));
+		REQUIRE(!mask.isPolyExcluded(blocked));
+
+		TestGeom geom;
+		REQUIRE(loadTestGeom("nav_test.obj", geom));
+		int dataSize = 0;
+		unsigned char* data = buildTestTile(geom, settings, tx, ty, &dataSize);
+		REQUIRE(data != 0);
+		dtTileRef tileRef = 0;
+		REQUIRE(dtStatusSucceed(nav->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, &tileRef)));
+		const dtPolyRef newRef = nav->getPolyRefBase(nav->getTileByRef(tileRef)) | nav->decodePolyIdPoly(blocked);
+		REQUIRE(nav->isValidPolyRef(newRef));
+		REQUIRE(!mask.isPolyExcluded(newRef));
+		const dtMeshTile* newTile = 0;
+		nav->getTileAndPolyByRefUnsafe(newRef, &newTile, &poly);
+		REQUIRE(mask.passFilter(newRef, newTile, poly));
+	}
+
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtPolyMaskFilter benchmark findPath with polygon masks", "[.][benchmark]")
+{
+	seedTestRandom();
+
+	TestBuildSettings settings;
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 65535)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	dtPolyMaskFilter mask;
+	REQUIRE(dtStatusSucceed(mask.init(nav, &filter)));
+
+	// Exclude one polygon in the middle of every tenth path.
+	static dtPolyRef path[TEST_MAX_PATH];
+	int nexcluded = 0;
+	for (int i = 0; i < npairs; i += 10)
+	{
+		int n = 0;
+		query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, path, &n, TEST_MAX_PATH);
+		if (n > 2 && dtStatusSucceed(mask.setPolyExcluded(path[n/2], true)))
+			nexcluded++;
+	}
+
+	const char* names[] = { "dtQueryFilter", "dtPolyMaskFilter" };
+	for (int q = 0; q < 2; ++q)
+	{
+		const clock_t begin = clock();
+		for (int i = 0; i < npairs; ++i)
+		{
+			int n = 0;
+			if (q == 0)
+				query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter, path, &n, TEST_MAX_PATH);
+			else
+				query.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &mask, path, &n, TEST_MAX_PATH);
+		}
+		const double ms = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+		printf("BM_findPath_%-17s %d paths in %8.2f ms: %8.2f us/path (%d excluded, %d bytes)\n",
+			   names[q], npairs, ms, ms * 1000.0 / npairs, nexcluded, mask.getMemUsed());
+	}
+
+	dtFreeNavMesh(nav);
+}
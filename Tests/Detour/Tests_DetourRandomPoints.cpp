@@ -0,0 +1,208 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "catch.hpp"
+
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourRandomPoints.h"
+
+#include "TestNavMesh.h"
+
+static const int TEST_SAMPLES = 200000;
+
+// Separate generator, so the samples do not shift the locations picked by the other tests.
+static unsigned int sampleSeed = 0x2345678;
+static float sampleRandom()
+{
+	sampleSeed = sampleSeed * 1664525u + 1013904223u;
+	return (float)(sampleSeed >> 8) / 16777216.0f;
+}
+
+// Returns the area of the ground polygons of the tile passing the filter.
+static double getTestTileArea(const dtNavMesh& nav, const dtQueryFilter& filter, const dtMeshTile* tile)
+{
+	if (!tile->header)
+		return 0.0;
+	const dtPolyRef base = nav.getPolyRefBase(tile);
+	double area = 0.0;
+	for (int i = 0; i < tile->header->polyCount; ++i)
+	{
+		const dtPoly* p = &tile->polys[i];
+		if (p->getType() != DT_POLYTYPE_GROUND || !filter.passFilter(base | (dtPolyRef)i, tile, p))
+			continue;
+		for (int j = 2; j < p->vertCount; ++j)
+			area += dtTriArea2D(&tile->verts[p->verts[0]*3], &tile->verts[p->verts[j-1]*3], &tile->verts[p->verts[j]*3]);
+	}
+	return area;
+}
+
+// Samples points and requires the share of each tile to match its share of the area.
+static void checkTileShares(const dtNavMesh& nav, const dtNavMeshQuery& query, const dtQueryFilter& filter,
+							const dtRandomPointTable& table)
+{
+	const int maxTiles = nav.getMaxTiles();
+	int* counts = new int[maxTiles];
+	memset(counts, 0, sizeof(int)*maxTiles);
+
+	for (int i = 0; i < TEST_SAMPLES; ++i)
+	{
+		dtPolyRef ref = 0;
+		float pt[3];
+		REQUIRE(table.findRandomPoint(&query, sampleRandom, &ref, pt) == DT_SUCCESS);
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		REQUIRE(dtStatusSucceed(nav.getTileAndPolyByRef(ref, &tile, &poly)));
+		REQUIRE(poly->getType() == DT_POLYTYPE_GROUND);
+		REQUIRE(filter.passFilter(ref, tile, poly));
+		counts[nav.decodePolyIdTile(ref)]++;
+	}
+
+	double total = 0.0;
+	for (int i = 0; i < maxTiles; ++i)
+		total += getTestTileArea(nav, filter, nav.getTile(i));
+	REQUIRE(fabs(table.getTotalArea() - total) <= total * 1e-4);
+
+	for (int i = 0; i < maxTiles; ++i)
+	{
+		const double p = getTestTileArea(nav, filter, nav.getTile(i)) / total;
+		const double expected = p * TEST_SAMPLES;
+		const double sigma = sqrt(expected * (1.0 - p));
+		REQUIRE(fabs(counts[i] - expected) <= 5.0 * sigma + 1.0);
+	}
+	delete [] counts;
+}
+
+TEST_CASE("dtRandomPointTable")
+{
+	TestBuildSettings settings;
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 2048)));
+
+	dtRandomPointTable* table = dtAllocRandomPointTable();
+	REQUIRE(table != 0);
+	dtPolyRef ref = 0;
+	float pt[3];
+	REQUIRE(dtStatusFailed(table->findRandomPoint(&query, sampleRandom, &ref, pt)));
+	REQUIRE(dtStatusFailed(table->init(0, &filter)));
+	REQUIRE(dtStatusFailed(table->init(nav, 0)));
+	REQUIRE(dtStatusSucceed(table->init(nav, &filter)));
+	REQUIRE(table->getTotalArea() > 0.0f);
+
+	SECTION("Points are uniform over the area")
+	{
+		checkTileShares(*nav, query, filter, *table);
+
+		// The points are on their polygons.
+		for (int i = 0; i < 1000; ++i)
+		{
+			REQUIRE(table->findRandomPoint(&query, sampleRandom, &ref, pt) == DT_SUCCESS);
+			float closest[3];
+			bool inside = false;
+			REQUIRE(dtStatusSucceed(query.closestPointOnPoly(ref, pt, closest, &inside)));
+			REQUIRE(inside);
+			REQUIRE(dtVdist(pt, closest) < 0.01f);
+		}
+	}
+
+	SECTION("Updates follow tile and flag changes")
+	{
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		REQUIRE(table->findRandomPoint(&query, sampleRandom, &ref, pt) == DT_SUCCESS);
+		nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+		const int tx = tile->header->x, ty = tile->header->y;
+		const float tileArea = (float)getTestTileArea(*nav, filter, tile);
+		const float totalArea = table->getTotalArea();
+		const unsigned int removedIdx = nav->decodePolyIdTile(ref);
+
+		REQUIRE(dtStatusSucceed(nav->removeTile(nav->getTileRef(tile), 0, 0)));
+
+		// Until the update, points falling in the removed tile fail.
+		int failed = 0;
+		for (int i = 0; i < 10000; ++i)
+		{
+			const dtStatus status = table->findRandomPoint(&query, sampleRandom, &ref, pt);
+			if (dtStatusFailed(status))
+				failed++;
+			else
+				REQUIRE(nav->isValidPolyRef(ref));
+		}
+		REQUIRE(failed > 0);
+
+		REQUIRE(dtStatusSucceed(table->update()));
+		REQUIRE(fabsf(table->getTotalArea() - (totalArea - tileArea)) <= totalArea * 1e-4f);
+		for (int i = 0; i < 10000; ++i)
+		{
+			REQUIRE(table->findRandomPoint(&query, sampleRandom, &ref, pt) == DT_SUCCESS);
+			REQUIRE(nav->decodePolyIdTile(ref) != removedIdx);
+		}
+
+		TestGeom geom;
+		REQUIRE(loadTestGeom("nav_test.obj", geom));
+		int dataSize = 0;
+		unsigned char* data = buildTestTile(geom, settings, tx, ty, &dataSize);
+		REQUIRE(data != 0);
+		REQUIRE(dtStatusSucceed(nav->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		REQUIRE(dtStatusSucceed(table->update()));
+		REQUIRE(fabsf(table->getTotalArea() - totalArea) <= totalArea * 1e-4f);
+
+		// Excluded polygons are not picked once the table is updated.
+		REQUIRE(table->findRandomPoint(&query, sampleRandom, &ref, pt) == DT_SUCCESS);
+		const dtPolyRef excluded = ref;
+		REQUIRE(dtStatusSucceed(nav->setPolyFlags(excluded, 0)));
+		REQUIRE(dtStatusSucceed(table->update()));
+		REQUIRE(table->getTotalArea() < totalArea);
+		checkTileShares(*nav, query, filter, *table);
+		for (int i = 0; i < 10000; ++i)
+		{
+			REQUIRE(table->findRandomPoint(&query, sampleRandom, &ref, pt) == DT_SUCCESS);
+			REQUIRE(ref != excluded);
+		}
+	}
+
+	dtFreeRandomPointTable(table);
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtRandomPointTable benchmark findRandomPoint", "[.][benchmark]")
+{
+	TestBuildSettings settings;
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 2048)));
+
+	dtRandomPointTable* table = dtAllocRandomPointTable();
+	REQUIRE(table != 0);
+	REQUIRE(dtStatusSucceed(table->init(nav, &filter)));
+
+	const int count = 50000;
+	dtPolyRef ref = 0;
+	float pt[3];
+	clock_t begin = clock();
+	for (int i = 0; i < count; ++i)
+		query.findRandomPoint(&filter, sampleRandom, &ref, pt);
+	const double plainMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+
+	begin = clock();
+	for (int i = 0; i < count; ++i)
+		table->findRandomPoint(&query, sampleRandom, &ref, pt);
+	const double tableMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+
+	printf("BM_findRandomPoint       %d points in %8.2f ms: %8.3f us/point\n", count, plainMs, plainMs * 1000.0 / count);
+	printf("BM_findRandomPointTable  %d points in %8.2f ms: %8.3f us/point (%d bytes)\n",
+		   count, tableMs, tableMs * 1000.0 / count, table->getMemUsed());
+
+	dtFreeRandomPointTable(table);
+	dtFreeNavMesh(nav);
+}
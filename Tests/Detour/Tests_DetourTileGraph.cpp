@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "catch.hpp"
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourTileGraph.h"
+
+#include "TestNavMesh.h"
+
+static const int TEST_MAX_PATH = 2048;
+static const int TEST_PATH_PAIRS = 300;
+
+TEST_CASE("dtTileGraph")
+{
+	seedTestRandom();
+
+	// Small tiles make for long paths in tiles. The tiles are built once for all sections.
+	static TestTileCache tiles;
+	if (!tiles.isBuilt())
+	{
+		TestBuildSettings settings;
+		settings.tileSize = 8;
+		REQUIRE(tiles.build("dungeon.obj", settings));
+	}
+	dtNavMesh* nav = tiles.createNavMesh();
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtTileGraph* graph = dtAllocTileGraph();
+	REQUIRE(graph != 0);
+	REQUIRE(dtStatusFailed(graph->init(0, &filter)));
+	REQUIRE(dtStatusSucceed(graph->init(nav, &filter)));
+	REQUIRE(graph->getNodeCount() > 0);
+
+	dtNavMeshQuery fullQuery;
+	dtNavMeshQuery legQuery;
+	REQUIRE(dtStatusSucceed(fullQuery.init(nav, 65535)));
+	REQUIRE(dtStatusSucceed(legQuery.init(nav, 256)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(fullQuery, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	static dtPolyRef path[TEST_MAX_PATH];
+
+	SECTION("Finds the paths the full search finds")
+	{
+		int complete = 0;
+		for (int i = 0; i < npairs; ++i)
+		{
+			int npath = 0;
+			const dtStatus fullStatus = fullQuery.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+														   &filter, path, &npath, TEST_MAX_PATH);
+			REQUIRE(dtStatusSucceed(fullStatus));
+			const dtStatus status = graph->findPath(&legQuery, refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+													path, &npath, TEST_MAX_PATH);
+			REQUIRE(dtStatusSucceed(status));
+			REQUIRE(npath > 0);
+			REQUIRE(path[0] == refs[i*2]);
+			REQUIRE(isTestPathConnected(*nav, path, npath));
+			REQUIRE(dtStatusDetail(status, DT_PARTIAL_RESULT) == dtStatusDetail(fullStatus, DT_PARTIAL_RESULT));
+			if (!dtStatusDetail(status, DT_PARTIAL_RESULT))
+			{
+				REQUIRE(path[npath-1] == refs[i*2+1]);
+				complete++;
+			}
+		}
+		REQUIRE(complete > 0);
+	}
+
+	SECTION("Waypoints end at the end polygon")
+	{
+		dtPolyRef waypoints[64];
+		float waypointPos[64*3];
+		for (int i = 0; i < npairs; ++i)
+		{
+			int nwaypoints = 0;
+			const dtStatus status = graph->findWaypoints(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+														 waypoints, waypointPos, &nwaypoints, 64);
+			REQUIRE(dtStatusSucceed(status));
+			REQUIRE(nwaypoints > 0);
+			if (!dtStatusDetail(status, DT_PARTIAL_RESULT) && !dtStatusDetail(status, DT_BUFFER_TOO_SMALL))
+				REQUIRE(waypoints[nwaypoints-1] == refs[i*2+1]);
+		}
+	}
+
+	SECTION("Update after removing and adding tiles")
+	{
+		// Remove every third tile, the paths must not go through them.
+		int removed = 0;
+		for (int i = 0; i < nav->getMaxTiles(); i += 3)
+		{
+			const dtMeshTile* tile = ((const dtNavMesh*)nav)->getTile(i);
+			if (!tile->header)
+				continue;
+			REQUIRE(dtStatusSucceed(nav->removeTile(nav->getTileRef(tile), 0, 0)));
+			removed++;
+		}
+		REQUIRE(removed > 0);
+
+		// Stale graph, the start or end may be gone.
+		REQUIRE(dtStatusSucceed(graph->update()));
+
+		for (int i = 0; i < npairs; ++i)
+		{
+			if (!nav->isValidPolyRef(refs[i*2]) || !nav->isValidPolyRef(refs[i*2+1]))
+				continue;
+			int npath = 0;
+			const dtStatus fullStatus = fullQuery.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+														   &filter, path, &npath, TEST_MAX_PATH);
+			const dtStatus status = graph->findPath(&legQuery, refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+													path, &npath, TEST_MAX_PATH);
+			REQUIRE(dtStatusSucceed(status));
+			REQUIRE(isTestPathConnected(*nav, path, npath));
+			REQUIRE(dtStatusDetail(status, DT_PARTIAL_RESULT) == dtStatusDetail(fullStatus, DT_PARTIAL_RESULT));
+		}
+
+		// Adding the tiles back restores the connections.
+		for (int y = 0; y < tiles.getTileCountY(); ++y)
+		{
+			for (int x = 0; x < tiles.getTileCountX(); ++x)
+			{
+				if (nav->getTileAt(x, y, 0))
+					continue;
+				int dataSize = 0;
+				unsigned char* data = tiles.copyTile(x, y, &dataSize);
+				if (data && dtStatusFailed(nav->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)))
+					dtFree(data);
+			}
+		}
+		REQUIRE(dtStatusSucceed(graph->update()));
+
+		const int npairs2 = pickTestPathEnds(fullQuery, filter, TEST_PATH_PAIRS, refs, pos);
+		for (int i = 0; i < npairs2; ++i)
+		{
+			int npath = 0;
+			const dtStatus fullStatus = fullQuery.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+														   &filter, path, &npath, TEST_MAX_PATH);
+			const dtStatus status = graph->findPath(&legQuery, refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+													path, &npath, TEST_MAX_PATH);
+			REQUIRE(dtStatusSucceed(status));
+			REQUIRE(isTestPathConnected(*nav, path, npath));
+			REQUIRE(dtStatusDetail(status, DT_PARTIAL_RESULT) == dtStatusDetail(fullStatus, DT_PARTIAL_RESULT));
+		}
+	}
+
+	dtFreeTileGraph(graph);
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtTileGraph benchmark long paths", "[.][benchmark]")
+{
+	seedTestRandom();
+
+	TestTileCache tiles;
+	TestBuildSettings settings;
+	settings.tileSize = 8;
+	REQUIRE(tiles.build("dungeon.obj", settings));
+	dtNavMesh* nav = tiles.createNavMesh();
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtTileGraph* graph = dtAllocTileGraph();
+	REQUIRE(graph != 0);
+	REQUIRE(dtStatusSucceed(graph->init(nav, &filter)));
+
+	dtNavMeshQuery fullQuery;
+	dtNavMeshQuery legQuery;
+	REQUIRE(dtStatusSucceed(fullQuery.init(nav, 65535)));
+	REQUIRE(dtStatusSucceed(legQuery.init(nav, 256)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(fullQuery, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	static dtPolyRef path[TEST_MAX_PATH];
+	const char* names[] = { "findPath", "tileGraph" };
+	for (int q = 0; q < 2; ++q)
+	{
+		const clock_t begin = clock();
+		for (int i = 0; i < npairs; ++i)
+		{
+			int npath = 0;
+			if (q == 0)
+				fullQuery.findPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+								   &filter, path, &npath, TEST_MAX_PATH);
+			else
+				graph->findPath(&legQuery, refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3],
+								path, &npath, TEST_MAX_PATH);
+		}
+		const double ms = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+		printf("BM_%-12s %d paths in %8.2f ms: %8.2f us/path (graph %d nodes, %d bytes)\n",
+			   names[q], npairs, ms, ms * 1000.0 / npairs, graph->getNodeCount(), graph->getMemUsed());
+	}
+
+	dtFreeTileGraph(graph);
+	dtFreeNavMesh(nav);
+}
@@ -0,0 +1,377 @@
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "catch.hpp"
+
+#include "DetourAlloc.h"
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourTileStreamer.h"
+
+#include "TestNavMesh.h"
+
+static const int TEST_MAX_PATH = 256;
+
+// Reads the archive from memory and counts the bytes read.
+struct TestArchiveReader : public dtTileArchiveReader
+{
+	const unsigned char* archive;
+	int archiveSize;
+	int readSize;
+	int readCount;
+
+	virtual dtStatus read(const int offset, const int size, unsigned char* data)
+	{
+		if (offset < 0 || offset + size > archiveSize)
+			return DT_FAILURE | DT_INVALID_PARAM;
+		memcpy(data, archive + offset, size);
+		readSize += size;
+		readCount++;
+		return DT_SUCCESS;
+	}
+};
+
+// Runs the jobs of one update. Returns the number of jobs.
+static int runTestJobs(dtTileStreamer& streamer)
+{
+	dtTileStreamJob* jobs[16];
+	const int njobs = streamer.getJobs(jobs, 16);
+	for (int i = 0; i < njobs; ++i)
+		streamer.runJob(jobs[i]);
+	for (int i = 0; i < njobs; ++i)
+		REQUIRE(dtStatusSucceed(streamer.finishJob(jobs[i])));
+	return njobs;
+}
+
+// Updates the streamer until all tiles around the focus points are loaded. Returns the number of updates.
+static int streamTestTiles(dtTileStreamer& streamer)
+{
+	int updates = 0;
+	do
+	{
+		streamer.update();
+		updates++;
+		REQUIRE(updates < 1000);
+	}
+	while (runTestJobs(streamer) > 0);
+	return updates;
+}
+
+// Returns true if the tile is within the radius of the point.
+static bool isTestTileNear(const dtNavMeshParams& params, const int x, const int y, const float* pos, const float radius)
+{
+	const float bx = params.orig[0] + x*params.tileWidth;
+	const float bz = params.orig[2] + y*params.tileHeight;
+	const float dx = dtMax(0.0f, dtMax(bx - pos[0], pos[0] - (bx + params.tileWidth)));
+	const float dz = dtMax(0.0f, dtMax(bz - pos[2], pos[2] - (bz + params.tileHeight)));
+	return dx*dx + dz*dz <= radius*radius;
+}
+
+// Requires the loaded tiles to be exactly the tiles of the full navigation mesh near the point.
+static void checkTestTiles(const dtNavMesh& full, const dtNavMesh& streamed, const dtTileStreamer& streamer,
+						   const float* pos, const float radius)
+{
+	int expected = 0;
+	for (int i = 0; i < full.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = full.getTile(i);
+		if (!tile->header)
+			continue;
+		const bool near = isTestTileNear(*full.getParams(), tile->header->x, tile->header->y, pos, radius);
+		const dtMeshTile* loaded = streamed.getTileAt(tile->header->x, tile->header->y, tile->header->layer);
+		REQUIRE((loaded != 0) == near);
+		REQUIRE(streamer.isTileLoaded(tile->header->x, tile->header->y) == near);
+		if (!near)
+			continue;
+		expected++;
+		REQUIRE(loaded->header->polyCount == tile->header->polyCount);
+		REQUIRE(loaded->header->vertCount == tile->header->vertCount);
+		REQUIRE(loaded->dataSize == tile->dataSize);
+	}
+	REQUIRE(streamer.getLoadedTileCount() == expected);
+}
+
+TEST_CASE("dtTileStreamer")
+{
+	dtNavMesh* full = buildTestNavMesh("nav_test.obj");
+	REQUIRE(full != 0);
+	const dtNavMesh& cfull = *full;
+	const dtNavMeshParams& params = *full->getParams();
+
+	// The center of the tiles.
+	float bmin[3] = { FLT_MAX, 0, FLT_MAX }, bmax[3] = { -FLT_MAX, 0, -FLT_MAX };
+	int tileCount = 0;
+	for (int i = 0; i < cfull.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = cfull.getTile(i);
+		if (!tile->header)
+			continue;
+		dtVmin(bmin, tile->header->bmin);
+		dtVmax(bmax, tile->header->bmax);
+		tileCount++;
+	}
+	float center[3];
+	dtVlerp(center, bmin, bmax, 0.5f);
+	const float radius = params.tileWidth * 1.5f;
+
+	unsigned char* archive = 0;
+	int archiveSize = 0;
+	REQUIRE(dtStatusSucceed(dtCreateTileArchive(full, false, &archive, &archiveSize)));
+	const dtTileArchiveHeader* header = (const dtTileArchiveHeader*)archive;
+	REQUIRE(header->tileCount == tileCount);
+
+	TestArchiveReader reader;
+	reader.archive = archive;
+	reader.archiveSize = archiveSize;
+	reader.readSize = 0;
+	reader.readCount = 0;
+
+	dtNavMesh* nav = dtAllocNavMesh();
+	REQUIRE(nav != 0);
+	REQUIRE(dtStatusSucceed(nav->init(&header->params)));
+
+	dtTileStreamerParams streamerParams;
+	streamerParams.maxFocus = 4;
+	streamerParams.maxJobs = 8;
+	streamerParams.maxResidentSize = archiveSize * 4;
+	streamerParams.maxReadSize = archiveSize;
+
+	dtTileStreamer* streamer = dtAllocTileStreamer();
+	REQUIRE(streamer != 0);
+	const int indexSize = dtGetTileArchiveIndexSize(header);
+	REQUIRE(dtStatusFailed(streamer->init(nav, archive, (int)sizeof(dtTileArchiveHeader), &reader, &streamerParams)));
+	REQUIRE(dtStatusSucceed(streamer->init(nav, archive, indexSize, &reader, &streamerParams)));
+
+	SECTION("Tiles around the focus points are loaded and unloaded")
+	{
+		REQUIRE(streamer->update() == DT_SUCCESS);
+		REQUIRE(runTestJobs(*streamer) == 0);
+		REQUIRE(streamer->getLoadedTileCount() == 0);
+
+		const int focus = streamer->addFocus(center, radius);
+		REQUIRE(focus >= 0);
+		streamTestTiles(*streamer);
+		REQUIRE(streamer->getLoadedTileCount() > 0);
+		REQUIRE(streamer->getLoadedTileCount() < tileCount);
+		checkTestTiles(*full, *nav, *streamer, center, radius);
+
+		// Moving the focus point swaps the tiles.
+		float corner[3];
+		dtVcopy(corner, bmin);
+		streamer->setFocus(focus, corner, radius);
+		streamTestTiles(*streamer);
+		checkTestTiles(*full, *nav, *streamer, corner, radius);
+
+		// A second point keeps its own tiles.
+		const int second = streamer->addFocus(center, radius);
+		REQUIRE(second >= 0);
+		REQUIRE(second != focus);
+		streamTestTiles(*streamer);
+		int both = 0;
+		for (int i = 0; i < cfull.getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = cfull.getTile(i);
+			if (tile->header && (isTestTileNear(params, tile->header->x, tile->header->y, corner, radius) ||
+								 isTestTileNear(params, tile->header->x, tile->header->y, center, radius)))
+				both++;
+		}
+		REQUIRE(streamer->getLoadedTileCount() == both);
+
+		streamer->removeFocus(focus);
+		streamer->removeFocus(second);
+		streamTestTiles(*streamer);
+		REQUIRE(streamer->getLoadedTileCount() == 0);
+		REQUIRE(streamer->getResidentSize() == 0);
+		for (int i = 0; i < nav->getMaxTiles(); ++i)
+			REQUIRE(((const dtNavMesh*)nav)->getTile(i)->header == 0);
+	}
+
+	SECTION("Budgets limit the tiles loaded")
+	{
+		const int focus = streamer->addFocus(center, radius);
+		REQUIRE(focus >= 0);
+
+		// A read budget of one byte reads one tile per update.
+		dtTileStreamer limited;
+		dtTileStreamerParams readParams = streamerParams;
+		readParams.maxReadSize = 1;
+		REQUIRE(dtStatusSucceed(limited.init(nav, archive, indexSize, &reader, &readParams)));
+		REQUIRE(limited.addFocus(center, radius) >= 0);
+		const int updates = streamTestTiles(limited);
+		REQUIRE(updates == limited.getLoadedTileCount() + 1);
+		checkTestTiles(*full, *nav, limited, center, radius);
+
+		// The resident size stays within its budget, closest tiles first.
+		dtNavMesh* small = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(small->init(&header->params)));
+		dtTileStreamer constrained;
+		dtTileStreamerParams memoryParams = streamerParams;
+		memoryParams.maxResidentSize = limited.getResidentSize() / 2;
+		REQUIRE(dtStatusSucceed(constrained.init(small, archive, indexSize, &reader, &memoryParams)));
+		REQUIRE(constrained.addFocus(center, radius) >= 0);
+		REQUIRE(dtStatusDetail(constrained.update(), DT_OUT_OF_MEMORY));
+		runTestJobs(constrained);
+		streamTestTiles(constrained);
+		REQUIRE(constrained.getLoadedTileCount() > 0);
+		REQUIRE(constrained.getLoadedTileCount() < limited.getLoadedTileCount());
+		REQUIRE(constrained.getResidentSize() <= memoryParams.maxResidentSize);
+		int x = 0, y = 0;
+		small->calcTileLoc(center, &x, &y);
+		REQUIRE(constrained.isTileLoaded(x, y));
+		dtFreeNavMesh(small);
+	}
+
+	SECTION("Tiles no longer needed when loaded are dropped")
+	{
+		const int focus = streamer->addFocus(center, radius);
+		REQUIRE(streamer->update() == DT_SUCCESS);
+		REQUIRE(streamer->getJobCount() > 0);
+		REQUIRE(streamer->getResidentSize() > 0);
+		streamer->removeFocus(focus);
+		REQUIRE(streamer->update() == DT_SUCCESS);
+		runTestJobs(*streamer);
+		REQUIRE(streamer->getJobCount() == 0);
+		REQUIRE(streamer->getLoadedTileCount() == 0);
+		REQUIRE(streamer->getResidentSize() == 0);
+	}
+
+	SECTION("Paths through unloaded tiles are reported")
+	{
+		const int focus = streamer->addFocus(center, radius);
+		streamTestTiles(*streamer);
+
+		dtNavMeshQuery query;
+		REQUIRE(dtStatusSucceed(query.init(nav, 2048)));
+		dtQueryFilter filter;
+		const float ext[3] = { params.tileWidth, 100.0f, params.tileHeight };
+		dtPolyRef startRef = 0;
+		float startPos[3];
+		REQUIRE(dtStatusSucceed(query.findNearestPoly(center, ext, &filter, &startRef, startPos)));
+		REQUIRE(startRef != 0);
+
+		// The end is in a tile of the archive that is not loaded.
+		float endPos[3] = { 0, 0, 0 };
+		for (int i = 0; i < cfull.getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = cfull.getTile(i);
+			if (tile->header && !isTestTileNear(params, tile->header->x, tile->header->y, center, radius))
+			{
+				dtVlerp(endPos, tile->header->bmin, tile->header->bmax, 0.5f);
+				break;
+			}
+		}
+		int x = 0, y = 0;
+		nav->calcTileLoc(endPos, &x, &y);
+		REQUIRE(!streamer->isTileLoaded(x, y));
+
+		dtPolyRef path[TEST_MAX_PATH];
+		int npath = 0;
+		REQUIRE(dtStatusSucceed(query.findPath(startRef, startRef, startPos, startPos, &filter, path, &npath, TEST_MAX_PATH)));
+		REQUIRE(streamer->checkPath(path, npath, startPos) == DT_SUCCESS);
+		REQUIRE(streamer->checkPath(path, npath, endPos) == (DT_SUCCESS | DT_TILE_NOT_LOADED));
+
+		// Moving the focus away invalidates the path.
+		float corner[3];
+		dtVcopy(corner, bmin);
+		streamer->setFocus(focus, corner, params.tileWidth * 0.5f);
+		streamTestTiles(*streamer);
+		REQUIRE(streamer->checkPath(path, npath, startPos) == (DT_FAILURE | DT_TILE_NOT_LOADED));
+	}
+
+	SECTION("Quantized tiles are decoded by the jobs")
+	{
+		unsigned char* quantized = 0;
+		int quantizedSize = 0;
+		REQUIRE(dtStatusSucceed(dtCreateTileArchive(full, true, &quantized, &quantizedSize)));
+		REQUIRE(quantizedSize < archiveSize);
+		reader.archive = quantized;
+		reader.archiveSize = quantizedSize;
+
+		const dtTileArchiveHeader* quantizedHeader = (const dtTileArchiveHeader*)quantized;
+		REQUIRE(dtStatusSucceed(streamer->init(nav, quantized, dtGetTileArchiveIndexSize(quantizedHeader), &reader, &streamerParams)));
+		REQUIRE(streamer->addFocus(center, radius) >= 0);
+		streamTestTiles(*streamer);
+		checkTestTiles(*full, *nav, *streamer, center, radius);
+		REQUIRE(reader.readCount == streamer->getLoadedTileCount());
+		REQUIRE(reader.readSize < streamer->getResidentSize());
+
+		dtFree(quantized);
+	}
+
+	dtFreeTileStreamer(streamer);
+	dtFreeNavMesh(nav);
+	dtFree(archive);
+	dtFreeNavMesh(full);
+}
+
+TEST_CASE("dtTileStreamer benchmark streaming", "[.][benchmark]")
+{
+	dtNavMesh* full = buildTestNavMesh("nav_test.obj");
+	REQUIRE(full != 0);
+	const dtNavMesh& cfull = *full;
+	const dtNavMeshParams& params = *full->getParams();
+
+	float bmin[3] = { FLT_MAX, 0, FLT_MAX }, bmax[3] = { -FLT_MAX, 0, -FLT_MAX };
+	for (int i = 0; i < cfull.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = cfull.getTile(i);
+		if (!tile->header)
+			continue;
+		dtVmin(bmin, tile->header->bmin);
+		dtVmax(bmax, tile->header->bmax);
+	}
+	const float radius = params.tileWidth * 1.5f;
+
+	unsigned char* archives[2] = { 0, 0 };
+	int archiveSizes[2] = { 0, 0 };
+	REQUIRE(dtStatusSucceed(dtCreateTileArchive(full, false, &archives[0], &archiveSizes[0])));
+	REQUIRE(dtStatusSucceed(dtCreateTileArchive(full, true, &archives[1], &archiveSizes[1])));
+
+	const char* names[] = { "raw", "quantized" };
+	for (int q = 0; q < 2; ++q)
+	{
+		TestArchiveReader reader;
+		reader.archive = archives[q];
+		reader.archiveSize = archiveSizes[q];
+		reader.readSize = 0;
+		reader.readCount = 0;
+
+		dtTileStreamerParams streamerParams;
+		streamerParams.maxFocus = 4;
+		streamerParams.maxJobs = 8;
+		streamerParams.maxResidentSize = archiveSizes[0] * 4;
+		streamerParams.maxReadSize = archiveSizes[0];
+
+		const dtTileArchiveHeader* h = (const dtTileArchiveHeader*)reader.archive;
+		dtNavMesh* walked = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(walked->init(&h->params)));
+		dtTileStreamer walker;
+		REQUIRE(dtStatusSucceed(walker.init(walked, reader.archive, dtGetTileArchiveIndexSize(h), &reader, &streamerParams)));
+		const int focus = walker.addFocus(bmin, radius);
+		streamTestTiles(walker);
+		reader.readSize = 0;
+		reader.readCount = 0;
+
+		// Walk the focus point across the tiles.
+		const int steps = 50;
+		const clock_t begin = clock();
+		for (int i = 0; i <= steps; ++i)
+		{
+			float pos[3];
+			dtVlerp(pos, bmin, bmax, (float)i / steps);
+			walker.setFocus(focus, pos, radius);
+			streamTestTiles(walker);
+		}
+		const double ms = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+		printf("BM_tileStreamer_%-9s %d steps in %8.2f ms: %d tiles read, %d bytes (%d byte archive)\n",
+			   names[q], steps, ms, reader.readCount, reader.readSize, reader.archiveSize);
+		dtFreeNavMesh(walked);
+	}
+
+	dtFree(archives[0]);
+	dtFree(archives[1]);
+	dtFreeNavMesh(full);
+}
@@ -0,0 +1,131 @@
+#include "catch.hpp"
+
+#include "DetourAlloc.h"
+#include "DetourNavMesh.h"
+#include "DetourTileTracker.h"
+
+#include "TestNavMesh.h"
+
+TEST_CASE("dtTileTracker")
+{
+	TestBuildSettings settings;
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+
+	dtTileTracker tracker;
+	REQUIRE(dtStatusFailed(tracker.init(0)));
+	REQUIRE(dtStatusSucceed(tracker.init(nav)));
+
+	// The first poll reports every tile as added.
+	int ntiles = 0;
+	REQUIRE(tracker.poll());
+	for (int i = 0; i < tracker.getSlotCount(); ++i)
+	{
+		const dtMeshTile* tile = nav->getTile(i);
+		REQUIRE(tracker.getChanges(i) == (tile->header ? DT_TILE_ADDED : 0));
+		REQUIRE(tracker.getSalt(i) == (tile->header ? tile->salt : 0));
+		if (tile->header)
+			ntiles++;
+	}
+	REQUIRE(ntiles > 1);
+	REQUIRE(!tracker.poll());
+
+	// Find a tile with neighbours.
+	const dtMeshTile* tile = 0;
+	const dtMeshTile* neis[DT_MAX_TILE_LAYERS];
+	for (int i = 0; i < tracker.getSlotCount() && !tile; ++i)
+	{
+		const dtMeshTile* t = nav->getTile(i);
+		if (t->header && t->header->polyCount > 0 && nav->getTilesAt(t->header->x+1, t->header->y, neis, DT_MAX_TILE_LAYERS) > 0)
+			tile = t;
+	}
+	REQUIRE(tile != 0);
+	const int tileIdx = (int)tile->index;
+	const int neiIdx = (int)neis[0]->index;
+
+	TestGeom geom;
+	REQUIRE(loadTestGeom("nav_test.obj", geom));
+	const int tx = tile->header->x, ty = tile->header->y;
+	int dataSize = 0;
+	unsigned char* data = buildTestTile(geom, settings, tx, ty, &dataSize);
+	REQUIRE(data != 0);
+
+	SECTION("Changing polygon flags revises the tile")
+	{
+		const dtPolyRef ref = nav->getPolyRefBase(tile);
+		unsigned short flags = 0;
+		REQUIRE(dtStatusSucceed(nav->getPolyFlags(ref, &flags)));
+		REQUIRE(dtStatusSucceed(nav->setPolyFlags(ref, (unsigned short)(flags ^ 0x8000))));
+
+		// Finding the changes does not remember them.
+		REQUIRE(tracker.findChanges(tileIdx) == DT_TILE_REVISED);
+		REQUIRE(tracker.findChanges(tileIdx) == DT_TILE_REVISED);
+		REQUIRE(tracker.findChanges(neiIdx) == 0);
+
+		REQUIRE(tracker.poll());
+		REQUIRE(tracker.getChanges(tileIdx) == DT_TILE_REVISED);
+		REQUIRE(tracker.getChanges(neiIdx) == 0);
+		REQUIRE(!tracker.poll());
+		REQUIRE(tracker.getChanges(tileIdx) == 0);
+		dtFree(data);
+	}
+
+	SECTION("Removing and adding a tile revises its neighbours")
+	{
+		const unsigned int salt = tile->salt;
+		REQUIRE(dtStatusSucceed(nav->removeTile(nav->getTileRef(tile), 0, 0)));
+		REQUIRE(tracker.poll());
+		REQUIRE(tracker.getChanges(tileIdx) == DT_TILE_REMOVED);
+		REQUIRE(tracker.getChanges(neiIdx) == DT_TILE_REVISED);
+		REQUIRE(tracker.getSalt(tileIdx) == 0);
+
+		dtTileRef ref = 0;
+		REQUIRE(dtStatusSucceed(nav->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, &ref)));
+		const dtMeshTile* added = nav->getTileByRef(ref);
+		REQUIRE(added->header->x == tx);
+		REQUIRE(added->header->y == ty);
+		REQUIRE(tracker.poll());
+		REQUIRE(tracker.getChanges((int)added->index) == DT_TILE_ADDED);
+		REQUIRE(tracker.getChanges(neiIdx) == DT_TILE_REVISED);
+		REQUIRE(tracker.getSalt((int)added->index) == added->salt);
+		if ((int)added->index == tileIdx)
+			REQUIRE(added->salt != salt);
+	}
+
+	SECTION("Replacing a tile between polls reports both")
+	{
+		// Restoring the tile reference keeps the salt, the tile is told apart by its data.
+		const dtTileRef ref = nav->getTileRef(tile);
+		REQUIRE(dtStatusSucceed(nav->removeTile(ref, 0, 0)));
+		REQUIRE(dtStatusSucceed(nav->addTile(data, dataSize, DT_TILE_FREE_DATA, ref, 0)));
+		REQUIRE(nav->getTile(tileIdx)->salt == tracker.getSalt(tileIdx));
+		REQUIRE(tracker.findChanges(tileIdx) == (DT_TILE_REMOVED | DT_TILE_ADDED));
+		REQUIRE(tracker.poll());
+		REQUIRE(tracker.getChanges(tileIdx) == (DT_TILE_REMOVED | DT_TILE_ADDED));
+	}
+
+	SECTION("Tiles in slots created after init are tracked")
+	{
+		// Re-add the tile in a slot past the ones the mesh had created when the tracker was made.
+		const int slotCount = nav->getTileSlotCount();
+		const int newIdx = slotCount + 20;
+		REQUIRE(newIdx < nav->getMaxTiles());
+		REQUIRE(tracker.getSlotCount() == slotCount);
+		REQUIRE(dtStatusSucceed(nav->removeTile(nav->getTileRef(tile), 0, 0)));
+		dtTileRef ref = 0;
+		REQUIRE(dtStatusSucceed(nav->addTile(data, dataSize, DT_TILE_FREE_DATA, nav->encodePolyId(1, newIdx, 0), &ref)));
+		REQUIRE(nav->getTileSlotCount() > newIdx);
+		REQUIRE(tracker.findChanges(newIdx) == DT_TILE_ADDED);
+
+		REQUIRE(dtStatusSucceed(tracker.reserve()));
+		REQUIRE(tracker.poll());
+		REQUIRE(tracker.getSlotCount() == nav->getTileSlotCount());
+		REQUIRE(tracker.getSlotCapacity() >= tracker.getSlotCount());
+		REQUIRE(tracker.getChanges(tileIdx) == DT_TILE_REMOVED);
+		REQUIRE(tracker.getChanges(newIdx) == DT_TILE_ADDED);
+		REQUIRE(tracker.getSalt(newIdx) == nav->getTileByRef(ref)->salt);
+		REQUIRE(!tracker.poll());
+	}
+
+	dtFreeNavMesh(nav);
+}
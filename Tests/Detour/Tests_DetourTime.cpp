@@ -0,0 +1,204 @@
+#include <stdio.h>
+
+#include "catch.hpp"
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourTime.h"
+
+#include "TestNavMesh.h"
+
+static const int TEST_MAX_PATH = 2048;
+static const int TEST_PATH_PAIRS = 100;
+
+// A clock that advances by a fixed step every time it is read.
+static const dtTimeVal FAKE_CLOCK_STEP = 5;
+static dtTimeVal fakeClockTime = 0;
+
+static dtTimeVal fakeClock()
+{
+	fakeClockTime += FAKE_CLOCK_STEP;
+	return fakeClockTime;
+}
+
+// Runs a sliced search to the end with iteration budgets and returns its finalized result.
+static dtStatus findSlicedPath(dtNavMeshQuery& query, const dtQueryFilter& filter,
+							   dtPolyRef startRef, dtPolyRef endRef, const float* startPos, const float* endPos,
+							   dtPolyRef* path, int* npath, int* iterations)
+{
+	*iterations = 0;
+	dtStatus status = query.initSlicedFindPath(startRef, endRef, startPos, endPos, &filter);
+	while (dtStatusInProgress(status))
+	{
+		int iters = 0;
+		status = query.updateSlicedFindPath(64, &iters);
+		*iterations += iters;
+	}
+	return query.finalizeSlicedFindPath(path, npath, TEST_MAX_PATH);
+}
+
+TEST_CASE("dtGetTimeUsec")
+{
+	const dtTimeVal a = dtGetTimeUsec();
+	const dtTimeVal b = dtGetTimeUsec();
+	REQUIRE(b >= a);
+
+	dtTimeSetCustom(fakeClock);
+	fakeClockTime = 0;
+	REQUIRE(dtGetTimeUsec() == FAKE_CLOCK_STEP);
+	REQUIRE(dtGetTimeUsec() == FAKE_CLOCK_STEP*2);
+	dtTimeSetCustom(0);
+	REQUIRE(dtGetTimeUsec() >= b);
+
+	dtTimeBudgetStats stats;
+	dtResetTimeBudgetStats(stats);
+	REQUIRE(stats.getItersPerUsec() == 0.0f);
+	dtAddTimeBudgetUpdate(stats, 300, 100, 120);
+	dtAddTimeBudgetUpdate(stats, 500, 150, 120);
+	REQUIRE(stats.updates == 2);
+	REQUIRE(stats.overruns == 1);
+	REQUIRE(stats.iterations == 800);
+	REQUIRE(stats.time == 250);
+	REQUIRE(stats.maxTime == 150);
+	REQUIRE(stats.getItersPerUsec() == Approx(3.2f));
+}
+
+TEST_CASE("dtNavMeshQuery time budgeted sliced search")
+{
+	seedTestRandom();
+
+	TestBuildSettings settings;
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 65535)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	static dtPolyRef path[TEST_MAX_PATH];
+	static dtPolyRef expected[TEST_MAX_PATH];
+
+	SECTION("Invalid budgets are rejected")
+	{
+		REQUIRE(query.initSlicedFindPath(refs[0], refs[1], &pos[0], &pos[3], &filter) != 0);
+		int iters = -1;
+		REQUIRE(dtStatusDetail(query.updateSlicedFindPathTimed(-1, 16, &iters), DT_INVALID_PARAM));
+		REQUIRE(iters == 0);
+		REQUIRE(dtStatusDetail(query.updateSlicedFindPathTimed(100, 0, &iters), DT_INVALID_PARAM));
+		REQUIRE(query.getSlicedStats().updates == 0);
+	}
+
+	SECTION("Updates stop when the budget is used")
+	{
+		// With the fake clock each slice takes one clock step, so a budget of four steps
+		// allows exactly four slices per update.
+		const int checkIters = 8;
+		const int budget = (int)FAKE_CLOCK_STEP * 4;
+
+		int searched = 0;
+		for (int i = 0; i < npairs; ++i)
+		{
+			const dtPolyRef startRef = refs[i*2], endRef = refs[i*2+1];
+			const float* startPos = &pos[i*2*3];
+			const float* endPos = &pos[(i*2+1)*3];
+			int nexpected = 0, expectedIters = 0;
+			const dtStatus expectedStatus = findSlicedPath(query, filter, startRef, endRef, startPos, endPos,
+														   expected, &nexpected, &expectedIters);
+
+			query.resetSlicedStats();
+			dtTimeSetCustom(fakeClock);
+			int totalIters = 0;
+			dtStatus status = query.initSlicedFindPath(startRef, endRef, startPos, endPos, &filter);
+			while (dtStatusInProgress(status))
+			{
+				int iters = 0;
+				status = query.updateSlicedFindPathTimed(budget, checkIters, &iters);
+				REQUIRE(iters <= checkIters*4);
+				if (dtStatusInProgress(status))
+					REQUIRE(iters == checkIters*4);
+				totalIters += iters;
+			}
+			dtTimeSetCustom(0);
+
+			int npath = 0;
+			status = query.finalizeSlicedFindPath(path, &npath, TEST_MAX_PATH);
+			REQUIRE(status == expectedStatus);
+			REQUIRE(npath == nexpected);
+			for (int j = 0; j < npath; ++j)
+				REQUIRE(path[j] == expected[j]);
+
+			const dtTimeBudgetStats& stats = query.getSlicedStats();
+			REQUIRE(totalIters == expectedIters);
+			REQUIRE(stats.iterations == totalIters);
+			REQUIRE(stats.overruns == 0);
+			REQUIRE(stats.maxTime <= budget);
+			if (stats.updates > 0)
+				searched++;
+		}
+		REQUIRE(searched > 0);
+	}
+
+	SECTION("A zero budget still makes progress")
+	{
+		dtTimeSetCustom(fakeClock);
+		bool progressed = false;
+		for (int i = 0; i < npairs && !progressed; ++i)
+		{
+			dtStatus status = query.initSlicedFindPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter);
+			if (!dtStatusInProgress(status))
+				continue;
+			int iters = 0;
+			status = query.updateSlicedFindPathTimed(0, 4, &iters);
+			REQUIRE(iters > 0);
+			REQUIRE(iters <= 4);
+			progressed = true;
+		}
+		dtTimeSetCustom(0);
+		REQUIRE(progressed);
+		REQUIRE(query.getSlicedStats().updates == 1);
+		REQUIRE(query.getSlicedStats().overruns == 1);
+	}
+
+	dtFreeNavMesh(nav);
+}
+
+TEST_CASE("dtNavMeshQuery benchmark iterations per microsecond", "[.][benchmark]")
+{
+	seedTestRandom();
+
+	TestBuildSettings settings;
+	dtNavMesh* nav = buildTestNavMesh("nav_test.obj", settings);
+	REQUIRE(nav != 0);
+
+	dtQueryFilter filter;
+	dtNavMeshQuery query;
+	REQUIRE(dtStatusSucceed(query.init(nav, 65535)));
+
+	static dtPolyRef refs[TEST_PATH_PAIRS*2];
+	static float pos[TEST_PATH_PAIRS*2*3];
+	const int npairs = pickTestPathEnds(query, filter, TEST_PATH_PAIRS, refs, pos);
+	REQUIRE(npairs > 0);
+
+	const int budget = 100;
+	const int checkIters[] = { 1, 16, 128 };
+	for (int c = 0; c < 3; ++c)
+	{
+		query.resetSlicedStats();
+		for (int i = 0; i < npairs; ++i)
+		{
+			dtStatus status = query.initSlicedFindPath(refs[i*2], refs[i*2+1], &pos[i*2*3], &pos[(i*2+1)*3], &filter);
+			while (dtStatusInProgress(status))
+				status = query.updateSlicedFindPathTimed(budget, checkIters[c], 0);
+		}
+		const dtTimeBudgetStats& stats = query.getSlicedStats();
+		printf("BM_updateSlicedFindPathTimed check every %3d iters: %8.2f iters/us, %d updates, %d overruns, max %d us\n",
+			   checkIters[c], stats.getItersPerUsec(), stats.updates, stats.overruns, (int)stats.maxTime);
+	}
+
+	dtFreeNavMesh(nav);
+}